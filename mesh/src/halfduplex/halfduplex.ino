@@ -3,14 +3,26 @@
 #include "../src/models/packet.h"
 #include "../src/storage/SdManager.h"
 #include "../src/comms/LoraManager.h"
+#include "../src/comms/Airtime.h"
+#include "../src/bus/SpiArbiter.h"
 #include "../src/app/ResearchStateMachine.h"
+#include "../src/app/WindowedSender.h"
+#include "../src/app/TransferTask.h"
+#include "../src/app/Reassembler.h"
+#include "../src/app/WorkerTask.h"
 #include "../src/display/StatusDisplay.h"
+#include "../src/mesh/MeshRouter.h"
+#include "../src/util/StageProfiler.h"
+#include "../src/util/HeapMonitor.h"
 
 SdManager sdMgr;
 bool g_sd_ready = false;
 
 LoRaManager lora;
+Reassembler reassembler(sdMgr);
 ResearchStateMachine state("HD");
+WindowedSender windowSender(lora, sdMgr);
+TransferTask transfer(lora, sdMgr, state, windowSender);
 
 uint16_t g_session_id;
 uint16_t g_seq_num;
@@ -21,13 +33,15 @@ constexpr float kDefaultLat = 0.0f;
 constexpr float kDefaultLon = 0.0f;
 
 constexpr const char* kPayloadFile = "lora_payload_new.bin";
-constexpr uint8_t kPayloadCodec = CODEC_RAW_PCM;
+constexpr uint8_t kPayloadCodec = MESH_PAYLOAD_CODEC;
 constexpr uint16_t kPayloadSampleHz = 8000;
 constexpr uint16_t kPayloadDurationMs = 0;
 constexpr uint8_t kMaxAckRetries = 2;
 constexpr uint32_t kButtonDebounceMs = 35;
 constexpr uint32_t kIdleDisplayTickMs = 500;
 constexpr uint32_t kIdleSerialTickMs = 2000;
+// Idle poll while the radio is in duty-cycled RX (see rx.ino).
+constexpr uint32_t kDutyCycledPollMs = 20;
 
 #if MESH_TX_BUTTON_ACTIVE_LOW
 constexpr uint8_t kButtonPressedLevel = LOW;
@@ -42,80 +56,53 @@ static uint32_t g_lastIdleDisplayMs = 0;
 static uint32_t g_lastIdleSerialMs = 0;
 static uint8_t g_idleSpinner = 0;
 
-static void withRetrySuffix(char* out, size_t outLen, const char* baseStatus, uint8_t retryIndex)
+// MESH_DUAL_CORE: a fragment write that failed on writer after its ACK
+// goes back to the reassembler, which asks for the fragment again. END
+// waits for the queue first so it never settles on a write still in flight.
+static void takeStoreFailures(bool settle)
 {
-    snprintf(out, outLen, "%s_R%u", baseStatus, static_cast<unsigned>(retryIndex));
-}
-
-static uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t len)
-{
-    for (size_t i = 0; i < len; ++i)
+#if MESH_DUAL_CORE
+    if (settle)
     {
-        crc ^= data[i];
-        for (uint8_t bit = 0; bit < 8; ++bit)
-        {
-            crc = (crc & 1U) ? ((crc >> 1) ^ 0xEDB88320UL) : (crc >> 1);
-        }
+        sdMgr.waitStoreDrained();
     }
-    return crc;
-}
-
-static const char* packetTypeLabel(uint8_t packetType)
-{
-    switch (packetType)
+    SdManager::StoreFailure failed;
+    while (sdMgr.takeStoreFailure(failed))
     {
-    case PKT_AUDIO_START: return "START";
-    case PKT_AUDIO_DATA: return "DATA";
-    case PKT_AUDIO_END: return "END";
-    case PKT_ACK: return "ACK";
-    default: return "UNKNOWN";
+        reassembler.onStoreFailed(failed);
     }
+#else
+    (void)settle;
+#endif
 }
 
-static bool getPayloadStats(SdManager& manager, const char* filename,
-                            uint32_t& totalSize, uint16_t& totalFrags, uint32_t& payloadCrc)
+static void logWindowFragment(uint32_t txTimeMs, bool ackOk, uint16_t seqNum,
+                              int16_t fragIndex, uint16_t fragLen,
+                              LogStatus status, uint8_t retryIndex,
+                              uint32_t toaMs, uint32_t txMs)
 {
-    totalSize = 0;
-    totalFrags = 0;
-    payloadCrc = 0;
-
-    if (!manager.openAudioFile(filename))
+    if (ackOk)
     {
-        Serial.printf("[HD] Unable to open payload file: %s\n", filename);
-        return false;
+        StatusDisplay::onPacketSent();
     }
-
-    uint32_t crcState = 0xFFFFFFFFUL;
-    uint32_t fragCount = 0;
-    AudioPacket packet;
-    while (manager.readAudioChunk(packet))
+    if (!g_sd_ready)
     {
-        if (packet.bytesRead <= 0)
-        {
-            continue;
-        }
-        totalSize += static_cast<uint32_t>(packet.bytesRead);
-        crcState = crc32Update(crcState, packet.buffer, static_cast<size_t>(packet.bytesRead));
-        fragCount++;
+        return;
     }
 
-    manager.closeAudioFile();
+    // Arrival time of the ACK frame, not of this (possibly later) log call.
+    const uint32_t ackTimeMs = ackOk ? lora.getLastRxMs() : millis();
+    const int rssi = ackOk ? static_cast<int>(lora.getLastRSSI()) : 0;
+    const float snr = ackOk ? lora.getLastSNR() : 0.0f;
 
-    if (totalSize == 0 || fragCount == 0)
-    {
-        Serial.println("[HD] Payload file is empty");
-        return false;
-    }
+    Serial.printf("[HD][LOG] type=DATA status=%s retry=%u seq=%u tx=%lu ack=%lu toa=%lu tx_ms=%lu\n",
+                  logStatusLabel(status), static_cast<unsigned>(retryIndex), seqNum,
+                  static_cast<unsigned long>(txTimeMs), static_cast<unsigned long>(ackTimeMs),
+                  static_cast<unsigned long>(toaMs), static_cast<unsigned long>(txMs));
 
-    if (fragCount > 0xFFFF)
-    {
-        Serial.printf("[HD] Payload too large, fragments=%lu exceeds protocol max\n", static_cast<unsigned long>(fragCount));
-        return false;
-    }
-
-    totalFrags = static_cast<uint16_t>(fragCount);
-    payloadCrc = ~crcState;
-    return true;
+    sdMgr.logTransmission(kDefaultLat, kDefaultLon, txTimeMs, ackTimeMs, rssi, snr,
+                          g_session_id, seqNum, fragIndex, fragLen, PKT_AUDIO_DATA_WIN, status, retryIndex,
+                          0, toaMs, txMs);
 }
 
 static bool wasTxButtonPressed()
@@ -165,6 +152,16 @@ static void publishIdleHeartbeat()
     }
 }
 
+// Rows and (auto) fragment sizing follow the rate ADR settled on.
+static void onLinkRateChanged()
+{
+    const LoRaRate& rate = lora.rate();
+    sdMgr.setLinkSf(rate.sf);
+#if MESH_FRAG_SIZE == MESH_FRAG_SIZE_AUTO
+    sdMgr.setChunkSize(optimalFragmentSize(rate.sf, bwCodeToKhz(rate.bwCode), rate.cr));
+#endif
+}
+
 static void processIncomingPacket()
 {
     uint8_t raw[LORA_MAX_PAYLOAD] = {0};
@@ -175,36 +172,75 @@ static void processIncomingPacket()
         return;
     }
 
-    state.transition(ResearchEvent::RECEIVE_WINDOW);
+    // Mid-transfer the FSM belongs to the sender; the frame is still handled.
+    const bool rxWindow = state.transition(ResearchEvent::RECEIVE_WINDOW);
+    const StatusDisplay::LoRaState after = transfer.busy() ? StatusDisplay::LORA_TRANSMITTING
+                                                           : StatusDisplay::LORA_OK_IDLE;
     StatusDisplay::setLoRa(StatusDisplay::LORA_RECEIVING);
 
     if (receivedLen < LORA_HEADER_SIZE)
     {
         Serial.printf("[HD][RX] Dropped short packet len=%u\n", static_cast<unsigned>(receivedLen));
-        state.transition(ResearchEvent::RX_PACKET_DONE);
-        StatusDisplay::setLoRa(StatusDisplay::LORA_OK_IDLE);
+        if (rxWindow)
+        {
+            state.transition(ResearchEvent::RX_PACKET_DONE);
+        }
+        StatusDisplay::setLoRa(after);
         return;
     }
 
     LoRaHeader hdr;
     deserializeHeader(raw, &hdr);
     const uint8_t packetType = getType(hdr.ver_type);
-    const char* packetTypeStr = packetTypeLabel(packetType);
 
     const uint32_t rxTimeMs = millis();
     const int rssi = static_cast<int>(lora.getLastRSSI());
     const float snr = lora.getLastSNR();
 
+    const uint8_t* body = raw + LORA_HEADER_SIZE;
+    const size_t bodyLen = receivedLen - LORA_HEADER_SIZE;
+
+    // Transfer frames go through the reassembler first so the log row and
+    // the ACK status reflect where the fragment landed.
     int16_t fragIndex = -1;
+    int16_t rebuilt = -1;   // a fragment this DATA let held parity rebuild
     uint16_t fragLen = 0;
-    if (packetType == PKT_AUDIO_DATA)
+    LogStatus rxStatus = LOG_STATUS_RX_RECV;
+    uint8_t ackStatus = ACK_STATUS_OK;
+    ResumeNack nack = {};
+    if (expectsPerFrameAck(packetType) || packetType == PKT_AUDIO_DATA_WIN ||
+        packetType == PKT_AUDIO_PARITY || packetType == PKT_RESUME)
     {
-        fragIndex = static_cast<int16_t>(hdr.seq_num);
-        fragLen = static_cast<uint16_t>(receivedLen - LORA_HEADER_SIZE);
+        ReassemblyResult result;
+        takeStoreFailures(packetType == PKT_AUDIO_END);
+        if (packetType == PKT_AUDIO_START)
+        {
+            result = reassembler.onStart(hdr, body, bodyLen);
+        }
+        else if (packetType == PKT_RESUME)
+        {
+            result = reassembler.onResume(hdr, body, bodyLen, &nack);
+        }
+        else if (packetType == PKT_AUDIO_END)
+        {
+            result = reassembler.onEnd(hdr, body, bodyLen);
+        }
+        else if (packetType == PKT_AUDIO_PARITY)
+        {
+            // fragIndex is the fragment the parity rebuilt, if any.
+            result = reassembler.onParity(hdr, body, bodyLen, &fragIndex);
+        }
+        else
+        {
+            fragLen = static_cast<uint16_t>(bodyLen);
+            result = reassembler.onData(hdr, body, bodyLen, &fragIndex, &rebuilt);
+        }
+        rxStatus = Reassembler::logStatus(result);
+        ackStatus = Reassembler::ackStatusFor(result);
     }
 
     Serial.printf("[HD][RX] type=%s seq=%u sess=0x%04X len=%u RSSI=%d SNR=%.1f\n",
-                  packetTypeStr,
+                  packetTypeLabel(packetType),
                   hdr.seq_num,
                   hdr.session_id,
                   static_cast<unsigned>(receivedLen),
@@ -217,274 +253,240 @@ static void processIncomingPacket()
     {
         sdMgr.logTransmission(kDefaultLat, kDefaultLon, rxTimeMs, rxTimeMs, rssi, snr,
                               hdr.session_id, hdr.seq_num, fragIndex, fragLen,
-                              packetTypeStr, "RX_RECV");
+                              packetType, rxStatus);
+        if (rebuilt >= 0)
+        {
+            sdMgr.logTransmission(kDefaultLat, kDefaultLon, rxTimeMs, rxTimeMs, rssi, snr,
+                                  hdr.session_id, hdr.seq_num, rebuilt, 0,
+                                  packetType, LOG_STATUS_RX_FEC_RECOVERED);
+        }
     }
 
-    // ACK frames should never be ACKed back.
-    if (packetType != PKT_ACK)
+    if (packetType == PKT_WINDOW_POLL && bodyLen >= sizeof(WindowPollPayload))
     {
+        WindowPollPayload poll;
+        deserializeWindowPoll(body, &poll);
+        takeStoreFailures(false);
+        const uint32_t bitmap = reassembler.windowBitmap(hdr, poll.base_seq, poll.count);
         const uint32_t ackTimeMs = millis();
-        const bool ackSent = lora.sendAckFor(hdr, ACK_STATUS_OK);
+        const bool ackSent = lora.sendWindowAckFor(hdr, poll.base_seq, bitmap);
 
         if (g_sd_ready)
         {
             sdMgr.logTransmission(kDefaultLat, kDefaultLon, rxTimeMs, ackTimeMs, rssi, snr,
-                                  hdr.session_id, hdr.seq_num, fragIndex, fragLen,
-                                  packetTypeStr, ackSent ? "ACK_SENT" : "ACK_SEND_FAIL");
+                                  hdr.session_id, poll.base_seq, -1, poll.count,
+                                  packetType, ackSent ? LOG_STATUS_WACK_SENT : LOG_STATUS_WACK_SEND_FAIL, 0, 0,
+                                  ackSent ? lora.lastToaMs() : 0, ackSent ? lora.lastTxMs() : 0);
         }
     }
 
-    state.transition(ResearchEvent::RX_PACKET_DONE);
-    StatusDisplay::setLoRa(StatusDisplay::LORA_OK_IDLE);
-}
-
-static bool transmitPayloadFile()
-{
-    if (!g_sd_ready)
+    if (packetType == PKT_RATE_CTRL)
     {
-        Serial.println("[HD][TX] SD not ready; cannot transmit payload file");
-        StatusDisplay::setMessage("SD not ready");
-        return false;
+        const uint32_t replyTimeMs = millis();
+        const bool changed = lora.handleRateCtrl(hdr, body, bodyLen);
+        if (changed)
+        {
+            onLinkRateChanged();
+        }
+        if (g_sd_ready)
+        {
+            sdMgr.logTransmission(kDefaultLat, kDefaultLon, rxTimeMs, replyTimeMs, rssi, snr,
+                                  hdr.session_id, hdr.seq_num, -1, 0,
+                                  packetType, changed ? LOG_STATUS_RATE_APPLIED : LOG_STATUS_RATE_KEPT);
+        }
     }
 
-    auto logAck = [&](uint32_t txTimeMs, bool ackOk, const char* packetType, const char* status,
-                      int16_t fragIndex, uint16_t fragLen, uint8_t retryIndex)
+    // RESUME is answered with the fragments still missing, not a plain ACK.
+    if (packetType == PKT_RESUME)
     {
-        if (!g_sd_ready)
+        nack.head.status = ackStatus;
+        const uint32_t ackTimeMs = millis();
+        const bool nackSent = lora.sendNackFor(hdr, nack);
+
+        if (g_sd_ready)
         {
-            return;
+            sdMgr.logTransmission(kDefaultLat, kDefaultLon, rxTimeMs, ackTimeMs, rssi, snr,
+                                  hdr.session_id, hdr.seq_num, -1, nack.head.received,
+                                  packetType, nackSent ? LOG_STATUS_NACK_SENT : LOG_STATUS_NACK_SEND_FAIL, 0, 0,
+                                  nackSent ? lora.lastToaMs() : 0, nackSent ? lora.lastTxMs() : 0);
         }
+    }
 
+    // ACK frames should never be ACKed back.
+    if (expectsPerFrameAck(packetType))
+    {
         const uint32_t ackTimeMs = millis();
-        const int rssi = ackOk ? static_cast<int>(lora.getLastRSSI()) : 0;
-        const float snr = ackOk ? lora.getLastSNR() : 0.0f;
-        const uint16_t seqNum = lora.getLastSeqNum();
-
-        Serial.printf("[HD][LOG] type=%s status=%s retry=%u tx=%lu ack=%lu rssi=%d snr=%.1f\n",
-                      packetType, status, static_cast<unsigned>(retryIndex), txTimeMs, ackTimeMs, rssi, snr);
+        const bool ackSent = lora.sendAckFor(hdr, ackStatus);
 
-        sdMgr.logTransmission(kDefaultLat, kDefaultLon, txTimeMs, ackTimeMs, rssi, snr,
-                              g_session_id, seqNum, fragIndex, fragLen, packetType, status);
-    };
-
-    uint32_t payloadSize = 0;
-    uint16_t total_frags = 0;
-    uint32_t audio_crc = 0;
-    if (!getPayloadStats(sdMgr, kPayloadFile, payloadSize, total_frags, audio_crc))
-    {
-        StatusDisplay::setMessage("Missing/invalid payload");
-        return false;
+        if (g_sd_ready)
+        {
+            sdMgr.logTransmission(kDefaultLat, kDefaultLon, rxTimeMs, ackTimeMs, rssi, snr,
+                                  hdr.session_id, hdr.seq_num, fragIndex, fragLen,
+                                  packetType, ackSent ? LOG_STATUS_ACK_SENT : LOG_STATUS_ACK_SEND_FAIL, 0, 0,
+                                  ackSent ? lora.lastToaMs() : 0, ackSent ? lora.lastTxMs() : 0);
+        }
     }
 
-    if (!sdMgr.openAudioFile(kPayloadFile))
+    if (rxWindow)
     {
-        Serial.printf("[HD][TX] Failed to reopen payload file for transmit: %s\n", kPayloadFile);
-        StatusDisplay::setMessage("Payload open failed");
-        return false;
+        state.transition(ResearchEvent::RX_PACKET_DONE);
     }
+    StatusDisplay::setLoRa(after);
+}
 
-    Serial.printf("[HD][TX] Starting transfer from %s: %lu bytes, %u fragments, CRC32=0x%08lX\n",
-                  kPayloadFile,
-                  static_cast<unsigned long>(payloadSize),
-                  total_frags,
-                  static_cast<unsigned long>(audio_crc));
-
-    StatusDisplay::setLoRa(StatusDisplay::LORA_TRANSMITTING);
-    StatusDisplay::setMessage("Button TX running...");
-
-    bool startAckOk = false;
-    for (uint8_t retry = 0; retry <= kMaxAckRetries; ++retry)
+// Serial commands: 'h' prints the heap (and worker) report, 'p' the stage histograms
+// gathered so far (MESH_PROFILE_ENABLE).
+static void serviceSerialCommands()
+{
+    while (Serial.available() > 0)
     {
-        state.transition(ResearchEvent::PAYLOAD_AVAILABLE);
-        const uint32_t startTxTime = millis();
-        const bool startSent = lora.sendAudioStart(total_frags, kPayloadCodec, kPayloadSampleHz, kPayloadDurationMs, payloadSize);
-
-        if (!startSent)
-        {
-            state.transition(ResearchEvent::TX_FAILED);
-            char status[24];
-            withRetrySuffix(status, sizeof(status), "TX_FAIL", retry);
-            logAck(startTxTime, false, "START", status, -1, 0, retry);
-
-            if (retry == kMaxAckRetries)
-            {
-                Serial.println("[HD][TX] START failed after retries");
-                sdMgr.closeAudioFile();
-                StatusDisplay::setLoRa(StatusDisplay::LORA_OK_IDLE);
-                return false;
-            }
-            delay(50);
-            continue;
-        }
-
-        state.transition(ResearchEvent::TX_COMPLETE);
-        startAckOk = lora.waitForAck(lora.getLastSeqNum(), timeout_ms);
-
-        char status[24];
-        withRetrySuffix(status, sizeof(status), startAckOk ? "ACK_OK" : "ACK_TIMEOUT", retry);
-        logAck(startTxTime, startAckOk, "START", status, -1, 0, retry);
-
-        if (startAckOk)
+        const int cmd = Serial.read();
+        if (cmd == 'h')
         {
-            state.transition(ResearchEvent::ACK_VALID);
-            break;
+            HeapMonitor::printStats();
+            WorkerTask::printStats();
         }
-
-        if (retry < kMaxAckRetries)
+#if MESH_PROFILE_ENABLE
+        else if (cmd == 'p')
         {
-            state.transition(ResearchEvent::ACK_TIMEOUT);
+            StageProfiler::printStats();
         }
-        else
-        {
-            state.transition(ResearchEvent::RETRY_EXHAUSTED);
-        }
-        delay(50);
+#endif
     }
+}
 
-    if (!startAckOk)
+#if MESH_PROFILE_ENABLE
+// Stage histograms of the transfer just finished, to serial and lora_prof.csv;
+// then start over so each session's rows stand alone.
+static void dumpProfile()
+{
+    StageProfiler::printStats();
+    static char csv[1024];
+    const size_t len = StageProfiler::formatCsv(csv, sizeof(csv), MESH_RUN_ID, g_session_id);
+    if (g_sd_ready && len > 0 && !sdMgr.writeProfile(csv, len))
     {
-        sdMgr.closeAudioFile();
-        StatusDisplay::setLoRa(StatusDisplay::LORA_OK_IDLE);
-        return false;
+        Serial.println("[PROF] lora_prof.csv write failed");
     }
+    StageProfiler::reset();
+}
+#endif
 
-    uint16_t dataOkCount = 0;
-    uint16_t dataFailCount = 0;
-    uint16_t frag = 0;
-    AudioPacket packet;
-    while (sdMgr.readAudioChunk(packet))
+static void logAck(uint32_t txTimeMs, bool ackOk, uint16_t seqNum, uint8_t packetType, LogStatus status,
+                   int16_t fragIndex, uint16_t fragLen, uint8_t retryIndex, uint32_t rtoMs)
+{
+    if (packetType == PKT_AUDIO_DATA)
     {
-        if (packet.bytesRead <= 0)
+        if (ackOk)
         {
-            continue;
+            StatusDisplay::onPacketSent();
         }
-
-        const uint16_t chunk = static_cast<uint16_t>(packet.bytesRead);
-        bool dataAckOk = false;
-
-        for (uint8_t retry = 0; retry <= kMaxAckRetries; ++retry)
+        else if (retryIndex == kMaxAckRetries)
         {
-            state.transition(ResearchEvent::PAYLOAD_AVAILABLE);
-            const uint32_t dataTxTime = millis();
-            const bool dataSent = lora.sendAudioData(packet.buffer, static_cast<uint8_t>(chunk));
-
-            if (!dataSent)
-            {
-                state.transition(ResearchEvent::TX_FAILED);
-                char status[24];
-                withRetrySuffix(status, sizeof(status), "TX_FAIL", retry);
-                logAck(dataTxTime, false, "DATA", status,
-                       static_cast<int16_t>(frag), static_cast<uint16_t>(chunk), retry);
-
-                if (retry == kMaxAckRetries)
-                {
-                    dataFailCount++;
-                    Serial.printf("[HD][TX] DATA frag %u failed after retries\n", frag);
-                    StatusDisplay::setMessage("Failed data fragment");
-                }
-                else
-                {
-                    delay(50);
-                }
-                continue;
-            }
-
-            state.transition(ResearchEvent::TX_COMPLETE);
-            dataAckOk = lora.waitForAck(lora.getLastSeqNum(), timeout_ms);
-
-            char status[24];
-            withRetrySuffix(status, sizeof(status), dataAckOk ? "ACK_OK" : "ACK_TIMEOUT", retry);
-            logAck(dataTxTime, dataAckOk, "DATA", status,
-                   static_cast<int16_t>(frag), static_cast<uint16_t>(chunk), retry);
-
-            if (dataAckOk)
-            {
-                state.transition(ResearchEvent::ACK_VALID);
-                dataOkCount++;
-                StatusDisplay::onPacketSent();
-                break;
-            }
-
-            if (retry < kMaxAckRetries)
-            {
-                state.transition(ResearchEvent::ACK_TIMEOUT);
-                delay(50);
-            }
-            else
-            {
-                state.transition(ResearchEvent::RETRY_EXHAUSTED);
-                dataFailCount++;
-                Serial.printf("[HD][TX] DATA frag %u no ACK after retries\n", frag);
-                StatusDisplay::setMessage("Data ACK timeout");
-            }
+            StatusDisplay::setMessage(status == LOG_STATUS_TX_FAIL ? "Failed data fragment" : "Data ACK timeout");
         }
-
-        frag++;
-        delay(50);
     }
-
-    sdMgr.closeAudioFile();
-
-    Serial.printf("[HD][TX] DATA summary: acked=%u failed_or_timeout=%u total=%u\n",
-                  dataOkCount, dataFailCount, frag);
-
-    bool endAckOk = false;
-    for (uint8_t retry = 0; retry <= kMaxAckRetries; ++retry)
+    if (!g_sd_ready)
     {
-        state.transition(ResearchEvent::PAYLOAD_AVAILABLE);
-        const uint32_t endTxTime = millis();
-        const bool endSentOk = lora.sendAudioEnd(frag, audio_crc);
+        return;
+    }
 
-        if (!endSentOk)
-        {
-            state.transition(ResearchEvent::TX_FAILED);
-            char status[24];
-            withRetrySuffix(status, sizeof(status), "TX_FAIL", retry);
-            logAck(endTxTime, false, "END", status, -1, 0, retry);
+    const uint32_t ackTimeMs = ackOk ? lora.getLastRxMs() : millis();
+    const int rssi = ackOk ? static_cast<int>(lora.getLastRSSI()) : 0;
+    const float snr = ackOk ? lora.getLastSNR() : 0.0f;
+
+    // Airtime columns describe the frame just sent (waiting for its ACK sends nothing).
+    const uint32_t toaMs = lora.lastToaMs();
+    const uint32_t txMs = lora.lastTxMs();
+    Serial.printf("[HD][LOG] type=%s status=%s retry=%u tx=%lu ack=%lu rto=%lu toa=%lu tx_ms=%lu rssi=%d snr=%.1f\n",
+                  packetTypeLabel(packetType), logStatusLabel(status), static_cast<unsigned>(retryIndex),
+                  static_cast<unsigned long>(txTimeMs), static_cast<unsigned long>(ackTimeMs),
+                  static_cast<unsigned long>(rtoMs), static_cast<unsigned long>(toaMs),
+                  static_cast<unsigned long>(txMs), rssi, snr);
+
+    sdMgr.logTransmission(kDefaultLat, kDefaultLon, txTimeMs, ackTimeMs, rssi, snr,
+                          g_session_id, seqNum, fragIndex, fragLen, packetType, status, retryIndex,
+                          rtoMs, toaMs, txMs);
+}
 
-            if (retry == kMaxAckRetries)
-            {
-                Serial.println("[HD][TX] END send failed after retries");
-            }
-            else
-            {
-                delay(50);
-            }
-            continue;
-        }
+static void onTransferDone(const TransferSummary& summary)
+{
+    StatusDisplay::setLoRa(StatusDisplay::LORA_OK_IDLE);
+    const uint32_t now = millis();
+    g_lastIdleDisplayMs = now;
+    g_lastIdleSerialMs = now;
+    if (!summary.started)
+    {
+        StatusDisplay::setMessage("Press button to TX");
+        return;
+    }
+    StatusDisplay::setMessage(summary.endAcked ? "Transfer complete" : "Transfer done w/ END fail");
 
-        state.transition(ResearchEvent::TX_COMPLETE);
-        endAckOk = lora.waitForAck(lora.getLastSeqNum(), timeout_ms);
-        char status[24];
-        withRetrySuffix(status, sizeof(status), endAckOk ? "ACK_OK" : "ACK_TIMEOUT", retry);
-        logAck(endTxTime, endAckOk, "END", status, -1, 0, retry);
+    if (g_sd_ready)
+    {
+        sdMgr.flushLog();
+    }
+    SpiArbiter::printStats();
+    HeapMonitor::printStats();
+    WorkerTask::printStats();
+    MeshRouter::printStats();
+    lora.printListenStats();
+    state.printStats();
+    state.resetStats();
+#if MESH_PROFILE_ENABLE
+    dumpProfile();
+#endif
+    if (summary.resumable)
+    {
+        // The next press resumes this session where the receiver left off.
+        Serial.printf("[HD][TX] Transfer interrupted; session 0x%04X resumes on the next press\n\n", g_session_id);
+        return;
+    }
+    g_session_id++;
+    g_seq_num = 0;
+    lora.setSession(g_session_id, g_seq_num);
 
-        if (endAckOk)
-        {
-            state.transition(ResearchEvent::ACK_VALID);
-            break;
-        }
+    Serial.println("[HD][TX] Transfer complete\n");
+}
 
-        if (retry < kMaxAckRetries)
-        {
-            state.transition(ResearchEvent::ACK_TIMEOUT);
-            delay(50);
-        }
-        else
-        {
-            state.transition(ResearchEvent::RETRY_EXHAUSTED);
-            Serial.println("[HD][TX] END ACK timeout after retries");
-        }
+// Queues the transfer; loop() keeps answering the peer while it runs.
+static bool startPayloadTransfer()
+{
+    if (!g_sd_ready)
+    {
+        Serial.println("[HD][TX] SD not ready; cannot transmit payload file");
+        StatusDisplay::setMessage("SD not ready");
+        return false;
     }
 
-    StatusDisplay::setLoRa(StatusDisplay::LORA_OK_IDLE);
-    StatusDisplay::setMessage(endAckOk ? "Transfer complete" : "Transfer done w/ END fail");
+    StatusDisplay::setLoRa(StatusDisplay::LORA_TRANSMITTING);
+    StatusDisplay::setMessage("Button TX running...");
+    if (!transfer.start(kPayloadFile, kPayloadCodec, kPayloadSampleHz, kPayloadDurationMs,
+                        timeout_ms, kMaxAckRetries))
+    {
+        StatusDisplay::setLoRa(StatusDisplay::LORA_OK_IDLE);
+        StatusDisplay::setMessage("Missing/invalid payload");
+        return false;
+    }
+    return true;
+}
 
-    g_session_id++;
-    g_seq_num = 0;
+// Refills the payload read-ahead and drains the CSV log queue while the
+// radio waits (LoRaManager::onIdle) and in the idle loop.
+static void serviceSdLog()
+{
+    if (g_sd_ready)
+    {
+        sdMgr.serviceReadAhead();
+        sdMgr.serviceLog();
+    }
+}
 
-    Serial.println("[HD][TX] Transfer complete\n");
-    return endAckOk;
+// LoRaManager::onIdle work: the SD log queue, then the display when the
+// wait leaves room for a frame.
+static void serviceIdle()
+{
+    serviceSdLog();
+    StatusDisplay::service(lora.quietMs());
 }
 
 void setup()
@@ -517,19 +519,35 @@ void setup()
     }
     StatusDisplay::setSD(g_sd_ready);
 
+    // total_frags in AUDIO_START is counted with the same chunk size.
+    sdMgr.setPayloadCodec(kPayloadCodec);
+    sdMgr.setChunkSize(configuredFragmentSize());
+    Serial.printf("Fragment size: %u bytes (%s)\n",
+                  static_cast<unsigned>(sdMgr.chunkSize()),
+                  MESH_FRAG_SIZE == MESH_FRAG_SIZE_AUTO ? "auto" : "fixed");
+
     Serial.println("Initializing LoRa...");
     g_session_id = static_cast<uint16_t>(millis() & 0xFFFF);
     g_seq_num = 0;
+    // An unfinished transfer keeps its session so the receiver can resume it.
+    if (g_sd_ready && transfer.savedSession(g_session_id))
+    {
+        Serial.printf("Unfinished transfer in session 0x%04X; the next press resumes it\n", g_session_id);
+    }
     const bool loraOk = lora.init(&g_session_id, &g_seq_num);
+    lora.onIdle(serviceIdle);
+    MeshRouter::begin(lora);
 
     StatusDisplay::setLoRa(loraOk ? StatusDisplay::LORA_OK_IDLE : StatusDisplay::LORA_FAIL);
     state.transition(ResearchEvent::SETUP_COMPLETE);
 
     Serial.printf("Session: 0x%04X\n", g_session_id);
     Serial.printf("Button pin=%d active=%s\n", MESH_TX_BUTTON_PIN, MESH_TX_BUTTON_ACTIVE_LOW ? "LOW" : "HIGH");
-    Serial.printf("Run config: run_id=%s role=%s sf=%u bw=%.1f cr=4/%u timeout_ms=%lu tx_power=%d\n",
+    Serial.printf("Run config: run_id=%s role=%s mode=%s window=%u sf=%u bw=%.1f cr=4/%u timeout_ms=%lu tx_power=%d\n",
                   MESH_RUN_ID,
                   MESH_LOG_ROLE,
+                  MESH_TRANSFER_MODE == MESH_TRANSFER_MODE_SELECTIVE_REPEAT ? "SR" : "SAW",
+                  static_cast<unsigned>(MESH_TX_WINDOW_SIZE),
                   static_cast<unsigned>(MESH_LORA_SF),
                   static_cast<double>(MESH_LORA_BW_KHZ),
                   static_cast<unsigned>(MESH_LORA_CR),
@@ -537,6 +555,13 @@ void setup()
                   static_cast<int>(MESH_LORA_TX_POWER_DBM));
     Serial.println("Node ready: idle RX, press button to TX payload\n");
     StatusDisplay::setMessage("Press button to TX");
+    StatusDisplay::refresh();
+#if MESH_DUAL_CORE
+    // SD log, payload writes and the OLED move to the other core from here on.
+    WorkerTask::begin(g_sd_ready ? &sdMgr : nullptr);
+#endif
+    HeapMonitor::mark();
+    transfer.begin({logAck, logWindowFragment, onTransferDone});
 
     const uint32_t now = millis();
     g_lastIdleDisplayMs = now;
@@ -546,22 +571,39 @@ void setup()
 void loop()
 {
     processIncomingPacket();
+    MeshRouter::service();
+    serviceSerialCommands();
 
     if (wasTxButtonPressed())
     {
-        Serial.println("[HD] TX button pressed");
-        StatusDisplay::setMessage("Button pressed");
-        transmitPayloadFile();
-        StatusDisplay::setMessage("Press button to TX");
-
-        const uint32_t now = millis();
-        g_lastIdleDisplayMs = now;
-        g_lastIdleSerialMs = now;
+        if (transfer.busy())
+        {
+            Serial.println("[HD] TX button pressed; transfer already running");
+        }
+        else
+        {
+            Serial.println("[HD] TX button pressed");
+            if (!startPayloadTransfer())
+            {
+                StatusDisplay::setMessage("Press button to TX");
+            }
+        }
     }
-    else
+    else if (!transfer.busy())
     {
         publishIdleHeartbeat();
+        if (lora.serviceAdr(timeout_ms))
+        {
+            onLinkRateChanged();
+        }
     }
 
-    delay(10);
+    transfer.service();
+    state.run();
+    serviceSdLog();
+    StatusDisplay::service(lora.quietMs());
+    if (!transfer.busy())
+    {
+        delay(lora.rxDutyCycled() ? kDutyCycledPollMs : 10);
+    }
 }
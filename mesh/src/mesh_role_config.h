@@ -5,6 +5,7 @@
 //   1 = TX
 //   2 = RX
 //   3 = HALF_DUPLEX (same firmware can RX and TX)
+//   4 = RELAY (forwards mesh frames between the endpoints, no SD/app)
 #ifndef MESH_APP_ROLE 
 #define MESH_APP_ROLE 3
 #endif
@@ -41,9 +42,407 @@
 #define MESH_LORA_TX_POWER_DBM 14
 #endif
 
+// DATA-phase transfer mode, selectable per run so r2_sweep_report.py can
+// compare the two:
+//   0 = STOP_AND_WAIT (one PKT_ACK per fragment, R2 baseline)
+//   1 = SELECTIVE_REPEAT (burst of MESH_TX_WINDOW_SIZE fragments, one
+//       PKT_WINDOW_ACK bitmap per burst, resend only the missing seqs)
+#define MESH_TRANSFER_MODE_STOP_AND_WAIT 0
+#define MESH_TRANSFER_MODE_SELECTIVE_REPEAT 1
+
+#ifndef MESH_TRANSFER_MODE
+#define MESH_TRANSFER_MODE MESH_TRANSFER_MODE_STOP_AND_WAIT
+#endif
+
+// Fragments in flight per burst in SELECTIVE_REPEAT mode (1..32).
+#ifndef MESH_TX_WINDOW_SIZE
+#define MESH_TX_WINDOW_SIZE 8
+#endif
+
+// Forward error correction for SELECTIVE_REPEAT (src/util/Fec.h): each
+// window becomes a block of MESH_TX_WINDOW_SIZE fragments plus this many
+// PKT_AUDIO_PARITY frames (0 = off, up to LORA_MAX_FEC_PARITY). The receiver
+// rebuilds a lost fragment from parity, so the window ACK already counts it
+// and no resend round trip is needed. Windows no longer slide: the next
+// block starts once every fragment of this one is resolved. Fragments are
+// capped at LORA_MAX_FEC_DATA_PAYLOAD (237) to leave room for the parity header.
+#ifndef MESH_FEC_PARITY
+#define MESH_FEC_PARITY 0
+#endif
+
+// DATA fragment payload in bytes, up to LORA_MAX_DATA_PAYLOAD (242).
+// MESH_FRAG_SIZE_AUTO picks the size with the lowest time-on-air per
+// delivered byte for the SF/BW/CR above (see src/comms/Airtime.h).
+#define MESH_FRAG_SIZE_AUTO 0
+
+#ifndef MESH_FRAG_SIZE
+#define MESH_FRAG_SIZE 242
+#endif
+
+// Payload codec, sent as codec_id in AUDIO_START:
+//   0 = CODEC_RAW_PCM    (the payload file is sent byte for byte)
+//   1 = CODEC_COMPRESSED (the file is 16-bit mono PCM; each DATA fragment is
+//       one IMA-ADPCM block, about 3.9:1, see src/codec/ImaAdpcm.h. The
+//       receiver also writes the decoded PCM to rx_<src>_<session>_pcm.bin)
+#ifndef MESH_PAYLOAD_CODEC
+#define MESH_PAYLOAD_CODEC 0
+#endif
+
+// Receiver session table (src/app/SessionTable.h): one reassembly context
+// per (src_id, session_id) in flight, all allocated up front. A START for a
+// new session takes a free or finished context, else the least recently
+// used one idle for MESH_RX_SESSION_STALL_MS; with none of those it is
+// refused (RX_TABLE_FULL) and the sender retries. The gateway (RX) keeps
+// four; half-duplex talks to one peer and keeps one.
+#ifndef MESH_RX_SESSIONS
+#if MESH_APP_ROLE == 2
+#define MESH_RX_SESSIONS 4
+#else
+#define MESH_RX_SESSIONS 1
+#endif
+#endif
+
+#ifndef MESH_RX_SESSION_STALL_MS
+#define MESH_RX_SESSION_STALL_MS 30000
+#endif
+
+// ACK replay at the receiver (src/app/ReplayWindow.h): the last
+// MESH_RX_REPLAY_WINDOW seqs ACKed per peer (a power of two), for
+// MESH_RX_REPLAY_PEERS peers. A retransmit of one of them gets the cached
+// ACK again without touching the session table or the card.
+#ifndef MESH_RX_REPLAY_WINDOW
+#define MESH_RX_REPLAY_WINDOW 16
+#endif
+
+#ifndef MESH_RX_REPLAY_PEERS
+#define MESH_RX_REPLAY_PEERS MESH_RX_SESSIONS
+#endif
+
+// RX reassembly limits, per context. Transfers up to MESH_RX_BUFFER_BYTES
+// are held in RAM and written once at END; larger ones stream to SD by
+// fragment offset. The whole table must fit MESH_RX_POOL_MAX_BYTES, which
+// is checked at compile time.
+#ifndef MESH_RX_MAX_FRAGS
+#define MESH_RX_MAX_FRAGS 2048
+#endif
+
+#ifndef MESH_RX_BUFFER_BYTES
+#if MESH_RX_SESSIONS > 1
+#define MESH_RX_BUFFER_BYTES 8192
+#else
+#define MESH_RX_BUFFER_BYTES 32768
+#endif
+#endif
+
+#ifndef MESH_RX_POOL_MAX_BYTES
+#define MESH_RX_POOL_MAX_BYTES 131072
+#endif
+
+// Resumable transfers. The sender keeps the session of a transfer that did
+// not complete in tx_resume.bin and reopens it with PKT_RESUME instead of
+// starting over; the receiver answers with PKT_NACK, the fragments it still
+// lacks, and only those are resent. A streamed transfer's bitmap is kept
+// in rx_<src>_<session>_map.bin next to its .bin, saved every
+// MESH_RESUME_MAP_EVERY placed fragments, so a receiver reboot costs at
+// most that many resends. Receivers always answer PKT_RESUME; 0 makes the
+// sender start every transfer from fragment 0 and drops the bitmap file.
+#ifndef MESH_RESUME_ENABLE
+#define MESH_RESUME_ENABLE 1
+#endif
+
+#ifndef MESH_RESUME_MAP_EVERY
+#define MESH_RESUME_MAP_EVERY 8
+#endif
+
+// CSV log queue. Rows are held in RAM and written when MESH_LOG_FLUSH_ROWS
+// are pending or the oldest is MESH_LOG_FLUSH_MS old, at most
+// MESH_LOG_MAX_ROWS_PER_FLUSH per idle call so one flush can't stall the link.
+// MESH_LOG_RING_ROWS must be a power of two (src/util/SpscQueue.h).
+#ifndef MESH_LOG_RING_ROWS
+#define MESH_LOG_RING_ROWS 32
+#endif
+
+#ifndef MESH_LOG_FLUSH_ROWS
+#define MESH_LOG_FLUSH_ROWS 8
+#endif
+
+#ifndef MESH_LOG_FLUSH_MS
+#define MESH_LOG_FLUSH_MS 1000
+#endif
+
+#ifndef MESH_LOG_MAX_ROWS_PER_FLUSH
+#define MESH_LOG_MAX_ROWS_PER_FLUSH 16
+#endif
+
+// TX payload read-ahead. MESH_SD_READAHEAD_BUFS buffers (a power of two) of
+// MESH_SD_READAHEAD_BYTES (whole 512-byte sectors) are filled with
+// multi-block reads while the radio is on air or waiting for an ACK, so
+// readAudioChunk() copies from RAM. The card is on its own SPI host and
+// runs at MESH_SD_SCK_MHZ; init retries at 2 MHz if it will not mount.
+#ifndef MESH_SD_READAHEAD_BUFS
+#define MESH_SD_READAHEAD_BUFS 2
+#endif
+
+#ifndef MESH_SD_READAHEAD_BYTES
+#define MESH_SD_READAHEAD_BYTES 4096
+#endif
+
+#ifndef MESH_SD_SCK_MHZ
+#define MESH_SD_SCK_MHZ 16
+#endif
+
+// Adaptive data rate (src/comms/RateController.h). With MESH_ADR_ENABLE the
+// sender keeps the last MESH_ADR_WINDOW ACK outcomes and SNRs per peer and,
+// between transfers, negotiates a faster SF (margin to spare) or a more
+// robust one / more power (ACK rate below MESH_ADR_MIN_ACK_PCT) with a
+// PKT_RATE_CTRL exchange. Receivers always answer; MESH_LORA_* is the base
+// rate both ends return to after MESH_ADR_FALLBACK_MS without hearing a frame.
+// A receiver with MESH_RX_SESSIONS > 1 (the RX gateway by default) serves
+// several senders at one radio rate, so it rejects every rate but the base.
+#ifndef MESH_ADR_ENABLE
+#define MESH_ADR_ENABLE 0
+#endif
+
+#ifndef MESH_ADR_WINDOW
+#define MESH_ADR_WINDOW 16
+#endif
+
+#ifndef MESH_ADR_MIN_ACK_PCT
+#define MESH_ADR_MIN_ACK_PCT 90
+#endif
+
+// SNR above the next-faster SF's demodulation floor needed to step up.
+#ifndef MESH_ADR_SNR_MARGIN_DB
+#define MESH_ADR_SNR_MARGIN_DB 5.0f
+#endif
+
+#ifndef MESH_ADR_MIN_SF
+#define MESH_ADR_MIN_SF 7
+#endif
+
+#ifndef MESH_ADR_MAX_SF
+#define MESH_ADR_MAX_SF 12
+#endif
+
+#ifndef MESH_ADR_MIN_TX_POWER_DBM
+#define MESH_ADR_MIN_TX_POWER_DBM 2
+#endif
+
+#ifndef MESH_ADR_MAX_TX_POWER_DBM
+#define MESH_ADR_MAX_TX_POWER_DBM 20
+#endif
+
+#ifndef MESH_ADR_POWER_STEP_DB
+#define MESH_ADR_POWER_STEP_DB 3
+#endif
+
+#ifndef MESH_ADR_FALLBACK_MS
+#define MESH_ADR_FALLBACK_MS 30000
+#endif
+
+#ifndef MESH_ADR_MAX_PEERS
+#define MESH_ADR_MAX_PEERS 4
+#endif
+
+// Adaptive ACK timeout (src/comms/RttEstimator.h). With MESH_RTO_ADAPTIVE
+// each ACK wait lasts SRTT + 4 * RTTVAR of the peer's measured TxDone-to-ACK
+// times (RFC 6298), never less than the modeled time on air of the ACK plus
+// MESH_RTO_TURNAROUND_MS, never more than MESH_ACK_TIMEOUT_MS, and doubled
+// per retry. Retries back off MESH_RETRY_BACKOFF_BASE_MS * 2^retry
+// (capped, with jitter). 0 = fixed MESH_ACK_TIMEOUT_MS and a flat base delay,
+// as the Phase R2 sweeps ran.
+#ifndef MESH_RTO_ADAPTIVE
+#define MESH_RTO_ADAPTIVE 1
+#endif
+
+// Receiver work between its RX done and ACK TX (parse, queue, reply header).
+#ifndef MESH_RTO_TURNAROUND_MS
+#define MESH_RTO_TURNAROUND_MS 30
+#endif
+
+#ifndef MESH_RETRY_BACKOFF_BASE_MS
+#define MESH_RETRY_BACKOFF_BASE_MS 50
+#endif
+
+#ifndef MESH_RETRY_BACKOFF_MAX_MS
+#define MESH_RETRY_BACKOFF_MAX_MS 1000
+#endif
+
+#ifndef MESH_RTT_MAX_PEERS
+#define MESH_RTT_MAX_PEERS 4
+#endif
+
+// Airtime budget (src/comms/AirtimeScheduler.h). Every frame's modeled
+// time on air is counted against MESH_DUTY_CYCLE_PERMILLE of any sliding
+// MESH_DUTY_CYCLE_WINDOW_MS (e.g. 10 = 1% for EU868 g1); a send that would
+// exceed it waits instead. 0 = no budget. MESH_TX_GAP_MS is the quiet time
+// after the last frame heard before sending anything but a reply; it
+// replaced the fixed 50 ms pause after each stop-and-wait fragment.
+#ifndef MESH_DUTY_CYCLE_PERMILLE
+#define MESH_DUTY_CYCLE_PERMILLE 0
+#endif
+
+#ifndef MESH_DUTY_CYCLE_WINDOW_MS
+#define MESH_DUTY_CYCLE_WINDOW_MS 3600000UL
+#endif
+
+#ifndef MESH_TX_GAP_MS
+#define MESH_TX_GAP_MS 50
+#endif
+
+// With nothing heard or sent for this long no exchange is in progress, and
+// LoRaManager::quietMs() lets deferred work (display) run at any time.
+#ifndef MESH_LINK_IDLE_MS
+#define MESH_LINK_IDLE_MS 2000
+#endif
+
+// Listen before talk: a channel activity detection (CAD) scan before every
+// frame that is not a reply. A busy channel defers the send, in RX, by a
+// random backoff of up to a few of its own airtimes; after
+// MESH_LBT_MAX_DEFERS busy scans in a row the frame goes out anyway.
+#ifndef MESH_LBT_ENABLE
+#define MESH_LBT_ENABLE 0
+#endif
+
+#ifndef MESH_LBT_MAX_DEFERS
+#define MESH_LBT_MAX_DEFERS 5
+#endif
+
+// Duty-cycled RX: once the link is idle (MESH_LINK_IDLE_MS) the SX1262
+// sleeps between short preamble searches instead of listening without a
+// break, and wakes fully when a preamble is found. Frames that may reach a
+// sleeping peer (nothing heard from it for MESH_LINK_IDLE_MS / 2) are sent
+// with MESH_LORA_WAKE_PREAMBLE symbols of preamble; the sleep time is
+// derived from the same value, so both ends must be built with it. Each
+// search lasts about MESH_RX_WAKE_MIN_SYMBOLS + 1 symbols, and the radio
+// is on for that share of MESH_LORA_WAKE_PREAMBLE - MESH_RX_WAKE_MIN_SYMBOLS + 1.
+#ifndef MESH_RX_DUTY_CYCLE
+#define MESH_RX_DUTY_CYCLE 0
+#endif
+
+#ifndef MESH_LORA_WAKE_PREAMBLE
+#define MESH_LORA_WAKE_PREAMBLE 64
+#endif
+
+#ifndef MESH_RX_WAKE_MIN_SYMBOLS
+#define MESH_RX_WAKE_MIN_SYMBOLS 8
+#endif
+
+// On-card log format:
+//   0 = CSV    (lora_log.csv, every column formatted on the device)
+//   1 = BINARY (lora_log.bin, fixed-width records with raw millis();
+//       tests/log_decoder.py regenerates the CSV schema on the host)
+#define MESH_LOG_FORMAT_CSV 0
+#define MESH_LOG_FORMAT_BINARY 1
+
+#ifndef MESH_LOG_FORMAT
+#define MESH_LOG_FORMAT MESH_LOG_FORMAT_CSV
+#endif
+
+// Hot-path timing (src/util/StageProfiler.h): per-stage histograms of SD
+// reads, log writes, SPI waits, TX pacing, radio TX, ACK waits and whole
+// fragments/windows. Printed after each transfer and on 'p' over serial,
+// and appended to lora_prof.csv. 0 compiles every timer out.
+#ifndef MESH_PROFILE_ENABLE
+#define MESH_PROFILE_ENABLE 0
+#endif
+
+// OLED (src/display/StatusDisplay.h). Status calls only mark rows dirty;
+// StatusDisplay::service() draws at most one frame per MESH_DISPLAY_FRAME_MS,
+// and only when the radio has MESH_DISPLAY_RENDER_MS of guaranteed quiet
+// ahead (LoRaManager::quietMs()).
+#ifndef MESH_DISPLAY_FRAME_MS
+#define MESH_DISPLAY_FRAME_MS 250
+#endif
+
+#ifndef MESH_DISPLAY_RENDER_MS
+#define MESH_DISPLAY_RENDER_MS 25
+#endif
+
+// Control loop (src/app/ResearchStateMachine.h). Events and timers are
+// queued and dispatched from loop(); the last MESH_FSM_TRACE_DEPTH
+// transitions are kept in RAM and printed with the per-state dwell times
+// after each transfer. MESH_FSM_VERBOSE 1 also prints every transition
+// as it happens (the pre-executor behaviour).
+#ifndef MESH_FSM_QUEUE_DEPTH
+#define MESH_FSM_QUEUE_DEPTH 8
+#endif
+
+#ifndef MESH_FSM_TIMERS
+#define MESH_FSM_TIMERS 4
+#endif
+
+#ifndef MESH_FSM_TRACE_DEPTH
+#define MESH_FSM_TRACE_DEPTH 16
+#endif
+
+#ifndef MESH_FSM_VERBOSE
+#define MESH_FSM_VERBOSE 0
+#endif
+
+// Pause between stop-and-wait transfers on the TX role, and after one
+// that could not start (no payload file, START never ACKed).
+#ifndef MESH_TX_REPEAT_MS
+#define MESH_TX_REPEAT_MS 10000
+#endif
+
+#ifndef MESH_TX_RETRY_MS
+#define MESH_TX_RETRY_MS 3000
+#endif
+
+// Dual-core runtime (src/app/WorkerTask.h). With MESH_DUAL_CORE 1 the
+// Arduino loop task (core 1) is the radio task, raised to
+// MESH_RADIO_TASK_PRIORITY, and a worker pinned to MESH_WORKER_CORE drains
+// the SD log, writes received payload behind the ACKs (up to
+// MESH_STORE_QUEUE_DEPTH fragments, a power of two) and draws the OLED,
+// waking every MESH_WORKER_PERIOD_MS. 0 keeps everything on the loop task.
+#ifndef MESH_DUAL_CORE
+#define MESH_DUAL_CORE 0
+#endif
+
+#ifndef MESH_WORKER_CORE
+#define MESH_WORKER_CORE 0
+#endif
+
+#ifndef MESH_WORKER_PRIORITY
+#define MESH_WORKER_PRIORITY 1
+#endif
+
+#ifndef MESH_RADIO_TASK_PRIORITY
+#define MESH_RADIO_TASK_PRIORITY 3
+#endif
+
+#ifndef MESH_WORKER_STACK_BYTES
+#define MESH_WORKER_STACK_BYTES 8192
+#endif
+
+#ifndef MESH_WORKER_PERIOD_MS
+#define MESH_WORKER_PERIOD_MS 5
+#endif
+
+#ifndef MESH_STORE_QUEUE_DEPTH
+#define MESH_STORE_QUEUE_DEPTH 8
+#endif
+
+// How long an SPI lease waits for the same device held by another task.
+// Across cores the radio task may meet the worker mid-write.
+#ifndef MESH_SPI_LEASE_MS
+#if MESH_DUAL_CORE
+#define MESH_SPI_LEASE_MS 1000
+#else
+#define MESH_SPI_LEASE_MS 100
+#endif
+#endif
+
+// Node ids only need to differ when MESH_ROUTING_ENABLE is on; the relay
+// defaults to its own so a TX/relay/RX line works with the stock ids.
 #ifndef MESH_NODE_ID
+#if MESH_APP_ROLE == 4
+#define MESH_NODE_ID 0x03
+#else
 #define MESH_NODE_ID 0x01
 #endif
+#endif
 
 #ifndef MESH_PEER_NODE_ID
 #define MESH_PEER_NODE_ID 0x02
@@ -53,6 +452,62 @@
 #define MESH_EXPERIMENT_ID 0x01
 #endif
 
+// Compact frame header (LORA_COMPACT_VERSION in src/models/packet.h). The
+// experiment id, TX power and SF/CR are left out when they match the link's
+// current rate, the seq becomes a varint, and single-hop fields are implied:
+// 7-9 bytes instead of 13 on most frames. Every receiver decodes it, so
+// only the sender needs the flag; relays forward it as a v2 frame.
+#ifndef MESH_WIRE_COMPACT
+#define MESH_WIRE_COMPACT 0
+#endif
+
+// Multi-hop forwarding (src/mesh/MeshRouter.h). With MESH_ROUTING_ENABLE
+// a node filters duplicates and learns routes, and MESH_FORWARD_ENABLE lets
+// it relay frames for other nodes too. Every board then needs its own
+// MESH_NODE_ID (and MESH_PEER_NODE_ID set to the far end), and
+// MESH_ACK_TIMEOUT_MS scaled by the hop count, since an ACK crosses every
+// hop twice. Off by default so identically flashed boards keep working;
+// the relay role turns it on.
+#ifndef MESH_ROUTING_ENABLE
+#if MESH_APP_ROLE == 4
+#define MESH_ROUTING_ENABLE 1
+#else
+#define MESH_ROUTING_ENABLE 0
+#endif
+#endif
+
+#ifndef MESH_FORWARD_ENABLE
+#define MESH_FORWARD_ENABLE 1
+#endif
+
+#ifndef MESH_ROUTE_TABLE_SIZE
+#define MESH_ROUTE_TABLE_SIZE 8
+#endif
+
+#ifndef MESH_ROUTE_TIMEOUT_MS
+#define MESH_ROUTE_TIMEOUT_MS 60000
+#endif
+
+// (src, session, seq) seen recently is a duplicate copy of the same
+// hop; after MESH_DUP_WINDOW_MS it counts as an end-to-end retransmission.
+#ifndef MESH_DUP_CACHE_SIZE
+#define MESH_DUP_CACHE_SIZE 32
+#endif
+
+#ifndef MESH_DUP_WINDOW_MS
+#define MESH_DUP_WINDOW_MS (MESH_ACK_TIMEOUT_MS / 2)
+#endif
+
+#ifndef MESH_FORWARD_QUEUE_DEPTH
+#define MESH_FORWARD_QUEUE_DEPTH 4
+#endif
+
+// Random 0..MESH_FORWARD_JITTER_MS delay before relaying, so two relays
+// that heard the same flood do not transmit on top of each other.
+#ifndef MESH_FORWARD_JITTER_MS
+#define MESH_FORWARD_JITTER_MS 50
+#endif
+
 #ifndef MESH_RUN_ID
 #define MESH_RUN_ID "R2_DEFAULT"
 #endif
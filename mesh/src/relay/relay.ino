@@ -0,0 +1,90 @@
+#include <Arduino.h>
+
+#include "../src/models/packet.h"
+#include "../src/comms/LoraManager.h"
+#include "../src/mesh/MeshRouter.h"
+#include "../src/display/StatusDisplay.h"
+#include "../src/app/WorkerTask.h"
+#include "../src/util/HeapMonitor.h"
+
+// Relay node: no SD and no transfer state, just MeshRouter forwarding
+// frames between the endpoints. Frames addressed to the relay itself (or
+// broadcast) are printed and discarded.
+
+LoRaManager lora;
+
+uint16_t g_session_id = 0;
+uint16_t g_seq_num = 0;
+
+constexpr uint32_t kStatsIntervalMs = 10000;
+uint32_t g_lastStatsMs = 0;
+uint32_t g_lastForwarded = 0;
+
+void setup() {
+  Serial.begin(115200);
+  delay(2000);
+  Serial.println("\n=== LoRa Mesh Relay ===");
+
+  Serial.println("Initializing Display...");
+  StatusDisplay::init();
+  StatusDisplay::setSD(false);
+
+  Serial.println("Initializing LoRa...");
+  const bool loraOk = lora.init(&g_session_id, &g_seq_num);
+  MeshRouter::begin(lora);
+  StatusDisplay::setLoRa(loraOk ? StatusDisplay::LORA_OK_IDLE : StatusDisplay::LORA_FAIL);
+  StatusDisplay::setMessage("Relaying");
+  StatusDisplay::refresh();
+#if MESH_DUAL_CORE
+  // No SD here; the worker only takes the OLED off the radio core.
+  WorkerTask::begin(nullptr);
+#endif
+  HeapMonitor::mark();
+
+  Serial.printf("Relay node=0x%02X ttl=%u routes=%u dup_cache=%u dup_window_ms=%lu jitter_ms=%u\n",
+                static_cast<unsigned>(MESH_NODE_ID),
+                static_cast<unsigned>(LORA_DEFAULT_TTL),
+                static_cast<unsigned>(MESH_ROUTE_TABLE_SIZE),
+                static_cast<unsigned>(MESH_DUP_CACHE_SIZE),
+                static_cast<unsigned long>(MESH_DUP_WINDOW_MS),
+                static_cast<unsigned>(MESH_FORWARD_JITTER_MS));
+  Serial.println(loraOk ? "LoRa relay ready\n" : "LoRa relay init failed\n");
+  g_lastStatsMs = millis();
+}
+
+void loop() {
+  lora.service();
+  MeshRouter::service();
+
+  uint8_t raw[LORA_MAX_PAYLOAD];
+  size_t receivedLen = 0;
+  while (lora.receiveRaw(raw, sizeof(raw), &receivedLen)) {
+    if (receivedLen < LORA_HEADER_SIZE) {
+      continue;
+    }
+    LoRaHeader hdr;
+    deserializeHeader(raw, &hdr);
+    Serial.printf("[RELAY] For us: type=0x%02X src=0x%02X seq=%u len=%u\n",
+                  getType(hdr.ver_type), hdr.src_id, hdr.seq_num,
+                  static_cast<unsigned>(receivedLen));
+  }
+
+  const uint32_t forwarded = MeshRouter::stats().forwarded;
+  if (forwarded != g_lastForwarded) {
+    g_lastForwarded = forwarded;
+    StatusDisplay::onPacketSent();
+  }
+
+  const uint32_t now = millis();
+  if (now - g_lastStatsMs >= kStatsIntervalMs) {
+    g_lastStatsMs = now;
+    MeshRouter::printStats();
+    MeshRouter::printRoutes();
+    lora.printListenStats();
+    HeapMonitor::printStats();
+    WorkerTask::printStats();
+  }
+
+  StatusDisplay::service(lora.quietMs());
+  delay(1);
+}
@@ -4,11 +4,19 @@
 #include "../src/storage/SdManager.h"
 #include "../src/comms/LoraManager.h"
 #include "../src/app/ResearchStateMachine.h"
+#include "../src/app/SessionTable.h"
+#include "../src/app/ReplayWindow.h"
+#include "../src/app/WorkerTask.h"
 #include "../src/display/StatusDisplay.h"
+#include "../src/mesh/MeshRouter.h"
+#include "../src/util/StageProfiler.h"
+#include "../src/util/HeapMonitor.h"
 
 SdManager sdMgr;
 bool g_sd_ready = false;
 LoRaManager lora;
+SessionTable sessions(sdMgr);
+ReplayWindow replay;
 ResearchStateMachine state("RX");
 
 uint16_t g_session_id = 0;
@@ -16,14 +24,67 @@ uint16_t g_seq_num = 0;
 
 constexpr float kDefaultLat = 0.0f;
 constexpr float kDefaultLon = 0.0f;
+// Idle poll while the radio is in duty-cycled RX: the wake preamble alone
+// lasts longer, and the frame waits in the radio buffer.
+constexpr uint32_t kDutyCycledPollMs = 20;
 
-static const char* packetTypeLabel(uint8_t packetType) {
-  switch (packetType) {
-    case PKT_AUDIO_START: return "START";
-    case PKT_AUDIO_DATA:  return "DATA";
-    case PKT_AUDIO_END:   return "END";
-    case PKT_ACK:         return "ACK";
-    default:              return "UNKNOWN";
+// Drains the CSV log queue between frames and while an ACK is on air.
+static void serviceSdLog() {
+  if (g_sd_ready) {
+    sdMgr.serviceLog();
+  }
+}
+
+// LoRaManager::onIdle work: the SD log queue, then the display when the
+// wait leaves room for a frame.
+static void serviceIdle() {
+  serviceSdLog();
+  StatusDisplay::service(lora.quietMs());
+}
+
+// Serial commands: 'h' prints the heap (and worker) report, 's' the session
+// table, ACK replay and channel access (LBT / duty-cycled RX) counters, 'p'
+// the stage histograms gathered so far (MESH_PROFILE_ENABLE).
+static void serviceSerialCommands() {
+  while (Serial.available() > 0) {
+    const int cmd = Serial.read();
+    if (cmd == 'h') {
+      HeapMonitor::printStats();
+      WorkerTask::printStats();
+    } else if (cmd == 's') {
+      sessions.printStats();
+      replay.printStats();
+      lora.printListenStats();
+    }
+#if MESH_PROFILE_ENABLE
+    else if (cmd == 'p') {
+      StageProfiler::printStats();
+    }
+#endif
+  }
+}
+
+// A retransmit the cached ACK answers: resent as is, nothing reassembled or
+// written, and both log rows flagged dup.
+static void replayAck(const LoRaHeader& hdr, const ReplayWindow::Entry& cached,
+                      uint32_t rxTimeMs, int rssi, float snr) {
+  const uint8_t packetType = getType(hdr.ver_type);
+  Serial.printf("[RX] dup type=%s seq=%u sess=0x%04X src=0x%02X: replaying ACK\n",
+                packetTypeLabel(packetType), hdr.seq_num, hdr.session_id, hdr.src_id);
+  StatusDisplay::onPacketReceived();
+  if (g_sd_ready) {
+    sdMgr.logTransmission(kDefaultLat, kDefaultLon, rxTimeMs, rxTimeMs, rssi, snr,
+                          hdr.session_id, hdr.seq_num, cached.fragIndex, cached.fragLen,
+                          packetType, LOG_STATUS_RX_DUP, 0, 0, 0, 0, true);
+  }
+
+  const uint32_t ackTimeMs = millis();
+  const bool ackSent = lora.resendReply(cached.frame, cached.len);
+  if (g_sd_ready) {
+    sdMgr.logTransmission(kDefaultLat, kDefaultLon, rxTimeMs, ackTimeMs, rssi, snr,
+                          hdr.session_id, hdr.seq_num, cached.fragIndex, cached.fragLen,
+                          packetType, ackSent ? LOG_STATUS_ACK_SENT : LOG_STATUS_ACK_SEND_FAIL, 0, 0,
+                          ackSent ? lora.lastToaMs() : 0, ackSent ? lora.lastTxMs() : 0, true);
   }
 }
 
@@ -48,8 +109,19 @@ void setup() {
 
   Serial.println("Initializing LoRa...");
   bool loraOk = lora.init(&g_session_id, &g_seq_num);
+  lora.onIdle(serviceIdle);
+  MeshRouter::begin(lora);
   StatusDisplay::setLoRa(loraOk ? StatusDisplay::LORA_OK_IDLE : StatusDisplay::LORA_FAIL);
+  StatusDisplay::refresh();
+#if MESH_DUAL_CORE
+  // SD log, payload writes and the OLED move to the other core from here on.
+  WorkerTask::begin(g_sd_ready ? &sdMgr : nullptr);
+#endif
+  HeapMonitor::mark();
   state.transition(ResearchEvent::SETUP_COMPLETE);
+  Serial.printf("Session table: %u contexts, %u bytes, stall evict %lu ms\n",
+                static_cast<unsigned>(MESH_RX_SESSIONS), static_cast<unsigned>(SessionTable::poolBytes()),
+                static_cast<unsigned long>(MESH_RX_SESSION_STALL_MS));
   Serial.println(loraOk ? "LoRa RX ready\n" : "LoRa RX init failed\n");
 }
 
@@ -57,8 +129,17 @@ void loop() {
   uint8_t raw[LORA_MAX_PAYLOAD] = {0};
   size_t receivedLen = 0;
 
+  MeshRouter::service();
+  serviceSerialCommands();
   if (!lora.receiveRaw(raw, sizeof(raw), &receivedLen)) {
-    delay(20);
+    // Frames queue in LoRaManager, so idle time can go to the SD log.
+    serviceSdLog();
+    if (lora.serviceAdr(MESH_ACK_TIMEOUT_MS)) {
+      sdMgr.setLinkSf(lora.rate().sf);  // fell back to the base rate
+      replay.clear();
+    }
+    StatusDisplay::service(lora.quietMs());
+    delay(lora.rxDutyCycled() ? kDutyCycledPollMs : 2);
     return;
   }
 
@@ -79,17 +160,56 @@ void loop() {
   LoRaHeader hdr;
   deserializeHeader(raw, &hdr);
   const uint8_t packetType = getType(hdr.ver_type);
-  const char* packetTypeStr = packetTypeLabel(packetType);
 
+  const uint8_t* body = raw + LORA_HEADER_SIZE;
+  const size_t bodyLen = receivedLen - LORA_HEADER_SIZE;
+
+  if (expectsPerFrameAck(packetType)) {
+    if (const ReplayWindow::Entry* cached = replay.find(hdr)) {
+      replayAck(hdr, *cached, rxTimeMs, rssi, snr);
+      state.transition(ResearchEvent::RX_PACKET_DONE);
+      StatusDisplay::setLoRa(StatusDisplay::LORA_OK_IDLE);
+      StatusDisplay::service(lora.quietMs());
+      return;
+    }
+  }
+
+  // Transfer frames go through the session table first so the log row and
+  // the ACK status reflect where the fragment landed.
   int16_t fragIndex = -1;
+  int16_t rebuilt = -1;   // a fragment this DATA let held parity rebuild
   uint16_t fragLen = 0;
-  if (packetType == PKT_AUDIO_DATA) {
-    fragIndex = static_cast<int16_t>(hdr.seq_num);
-    fragLen = static_cast<uint16_t>(receivedLen - LORA_HEADER_SIZE);
+  LogStatus rxStatus = LOG_STATUS_RX_RECV;
+  uint8_t ackStatus = ACK_STATUS_OK;
+  ResumeNack nack = {};
+  if (expectsPerFrameAck(packetType) || packetType == PKT_AUDIO_DATA_WIN ||
+      packetType == PKT_AUDIO_PARITY || packetType == PKT_RESUME) {
+    ReassemblyResult result;
+    if (packetType == PKT_AUDIO_START) {
+      result = sessions.onStart(hdr, body, bodyLen);
+    } else if (packetType == PKT_RESUME) {
+      result = sessions.onResume(hdr, body, bodyLen, &nack);
+      replay.forget(hdr);
+    } else if (packetType == PKT_AUDIO_END) {
+      result = sessions.onEnd(hdr, body, bodyLen);
+      if (result == ReassemblyResult::COMPLETE || result == ReassemblyResult::CRC_MISMATCH) {
+        sessions.printStats();
+      }
+    } else if (packetType == PKT_AUDIO_PARITY) {
+      // fragIndex is the fragment the parity rebuilt, if any.
+      result = sessions.onParity(hdr, body, bodyLen, &fragIndex);
+    } else {
+      fragLen = static_cast<uint16_t>(bodyLen);
+      result = sessions.onData(hdr, body, bodyLen, &fragIndex, &rebuilt);
+    }
+    rxStatus = Reassembler::logStatus(result);
+    ackStatus = Reassembler::ackStatusFor(result);
   }
+  // Past the replay window (or windowed DATA): the reassembler still knows.
+  const bool duplicate = (rxStatus == LOG_STATUS_RX_DUP);
 
   Serial.printf("[RX] type=%s seq=%u sess=0x%04X len=%u RSSI=%d SNR=%.1f\n",
-                packetTypeStr,
+                packetTypeLabel(packetType),
                 hdr.seq_num,
                 hdr.session_id,
                 static_cast<unsigned>(receivedLen),
@@ -101,20 +221,73 @@ void loop() {
   if (g_sd_ready) {
     sdMgr.logTransmission(kDefaultLat, kDefaultLon, rxTimeMs, rxTimeMs, rssi, snr,
                           hdr.session_id, hdr.seq_num, fragIndex, fragLen,
-                          packetTypeStr, "RX_RECV");
+                          packetType, rxStatus, 0, 0, 0, 0, duplicate);
+    if (rebuilt >= 0) {
+      sdMgr.logTransmission(kDefaultLat, kDefaultLon, rxTimeMs, rxTimeMs, rssi, snr,
+                            hdr.session_id, hdr.seq_num, rebuilt, 0,
+                            packetType, LOG_STATUS_RX_FEC_RECOVERED);
+    }
+  }
+
+  if (packetType == PKT_WINDOW_POLL && bodyLen >= sizeof(WindowPollPayload)) {
+    WindowPollPayload poll;
+    deserializeWindowPoll(body, &poll);
+    const uint32_t bitmap = sessions.windowBitmap(hdr, poll.base_seq, poll.count);
+    const uint32_t ackTimeMs = millis();
+    bool ackSent = lora.sendWindowAckFor(hdr, poll.base_seq, bitmap);
+    if (g_sd_ready) {
+      sdMgr.logTransmission(kDefaultLat, kDefaultLon, rxTimeMs, ackTimeMs, rssi, snr,
+                            hdr.session_id, poll.base_seq, -1, poll.count,
+                            packetType, ackSent ? LOG_STATUS_WACK_SENT : LOG_STATUS_WACK_SEND_FAIL, 0, 0,
+                            ackSent ? lora.lastToaMs() : 0, ackSent ? lora.lastTxMs() : 0);
+    }
+  }
+
+  if (packetType == PKT_RATE_CTRL) {
+    const uint32_t replyTimeMs = millis();
+    const bool changed = lora.handleRateCtrl(hdr, body, bodyLen);
+    if (changed) {
+      sdMgr.setLinkSf(lora.rate().sf);
+      replay.clear();  // cached ACK headers carry the old rate
+    }
+    if (g_sd_ready) {
+      sdMgr.logTransmission(kDefaultLat, kDefaultLon, rxTimeMs, replyTimeMs, rssi, snr,
+                            hdr.session_id, hdr.seq_num, -1, 0,
+                            packetType, changed ? LOG_STATUS_RATE_APPLIED : LOG_STATUS_RATE_KEPT);
+    }
+  }
+
+  // RESUME is answered with the fragments still missing, not a plain ACK.
+  if (packetType == PKT_RESUME) {
+    nack.head.status = ackStatus;
+    const uint32_t ackTimeMs = millis();
+    const bool nackSent = lora.sendNackFor(hdr, nack);
+    if (g_sd_ready) {
+      sdMgr.logTransmission(kDefaultLat, kDefaultLon, rxTimeMs, ackTimeMs, rssi, snr,
+                            hdr.session_id, hdr.seq_num, -1, nack.head.received,
+                            packetType, nackSent ? LOG_STATUS_NACK_SENT : LOG_STATUS_NACK_SEND_FAIL, 0, 0,
+                            nackSent ? lora.lastToaMs() : 0, nackSent ? lora.lastTxMs() : 0);
+    }
   }
 
   // Never ACK an ACK frame to avoid ACK ping-pong.
-  if (packetType != PKT_ACK) {
+  if (expectsPerFrameAck(packetType)) {
     const uint32_t ackTimeMs = millis();
-    bool ackSent = lora.sendAckFor(hdr, ACK_STATUS_OK);
+    uint8_t ackFrame[LORA_ACK_FRAME_SIZE];
+    bool ackSent = lora.sendAckFor(hdr, ackStatus, ackFrame);
+    if (ackSent && ackStatus == ACK_STATUS_OK) {
+      replay.store(hdr, ackFrame, LORA_ACK_FRAME_SIZE, fragIndex, fragLen);
+    }
     if (g_sd_ready) {
       sdMgr.logTransmission(kDefaultLat, kDefaultLon, rxTimeMs, ackTimeMs, rssi, snr,
                             hdr.session_id, hdr.seq_num, fragIndex, fragLen,
-                            packetTypeStr, ackSent ? "ACK_SENT" : "ACK_SEND_FAIL");
+                            packetType, ackSent ? LOG_STATUS_ACK_SENT : LOG_STATUS_ACK_SEND_FAIL, 0, 0,
+                            ackSent ? lora.lastToaMs() : 0, ackSent ? lora.lastTxMs() : 0, duplicate);
     }
   }
 
   state.transition(ResearchEvent::RX_PACKET_DONE);
   StatusDisplay::setLoRa(StatusDisplay::LORA_OK_IDLE);
+  // Right after an ACK the sender holds off MESH_TX_GAP_MS: room for a frame.
+  StatusDisplay::service(lora.quietMs());
 }
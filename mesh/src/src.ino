@@ -4,6 +4,7 @@
 #define MESH_APP_ROLE_TX 1
 #define MESH_APP_ROLE_RX 2
 #define MESH_APP_ROLE_HALF_DUPLEX 3
+#define MESH_APP_ROLE_RELAY 4
 
 #include "mesh_role_config.h"
 
@@ -13,6 +14,8 @@
 #include "rx/rx.ino"
 #elif MESH_APP_ROLE == MESH_APP_ROLE_HALF_DUPLEX
 #include "halfduplex/halfduplex.ino"
+#elif MESH_APP_ROLE == MESH_APP_ROLE_RELAY
+#include "relay/relay.ino"
 #else
-#error "Invalid MESH_APP_ROLE. Use MESH_APP_ROLE_TX (1), MESH_APP_ROLE_RX (2), or MESH_APP_ROLE_HALF_DUPLEX (3)."
+#error "Invalid MESH_APP_ROLE. Use MESH_APP_ROLE_TX (1), MESH_APP_ROLE_RX (2), MESH_APP_ROLE_HALF_DUPLEX (3), or MESH_APP_ROLE_RELAY (4)."
 #endif
@@ -0,0 +1,711 @@
+#include "Reassembler.h"
+#include "../util/Fec.h"
+
+#if MESH_RX_MAX_FRAGS > 0xFFFF
+#error "MESH_RX_MAX_FRAGS must fit the uint16 total_frags field."
+#endif
+
+Reassembler::Reassembler(SdManager& sd) : _sd(sd) {}
+
+// ─── Bitmap helpers ──────────────────────────────────────────────────────────
+
+bool Reassembler::_hasFrag(uint16_t frag) const {
+  return (_bitmap[frag >> 3] >> (frag & 7)) & 1;
+}
+
+void Reassembler::_setFrag(uint16_t frag) {
+  _bitmap[frag >> 3] |= static_cast<uint8_t>(1U << (frag & 7));
+}
+
+void Reassembler::_clearFrag(uint16_t frag) {
+  _bitmap[frag >> 3] &= static_cast<uint8_t>(~(1U << (frag & 7)));
+}
+
+bool Reassembler::_matches(const LoRaHeader& hdr) const {
+  return _active && hdr.src_id == _stats.srcId && hdr.session_id == _stats.sessionId;
+}
+
+// Every fragment but the last is _fragSize bytes; the last one ends the file.
+uint32_t Reassembler::_fragOffset(uint16_t frag, size_t len) const {
+  if (frag + 1U == _stats.totalFrags) {
+    return _stats.totalSize - static_cast<uint32_t>(len);
+  }
+  return static_cast<uint32_t>(frag) * static_cast<uint32_t>(len);
+}
+
+uint16_t Reassembler::_fragLength(uint16_t frag) const {
+  if (frag + 1U < _stats.totalFrags) {
+    return _fragSize;
+  }
+  if (_stats.totalFrags == 1) {
+    return static_cast<uint16_t>(_stats.totalSize);
+  }
+  if (_fragSize == 0) {
+    return 0;
+  }
+  return static_cast<uint16_t>(_stats.totalSize -
+                               static_cast<uint32_t>(_stats.totalFrags - 1U) * _fragSize);
+}
+
+void Reassembler::_advanceCrc() {
+  while (_crcFrontier < _stats.totalFrags && _hasFrag(_crcFrontier)) {
+    const uint16_t len = _fragLength(_crcFrontier);
+    if (len == 0) {
+      return;  // fragment size not learned yet
+    }
+    const uint32_t op = (len == _fragSize) ? _fullOp : crc32ShiftOperator(len);
+    _stats.crc32 = crc32Combine(_stats.crc32, _fragCrc[_crcFrontier], op);
+    _crcFrontier++;
+  }
+}
+
+// ─── Packet handlers ─────────────────────────────────────────────────────────
+
+// CRC16 and limits of a START / RESUME body; STARTED when it is usable.
+ReassemblyResult Reassembler::_parseStart(const uint8_t* payload, size_t len, AudioStartPayload& sp) {
+  if (payload == nullptr || len < sizeof(AudioStartPayload)) {
+    return ReassemblyResult::BAD_START;
+  }
+
+  deserializeAudioStart(payload, &sp);
+
+  const uint16_t expectedCrc = crc16(payload, sizeof(AudioStartPayload) - sizeof(uint16_t));
+  if (sp.crc16 != expectedCrc) {
+    Serial.printf("[RASM] START CRC16 mismatch: got 0x%04X expected 0x%04X\n", sp.crc16, expectedCrc);
+    return ReassemblyResult::BAD_START;
+  }
+
+  if (sp.total_frags == 0 || sp.total_frags > MESH_RX_MAX_FRAGS || sp.total_size == 0 ||
+      sp.total_size > static_cast<uint32_t>(sp.total_frags) * LORA_MAX_DATA_PAYLOAD) {
+    Serial.printf("[RASM] START rejected: frags=%u size=%lu (max frags %u)\n",
+                  sp.total_frags, static_cast<unsigned long>(sp.total_size),
+                  static_cast<unsigned>(MESH_RX_MAX_FRAGS));
+    return ReassemblyResult::BAD_START;
+  }
+  return ReassemblyResult::STARTED;
+}
+
+// Empty context for the transfer; nothing on SD is touched yet.
+void Reassembler::_open(const LoRaHeader& hdr, const AudioStartPayload& sp) {
+  _active = true;
+  _finished = false;
+  _crcFailed = false;
+  _flushed = false;
+  _firstSeq = static_cast<uint16_t>(hdr.seq_num + 1);
+  _highestFrag = -1;
+  _fragSize = 0;
+  _fullOp = 0;
+  _crcFrontier = 0;
+  _mapPending = 0;
+  _mapHeaderSaved = false;
+  memset(_bitmap, 0, sizeof(_bitmap));
+  for (ParitySlot& slot : _parity) {
+    slot.used = false;
+  }
+
+  _stats = ReassemblyStats{};
+  _stats.srcId = hdr.src_id;
+  _stats.sessionId = hdr.session_id;
+  _stats.totalFrags = sp.total_frags;
+  _stats.totalSize = sp.total_size;
+  _stats.startMs = millis();
+  _stats.lastMs = _stats.startMs;
+  _stats.crc32 = 0;  // crc32 of the empty prefix
+  _stats.streamed = sp.total_size > MESH_RX_BUFFER_BYTES;
+  _stats.codec = sp.codec_id;
+
+  snprintf(_fileName, sizeof(_fileName), "rx_%02X_%04X.bin", hdr.src_id, hdr.session_id);
+  snprintf(_pcmFileName, sizeof(_pcmFileName), "rx_%02X_%04X_pcm.bin", hdr.src_id, hdr.session_id);
+  snprintf(_mapFileName, sizeof(_mapFileName), "rx_%02X_%04X_map.bin", hdr.src_id, hdr.session_id);
+}
+
+// Truncate any previous copy so offsets start from an empty file.
+void Reassembler::_truncateFiles() {
+  if (!_sd.isReady()) {
+    return;
+  }
+  const uint8_t none = 0;
+  if (_stats.streamed) {
+    _sd.writeBinaryFile(_fileName, &none, 0, false);
+  }
+  if (_stats.codec == CODEC_COMPRESSED) {
+    _sd.writeBinaryFile(_pcmFileName, &none, 0, false);
+  }
+  _saveMap();
+}
+
+ReassemblyResult Reassembler::onStart(const LoRaHeader& hdr, const uint8_t* payload, size_t len) {
+  AudioStartPayload sp;
+  const ReassemblyResult parsed = _parseStart(payload, len, sp);
+  if (parsed != ReassemblyResult::STARTED) {
+    return parsed;
+  }
+
+  // A START always (re)opens the context; a retried START moves firstSeq.
+  _open(hdr, sp);
+  _truncateFiles();
+
+  Serial.printf("[RASM] START src=0x%02X sess=0x%04X frags=%u size=%lu mode=%s file=%s\n",
+                hdr.src_id, hdr.session_id, sp.total_frags,
+                static_cast<unsigned long>(sp.total_size),
+                _stats.streamed ? "SD" : "RAM", _fileName);
+  return ReassemblyResult::STARTED;
+}
+
+/**
+ * PKT_RESUME: the sender reopens a transfer it could not finish. A context
+ * still open for it keeps what it holds and only moves firstSeq. Otherwise
+ * a streamed transfer is rebuilt from its map file, each held fragment read
+ * back for its CRC32; with neither, the RESUME opens the transfer like a
+ * START (STARTED). nack gets the fragments still missing.
+ */
+ReassemblyResult Reassembler::onResume(const LoRaHeader& hdr, const uint8_t* payload, size_t len,
+                                       ResumeNack* nack) {
+  AudioStartPayload sp;
+  const ReassemblyResult parsed = _parseStart(payload, len, sp);
+  if (parsed != ReassemblyResult::STARTED) {
+    return parsed;
+  }
+
+  ReassemblyResult result = ReassemblyResult::RESUMED;
+  const char* from = "context";
+  if (_matches(hdr) && !_crcFailed && _stats.totalFrags == sp.total_frags &&
+      _stats.totalSize == sp.total_size && _stats.codec == sp.codec_id) {
+    _firstSeq = static_cast<uint16_t>(hdr.seq_num + 1);
+    _finished = false;
+    _highestFrag = -1;
+  } else {
+#if MESH_DUAL_CORE
+    // The map and the fragments it names are read back, so they must have
+    // landed; the sender retries the RESUME meanwhile.
+    if (!_sd.waitStoreDrained()) {
+      return ReassemblyResult::STORAGE_FAIL;
+    }
+#endif
+    _open(hdr, sp);
+    if (_loadMap()) {
+      from = "map";
+    } else {
+      _truncateFiles();
+      from = "none";
+      result = ReassemblyResult::STARTED;
+    }
+  }
+  if (result == ReassemblyResult::RESUMED) {
+    _saveMap();  // bits whose read-back failed are gone from the file too
+  }
+  if (nack != nullptr) {
+    describeMissing(*nack);
+  }
+
+  Serial.printf("[RASM] RESUME src=0x%02X sess=0x%04X held=%u/%u from=%s mode=%s file=%s\n",
+                hdr.src_id, hdr.session_id, _stats.received, _stats.totalFrags, from,
+                _stats.streamed ? "SD" : "RAM", _fileName);
+  return result;
+}
+
+/**
+ * The first LORA_MAX_NACK_RANGES gaps in the bitmap. covered is where the
+ * list stops (totalFrags when every gap fit), so the sender treats all of
+ * [covered, totalFrags) as missing and the answer never drops a fragment.
+ */
+void Reassembler::describeMissing(ResumeNack& nack) const {
+  nack = ResumeNack{};
+  nack.head.status = ACK_STATUS_OK;
+  nack.head.received = _stats.received;
+  uint16_t frag = 0;
+  while (frag < _stats.totalFrags) {
+    if (_hasFrag(frag)) {
+      frag++;
+      continue;
+    }
+    if (nack.head.range_count == LORA_MAX_NACK_RANGES) {
+      break;
+    }
+    NackRange& range = nack.ranges[nack.head.range_count++];
+    range.first_frag = frag;
+    while (frag < _stats.totalFrags && !_hasFrag(frag)) {
+      frag++;
+    }
+    range.count = static_cast<uint16_t>(frag - range.first_frag);
+  }
+  nack.head.covered = frag;
+}
+
+ReassemblyResult Reassembler::onData(const LoRaHeader& hdr, const uint8_t* payload, size_t len,
+                                     int16_t* fragIndex, int16_t* rebuilt) {
+  if (fragIndex != nullptr) {
+    *fragIndex = -1;
+  }
+  if (rebuilt != nullptr) {
+    *rebuilt = -1;
+  }
+  if (!_matches(hdr)) {
+    return ReassemblyResult::NO_SESSION;
+  }
+
+  const uint16_t frag = static_cast<uint16_t>(hdr.seq_num - _firstSeq);
+  if (frag >= _stats.totalFrags || payload == nullptr || len == 0 || len > LORA_MAX_DATA_PAYLOAD) {
+    return ReassemblyResult::OUT_OF_RANGE;
+  }
+  if (fragIndex != nullptr) {
+    *fragIndex = static_cast<int16_t>(frag);
+  }
+
+  if (_hasFrag(frag)) {
+    _stats.duplicates++;
+    return ReassemblyResult::DUPLICATE;
+  }
+
+  const ReassemblyResult placed = _place(frag, payload, len);
+  if (placed == ReassemblyResult::PLACED) {
+    if (static_cast<int32_t>(frag) < _highestFrag) {
+      _stats.outOfOrder++;
+    } else {
+      _highestFrag = frag;
+    }
+    const int32_t repaired = _repairGroupOf(frag);
+    if (rebuilt != nullptr) {
+      *rebuilt = static_cast<int16_t>(repaired);
+    }
+  }
+  return placed;
+}
+
+// Store a fragment not held yet; shared by DATA and FEC repair.
+ReassemblyResult Reassembler::_place(uint16_t frag, const uint8_t* payload, size_t len) {
+  const bool isLast = (frag + 1U == _stats.totalFrags);
+  if (!isLast) {
+    if (_fragSize == 0) {
+      _fragSize = static_cast<uint16_t>(len);
+      _fullOp = crc32ShiftOperator(_fragSize);
+      _mapHeaderSaved = false;
+    } else if (len != _fragSize) {
+      Serial.printf("[RASM] frag %u len %u != fragment size %u\n",
+                    frag, static_cast<unsigned>(len), _fragSize);
+      return ReassemblyResult::OUT_OF_RANGE;
+    }
+  }
+
+  const uint32_t offset = _fragOffset(frag, len);
+  if (offset + len > _stats.totalSize) {
+    return ReassemblyResult::OUT_OF_RANGE;
+  }
+
+  if (!_stats.streamed) {
+    memcpy(_buffer + offset, payload, len);
+  } else if (_sd.isReady()) {
+    if (!_sd.writeBinaryFile(_fileName, offset, payload, len)) {
+      return ReassemblyResult::STORAGE_FAIL;
+    }
+  }
+
+  _fragCrc[frag] = crc32(payload, len);
+  _setFrag(frag);
+  _stats.received++;
+  _stats.bytesReceived += static_cast<uint32_t>(len);
+  _stats.lastMs = millis();
+  _advanceCrc();
+  if (_stats.codec == CODEC_COMPRESSED) {
+    _decodeFrag(frag, payload, len);
+  }
+  if (++_mapPending >= MESH_RESUME_MAP_EVERY) {
+    _saveMap();
+  }
+  return ReassemblyResult::PLACED;
+}
+
+// ─── Resume map ──────────────────────────────────────────────────────────────
+//
+// rx_<src>_<session>_map.bin holds a MapHeader, then the bitmap bytes. The
+// writes queue behind the fragment writes they describe, so the map never
+// claims a fragment the .bin does not have yet.
+
+void Reassembler::_saveMap() {
+  _mapPending = 0;
+#if MESH_RESUME_ENABLE
+  if (!_stats.streamed || !_sd.isReady()) {
+    return;
+  }
+  // The header is rewritten once more when the fragment size is learned.
+  if (!_mapHeaderSaved) {
+    MapHeader mh = {};
+    mh.magic = kMapMagic;
+    mh.totalSize = _stats.totalSize;
+    mh.totalFrags = _stats.totalFrags;
+    mh.fragSize = _fragSize;
+    mh.codec = _stats.codec;
+    _mapHeaderSaved = _sd.writeBinaryFile(_mapFileName, 0, reinterpret_cast<const uint8_t*>(&mh), sizeof(mh));
+  }
+  if (!_mapHeaderSaved ||
+      !_sd.writeBinaryFile(_mapFileName, sizeof(MapHeader), _bitmap, (_stats.totalFrags + 7U) / 8U)) {
+    Serial.printf("[RASM] map write failed: %s\n", _mapFileName);
+  }
+#endif
+}
+
+// After _open(): the map file's bitmap, if it describes this transfer. Held
+// fragments are read back for their CRC32; one that cannot be is dropped
+// from the bitmap and asked for again.
+bool Reassembler::_loadMap() {
+  if (!_stats.streamed || !_sd.isReady()) {
+    return false;
+  }
+  MapHeader mh = {};
+  if (!_sd.readBinaryFile(_mapFileName, 0, reinterpret_cast<uint8_t*>(&mh), sizeof(mh)) ||
+      mh.magic != kMapMagic || mh.totalSize != _stats.totalSize ||
+      mh.totalFrags != _stats.totalFrags || mh.codec != _stats.codec) {
+    return false;
+  }
+  if (!_sd.readBinaryFile(_mapFileName, sizeof(MapHeader), _bitmap, (_stats.totalFrags + 7U) / 8U)) {
+    memset(_bitmap, 0, sizeof(_bitmap));
+    return false;
+  }
+  _mapHeaderSaved = true;
+  _fragSize = mh.fragSize;
+  _fullOp = _fragSize != 0 ? crc32ShiftOperator(_fragSize) : 0;
+
+  uint8_t held[LORA_MAX_DATA_PAYLOAD];
+  for (uint16_t frag = 0; frag < _stats.totalFrags; ++frag) {
+    if (!_hasFrag(frag)) {
+      continue;
+    }
+    const uint16_t len = _fragLength(frag);
+    if (len == 0 || len > sizeof(held) || !_readFrag(frag, held, len)) {
+      _clearFrag(frag);
+      continue;
+    }
+    _fragCrc[frag] = crc32(held, len);
+    _stats.received++;
+    _stats.bytesReceived += len;
+  }
+  _advanceCrc();
+  return true;
+}
+
+#if MESH_DUAL_CORE
+/**
+ * A fragment write writer could not land after the fragment was ACKed.
+ * The fragment is dropped from the bitmap, so END answers MISSING and the
+ * next RESUME asks for it; CRC32 is refolded from the per-fragment CRCs of
+ * the prefix still held. A failed map write is redone whole.
+ */
+bool Reassembler::onStoreFailed(const SdManager::StoreFailure& failed) {
+  if (!_active) {
+    return false;
+  }
+  if (strcmp(failed.file, _mapFileName) == 0) {
+    _mapHeaderSaved = false;
+    _saveMap();
+    return true;
+  }
+  if (strcmp(failed.file, _pcmFileName) == 0) {
+    _stats.pcmBytes -= failed.len;  // silence there; END verifies the wire copy
+    return true;
+  }
+  if (strcmp(failed.file, _fileName) != 0) {
+    return false;
+  }
+
+  // Each fragment is one write at _fragOffset(); a truncate (len 0) is neither.
+  uint16_t frag = _stats.totalFrags;
+  if (failed.len != 0 && failed.offset + failed.len == _stats.totalSize) {
+    frag = static_cast<uint16_t>(_stats.totalFrags - 1U);
+  } else if (failed.len != 0 && failed.offset % failed.len == 0) {
+    frag = static_cast<uint16_t>(failed.offset / failed.len);
+  }
+  if (frag >= _stats.totalFrags || !_hasFrag(frag) || _fragLength(frag) != failed.len) {
+    return true;
+  }
+
+  _clearFrag(frag);
+  _stats.received--;
+  _stats.bytesReceived -= failed.len;
+  if (frag < _crcFrontier) {
+    _crcFrontier = 0;
+    _stats.crc32 = 0;
+    _advanceCrc();
+  }
+  _saveMap();
+  Serial.printf("[RASM] frag %u lost on the card after its ACK, asking again: %s\n", frag, _fileName);
+  return true;
+}
+#endif
+
+// Decode one ADPCM block into the PCM file. Losing the PCM copy does not
+// fail the fragment: the wire copy is what END verifies.
+void Reassembler::_decodeFrag(uint16_t frag, const uint8_t* payload, size_t len) {
+  if (!_sd.isReady()) {
+    return;
+  }
+  // Every block but the last is _fragSize bytes; before one has arrived
+  // the last block's size gives it away through total_size.
+  uint32_t blockBytes = _fragSize;
+  if (blockBytes == 0) {
+    blockBytes = (_stats.totalFrags > 1)
+                     ? (_stats.totalSize - static_cast<uint32_t>(len)) / (_stats.totalFrags - 1U)
+                     : static_cast<uint32_t>(len);
+  }
+
+  const uint32_t start = micros();
+  const uint16_t samples = imaAdpcmDecodeBlock(payload, len, _pcm);
+  _stats.decodeUs += micros() - start;
+  if (samples == 0) {
+    Serial.printf("[RASM] frag %u is not an ADPCM block\n", frag);
+    return;
+  }
+
+  const uint32_t offset = static_cast<uint32_t>(frag) *
+                          imaAdpcmBlockSamples(static_cast<uint16_t>(blockBytes)) * sizeof(int16_t);
+  const size_t bytes = samples * sizeof(int16_t);
+  if (!_sd.writeBinaryFile(_pcmFileName, offset, reinterpret_cast<const uint8_t*>(_pcm), bytes)) {
+    Serial.printf("[RASM] PCM write failed for frag %u\n", frag);
+    return;
+  }
+  _stats.pcmBytes += static_cast<uint32_t>(bytes);
+}
+
+ReassemblyResult Reassembler::onParity(const LoRaHeader& hdr, const uint8_t* payload, size_t len,
+                                       int16_t* fragIndex) {
+  if (fragIndex != nullptr) {
+    *fragIndex = -1;
+  }
+  if (!_matches(hdr)) {
+    return ReassemblyResult::NO_SESSION;
+  }
+  if (payload == nullptr || len <= sizeof(FecParityPayload) ||
+      len > sizeof(FecParityPayload) + LORA_MAX_FEC_DATA_PAYLOAD) {
+    return ReassemblyResult::OUT_OF_RANGE;
+  }
+
+  FecParityPayload fp;
+  deserializeFecParity(payload, &fp);
+  if (fp.parity_count == 0 || fp.parity_count > LORA_MAX_FEC_PARITY ||
+      fp.parity_index >= fp.parity_count || fp.data_count == 0 ||
+      fp.block_frag + static_cast<uint32_t>(fp.data_count) > _stats.totalFrags) {
+    return ReassemblyResult::OUT_OF_RANGE;
+  }
+
+  // One slot per index: the next block's parity replaces this block's.
+  ParitySlot& slot = _parity[fp.parity_index];
+  slot.used = true;
+  slot.blockFrag = fp.block_frag;
+  slot.dataCount = fp.data_count;
+  slot.index = fp.parity_index;
+  slot.count = fp.parity_count;
+  slot.len = static_cast<uint16_t>(len - sizeof(FecParityPayload));
+  memcpy(slot.data, payload + sizeof(FecParityPayload), slot.len);
+
+  const int32_t rebuilt = _repair(slot);
+  if (rebuilt < 0) {
+    return ReassemblyResult::PARITY_HELD;
+  }
+  if (fragIndex != nullptr) {
+    *fragIndex = static_cast<int16_t>(rebuilt);
+  }
+  return ReassemblyResult::RECOVERED;
+}
+
+bool Reassembler::_readFrag(uint16_t frag, uint8_t* out, uint16_t len) {
+  const uint32_t offset = _fragOffset(frag, len);
+  if (!_stats.streamed) {
+    memcpy(out, _buffer + offset, len);
+    return true;
+  }
+  return _sd.isReady() && _sd.readBinaryFile(_fileName, offset, out, len);
+}
+
+/**
+ * Rebuild the group's fragment if it is the only one missing. Returns its
+ * index, or -1 (nothing missing, more than one missing, or a read failed).
+ * The slot is released once its group is whole.
+ */
+int32_t Reassembler::_repair(ParitySlot& slot) {
+  const uint8_t members = fecGroupSize(slot.dataCount, slot.count, slot.index);
+  int32_t missing = -1;
+  for (uint8_t j = 0; j < members; ++j) {
+    const uint16_t frag = static_cast<uint16_t>(slot.blockFrag + slot.index + j * slot.count);
+    if (!_hasFrag(frag)) {
+      if (missing >= 0) {
+        return -1;
+      }
+      missing = frag;
+    }
+  }
+  if (missing < 0) {
+    slot.used = false;
+    return -1;
+  }
+
+  const uint16_t target = static_cast<uint16_t>(missing);
+  // Before any full-size fragment arrived, parity length is the fragment size.
+  uint16_t targetLen = _fragLength(target);
+  if (targetLen == 0) {
+    targetLen = slot.len;
+  }
+  if (targetLen > slot.len) {
+    return -1;
+  }
+
+  uint8_t acc[LORA_MAX_FEC_DATA_PAYLOAD];
+  uint8_t held[LORA_MAX_FEC_DATA_PAYLOAD];
+  memcpy(acc, slot.data, slot.len);
+  for (uint8_t j = 0; j < members; ++j) {
+    const uint16_t frag = static_cast<uint16_t>(slot.blockFrag + slot.index + j * slot.count);
+    if (frag == target) {
+      continue;
+    }
+    const uint16_t len = _fragLength(frag);
+    if (len == 0 || len > slot.len || !_readFrag(frag, held, len)) {
+      return -1;
+    }
+    fecXor(acc, held, len);
+  }
+
+  if (_place(target, acc, targetLen) != ReassemblyResult::PLACED) {
+    return -1;
+  }
+  _stats.recovered++;
+  slot.used = false;
+  Serial.printf("[RASM] FEC rebuilt frag %u (parity %u/%u of block at %u)\n",
+                target, slot.index, slot.count, slot.blockFrag);
+  return missing;
+}
+
+// A fragment just landed: its parity group may now be one short.
+int32_t Reassembler::_repairGroupOf(uint16_t frag) {
+  for (ParitySlot& slot : _parity) {
+    if (slot.used && frag >= slot.blockFrag && frag < slot.blockFrag + slot.dataCount &&
+        (frag - slot.blockFrag) % slot.count == slot.index) {
+      return _repair(slot);
+    }
+  }
+  return -1;
+}
+
+ReassemblyResult Reassembler::onEnd(const LoRaHeader& hdr, const uint8_t* payload, size_t len) {
+  if (!_matches(hdr)) {
+    return ReassemblyResult::NO_SESSION;
+  }
+
+  AudioEndPayload ep = {};
+  if (payload != nullptr && len >= sizeof(AudioEndPayload)) {
+    deserializeAudioEnd(payload, &ep);
+  }
+
+#if MESH_DUAL_CORE
+  // A queued fragment write can still fail; the caller drains the queue
+  // and hands failures to onStoreFailed() first.
+  if (_stats.streamed && _sd.storePending() > 0) {
+    Serial.printf("[RASM] END before %u queued writes landed\n", static_cast<unsigned>(_sd.storePending()));
+    return ReassemblyResult::INCOMPLETE;
+  }
+#endif
+  if (_stats.received < _stats.totalFrags || _crcFrontier < _stats.totalFrags) {
+    _saveMap();
+    Serial.printf("[RASM] END incomplete: %u/%u fragments, sender sent %u\n",
+                  _stats.received, _stats.totalFrags, ep.frag_count);
+    return ReassemblyResult::INCOMPLETE;
+  }
+
+  if (!_stats.streamed && !_flushed && _sd.isReady()) {
+    _flushed = _sd.writeBinaryFile(_fileName, _buffer, _stats.totalSize, false);
+  }
+
+  const bool crcOk = (_stats.crc32 == ep.crc32);
+  _finished = true;
+  _crcFailed = !crcOk;
+  if (crcOk) {
+    _saveMap();
+  } else if (_stats.streamed && _sd.isReady()) {
+    // Nothing here is worth resuming: the next RESUME starts over.
+    const uint8_t none = 0;
+    _sd.writeBinaryFile(_mapFileName, &none, 0, false);
+    _mapHeaderSaved = false;
+  }
+  Serial.printf("[RASM] END %s: crc32=0x%08lX expected=0x%08lX bytes=%lu dups=%u ooo=%u fec=%u goodput=%lu bps file=%s\n",
+                crcOk ? "CRC OK" : "CRC MISMATCH",
+                static_cast<unsigned long>(_stats.crc32),
+                static_cast<unsigned long>(ep.crc32),
+                static_cast<unsigned long>(_stats.bytesReceived),
+                _stats.duplicates,
+                _stats.outOfOrder,
+                _stats.recovered,
+                static_cast<unsigned long>(goodputBps()),
+                _fileName);
+  if (_stats.codec == CODEC_COMPRESSED && _stats.received > 0) {
+    Serial.printf("[RASM] ADPCM %lu -> %lu bytes (%.2f:1), decode %lu us per fragment, file=%s\n",
+                  static_cast<unsigned long>(_stats.totalSize),
+                  static_cast<unsigned long>(_stats.pcmBytes),
+                  static_cast<double>(_stats.pcmBytes) / _stats.totalSize,
+                  static_cast<unsigned long>(_stats.decodeUs / _stats.received),
+                  _pcmFileName);
+  }
+  return crcOk ? ReassemblyResult::COMPLETE : ReassemblyResult::CRC_MISMATCH;
+}
+
+uint32_t Reassembler::windowBitmap(const LoRaHeader& pollHdr, uint16_t baseSeq, uint8_t count) const {
+  if (!_matches(pollHdr)) {
+    return 0;
+  }
+  if (count > LORA_MAX_WINDOW_SIZE) {
+    count = LORA_MAX_WINDOW_SIZE;
+  }
+
+  uint32_t bitmap = 0;
+  for (uint8_t i = 0; i < count; ++i) {
+    const uint16_t frag = static_cast<uint16_t>(baseSeq + i - _firstSeq);
+    if (frag < _stats.totalFrags && _hasFrag(frag)) {
+      bitmap |= 1UL << i;
+    }
+  }
+  return bitmap;
+}
+
+uint32_t Reassembler::goodputBps() const {
+  const uint32_t elapsedMs = _stats.lastMs - _stats.startMs;
+  if (elapsedMs == 0) {
+    return 0;
+  }
+  return static_cast<uint32_t>((static_cast<uint64_t>(_stats.bytesReceived) * 8000ULL) / elapsedMs);
+}
+
+// ─── Labels ──────────────────────────────────────────────────────────────────
+
+uint8_t Reassembler::ackStatusFor(ReassemblyResult result) {
+  switch (result) {
+    case ReassemblyResult::STARTED:
+    case ReassemblyResult::RESUMED:
+    case ReassemblyResult::PLACED:
+    case ReassemblyResult::DUPLICATE:
+    case ReassemblyResult::PARITY_HELD:
+    case ReassemblyResult::RECOVERED:
+    case ReassemblyResult::COMPLETE:
+      return ACK_STATUS_OK;
+    case ReassemblyResult::CRC_MISMATCH:
+    case ReassemblyResult::BAD_START:
+      return ACK_STATUS_CRC_ERR;
+    default:
+      return ACK_STATUS_MISSING;
+  }
+}
+
+LogStatus Reassembler::logStatus(ReassemblyResult result) {
+  switch (result) {
+    case ReassemblyResult::STARTED: return LOG_STATUS_RX_START_OK;
+    case ReassemblyResult::RESUMED: return LOG_STATUS_RX_RESUMED;
+    case ReassemblyResult::PLACED: return LOG_STATUS_RX_RECV;
+    case ReassemblyResult::DUPLICATE: return LOG_STATUS_RX_DUP;
+    case ReassemblyResult::PARITY_HELD: return LOG_STATUS_RX_PARITY;
+    case ReassemblyResult::RECOVERED: return LOG_STATUS_RX_FEC_RECOVERED;
+    case ReassemblyResult::COMPLETE: return LOG_STATUS_RX_CRC_OK;
+    case ReassemblyResult::CRC_MISMATCH: return LOG_STATUS_RX_CRC_FAIL;
+    case ReassemblyResult::INCOMPLETE: return LOG_STATUS_RX_INCOMPLETE;
+    case ReassemblyResult::NO_SESSION: return LOG_STATUS_RX_NO_SESSION;
+    case ReassemblyResult::OUT_OF_RANGE: return LOG_STATUS_RX_OUT_OF_RANGE;
+    case ReassemblyResult::STORAGE_FAIL: return LOG_STATUS_RX_STORE_FAIL;
+    case ReassemblyResult::BAD_START: return LOG_STATUS_RX_BAD_START;
+    case ReassemblyResult::NO_CONTEXT: return LOG_STATUS_RX_TABLE_FULL;
+    default: return LOG_STATUS_UNKNOWN;
+  }
+}
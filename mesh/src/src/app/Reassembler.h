@@ -0,0 +1,177 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "../models/packet.h"
+#include "../storage/SdManager.h"
+#include "../codec/ImaAdpcm.h"
+#include "../../mesh_role_config.h"
+
+enum class ReassemblyResult : uint8_t {
+  STARTED,        // START accepted, context (re)opened
+  RESUMED,        // RESUME reopened a context with the fragments it held
+  PLACED,         // DATA fragment stored
+  DUPLICATE,      // DATA fragment already held
+  PARITY_HELD,    // FEC parity stored; nothing to rebuild (yet)
+  RECOVERED,      // FEC parity rebuilt a missing DATA fragment
+  COMPLETE,       // END: all fragments present and CRC32 matches
+  CRC_MISMATCH,   // END: all fragments present, CRC32 differs
+  INCOMPLETE,     // END: fragments still missing
+  NO_SESSION,     // DATA/END for a (src, session) with no START
+  OUT_OF_RANGE,   // seq does not map to a fragment of this transfer
+  STORAGE_FAIL,   // SD write failed; fragment not marked so a retry can land
+  BAD_START,      // START payload failed CRC16 or exceeds limits
+  NO_CONTEXT      // START refused: every SessionTable context holds a live session
+};
+
+struct ReassemblyStats {
+  uint8_t  srcId;
+  uint16_t sessionId;
+  uint16_t totalFrags;
+  uint32_t totalSize;
+  uint16_t received;
+  uint16_t duplicates;
+  uint16_t outOfOrder;   // DATA placed below the highest fragment already held
+  uint16_t recovered;    // fragments rebuilt from FEC parity
+  uint32_t bytesReceived;
+  uint32_t startMs;
+  uint32_t lastMs;
+  uint32_t crc32;        // running CRC over the contiguous prefix
+  bool     streamed;     // true = written to SD per fragment, false = RAM
+  uint8_t  codec;        // codec_id from START
+  uint32_t pcmBytes;     // CODEC_COMPRESSED: decoded bytes written
+  uint32_t decodeUs;     // CODEC_COMPRESSED: total decode time
+};
+
+/*
+ * Reassembler - RX side of a START / DATA... / END transfer
+ *
+ * The AudioStartPayload sizes the context (total_frags, total_size).
+ * Each DATA seq maps to frag = seq - firstSeq, where firstSeq is the seq
+ * right after the accepted START. Fragments land by index in a RAM buffer
+ * (small transfers, flushed once at END) or straight into an SD .bin via
+ * SdManager::writeBinaryFile at their byte offset (large transfers).
+ *
+ * A bitmap tracks which fragments are held. CRC32 is folded in as the
+ * contiguous prefix grows using per-fragment CRCs and crc32Combine(), so
+ * END is a compare, not a second pass over the data.
+ *
+ * PKT_AUDIO_PARITY frames (src/util/Fec.h) are kept one per parity index.
+ * Whenever a parity group is down to one missing fragment, the held ones
+ * are read back (RAM buffer or SD) and XORed out of the parity, and the
+ * result is placed like any other DATA fragment. That runs when the parity
+ * arrives and again when a resend fills a group, so a poll that follows
+ * already reports the rebuilt fragments.
+ *
+ * The .bin always holds the bytes as sent, so CRC32 and FEC see the wire
+ * stream. For CODEC_COMPRESSED every placed fragment is also decoded as one
+ * IMA-ADPCM block into rx_<src>_<session>_pcm.bin at its sample offset; a
+ * fragment that never arrives stays zero-filled silence there.
+ *
+ * PKT_RESUME reopens a transfer the sender could not finish: the context
+ * keeps its bitmap, or a streamed one reloads it from
+ * rx_<src>_<session>_map.bin, and describeMissing() fills the PKT_NACK.
+ */
+class Reassembler {
+ public:
+  explicit Reassembler(SdManager& sd);
+
+  ReassemblyResult onStart(const LoRaHeader& hdr, const uint8_t* payload, size_t len);
+  /** PKT_RESUME (AudioStartPayload body); nack gets the fragments still missing. */
+  ReassemblyResult onResume(const LoRaHeader& hdr, const uint8_t* payload, size_t len,
+                            ResumeNack* nack = nullptr);
+  /** DATA; rebuilt is the fragment its parity group then rebuilt, else -1. */
+  ReassemblyResult onData(const LoRaHeader& hdr, const uint8_t* payload, size_t len,
+                          int16_t* fragIndex = nullptr, int16_t* rebuilt = nullptr);
+  ReassemblyResult onEnd(const LoRaHeader& hdr, const uint8_t* payload, size_t len);
+  /** PKT_AUDIO_PARITY; fragIndex is the fragment it rebuilt, else -1. */
+  ReassemblyResult onParity(const LoRaHeader& hdr, const uint8_t* payload, size_t len,
+                            int16_t* fragIndex = nullptr);
+
+  /** Received-bitmap for [baseSeq, baseSeq + count), answers PKT_WINDOW_POLL. */
+  uint32_t windowBitmap(const LoRaHeader& pollHdr, uint16_t baseSeq, uint8_t count) const;
+  /** Gaps in the bitmap as PKT_NACK ranges; status OK, ack_seq left 0. */
+  void describeMissing(ResumeNack& nack) const;
+#if MESH_DUAL_CORE
+  /** A write-behind failure (SdManager::takeStoreFailure); false when not this context's file. */
+  bool onStoreFailed(const SdManager::StoreFailure& failed);
+#endif
+
+  /** Context state for SessionTable: open, whose, and whether END settled it. */
+  bool active() const { return _active; }
+  bool holds(uint8_t srcId, uint16_t sessionId) const {
+    return _active && _stats.srcId == srcId && _stats.sessionId == sessionId;
+  }
+  bool finished() const { return _finished; }
+  void close() { _active = false; }
+
+  const ReassemblyStats& stats() const { return _stats; }
+  uint32_t goodputBps() const;
+  const char* outputFile() const { return _fileName; }
+
+  static uint8_t ackStatusFor(ReassemblyResult result);
+  static LogStatus logStatus(ReassemblyResult result);   // status column for the frame
+
+ private:
+  struct ParitySlot {
+    bool     used;
+    uint16_t blockFrag;
+    uint8_t  dataCount;
+    uint8_t  index;
+    uint8_t  count;
+    uint16_t len;
+    uint8_t  data[LORA_MAX_FEC_DATA_PAYLOAD];
+  };
+
+  // rx_<src>_<session>_map.bin: this header, then the bitmap bytes.
+  struct MapHeader {
+    uint32_t magic;
+    uint32_t totalSize;
+    uint16_t totalFrags;
+    uint16_t fragSize;
+    uint8_t  codec;
+    uint8_t  reserved[3];
+  };
+  static constexpr uint32_t kMapMagic = 0x50414D52UL;  // "RMAP"
+
+  ReassemblyResult _parseStart(const uint8_t* payload, size_t len, AudioStartPayload& sp);
+  void _open(const LoRaHeader& hdr, const AudioStartPayload& sp);
+  void _truncateFiles();
+  void _saveMap();
+  bool _loadMap();
+  bool _matches(const LoRaHeader& hdr) const;
+  bool _hasFrag(uint16_t frag) const;
+  void _setFrag(uint16_t frag);
+  void _clearFrag(uint16_t frag);
+  uint32_t _fragOffset(uint16_t frag, size_t len) const;
+  uint16_t _fragLength(uint16_t frag) const;
+  void _advanceCrc();
+  ReassemblyResult _place(uint16_t frag, const uint8_t* payload, size_t len);
+  bool _readFrag(uint16_t frag, uint8_t* out, uint16_t len);
+  int32_t _repair(ParitySlot& slot);
+  int32_t _repairGroupOf(uint16_t frag);
+  void _decodeFrag(uint16_t frag, const uint8_t* payload, size_t len);
+
+  SdManager& _sd;
+  bool _active = false;
+  bool _finished = false;       // END answered COMPLETE or CRC_MISMATCH
+  bool _crcFailed = false;      // ... and it was CRC_MISMATCH: a RESUME starts over
+  uint16_t _firstSeq = 0;
+  int32_t _highestFrag = -1;    // highest DATA fragment placed, for outOfOrder
+  uint16_t _fragSize = 0;       // learned from the first non-last fragment
+  uint16_t _crcFrontier = 0;    // fragments [0, _crcFrontier) folded into _stats.crc32
+  uint32_t _fullOp = 0;         // cached crc32ShiftOperator(_fragSize)
+  ReassemblyStats _stats = {};
+  bool _flushed = false;        // RAM-mode file already written at END
+  char _fileName[24] = {0};
+  char _pcmFileName[24] = {0};
+  char _mapFileName[24] = {0};
+  uint16_t _mapPending = 0;     // fragments placed since the map was saved
+  bool _mapHeaderSaved = false;
+
+  uint8_t _bitmap[(MESH_RX_MAX_FRAGS + 7) / 8];
+  uint32_t _fragCrc[MESH_RX_MAX_FRAGS];
+  uint8_t _buffer[MESH_RX_BUFFER_BYTES];
+  ParitySlot _parity[LORA_MAX_FEC_PARITY];
+  int16_t _pcm[imaAdpcmBlockSamples(LORA_MAX_DATA_PAYLOAD)];
+};
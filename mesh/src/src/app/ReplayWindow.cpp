@@ -0,0 +1,101 @@
+#include "ReplayWindow.h"
+
+ReplayWindow::Peer* ReplayWindow::_peer(uint8_t srcId) {
+  for (Peer& peer : _peers) {
+    if (peer.used && peer.srcId == srcId) {
+      return &peer;
+    }
+  }
+  return nullptr;
+}
+
+// A free window, else the one of the peer heard least recently.
+ReplayWindow::Peer* ReplayWindow::_claimPeer(uint8_t srcId) {
+  const uint32_t now = millis();
+  Peer* victim = &_peers[0];
+  for (Peer& peer : _peers) {
+    if (!peer.used) {
+      victim = &peer;
+      break;
+    }
+    if (now - peer.lastMs > now - victim->lastMs) {
+      victim = &peer;
+    }
+  }
+  if (victim->used) {
+    _stats.peerEvictions++;
+  }
+  memset(victim, 0, sizeof(*victim));
+  victim->used = true;
+  victim->srcId = srcId;
+  victim->lastMs = now;
+  return victim;
+}
+
+const ReplayWindow::Entry* ReplayWindow::find(const LoRaHeader& hdr) {
+  Peer* peer = _peer(hdr.src_id);
+  if (peer == nullptr) {
+    return nullptr;
+  }
+  peer->lastMs = millis();
+  const Entry& entry = peer->slots[hdr.seq_num & (MESH_RX_REPLAY_WINDOW - 1)];
+  if (!entry.used || entry.seq != hdr.seq_num || entry.sessionId != hdr.session_id ||
+      entry.type != getType(hdr.ver_type)) {
+    return nullptr;
+  }
+  _stats.hits++;
+  return &entry;
+}
+
+void ReplayWindow::store(const LoRaHeader& hdr, const uint8_t* ack, uint8_t len, int16_t fragIndex,
+                         uint16_t fragLen) {
+  if (ack == nullptr || len == 0 || len > LORA_ACK_FRAME_SIZE) {
+    return;
+  }
+  Peer* peer = _peer(hdr.src_id);
+  if (peer == nullptr) {
+    peer = _claimPeer(hdr.src_id);
+  }
+  peer->lastMs = millis();
+
+  Entry& entry = peer->slots[hdr.seq_num & (MESH_RX_REPLAY_WINDOW - 1)];
+  entry.used = true;
+  entry.type = getType(hdr.ver_type);
+  entry.sessionId = hdr.session_id;
+  entry.seq = hdr.seq_num;
+  entry.fragIndex = fragIndex;
+  entry.fragLen = fragLen;
+  entry.len = len;
+  memcpy(entry.frame, ack, len);
+  _stats.stored++;
+}
+
+void ReplayWindow::forget(const LoRaHeader& hdr) {
+  Peer* peer = _peer(hdr.src_id);
+  if (peer == nullptr) {
+    return;
+  }
+  for (Entry& entry : peer->slots) {
+    if (entry.sessionId == hdr.session_id) {
+      entry.used = false;
+    }
+  }
+}
+
+void ReplayWindow::clear() {
+  for (Peer& peer : _peers) {
+    peer.used = false;
+  }
+}
+
+void ReplayWindow::printStats() const {
+  uint8_t peers = 0;
+  for (const Peer& peer : _peers) {
+    peers += peer.used ? 1 : 0;
+  }
+  Serial.printf("[DUP] replayed=%lu cached=%lu peers=%u/%u window=%u peer_evictions=%lu\n",
+                static_cast<unsigned long>(_stats.hits), static_cast<unsigned long>(_stats.stored),
+                static_cast<unsigned>(peers), static_cast<unsigned>(MESH_RX_REPLAY_PEERS),
+                static_cast<unsigned>(MESH_RX_REPLAY_WINDOW),
+                static_cast<unsigned long>(_stats.peerEvictions));
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "../models/packet.h"
+#include "../../mesh_role_config.h"
+
+/*
+ * ReplayWindow - cached ACKs for retransmitted frames at the receiver
+ *
+ * When an ACK is lost the sender resends the same seq. Every OK ACK sent
+ * for a START / DATA / END is kept here, per peer, in a window of
+ * MESH_RX_REPLAY_WINDOW slots indexed by seq & (window - 1). A frame whose
+ * (session, seq, type) is in its slot is a retransmit: the caller puts the
+ * cached ACK bytes straight back on air (LoRaManager::resendReply) and logs
+ * the frame with dup=1, without running it through the session table or
+ * writing it to SD again. That is one compare per frame.
+ *
+ * A slot is taken over by the seq one window later, so only the last
+ * MESH_RX_REPLAY_WINDOW seqs of a peer replay. An older retransmit falls
+ * through to the reassembler, which still answers it as DUPLICATE. Error
+ * ACKs are never cached: a START the table refused or an END that found
+ * fragments missing must be looked at again. More than MESH_RX_REPLAY_PEERS
+ * peers share the windows; the least recently heard peer loses its own.
+ *
+ * Usage:
+ *   if (const ReplayWindow::Entry* cached = replay.find(hdr)) {
+ *     lora.resendReply(cached->frame, cached->len);
+ *   } else if (lora.sendAckFor(hdr, status, ackFrame) && status == ACK_STATUS_OK) {
+ *     replay.store(hdr, ackFrame, LORA_ACK_FRAME_SIZE, fragIndex, fragLen);
+ *   }
+ */
+class ReplayWindow {
+ public:
+  static_assert(MESH_RX_REPLAY_WINDOW > 0 && (MESH_RX_REPLAY_WINDOW & (MESH_RX_REPLAY_WINDOW - 1)) == 0,
+                "MESH_RX_REPLAY_WINDOW must be a power of two");
+
+  struct Entry {
+    bool     used;
+    uint8_t  type;        // packet type the ACK answered
+    uint16_t sessionId;
+    uint16_t seq;
+    int16_t  fragIndex;   // for the duplicate's log row
+    uint16_t fragLen;
+    uint8_t  len;
+    uint8_t  frame[LORA_ACK_FRAME_SIZE];
+  };
+
+  struct Stats {
+    uint32_t hits;           // retransmits answered from the cache
+    uint32_t stored;
+    uint32_t peerEvictions;  // windows handed to a new peer
+  };
+
+  /** The cached ACK for this frame, or nullptr; counts a hit. */
+  const Entry* find(const LoRaHeader& hdr);
+  void store(const LoRaHeader& hdr, const uint8_t* ack, uint8_t len, int16_t fragIndex, uint16_t fragLen);
+  void clear();   // e.g. after a rate change: cached headers carry the old SF
+  // Drop the session's ACKs: after a PKT_RESUME from a rebooted sender its
+  // seqs start over and would hit ACKs cached for other fragments.
+  void forget(const LoRaHeader& hdr);
+
+  const Stats& stats() const { return _stats; }
+  void printStats() const;
+
+ private:
+  struct Peer {
+    bool     used;
+    uint8_t  srcId;
+    uint32_t lastMs;
+    Entry    slots[MESH_RX_REPLAY_WINDOW];
+  };
+
+  Peer* _peer(uint8_t srcId);
+  Peer* _claimPeer(uint8_t srcId);
+
+  Peer _peers[MESH_RX_REPLAY_PEERS] = {};
+  Stats _stats = {};
+};
@@ -1,18 +1,46 @@
 #include "ResearchStateMachine.h"
 
 ResearchStateMachine::ResearchStateMachine(const char* roleLabel)
-    : _state(ResearchState::INIT), _roleLabel(roleLabel ? roleLabel : "NODE") {}
+    : _state(ResearchState::INIT), _roleLabel(roleLabel ? roleLabel : "NODE") {
+  _stats.entries[static_cast<uint8_t>(ResearchState::INIT)] = 1;
+}
 
 ResearchState ResearchStateMachine::state() const {
   return _state;
 }
 
+void ResearchStateMachine::expectCompletion(uint32_t startMs, uint32_t durationMs) {
+  _expecting = true;
+  _expectStartMs = startMs;
+  _expectDurationMs = durationMs;
+}
+
+void ResearchStateMachine::clearExpectation() {
+  _expecting = false;
+}
+
+bool ResearchStateMachine::hasExpectation() const {
+  return _expecting;
+}
+
+uint32_t ResearchStateMachine::expectedDurationMs() const {
+  return _expecting ? _expectDurationMs : 0;
+}
+
+int32_t ResearchStateMachine::etaMs(uint32_t nowMs) const {
+  if (!_expecting) {
+    return 0;
+  }
+  return static_cast<int32_t>(_expectDurationMs) - static_cast<int32_t>(nowMs - _expectStartMs);
+}
+
 const char* ResearchStateMachine::stateName(ResearchState state) {
   switch (state) {
     case ResearchState::INIT: return "INIT";
     case ResearchState::IDLE: return "IDLE";
     case ResearchState::TX: return "TX";
     case ResearchState::WAIT_ACK: return "WAIT_ACK";
+    case ResearchState::BACKOFF: return "BACKOFF";
     case ResearchState::RX: return "RX";
     default: return "UNKNOWN";
   }
@@ -26,6 +54,7 @@ const char* ResearchStateMachine::eventName(ResearchEvent event) {
     case ResearchEvent::TX_FAILED: return "TX_FAILED";
     case ResearchEvent::ACK_VALID: return "ACK_VALID";
     case ResearchEvent::ACK_TIMEOUT: return "ACK_TIMEOUT";
+    case ResearchEvent::RETRY_DUE: return "RETRY_DUE";
     case ResearchEvent::RETRY_EXHAUSTED: return "RETRY_EXHAUSTED";
     case ResearchEvent::RECEIVE_WINDOW: return "RECEIVE_WINDOW";
     case ResearchEvent::RX_PACKET_DONE: return "RX_PACKET_DONE";
@@ -33,62 +62,231 @@ const char* ResearchStateMachine::eventName(ResearchEvent event) {
   }
 }
 
-bool ResearchStateMachine::transition(ResearchEvent event) {
-  const ResearchState from = _state;
-  ResearchState to = from;
-
+ResearchState ResearchStateMachine::_next(ResearchState from, ResearchEvent event) {
   switch (from) {
     case ResearchState::INIT:
       if (event == ResearchEvent::SETUP_COMPLETE) {
-        to = ResearchState::IDLE;
+        return ResearchState::IDLE;
       }
       break;
 
     case ResearchState::IDLE:
       if (event == ResearchEvent::PAYLOAD_AVAILABLE) {
-        to = ResearchState::TX;
+        return ResearchState::TX;
       } else if (event == ResearchEvent::RECEIVE_WINDOW) {
-        to = ResearchState::RX;
+        return ResearchState::RX;
       }
       break;
 
     case ResearchState::TX:
       if (event == ResearchEvent::TX_COMPLETE) {
-        to = ResearchState::WAIT_ACK;
+        return ResearchState::WAIT_ACK;
       } else if (event == ResearchEvent::TX_FAILED) {
-        to = ResearchState::IDLE;
+        return ResearchState::BACKOFF;
       }
       break;
 
     case ResearchState::WAIT_ACK:
       if (event == ResearchEvent::ACK_VALID) {
-        to = ResearchState::IDLE;
+        return ResearchState::IDLE;
       } else if (event == ResearchEvent::ACK_TIMEOUT) {
-        to = ResearchState::TX;
+        return ResearchState::BACKOFF;
+      } else if (event == ResearchEvent::RETRY_EXHAUSTED) {
+        return ResearchState::IDLE;
+      }
+      break;
+
+    case ResearchState::BACKOFF:
+      // PAYLOAD_AVAILABLE: the windowed sender resends without a pause.
+      if (event == ResearchEvent::RETRY_DUE || event == ResearchEvent::PAYLOAD_AVAILABLE) {
+        return ResearchState::TX;
       } else if (event == ResearchEvent::RETRY_EXHAUSTED) {
-        to = ResearchState::IDLE;
+        return ResearchState::IDLE;
       }
       break;
 
     case ResearchState::RX:
       if (event == ResearchEvent::RX_PACKET_DONE) {
-        to = ResearchState::IDLE;
+        return ResearchState::IDLE;
       }
       break;
 
     default:
       break;
   }
+  return from;
+}
 
+bool ResearchStateMachine::transition(ResearchEvent event) {
+  const ResearchState from = _state;
+  const ResearchState to = _next(from, event);
   if (to == from) {
+    _stats.ignored++;
     return false;
   }
 
+  const uint32_t now = millis();
+  _record(from, event, to, now);
+
+  const Handler& exitFn = _exit[static_cast<uint8_t>(from)];
+  if (exitFn.fn != nullptr) {
+    exitFn.fn(exitFn.ctx, event);
+  }
   _state = to;
-  Serial.printf("[FSM][%s] %s --(%s)--> %s\n",
-                _roleLabel,
-                stateName(from),
-                eventName(event),
-                stateName(to));
+  const Handler& enterFn = _enter[static_cast<uint8_t>(to)];
+  if (enterFn.fn != nullptr) {
+    enterFn.fn(enterFn.ctx, event);
+  }
+  return true;
+}
+
+void ResearchStateMachine::_record(ResearchState from, ResearchEvent event, ResearchState to, uint32_t nowMs) {
+  _stats.dwellMs[static_cast<uint8_t>(from)] += nowMs - _enteredMs;
+  _stats.entries[static_cast<uint8_t>(to)]++;
+  _stats.transitions++;
+  _enteredMs = nowMs;
+
+  TraceEntry& entry = _trace[_traceNext];
+  entry.atMs = nowMs;
+  entry.from = from;
+  entry.event = event;
+  entry.to = to;
+  _traceNext = static_cast<uint8_t>((_traceNext + 1) % MESH_FSM_TRACE_DEPTH);
+  if (_traceCount < MESH_FSM_TRACE_DEPTH) {
+    _traceCount++;
+  }
+
+#if MESH_FSM_VERBOSE
+  if (_expecting) {
+    Serial.printf("[FSM][%s] %s --(%s)--> %s eta=%ldms\n",
+                  _roleLabel, stateName(from), eventName(event), stateName(to),
+                  static_cast<long>(etaMs(nowMs)));
+  } else {
+    Serial.printf("[FSM][%s] %s --(%s)--> %s\n",
+                  _roleLabel, stateName(from), eventName(event), stateName(to));
+  }
+#endif
+}
+
+// ── Executor ──────────────────────────────────────────────────────
+void ResearchStateMachine::onEnter(ResearchState state, ResearchStateFn fn, void* ctx) {
+  _enter[static_cast<uint8_t>(state)] = {fn, ctx};
+}
+
+void ResearchStateMachine::onExit(ResearchState state, ResearchStateFn fn, void* ctx) {
+  _exit[static_cast<uint8_t>(state)] = {fn, ctx};
+}
+
+bool ResearchStateMachine::post(ResearchEvent event) {
+  if (_queued >= MESH_FSM_QUEUE_DEPTH) {
+    _stats.dropped++;
+    Serial.printf("[FSM][%s] queue full, dropped %s\n", _roleLabel, eventName(event));
+    return false;
+  }
+  _queue[(_head + _queued) % MESH_FSM_QUEUE_DEPTH] = event;
+  _queued++;
+  if (_queued > _stats.maxQueued) {
+    _stats.maxQueued = _queued;
+  }
+  return true;
+}
+
+bool ResearchStateMachine::startTimer(ResearchEvent event, uint32_t delayMs) {
+  Timer* freeSlot = nullptr;
+  for (Timer& timer : _timers) {
+    if (timer.active && timer.event == event) {
+      freeSlot = &timer;
+      break;
+    }
+    if (!timer.active && freeSlot == nullptr) {
+      freeSlot = &timer;
+    }
+  }
+  if (freeSlot == nullptr) {
+    Serial.printf("[FSM][%s] no free timer for %s\n", _roleLabel, eventName(event));
+    return false;
+  }
+  freeSlot->active = true;
+  freeSlot->event = event;
+  freeSlot->dueMs = millis() + delayMs;
+  return true;
+}
+
+void ResearchStateMachine::cancelTimer(ResearchEvent event) {
+  for (Timer& timer : _timers) {
+    if (timer.active && timer.event == event) {
+      timer.active = false;
+    }
+  }
+}
+
+void ResearchStateMachine::cancelTimers() {
+  for (Timer& timer : _timers) {
+    timer.active = false;
+  }
+}
+
+bool ResearchStateMachine::dispatch() {
+  const uint32_t now = millis();
+  for (Timer& timer : _timers) {
+    if (timer.active && static_cast<int32_t>(now - timer.dueMs) >= 0) {
+      timer.active = false;
+      post(timer.event);
+    }
+  }
+  if (_queued == 0) {
+    return false;
+  }
+  const ResearchEvent event = _queue[_head];
+  _head = static_cast<uint8_t>((_head + 1) % MESH_FSM_QUEUE_DEPTH);
+  _queued--;
+  transition(event);
   return true;
 }
+
+uint8_t ResearchStateMachine::run() {
+  // Bounded so a handler that keeps posting cannot hold loop().
+  uint8_t ran = 0;
+  while (ran < 2 * MESH_FSM_QUEUE_DEPTH && dispatch()) {
+    ran++;
+  }
+  return ran;
+}
+
+void ResearchStateMachine::printStats() const {
+  const uint32_t now = millis();
+  Serial.printf("[FSM][%s] transitions=%lu ignored=%lu dropped=%lu max_queued=%u\n",
+                _roleLabel,
+                static_cast<unsigned long>(_stats.transitions),
+                static_cast<unsigned long>(_stats.ignored),
+                static_cast<unsigned long>(_stats.dropped),
+                static_cast<unsigned>(_stats.maxQueued));
+  Serial.printf("[FSM][%s] dwell", _roleLabel);
+  for (uint8_t i = 0; i < kStateCount; ++i) {
+    uint32_t dwell = _stats.dwellMs[i];
+    if (static_cast<uint8_t>(_state) == i) {
+      dwell += now - _enteredMs;  // the visit under way
+    }
+    Serial.printf(" %s=%lums/%lu", stateName(static_cast<ResearchState>(i)),
+                  static_cast<unsigned long>(dwell), static_cast<unsigned long>(_stats.entries[i]));
+  }
+  Serial.println();
+
+  // Oldest first; times relative to the newest entry.
+  const uint8_t first = static_cast<uint8_t>((_traceNext + MESH_FSM_TRACE_DEPTH - _traceCount) % MESH_FSM_TRACE_DEPTH);
+  const uint32_t lastMs = _traceCount > 0 ? _trace[(_traceNext + MESH_FSM_TRACE_DEPTH - 1) % MESH_FSM_TRACE_DEPTH].atMs : now;
+  for (uint8_t n = 0; n < _traceCount; ++n) {
+    const TraceEntry& entry = _trace[(first + n) % MESH_FSM_TRACE_DEPTH];
+    Serial.printf("[FSM][%s]   -%lums %s --(%s)--> %s\n", _roleLabel,
+                  static_cast<unsigned long>(lastMs - entry.atMs),
+                  stateName(entry.from), eventName(entry.event), stateName(entry.to));
+  }
+}
+
+void ResearchStateMachine::resetStats() {
+  _stats = Stats{};
+  _stats.entries[static_cast<uint8_t>(_state)] = 1;
+  _enteredMs = millis();
+  _traceCount = 0;
+  _traceNext = 0;
+}
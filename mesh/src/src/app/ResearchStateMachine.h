@@ -2,12 +2,14 @@
 
 #include <Arduino.h>
 #include <stdint.h>
+#include "../../mesh_role_config.h"
 
 enum class ResearchState : uint8_t {
   INIT,
   IDLE,
   TX,
   WAIT_ACK,
+  BACKOFF,   // between a failed attempt and its retry
   RX
 };
 
@@ -18,22 +20,121 @@ enum class ResearchEvent : uint8_t {
   TX_FAILED,
   ACK_VALID,
   ACK_TIMEOUT,
+  RETRY_DUE,
   RETRY_EXHAUSTED,
   RECEIVE_WINDOW,
   RX_PACKET_DONE
 };
 
+// Entry / exit handler; cause is the event that made the transition.
+typedef void (*ResearchStateFn)(void* ctx, ResearchEvent cause);
+
+/*
+ * ResearchStateMachine - transition table and cooperative executor
+ *
+ * transition() applies one event at once, as the receive handlers have
+ * always used it. post() and startTimer() queue events instead and
+ * dispatch() feeds them through the same table from loop(), so a sender
+ * can sit in WAIT_ACK or BACKOFF without holding the CPU. Each state may have an entry and an exit
+ * handler; handlers should post() their follow-up, not transition().
+ *
+ * Transitions are kept in a small RAM trace with the time spent in each
+ * state; printStats() prints both. MESH_FSM_VERBOSE 1 also prints every
+ * transition as it happens.
+ *
+ * Usage:
+ *   fsm.onEnter(ResearchState::WAIT_ACK, armAckDeadline, this);
+ *   fsm.post(ResearchEvent::PAYLOAD_AVAILABLE);
+ *   void loop() { fsm.run(); ... }
+ */
 class ResearchStateMachine {
  public:
+  static constexpr uint8_t kStateCount = static_cast<uint8_t>(ResearchState::RX) + 1;
+
+  struct TraceEntry {
+    uint32_t atMs;
+    ResearchState from;
+    ResearchEvent event;
+    ResearchState to;
+  };
+
+  struct Stats {
+    uint32_t dwellMs[kStateCount];   // time spent in each state, completed visits
+    uint32_t entries[kStateCount];
+    uint32_t transitions;
+    uint32_t ignored;                // events with no transition from the current state
+    uint32_t dropped;                // post() with the queue full
+    uint8_t  maxQueued;
+  };
+
   explicit ResearchStateMachine(const char* roleLabel = "NODE");
 
   ResearchState state() const;
   bool transition(ResearchEvent event);
 
+  // ── Executor ──────────────────────────────────────────────────
+  void onEnter(ResearchState state, ResearchStateFn fn, void* ctx = nullptr);
+  void onExit(ResearchState state, ResearchStateFn fn, void* ctx = nullptr);
+
+  /** Queue an event for dispatch(); false (and stats().dropped) when full. */
+  bool post(ResearchEvent event);
+  /** Post event after delayMs; re-arming an event already pending moves it. */
+  bool startTimer(ResearchEvent event, uint32_t delayMs);
+  void cancelTimer(ResearchEvent event);
+  void cancelTimers();
+  /** Fire due timers, then apply one queued event. false when nothing ran. */
+  bool dispatch();
+  /** dispatch() until the queue is empty (handlers may post more, bounded). */
+  uint8_t run();
+  bool pending() const { return _queued > 0; }
+  uint32_t inStateMs(uint32_t nowMs) const { return nowMs - _enteredMs; }
+
+  const Stats& stats() const { return _stats; }
+  void printStats() const;
+  void resetStats();
+
+  // Deadline from the airtime model (estimateTransfer in Airtime.h) for
+  // the transfer under way. MESH_FSM_VERBOSE transition lines also print
+  // the time left (negative once overdue).
+  void expectCompletion(uint32_t startMs, uint32_t durationMs);
+  void clearExpectation();
+  bool hasExpectation() const;
+  uint32_t expectedDurationMs() const;
+  int32_t etaMs(uint32_t nowMs) const;
+
   static const char* stateName(ResearchState state);
   static const char* eventName(ResearchEvent event);
 
  private:
+  struct Handler {
+    ResearchStateFn fn;
+    void* ctx;
+  };
+  struct Timer {
+    bool active;
+    ResearchEvent event;
+    uint32_t dueMs;
+  };
+
+  static ResearchState _next(ResearchState from, ResearchEvent event);
+  void _record(ResearchState from, ResearchEvent event, ResearchState to, uint32_t nowMs);
+
   ResearchState _state;
   const char* _roleLabel;
+  bool _expecting = false;
+  uint32_t _expectStartMs = 0;
+  uint32_t _expectDurationMs = 0;
+
+  Handler _enter[kStateCount] = {};
+  Handler _exit[kStateCount] = {};
+  ResearchEvent _queue[MESH_FSM_QUEUE_DEPTH];
+  uint8_t _head = 0;
+  uint8_t _queued = 0;
+  Timer _timers[MESH_FSM_TIMERS] = {};
+
+  uint32_t _enteredMs = 0;
+  TraceEntry _trace[MESH_FSM_TRACE_DEPTH];
+  uint8_t _traceNext = 0;
+  uint8_t _traceCount = 0;
+  Stats _stats = {};
 };
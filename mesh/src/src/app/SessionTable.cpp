@@ -0,0 +1,284 @@
+#include "SessionTable.h"
+#include <new>
+
+static_assert(MESH_RX_SESSIONS >= 1 && MESH_RX_SESSIONS <= 32, "MESH_RX_SESSIONS must be 1..32");
+static_assert(SessionTable::poolBytes() <= MESH_RX_POOL_MAX_BYTES,
+              "Session pool exceeds MESH_RX_POOL_MAX_BYTES; lower MESH_RX_SESSIONS or MESH_RX_BUFFER_BYTES");
+
+SessionTable::SessionTable(SdManager& sd) : _sd(sd) {
+  for (uint8_t i = 0; i < MESH_RX_SESSIONS; ++i) {
+    new (_pool[i]) Reassembler(sd);
+  }
+}
+
+SessionTable::~SessionTable() {
+  for (uint8_t i = 0; i < MESH_RX_SESSIONS; ++i) {
+    _ctx(i).~Reassembler();
+  }
+}
+
+// Session ids count up from a random start, so mixing in the high byte and
+// the source spreads both across the slots.
+uint8_t SessionTable::_hash(uint8_t srcId, uint16_t sessionId) {
+  const uint16_t mixed = static_cast<uint16_t>(sessionId ^ (sessionId >> 8) ^ (srcId * 31U));
+  return static_cast<uint8_t>(mixed % MESH_RX_SESSIONS);
+}
+
+int16_t SessionTable::_slotOf(uint8_t srcId, uint16_t sessionId, uint8_t* probes) const {
+  const uint8_t first = _hash(srcId, sessionId);
+  for (uint8_t n = 0; n < MESH_RX_SESSIONS; ++n) {
+    const uint8_t slot = static_cast<uint8_t>((first + n) % MESH_RX_SESSIONS);
+    if (_ctx(slot).holds(srcId, sessionId)) {
+      if (probes != nullptr) {
+        *probes = static_cast<uint8_t>(n + 1);
+      }
+      return slot;
+    }
+  }
+  if (probes != nullptr) {
+    *probes = MESH_RX_SESSIONS;
+  }
+  return -1;
+}
+
+Reassembler* SessionTable::_lookup(const LoRaHeader& hdr) {
+  uint8_t probes = 0;
+  const int16_t slot = _slotOf(hdr.src_id, hdr.session_id, &probes);
+  _stats.lookups++;
+  _stats.probes += probes;
+  if (slot < 0) {
+    return nullptr;
+  }
+  _lastUseMs[slot] = millis();
+  return &_ctx(static_cast<uint8_t>(slot));
+}
+
+const Reassembler* SessionTable::find(uint8_t srcId, uint16_t sessionId) const {
+  const int16_t slot = _slotOf(srcId, sessionId);
+  return slot < 0 ? nullptr : &_ctx(static_cast<uint8_t>(slot));
+}
+
+uint8_t SessionTable::activeCount() const {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < MESH_RX_SESSIONS; ++i) {
+    if (_ctx(i).active() && !_ctx(i).finished()) {
+      count++;
+    }
+  }
+  return count;
+}
+
+/**
+ * A context for a new session: free, else the LRU finished one, else the
+ * LRU one stalled past MESH_RX_SESSION_STALL_MS. -1 when all are live.
+ * Free slots are searched from the hash position so lookups stay short.
+ */
+int16_t SessionTable::_claim(uint8_t srcId, uint16_t sessionId) {
+  const uint8_t first = _hash(srcId, sessionId);
+  for (uint8_t n = 0; n < MESH_RX_SESSIONS; ++n) {
+    const uint8_t slot = static_cast<uint8_t>((first + n) % MESH_RX_SESSIONS);
+    if (!_ctx(slot).active()) {
+      return slot;
+    }
+  }
+
+  const uint32_t now = millis();
+  int16_t finished = -1;
+  int16_t stalled = -1;
+  for (uint8_t slot = 0; slot < MESH_RX_SESSIONS; ++slot) {
+    const uint32_t idle = now - _lastUseMs[slot];
+    if (_ctx(slot).finished()) {
+      if (finished < 0 || idle > now - _lastUseMs[finished]) {
+        finished = slot;
+      }
+    } else if (idle >= MESH_RX_SESSION_STALL_MS) {
+      if (stalled < 0 || idle > now - _lastUseMs[stalled]) {
+        stalled = slot;
+      }
+    }
+  }
+  const int16_t victim = (finished >= 0) ? finished : stalled;
+  if (victim < 0) {
+    return -1;
+  }
+
+  Reassembler& ctx = _ctx(static_cast<uint8_t>(victim));
+  if (!ctx.finished()) {
+    _writeSummary(static_cast<uint8_t>(victim), "EVICTED");
+    _stats.evicted++;
+    Serial.printf("[SESS] evicted src=0x%02X sess=0x%04X after %lu ms idle (%u/%u frags)\n",
+                  ctx.stats().srcId, ctx.stats().sessionId,
+                  static_cast<unsigned long>(now - _lastUseMs[victim]),
+                  ctx.stats().received, ctx.stats().totalFrags);
+  }
+  ctx.close();
+  return victim;
+}
+
+// ─── Packet handlers ─────────────────────────────────────────────────────────
+
+// The context for a START / RESUME: its own if it has one, else a claimed one.
+int16_t SessionTable::_contextFor(const LoRaHeader& hdr, const char* what) {
+  if (_lookup(hdr) != nullptr) {
+    return _slotOf(hdr.src_id, hdr.session_id);
+  }
+  const int16_t slot = _claim(hdr.src_id, hdr.session_id);
+  if (slot < 0) {
+    _stats.refused++;
+    Serial.printf("[SESS] %s refused src=0x%02X sess=0x%04X: %u sessions live\n",
+                  what, hdr.src_id, hdr.session_id, static_cast<unsigned>(activeCount()));
+  }
+  return slot;
+}
+
+ReassemblyResult SessionTable::onStart(const LoRaHeader& hdr, const uint8_t* payload, size_t len) {
+  _takeStoreFailures();
+  // A retried START reopens its own context.
+  const int16_t slot = _contextFor(hdr, "START");
+  if (slot < 0) {
+    return ReassemblyResult::NO_CONTEXT;
+  }
+
+  const ReassemblyResult result = _ctx(static_cast<uint8_t>(slot)).onStart(hdr, payload, len);
+  if (result == ReassemblyResult::STARTED) {
+    _lastUseMs[slot] = millis();
+    _summarized[slot] = false;
+    _stats.opened++;
+  }
+  return result;
+}
+
+ReassemblyResult SessionTable::onResume(const LoRaHeader& hdr, const uint8_t* payload, size_t len,
+                                        ResumeNack* nack) {
+  _takeStoreFailures();
+  const int16_t slot = _contextFor(hdr, "RESUME");
+  if (slot < 0) {
+    return ReassemblyResult::NO_CONTEXT;
+  }
+
+  Reassembler& ctx = _ctx(static_cast<uint8_t>(slot));
+  const bool live = ctx.holds(hdr.src_id, hdr.session_id);
+  const ReassemblyResult result = ctx.onResume(hdr, payload, len, nack);
+  if (result == ReassemblyResult::STARTED || result == ReassemblyResult::RESUMED) {
+    _lastUseMs[slot] = millis();
+    // A context kept across the RESUME keeps its END row, if it has one.
+    if (!live || result == ReassemblyResult::STARTED) {
+      _summarized[slot] = false;
+      _stats.opened++;
+    }
+  }
+  return result;
+}
+
+ReassemblyResult SessionTable::onData(const LoRaHeader& hdr, const uint8_t* payload, size_t len,
+                                      int16_t* fragIndex, int16_t* rebuilt) {
+  _takeStoreFailures();
+  Reassembler* ctx = _lookup(hdr);
+  if (ctx == nullptr) {
+    if (fragIndex != nullptr) {
+      *fragIndex = -1;
+    }
+    if (rebuilt != nullptr) {
+      *rebuilt = -1;
+    }
+    return ReassemblyResult::NO_SESSION;
+  }
+  return ctx->onData(hdr, payload, len, fragIndex, rebuilt);
+}
+
+ReassemblyResult SessionTable::onParity(const LoRaHeader& hdr, const uint8_t* payload, size_t len,
+                                        int16_t* fragIndex) {
+  _takeStoreFailures();
+  Reassembler* ctx = _lookup(hdr);
+  if (ctx == nullptr) {
+    if (fragIndex != nullptr) {
+      *fragIndex = -1;
+    }
+    return ReassemblyResult::NO_SESSION;
+  }
+  return ctx->onParity(hdr, payload, len, fragIndex);
+}
+
+ReassemblyResult SessionTable::onEnd(const LoRaHeader& hdr, const uint8_t* payload, size_t len) {
+#if MESH_DUAL_CORE
+  _sd.waitStoreDrained();  // still pending, the context answers INCOMPLETE
+#endif
+  _takeStoreFailures();
+  Reassembler* ctx = _lookup(hdr);
+  if (ctx == nullptr) {
+    return ReassemblyResult::NO_SESSION;
+  }
+  const ReassemblyResult result = ctx->onEnd(hdr, payload, len);
+  // A retried END is answered again but logged once.
+  const uint8_t slot = static_cast<uint8_t>(_slotOf(hdr.src_id, hdr.session_id));
+  if (ctx->finished() && !_summarized[slot]) {
+    _writeSummary(slot, result == ReassemblyResult::COMPLETE ? "COMPLETE" : "CRC_MISMATCH");
+    _summarized[slot] = true;
+  }
+  return result;
+}
+
+uint32_t SessionTable::windowBitmap(const LoRaHeader& pollHdr, uint16_t baseSeq, uint8_t count) {
+  _takeStoreFailures();
+  Reassembler* ctx = _lookup(pollHdr);
+  return ctx == nullptr ? 0 : ctx->windowBitmap(pollHdr, baseSeq, count);
+}
+
+// Failures come back in the order writer hit them; a file no context owns
+// any more is a transfer already settled or evicted.
+void SessionTable::_takeStoreFailures() {
+#if MESH_DUAL_CORE
+  SdManager::StoreFailure failed;
+  while (_sd.takeStoreFailure(failed)) {
+    for (uint8_t i = 0; i < MESH_RX_SESSIONS; ++i) {
+      if (_ctx(i).onStoreFailed(failed)) {
+        break;
+      }
+    }
+  }
+#endif
+}
+
+// ─── Reporting ───────────────────────────────────────────────────────────────
+
+void SessionTable::_writeSummary(uint8_t slot, const char* outcome) {
+  const Reassembler& ctx = _ctx(slot);
+  const ReassemblyStats& s = ctx.stats();
+  char row[160];
+  const int len = snprintf(row, sizeof(row), "%s,%u,%u,%s,%u,%u,%u,%u,%u,%lu,%lu,%lu\n",
+                           MESH_RUN_ID, s.srcId, s.sessionId, outcome, s.totalFrags, s.received,
+                           s.duplicates, s.outOfOrder, s.recovered,
+                           static_cast<unsigned long>(s.bytesReceived),
+                           static_cast<unsigned long>(s.lastMs - s.startMs),
+                           static_cast<unsigned long>(ctx.goodputBps()));
+  if (len <= 0 || static_cast<size_t>(len) >= sizeof(row)) {
+    return;
+  }
+  if (_sd.isReady() && !_sd.writeSessions(row, static_cast<size_t>(len))) {
+    Serial.println("[SESS] lora_sessions.csv write failed");
+  }
+}
+
+void SessionTable::printStats() const {
+  const float avgProbes = _stats.lookups > 0
+                              ? static_cast<float>(_stats.probes) / static_cast<float>(_stats.lookups)
+                              : 0.0f;
+  Serial.printf("[SESS] contexts=%u live=%u opened=%lu evicted=%lu refused=%lu probes/lookup=%.2f pool=%u bytes\n",
+                static_cast<unsigned>(MESH_RX_SESSIONS), static_cast<unsigned>(activeCount()),
+                static_cast<unsigned long>(_stats.opened), static_cast<unsigned long>(_stats.evicted),
+                static_cast<unsigned long>(_stats.refused), static_cast<double>(avgProbes),
+                static_cast<unsigned>(poolBytes()));
+  const uint32_t now = millis();
+  for (uint8_t slot = 0; slot < MESH_RX_SESSIONS; ++slot) {
+    const Reassembler& ctx = _ctx(slot);
+    if (!ctx.active()) {
+      continue;
+    }
+    const ReassemblyStats& s = ctx.stats();
+    Serial.printf("[SESS]  [%u] src=0x%02X sess=0x%04X %s frags=%u/%u dups=%u ooo=%u fec=%u goodput=%lu bps idle=%lu ms\n",
+                  slot, s.srcId, s.sessionId, ctx.finished() ? "done" : "open",
+                  s.received, s.totalFrags, s.duplicates, s.outOfOrder, s.recovered,
+                  static_cast<unsigned long>(ctx.goodputBps()),
+                  static_cast<unsigned long>(now - _lastUseMs[slot]));
+  }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "Reassembler.h"
+#include "../../mesh_role_config.h"
+
+#define SESSION_CSV_HEADER \
+  "run_id,src_id,session_id,outcome,total_frags,received,duplicates,out_of_order,recovered,bytes,elapsed_ms,goodput_bps\n"
+
+/*
+ * SessionTable - several interleaved transfers on one receiver
+ *
+ * A fixed pool of MESH_RX_SESSIONS Reassembler contexts, built in place
+ * when the table is constructed: no heap, and the static_assert on
+ * MESH_RX_POOL_MAX_BYTES holds the footprint where the build put it. A
+ * frame maps to its context by (src_id, session_id). A small hash of the
+ * pair picks the first slot to try, and the probe walks on from there, so
+ * a lookup usually compares one slot.
+ *
+ * A START for a session not in the table takes, in order: a free context,
+ * the least recently used finished one, or the least recently used one
+ * with no frame for MESH_RX_SESSION_STALL_MS. If there is none, the START
+ * is refused (NO_CONTEXT) and the sender retries it later; a live transfer
+ * is never dropped for a newer one. A RESUME finds a context the same way.
+ *
+ * MESH_DUAL_CORE: fragment writes land on writer after the ACK. Each
+ * handler first hands any write that failed there to its context, and END
+ * waits for the queue to drain, so a lost write is asked for again.
+ *
+ * When a session settles at END, or is evicted unfinished, one
+ * SESSION_CSV_HEADER row with its counters is appended to
+ * lora_sessions.csv.
+ *
+ * Usage:
+ *   SessionTable sessions(sdMgr);
+ *   ReassemblyResult r = sessions.onData(hdr, body, bodyLen, &fragIndex);
+ *   sessions.printStats();   // table counters, then one line per context
+ */
+class SessionTable {
+ public:
+  struct Stats {
+    uint32_t opened;     // STARTs (and RESUMEs) that took a context
+    uint32_t evicted;    // unfinished sessions dropped for a new START
+    uint32_t refused;    // STARTs turned away with every context live
+    uint32_t lookups;
+    uint32_t probes;     // slots compared over all lookups
+  };
+
+  explicit SessionTable(SdManager& sd);
+  ~SessionTable();
+  SessionTable(const SessionTable&) = delete;
+  SessionTable& operator=(const SessionTable&) = delete;
+
+  ReassemblyResult onStart(const LoRaHeader& hdr, const uint8_t* payload, size_t len);
+  ReassemblyResult onResume(const LoRaHeader& hdr, const uint8_t* payload, size_t len,
+                            ResumeNack* nack = nullptr);
+  ReassemblyResult onData(const LoRaHeader& hdr, const uint8_t* payload, size_t len,
+                          int16_t* fragIndex = nullptr, int16_t* rebuilt = nullptr);
+  ReassemblyResult onEnd(const LoRaHeader& hdr, const uint8_t* payload, size_t len);
+  ReassemblyResult onParity(const LoRaHeader& hdr, const uint8_t* payload, size_t len,
+                            int16_t* fragIndex = nullptr);
+  uint32_t windowBitmap(const LoRaHeader& pollHdr, uint16_t baseSeq, uint8_t count);
+
+  /** The context holding (srcId, sessionId), or nullptr. */
+  const Reassembler* find(uint8_t srcId, uint16_t sessionId) const;
+  uint8_t activeCount() const;
+  const Stats& stats() const { return _stats; }
+  void printStats() const;
+
+  static constexpr size_t poolBytes() { return sizeof(Reassembler) * MESH_RX_SESSIONS; }
+
+ private:
+  static uint8_t _hash(uint8_t srcId, uint16_t sessionId);
+  Reassembler& _ctx(uint8_t slot) { return *reinterpret_cast<Reassembler*>(_pool[slot]); }
+  const Reassembler& _ctx(uint8_t slot) const {
+    return *reinterpret_cast<const Reassembler*>(_pool[slot]);
+  }
+  int16_t _slotOf(uint8_t srcId, uint16_t sessionId, uint8_t* probes = nullptr) const;
+  Reassembler* _lookup(const LoRaHeader& hdr);
+  int16_t _claim(uint8_t srcId, uint16_t sessionId);
+  int16_t _contextFor(const LoRaHeader& hdr, const char* what);
+  void _writeSummary(uint8_t slot, const char* outcome);
+  void _takeStoreFailures();
+
+  SdManager& _sd;
+  alignas(Reassembler) uint8_t _pool[MESH_RX_SESSIONS][sizeof(Reassembler)];
+  uint32_t _lastUseMs[MESH_RX_SESSIONS] = {};
+  bool _summarized[MESH_RX_SESSIONS] = {};   // END row already written
+  Stats _stats = {};
+};
@@ -0,0 +1,473 @@
+#include "TransferTask.h"
+#include "../comms/Airtime.h"
+#include "../util/StageProfiler.h"
+
+namespace {
+constexpr const char* kResumeFile = "tx_resume.bin";
+}  // namespace
+
+TransferTask::TransferTask(LoRaManager& lora, SdManager& sd, ResearchStateMachine& fsm, WindowedSender& window)
+    : _lora(lora), _sd(sd), _fsm(fsm), _window(window) {}
+
+void TransferTask::begin(const TransferHooks& hooks) {
+  _hooks = hooks;
+  _fsm.onEnter(ResearchState::TX, _onEnterTx, this);
+  _fsm.onEnter(ResearchState::WAIT_ACK, _onEnterWaitAck, this);
+  _fsm.onExit(ResearchState::WAIT_ACK, _onExitWaitAck, this);
+  _fsm.onEnter(ResearchState::BACKOFF, _onEnterBackoff, this);
+  _fsm.onEnter(ResearchState::IDLE, _onEnterIdle, this);
+}
+
+/**
+ * Open the payload, print what is about to go out and queue START, or
+ * RESUME when tx_resume.bin holds this session's unfinished transfer of
+ * the same payload. The FSM takes it from there; see service().
+ *
+ * @return false if a transfer is under way or the payload will not open
+ */
+bool TransferTask::start(const char* file, uint8_t codec, uint16_t sampleHz, uint16_t durationMs,
+                         uint32_t ackTimeoutMs, uint8_t maxRetries) {
+  if (busy()) {
+    return false;
+  }
+  // One open + stat; the CRC comes from the metadata cache unless the file changed.
+  if (!_sd.openAudioFile(file, _meta)) {
+    Serial.printf("[XFER] Cannot open payload %s\n", file);
+    return false;
+  }
+
+  Serial.printf("[XFER] Starting transfer from %s: %lu bytes, %u fragments, CRC32=0x%08lX (%s)\n",
+                file,
+                static_cast<unsigned long>(_meta.size),
+                _meta.totalFrags,
+                static_cast<unsigned long>(_meta.crc32),
+                _meta.cached ? "cached" : (codec == CODEC_COMPRESSED ? "at END" : "scanned"));
+  if (codec == CODEC_COMPRESSED) {
+    Serial.printf("[XFER] ADPCM: %lu PCM bytes -> %lu on air (%.2f:1)\n",
+                  static_cast<unsigned long>(_meta.sourceSize),
+                  static_cast<unsigned long>(_meta.size),
+                  static_cast<double>(_meta.sourceSize) / _meta.size);
+  }
+
+  // Model of this transfer at the current rate, if no frame is lost.
+  const LoRaRate& rate = _lora.rate();
+  const TransferEstimate model = estimateTransfer(_meta.totalFrags, _meta.size, _sd.chunkSize(),
+                                                  rate.sf, bwCodeToKhz(rate.bwCode), rate.cr);
+  Serial.printf("[XFER] Model: %lu ms TX + %lu ms ACK airtime, ~%lu ms, %lu bps goodput\n",
+                static_cast<unsigned long>(model.txAirtimeMs),
+                static_cast<unsigned long>(model.rxAirtimeMs),
+                static_cast<unsigned long>(model.durationMs),
+                static_cast<unsigned long>(model.goodputBps));
+
+  _codec = codec;
+  _sampleHz = sampleHz;
+  _durationMs = durationMs;
+  _ackTimeoutMs = ackTimeoutMs;
+  _maxRetries = maxRetries;
+  _summary = {};
+  _summary.modelMs = model.durationMs;
+  _summary.elapsedMs = millis();  // start time until _finish()
+  _frag = 0;
+  _retry = 0;
+  _resumed = false;
+  _resync = false;
+  _refused = false;
+  _resyncs = 0;
+  ResumeRecord rec;
+  _recorded = _loadResume(rec) && _resumeMatches(rec);
+  _phase = _recorded ? PHASE_RESUME : PHASE_START;
+  if (_recorded) {
+    Serial.printf("[XFER] Resuming session 0x%04X from the receiver's bitmap\n", rec.session);
+  }
+
+  if (!_fsm.post(ResearchEvent::PAYLOAD_AVAILABLE)) {
+    _sd.closeAudioFile();
+    _phase = PHASE_IDLE;
+    return false;
+  }
+  return true;
+}
+
+/**
+ * loop() work: hand the armed ACK's outcome to the FSM. A window ACK with
+ * holes in its bitmap leaves through ACK_TIMEOUT, so BACKOFF resends them.
+ */
+void TransferTask::service() {
+  if (_phase == PHASE_IDLE || _fsm.state() != ResearchState::WAIT_ACK) {
+    return;
+  }
+
+  const LoRaManager::AckWait ack = _lora.pollAck();
+  if (_phase == PHASE_WINDOW) {
+    if (ack == LoRaManager::ACK_WAIT_OK || ack == LoRaManager::ACK_WAIT_REJECTED) {
+      const bool ackOk = (ack == LoRaManager::ACK_WAIT_OK);
+      _fsm.cancelTimer(ResearchEvent::ACK_TIMEOUT);
+      _fsm.post(_window.windowAcked(ackOk, ackOk ? _lora.lastWindowBitmap() : 0)
+                    ? ResearchEvent::ACK_VALID : ResearchEvent::ACK_TIMEOUT);
+    }
+    return;
+  }
+  if (ack == LoRaManager::ACK_WAIT_OK) {
+    _fsm.cancelTimer(ResearchEvent::ACK_TIMEOUT);
+    _fsm.post(ResearchEvent::ACK_VALID);
+  } else if (ack == LoRaManager::ACK_WAIT_REJECTED) {
+    // An error status counts as a miss, as it always has. DATA the
+    // receiver has no session for means it lost it: resync with RESUME.
+    _resync = MESH_RESUME_ENABLE && _phase == PHASE_DATA && _lora.lastAckStatus() == ACK_STATUS_MISSING;
+    _refused = _refused || _phase == PHASE_RESUME;
+    _fsm.cancelTimer(ResearchEvent::ACK_TIMEOUT);
+    _fsm.post(ResearchEvent::ACK_TIMEOUT);
+  }
+}
+
+// Handlers see every transition; outside a transfer the receive path
+// drives the same FSM and is left alone.
+void TransferTask::_onEnterTx(void* ctx, ResearchEvent) {
+  TransferTask* self = static_cast<TransferTask*>(ctx);
+  if (self->_stopAndWait()) {
+    self->_send();
+  } else if (self->_phase == PHASE_WINDOW) {
+    self->_fsm.post(self->_window.sendWindow() ? ResearchEvent::TX_COMPLETE : ResearchEvent::TX_FAILED);
+  }
+}
+
+void TransferTask::_onEnterWaitAck(void* ctx, ResearchEvent) {
+  TransferTask* self = static_cast<TransferTask*>(ctx);
+  if (self->_stopAndWait()) {
+    self->_lora.armAck(self->_seq);
+    self->_fsm.startTimer(ResearchEvent::ACK_TIMEOUT, self->_lora.ackWaitMs(self->_retry, self->_ackTimeoutMs));
+  } else if (self->_phase == PHASE_WINDOW) {
+    self->_lora.armWindowAck(self->_window.pollBase());
+    self->_fsm.startTimer(ResearchEvent::ACK_TIMEOUT, self->_ackTimeoutMs);
+  }
+}
+
+void TransferTask::_onExitWaitAck(void* ctx, ResearchEvent cause) {
+  TransferTask* self = static_cast<TransferTask*>(ctx);
+  if (self->_stopAndWait()) {
+    self->_attemptDone(cause);
+  } else if (self->_phase == PHASE_WINDOW && cause != ResearchEvent::ACK_VALID) {
+    // No bitmap by the deadline; a no-op when service() already resolved it.
+    self->_fsm.cancelTimer(ResearchEvent::ACK_TIMEOUT);
+    self->_lora.cancelAck(true);
+    self->_window.windowAcked(false, 0);
+  }
+}
+
+void TransferTask::_onEnterBackoff(void* ctx, ResearchEvent) {
+  TransferTask* self = static_cast<TransferTask*>(ctx);
+  if (self->_stopAndWait()) {
+    self->_retryOrGiveUp();
+  } else if (self->_phase == PHASE_WINDOW) {
+    // Resend what the bitmap lacks at once; the slots hold their own retries.
+    self->_fsm.post(self->_window.windowPending() ? ResearchEvent::PAYLOAD_AVAILABLE
+                                                  : ResearchEvent::RETRY_EXHAUSTED);
+  }
+}
+
+void TransferTask::_onEnterIdle(void* ctx, ResearchEvent cause) {
+  TransferTask* self = static_cast<TransferTask*>(ctx);
+  if (cause != ResearchEvent::ACK_VALID && cause != ResearchEvent::RETRY_EXHAUSTED) {
+    return;
+  }
+  if (self->_stopAndWait()) {
+    self->_attemptResolved(cause == ResearchEvent::ACK_VALID);
+  } else if (self->_phase == PHASE_WINDOW) {
+    self->_nextWindow();
+  }
+}
+
+bool TransferTask::_stopAndWait() const {
+  return _phase == PHASE_START || _phase == PHASE_RESUME || _phase == PHASE_DATA || _phase == PHASE_END;
+}
+
+uint8_t TransferTask::_packetType() const {
+  if (_phase == PHASE_START) {
+    return PKT_AUDIO_START;
+  }
+  if (_phase == PHASE_RESUME) {
+    return PKT_RESUME;
+  }
+  return _phase == PHASE_END ? PKT_AUDIO_END : PKT_AUDIO_DATA;
+}
+
+void TransferTask::_log(bool ackOk, LogStatus status, uint32_t rtoMs) {
+  if (_hooks.attempt == nullptr) {
+    return;
+  }
+  const bool data = (_phase == PHASE_DATA);
+  _hooks.attempt(_txTimeMs, ackOk, _seq, _packetType(), status,
+                 data ? static_cast<int16_t>(_frag) : -1, data ? _chunk : 0, _retry, rtoMs);
+}
+
+// Entering TX: one send of the current frame, then TX_COMPLETE / TX_FAILED.
+void TransferTask::_send() {
+  _txTimeMs = millis();
+  bool sent = false;
+  if (_phase == PHASE_START || _phase == PHASE_RESUME) {
+    sent = _lora.sendAudioStart(_meta.totalFrags, _codec, _sampleHz, _durationMs, _meta.size, _packetType());
+    _seq = _lora.getLastSeqNum();
+  } else if (_phase == PHASE_DATA) {
+    // Retries reuse the fragment's seq so the receiver can place it by index.
+    _seq = static_cast<uint16_t>(_dataSeqBase + _frag);
+    sent = _lora.sendDataFrame(_frame, _seq, static_cast<uint8_t>(_chunk));
+  } else {
+    sent = _lora.sendAudioEnd(_frag, _endCrc);
+    _seq = _lora.getLastSeqNum();
+  }
+
+  if (sent) {
+    _fsm.post(ResearchEvent::TX_COMPLETE);
+    return;
+  }
+  _log(false, LOG_STATUS_TX_FAIL, 0);
+  _fsm.post(ResearchEvent::TX_FAILED);
+}
+
+// Leaving WAIT_ACK: the row for this attempt, whichever way it went.
+void TransferTask::_attemptDone(ResearchEvent cause) {
+  const bool ackOk = (cause == ResearchEvent::ACK_VALID);
+  if (!ackOk) {
+    _fsm.cancelTimer(ResearchEvent::ACK_TIMEOUT);
+    _lora.cancelAck(true);  // no-op when an error-status ACK already ended it
+  }
+  _log(ackOk, ackOk ? LOG_STATUS_ACK_OK : LOG_STATUS_ACK_TIMEOUT, _lora.lastRtoMs());
+}
+
+void TransferTask::_retryOrGiveUp() {
+  if (_resync) {
+    _resync = false;
+    if (_resyncs < _maxRetries) {
+      _resyncs++;
+      Serial.printf("[XFER] Receiver lost the session at frag %u; resuming\n", _frag);
+      _phase = PHASE_RESUME;
+      _retry = 0;
+      _fsm.startTimer(ResearchEvent::RETRY_DUE, _lora.retryBackoffMs(0));
+      return;
+    }
+  }
+  if (_retry >= _maxRetries) {
+    _fsm.post(ResearchEvent::RETRY_EXHAUSTED);
+    return;
+  }
+  const uint32_t waitMs = _lora.retryBackoffMs(_retry);
+  _retry++;
+  _fsm.startTimer(ResearchEvent::RETRY_DUE, waitMs);
+}
+
+// Back in IDLE with the current frame ACKed or given up on.
+void TransferTask::_attemptResolved(bool ok) {
+  if (_phase == PHASE_START) {
+    if (!ok) {
+      Serial.println("[XFER] START failed after retries");
+      _sd.closeAudioFile();
+      _finish();
+      return;
+    }
+    _summary.started = true;
+    _fsm.expectCompletion(_summary.elapsedMs, _summary.modelMs);
+    _saveResume();
+    _beginData();
+    return;
+  }
+
+  if (_phase == PHASE_RESUME) {
+    if (!ok) {
+      Serial.println("[XFER] RESUME failed after retries");
+      if (_refused) {
+        _clearResume();  // the receiver will not take it: start over next time
+      }
+      _sd.closeAudioFile();
+      _finish();
+      return;
+    }
+    _nack = _lora.lastNack();
+    const uint16_t missing = nackMissingCount(_nack, _meta.totalFrags);
+    Serial.printf("[XFER] RESUME: receiver holds %u/%u fragments, sending %u\n",
+                  _nack.head.received, _meta.totalFrags, missing);
+    if (!_summary.started) {
+      _summary.started = true;
+      _fsm.expectCompletion(_summary.elapsedMs, _summary.modelMs);
+    }
+    _resumed = true;
+    _summary.resumed = true;
+    // The DATA counters restart with the receiver's view of the transfer.
+    _summary.acked = 0;
+    _summary.failed = 0;
+    _summary.skipped = static_cast<uint16_t>(_meta.totalFrags - missing);
+    _frag = 0;
+    _beginData();
+    return;
+  }
+
+  if (_phase == PHASE_DATA) {
+    PROFILE_RECORD(PROFILE_FRAGMENT, micros() - _fragStartUs);
+    if (ok) {
+      _summary.acked++;
+    } else {
+      _summary.failed++;
+      Serial.printf("[XFER] DATA frag %u no ACK after retries\n", _frag);
+    }
+    _frag++;
+    _nextFragment();
+    return;
+  }
+
+  _summary.endAcked = ok;
+  if (ok) {
+    _clearResume();
+  } else {
+    Serial.println("[XFER] END ACK timeout after retries");
+  }
+  _finish();
+}
+
+void TransferTask::_beginData() {
+#if MESH_TRANSFER_MODE == MESH_TRANSFER_MODE_SELECTIVE_REPEAT
+  _phase = PHASE_WINDOW;
+  _window.begin(_meta.totalFrags, _maxRetries, _hooks.fragment, _resumed ? &_nack : nullptr);
+  _nextWindow();
+#else
+  _phase = PHASE_DATA;
+  _dataSeqBase = _lora.reserveSeqRange(_meta.totalFrags);
+  _nextFragment();
+#endif
+}
+
+// Each chunk is read from SD straight into the task's frame and resent
+// from there on retry; nothing is copied in between.
+void TransferTask::_nextFragment() {
+  if (_resumed) {
+    // Past what the receiver holds; the payload seeks only across a gap.
+    _frag = nackNextMissing(_nack, _frag, _meta.totalFrags);
+    if (_frag >= _meta.totalFrags || !_sd.seekAudioChunk(_frag)) {
+      _beginEnd();
+      return;
+    }
+  }
+  if (!_sd.readAudioChunk(_frame + LORA_HEADER_SIZE, _chunk)) {
+    _beginEnd();
+    return;
+  }
+  _retry = 0;
+  _fragStartUs = micros();
+  _fsm.post(ResearchEvent::PAYLOAD_AVAILABLE);
+}
+
+// Back in IDLE with the window resolved: the next one, or END.
+void TransferTask::_nextWindow() {
+  if (_window.nextWindow()) {
+    _fsm.post(ResearchEvent::PAYLOAD_AVAILABLE);
+    return;
+  }
+  const WindowedTransferResult& result = _window.finish();
+  _summary.acked = result.acked;
+  _summary.failed = result.failed;
+  _summary.skipped = result.skipped;
+  _frag = result.fragments;
+  _beginEnd();
+}
+
+void TransferTask::_beginEnd() {
+  // END's CRC32 of a compressed payload covers the blocks never sent too.
+  if (_codec == CODEC_COMPRESSED && _sd.nextChunk() < _meta.totalFrags) {
+    _sd.seekAudioChunk(_meta.totalFrags);
+  }
+  _sd.closeAudioFile();
+  _summary.fragments = _frag;
+
+  Serial.printf("[XFER] DATA summary: acked=%u failed_or_timeout=%u skipped=%u total=%u\n",
+                _summary.acked, _summary.failed, _summary.skipped, _frag);
+  RttEstimator::PeerRtt rtt;
+  if (_lora.rtt().stats(MESH_PEER_NODE_ID, rtt)) {
+    Serial.printf("[XFER] RTT: srtt=%lums rttvar=%lums samples=%u\n",
+                  static_cast<unsigned long>(rtt.srttMs),
+                  static_cast<unsigned long>(rtt.rttvarMs),
+                  static_cast<unsigned>(rtt.samples));
+  }
+  // A compressed payload's CRC32 is over the encoded blocks, known only now.
+  _endCrc = (_codec == CODEC_COMPRESSED) ? _sd.streamCrc32() : _meta.crc32;
+  if (_codec == CODEC_COMPRESSED && _frag > 0) {
+    Serial.printf("[XFER] ADPCM encode: %lu us per fragment, CRC32=0x%08lX\n",
+                  static_cast<unsigned long>(_sd.encodeUs() / _frag),
+                  static_cast<unsigned long>(_endCrc));
+  }
+
+  _phase = PHASE_END;
+  _retry = 0;
+  _fsm.post(ResearchEvent::PAYLOAD_AVAILABLE);
+}
+
+void TransferTask::_finish() {
+  const uint32_t nowMs = millis();
+  _summary.elapsedMs = nowMs - _summary.elapsedMs;
+  if (_summary.started) {
+    Serial.printf("[XFER] Took %lu ms, model %lu ms (%ld ms left)\n",
+                  static_cast<unsigned long>(_summary.elapsedMs),
+                  static_cast<unsigned long>(_fsm.expectedDurationMs()),
+                  static_cast<long>(_fsm.etaMs(nowMs)));
+  }
+  _fsm.clearExpectation();
+  _summary.resumable = MESH_RESUME_ENABLE && _recorded && !_summary.endAcked;
+  _phase = PHASE_IDLE;
+  if (_hooks.done != nullptr) {
+    _hooks.done(_summary);
+  }
+}
+
+// ─── Resume record ───────────────────────────────────────────────────────────
+
+bool TransferTask::savedSession(uint16_t& sessionId) {
+  ResumeRecord rec;
+  if (!_loadResume(rec)) {
+    return false;
+  }
+  sessionId = rec.session;
+  return true;
+}
+
+bool TransferTask::_loadResume(ResumeRecord& rec) {
+#if MESH_RESUME_ENABLE
+  size_t got = 0;
+  return _sd.isReady() &&
+         _sd.readBinaryFile(kResumeFile, reinterpret_cast<uint8_t*>(&rec), sizeof(rec), got) &&
+         got == sizeof(rec) && rec.magic == kResumeMagic;
+#else
+  (void)rec;
+  return false;
+#endif
+}
+
+// Same session, same payload bytes, same fragmenting: the receiver's
+// bitmap still means what it did.
+bool TransferTask::_resumeMatches(const ResumeRecord& rec) const {
+  return rec.session == _lora.session() && rec.size == _meta.size && rec.crc32 == _meta.crc32 &&
+         rec.sourceSize == _meta.sourceSize && rec.modified == _meta.modified &&
+         rec.totalFrags == _meta.totalFrags && rec.chunkSize == _sd.chunkSize() && rec.codec == _codec;
+}
+
+void TransferTask::_saveResume() {
+#if MESH_RESUME_ENABLE
+  ResumeRecord rec = {};
+  rec.magic = kResumeMagic;
+  rec.size = _meta.size;
+  rec.crc32 = _meta.crc32;
+  rec.sourceSize = _meta.sourceSize;
+  rec.modified = _meta.modified;
+  rec.session = _lora.session();
+  rec.totalFrags = _meta.totalFrags;
+  rec.chunkSize = _sd.chunkSize();
+  rec.codec = _codec;
+  _recorded = _sd.writeBinaryFile(kResumeFile, reinterpret_cast<const uint8_t*>(&rec), sizeof(rec), false);
+#endif
+}
+
+void TransferTask::_clearResume() {
+#if MESH_RESUME_ENABLE
+  if (_recorded) {
+    const uint8_t none = 0;
+    _sd.writeBinaryFile(kResumeFile, &none, 0, false);
+  }
+#endif
+  _recorded = false;
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "../comms/LoraManager.h"
+#include "../storage/SdManager.h"
+#include "ResearchStateMachine.h"
+#include "WindowedSender.h"
+#include "../../mesh_role_config.h"
+
+struct TransferSummary {
+  bool     started;      // START (or RESUME) was acknowledged
+  bool     endAcked;
+  bool     resumed;      // reopened with PKT_RESUME; skipped fragments were held
+  bool     resumable;    // not finished; start() again in this session resumes it
+  uint16_t fragments;    // DATA fragments read from the payload
+  uint16_t acked;
+  uint16_t failed;       // no ACK (or send failure) after every retry
+  uint16_t skipped;      // already held by the receiver, not sent
+  uint32_t elapsedMs;    // start() to the END outcome
+  uint32_t modelMs;      // estimateTransfer() at the rate in use
+};
+
+/*
+ * One stop-and-wait attempt (START, DATA or END), same row shape as
+ * WindowFragmentLogFn. rtoMs is the ACK deadline the attempt used, 0 when
+ * the send itself failed.
+ */
+typedef void (*TransferAttemptLogFn)(uint32_t txTimeMs, bool ackOk, uint16_t seqNum, uint8_t packetType,
+                                     LogStatus status, int16_t fragIndex, uint16_t fragLen,
+                                     uint8_t retryIndex, uint32_t rtoMs);
+typedef void (*TransferDoneFn)(const TransferSummary& summary);
+
+// Sketch hooks; logging, display and what follows a transfer stay there.
+struct TransferHooks {
+  TransferAttemptLogFn attempt;
+  WindowFragmentLogFn  fragment;   // MESH_TRANSFER_MODE_SELECTIVE_REPEAT DATA phase
+  TransferDoneFn       done;
+};
+
+/*
+ * TransferTask - START, DATA, END as events through ResearchStateMachine
+ *
+ * Nothing here waits in a loop. Entering TX sends the current frame and
+ * posts TX_COMPLETE / TX_FAILED; entering WAIT_ACK arms the ACK and an
+ * ACK_TIMEOUT timer; BACKOFF arms RETRY_DUE or gives up with
+ * RETRY_EXHAUSTED; IDLE moves on to the next fragment (read from SD,
+ * then PAYLOAD_AVAILABLE) or the next phase. service() polls for the ACK.
+ * Between those steps loop() is free to take RX frames, the button and
+ * the display.
+ *
+ * The selective-repeat DATA phase takes the same path one window at a
+ * time: TX sends the burst, parity and poll (WindowedSender::sendWindow()),
+ * WAIT_ACK arms the PKT_WINDOW_ACK, a bitmap with holes goes through
+ * BACKOFF straight back to TX, and IDLE loads the next window.
+ *
+ * A send still waits out its own airtime (and any pacing) inside
+ * LoRaManager, with onIdle servicing SD and display as before.
+ *
+ * DATA is read into a frame owned by the task rather than the borrowed
+ * radio frame, so replies sent between fragments (half-duplex ACKs) can
+ * still claim it.
+ *
+ * With MESH_RESUME_ENABLE, a transfer whose START was ACKed is recorded in
+ * tx_resume.bin until its END is. start() in the same session (the sketch
+ * keeps it; savedSession() restores it after a reboot) sends PKT_RESUME
+ * instead of START when the payload is unchanged, and DATA covers only the
+ * fragments the receiver's PKT_NACK lists. A DATA fragment refused with
+ * ACK_STATUS_MISSING (the receiver lost the session) resyncs the same way.
+ *
+ * Usage:
+ *   transfer.begin(hooks);
+ *   transfer.start(kPayloadFile, codec, 8000, 0, timeoutMs, 2);
+ *   void loop() { transfer.service(); fsm.run(); ... }
+ */
+class TransferTask {
+ public:
+  TransferTask(LoRaManager& lora, SdManager& sd, ResearchStateMachine& fsm, WindowedSender& window);
+
+  /** Register the FSM handlers; once, from setup(). */
+  void begin(const TransferHooks& hooks);
+
+  /** Open the payload and queue START; false if busy or the file is unusable. */
+  bool start(const char* file, uint8_t codec, uint16_t sampleHz, uint16_t durationMs,
+             uint32_t ackTimeoutMs, uint8_t maxRetries);
+  void service();
+  bool busy() const { return _phase != PHASE_IDLE; }
+  /** Session of an unfinished transfer in tx_resume.bin; call from setup(). */
+  bool savedSession(uint16_t& sessionId);
+
+ private:
+  enum Phase : uint8_t { PHASE_IDLE, PHASE_START, PHASE_RESUME, PHASE_DATA, PHASE_WINDOW, PHASE_END };
+
+  // tx_resume.bin: the transfer as START announced it.
+  struct ResumeRecord {
+    uint32_t magic;
+    uint32_t size;
+    uint32_t crc32;
+    uint32_t sourceSize;
+    uint32_t modified;
+    uint16_t session;
+    uint16_t totalFrags;
+    uint16_t chunkSize;
+    uint8_t  codec;
+    uint8_t  reserved;
+  };
+  static constexpr uint32_t kResumeMagic = 0x4D555352UL;  // "RSUM"
+
+  static void _onEnterTx(void* ctx, ResearchEvent cause);
+  static void _onEnterWaitAck(void* ctx, ResearchEvent cause);
+  static void _onExitWaitAck(void* ctx, ResearchEvent cause);
+  static void _onEnterBackoff(void* ctx, ResearchEvent cause);
+  static void _onEnterIdle(void* ctx, ResearchEvent cause);
+
+  bool _stopAndWait() const;
+  void _send();
+  void _attemptDone(ResearchEvent cause);
+  void _retryOrGiveUp();
+  void _attemptResolved(bool ok);
+  void _nextFragment();
+  void _nextWindow();
+  void _beginEnd();
+  void _finish();
+  void _log(bool ackOk, LogStatus status, uint32_t rtoMs);
+  uint8_t _packetType() const;
+  bool _loadResume(ResumeRecord& rec);
+  bool _resumeMatches(const ResumeRecord& rec) const;
+  void _saveResume();
+  void _clearResume();
+  void _beginData();
+
+  LoRaManager& _lora;
+  SdManager& _sd;
+  ResearchStateMachine& _fsm;
+  WindowedSender& _window;
+  TransferHooks _hooks = {};
+
+  Phase _phase = PHASE_IDLE;
+  uint8_t _codec = 0;
+  uint16_t _sampleHz = 0;
+  uint16_t _durationMs = 0;
+  uint32_t _ackTimeoutMs = 0;
+  uint8_t _maxRetries = 0;
+  PayloadMeta _meta = {};
+
+  uint8_t  _retry = 0;
+  uint16_t _seq = 0;           // of the frame awaiting its ACK
+  uint32_t _txTimeMs = 0;
+  uint16_t _dataSeqBase = 0;
+  uint16_t _frag = 0;
+  uint16_t _chunk = 0;
+  uint32_t _endCrc = 0;
+  uint32_t _fragStartUs = 0;
+  TransferSummary _summary = {};
+
+  bool _recorded = false;      // tx_resume.bin describes this transfer
+  bool _resumed = false;       // DATA follows _nack
+  bool _resync = false;        // receiver lost the session mid-DATA: RESUME next
+  bool _refused = false;       // RESUME answered with an error status
+  uint8_t _resyncs = 0;
+  ResumeNack _nack = {};
+
+  uint8_t _frame[LORA_MAX_PAYLOAD];
+};
@@ -0,0 +1,231 @@
+#include "WindowedSender.h"
+#include "../util/Fec.h"
+#include "../util/StageProfiler.h"
+
+WindowedSender::WindowedSender(LoRaManager& lora, SdManager& sd) : _lora(lora), _sd(sd) {}
+
+/**
+ * Send MESH_FEC_PARITY parity frames for the block of count fragments at
+ * blockFrag: parity i is the XOR of fragments i, i + M, i + 2M, ... each
+ * zero-padded to the longest. Parity frames take fresh seqs outside the
+ * fragment range, so the receiver's seq-to-fragment mapping is untouched.
+ *
+ * @return parity frames sent
+ */
+uint8_t WindowedSender::_sendParity(uint16_t blockFrag, uint8_t count) {
+#if MESH_FEC_PARITY > 0
+  uint8_t sent = 0;
+  const uint8_t m = static_cast<uint8_t>(MESH_FEC_PARITY < count ? MESH_FEC_PARITY : count);
+  for (uint8_t p = 0; p < m; ++p) {
+    uint8_t* parity = _parityFrame + LORA_HEADER_SIZE + sizeof(FecParityPayload);
+    uint16_t maxLen = 0;
+    memset(parity, 0, LORA_MAX_FEC_DATA_PAYLOAD);
+    for (uint8_t i = p; i < count; i = static_cast<uint8_t>(i + m)) {
+      const Slot& slot = _slot(static_cast<uint16_t>(blockFrag + i));
+      fecXor(parity, slot.frame + LORA_HEADER_SIZE, slot.len);
+      if (slot.len > maxLen) {
+        maxLen = slot.len;
+      }
+    }
+
+    FecParityPayload fp;
+    fp.block_frag = blockFrag;
+    fp.data_count = count;
+    fp.parity_index = p;
+    fp.parity_count = m;
+    serializeFecParity(&fp, _parityFrame + LORA_HEADER_SIZE);
+
+    const uint16_t seq = _lora.reserveSeqRange(1);
+    if (_lora.sendDataFrame(_parityFrame, seq,
+                            static_cast<uint8_t>(sizeof(FecParityPayload) + maxLen),
+                            PKT_AUDIO_PARITY)) {
+      sent++;
+    }
+  }
+  return sent;
+#else
+  (void)blockFrag;
+  (void)count;
+  return 0;
+#endif
+}
+
+void WindowedSender::begin(uint16_t totalFrags, uint8_t maxRetries, WindowFragmentLogFn log,
+                           const ResumeNack* resume) {
+  _totalFrags = totalFrags;
+  _maxRetries = maxRetries;
+  _log = log;
+  _resume = resume;
+  _result = WindowedTransferResult{};
+  _firstSeq = _lora.reserveSeqRange(totalFrags);
+  _base = 0;
+  _loaded = 0;
+  _freshBlock = false;
+}
+
+void WindowedSender::_report(const Slot& slot, uint16_t frag, bool ackOk, LogStatus status) {
+  if (_log == nullptr) {
+    return;
+  }
+  _log(slot.txTimeMs, ackOk, static_cast<uint16_t>(_firstSeq + frag),
+       static_cast<int16_t>(frag), slot.len, status, slot.retry, slot.toaMs, slot.txMs);
+}
+
+// Read new fragments into free slots. FEC blocks are window-aligned, so
+// only an empty window is refilled.
+void WindowedSender::_refill() {
+  if (MESH_FEC_PARITY > 0 && _base != _loaded) {
+    return;
+  }
+  _freshBlock = _freshBlock || _loaded < _totalFrags;
+  while (_loaded < _totalFrags && _loaded < _base + MESH_TX_WINDOW_SIZE) {
+    Slot& slot = _slot(_loaded);
+    const bool held = _resume != nullptr && !nackMissing(*_resume, _loaded);
+    slot.retry = 0;
+    slot.txTimeMs = 0;
+    slot.state = held ? SLOT_ACKED : SLOT_PENDING;
+    if (held && MESH_FEC_PARITY == 0) {
+      slot.len = 0;
+      _result.skipped++;
+      _loaded++;
+      continue;
+    }
+    // Read straight into the slot's frame; sendDataFrame() adds the header in place.
+    if (!_sd.seekAudioChunk(_loaded) || !_sd.readAudioChunk(slot.frame + LORA_HEADER_SIZE, slot.len)) {
+      Serial.printf("[WIN] Payload ended early at frag %u of %u\n", _loaded, _totalFrags);
+      _totalFrags = _loaded;
+      break;
+    }
+    _result.skipped += held ? 1 : 0;
+    _loaded++;
+  }
+}
+
+/**
+ * Slide past every resolved fragment at the front and refill, until the
+ * window has something to send. A window the receiver already holds in
+ * full is passed over without a send.
+ *
+ * @return false once every fragment is resolved
+ */
+bool WindowedSender::nextWindow() {
+  for (;;) {
+    while (_base < _loaded &&
+           (_slot(_base).state == SLOT_ACKED || _slot(_base).state == SLOT_FAILED)) {
+      _base++;
+    }
+    _refill();
+    if (_base >= _totalFrags) {
+      return false;
+    }
+    if (windowPending()) {
+      return true;
+    }
+  }
+}
+
+bool WindowedSender::windowPending() const {
+  for (uint16_t frag = _base; frag < _loaded; ++frag) {
+    if (_slot(frag).state == SLOT_PENDING) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool WindowedSender::sendWindow() {
+  _windowStartUs = micros();
+  if (!nextWindow()) {
+    return false;
+  }
+  const uint16_t windowEnd = _loaded;
+  const uint8_t count = static_cast<uint8_t>(windowEnd - _base);
+
+  // ── Burst: send every fragment that still needs it ──
+  uint8_t inFlight = 0;
+  for (uint16_t frag = _base; frag < windowEnd; ++frag) {
+    Slot& slot = _slot(frag);
+    if (slot.state != SLOT_PENDING) {
+      continue;
+    }
+
+    if (slot.retry > 0) {
+      _result.retransmits++;
+    }
+    slot.txTimeMs = millis();
+    const bool sent = _lora.sendDataFrame(slot.frame, static_cast<uint16_t>(_firstSeq + frag),
+                                          static_cast<uint8_t>(slot.len), PKT_AUDIO_DATA_WIN);
+    slot.toaMs = _lora.lastToaMs();
+    slot.txMs = _lora.lastTxMs();
+    if (sent) {
+      slot.state = SLOT_INFLIGHT;
+      inFlight++;
+      continue;
+    }
+
+    _report(slot, frag, false, LOG_STATUS_TX_FAIL);
+    if (slot.retry >= _maxRetries) {
+      slot.state = SLOT_FAILED;
+      _result.failed++;
+    } else {
+      slot.retry++;
+    }
+  }
+  if (inFlight == 0) {
+    return false;
+  }
+
+  // ── Parity: once per FEC block, after its first burst ──
+  if (MESH_FEC_PARITY > 0 && _freshBlock) {
+    _result.parity += _sendParity(_base, count);
+  }
+  _freshBlock = false;
+
+  // ── Poll: one bitmap ACK covers the whole window ──
+  _result.polls++;
+  if (_lora.sendWindowPoll(pollBase(), count)) {
+    return true;
+  }
+  windowAcked(false, 0);
+  return false;
+}
+
+bool WindowedSender::windowAcked(bool ackOk, uint32_t bitmap) {
+  bool windowClean = true;
+  bool resolved = false;
+  for (uint16_t frag = _base; frag < _loaded; ++frag) {
+    Slot& slot = _slot(frag);
+    if (slot.state != SLOT_INFLIGHT) {
+      continue;
+    }
+
+    const bool received = ackOk && ((bitmap >> (frag - _base)) & 1UL);
+    _report(slot, frag, received, received ? LOG_STATUS_ACK_OK : LOG_STATUS_ACK_TIMEOUT);
+    resolved = true;
+
+    if (received) {
+      slot.state = SLOT_ACKED;
+      _result.acked++;
+    } else if (slot.retry >= _maxRetries) {
+      slot.state = SLOT_FAILED;
+      _result.failed++;
+      Serial.printf("[WIN] DATA frag %u no ACK after retries\n", frag);
+    } else {
+      slot.retry++;
+      slot.state = SLOT_PENDING;
+      windowClean = false;
+    }
+  }
+  if (resolved) {
+    PROFILE_RECORD(PROFILE_WINDOW, micros() - _windowStartUs);
+  }
+  return windowClean && !windowPending();
+}
+
+const WindowedTransferResult& WindowedSender::finish() {
+  _result.fragments = _totalFrags;
+  Serial.printf("[WIN] DATA summary: acked=%u failed=%u retransmits=%u polls=%u parity=%u skipped=%u window=%u\n",
+                _result.acked, _result.failed, _result.retransmits, _result.polls, _result.parity,
+                _result.skipped, static_cast<unsigned>(MESH_TX_WINDOW_SIZE));
+  return _result;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "../comms/LoraManager.h"
+#include "../storage/SdManager.h"
+#include "../../mesh_role_config.h"
+
+#if MESH_TX_WINDOW_SIZE < 1 || MESH_TX_WINDOW_SIZE > LORA_MAX_WINDOW_SIZE
+#error "MESH_TX_WINDOW_SIZE must be between 1 and LORA_MAX_WINDOW_SIZE (32)."
+#endif
+
+#if MESH_FEC_PARITY > 0
+#if MESH_TRANSFER_MODE != MESH_TRANSFER_MODE_SELECTIVE_REPEAT
+#error "MESH_FEC_PARITY needs MESH_TRANSFER_MODE_SELECTIVE_REPEAT."
+#endif
+#if MESH_FEC_PARITY > LORA_MAX_FEC_PARITY || MESH_FEC_PARITY > MESH_TX_WINDOW_SIZE
+#error "MESH_FEC_PARITY must not exceed LORA_MAX_FEC_PARITY (4) or MESH_TX_WINDOW_SIZE."
+#endif
+#endif
+
+struct WindowedTransferResult {
+  uint16_t fragments;    // fragments read from the payload file
+  uint16_t acked;        // fragments confirmed by a PKT_WINDOW_ACK bitmap
+  uint16_t failed;       // fragments that ran out of retries
+  uint16_t retransmits;  // extra DATA sends beyond the first per fragment
+  uint16_t polls;        // PKT_WINDOW_POLL rounds
+  uint16_t parity;       // PKT_AUDIO_PARITY frames sent (MESH_FEC_PARITY)
+  uint16_t skipped;      // already held by the receiver (resume), not sent
+};
+
+/*
+ * Per-fragment outcome hook so the sketch keeps ownership of logging
+ * and display side effects (same row shape as the stop-and-wait logAck).
+ * toaMs / txMs are the fragment's last send: modeled time on air and
+ * measured send-to-TxDone (LoRaManager::lastToaMs / lastTxMs). status is
+ * the attempt's outcome without the retry suffix; SdManager adds it.
+ */
+typedef void (*WindowFragmentLogFn)(uint32_t txTimeMs, bool ackOk, uint16_t seqNum,
+                                    int16_t fragIndex, uint16_t fragLen,
+                                    LogStatus status, uint8_t retryIndex,
+                                    uint32_t toaMs, uint32_t txMs);
+
+/*
+ * WindowedSender - selective-repeat DATA phase
+ *
+ * Sends up to MESH_TX_WINDOW_SIZE PKT_AUDIO_DATA_WIN fragments back to
+ * back, then one PKT_WINDOW_POLL. The PKT_WINDOW_ACK bitmap marks which
+ * seqs landed; only the missing ones are resent in the next burst. The
+ * window slides as soon as its oldest fragment is resolved.
+ *
+ * With MESH_FEC_PARITY the window is a fixed FEC block instead: its first
+ * burst is followed by that many XOR parity frames (src/util/Fec.h), the
+ * receiver rebuilds single losses per parity group before answering the
+ * poll, and the next block is loaded once this one is fully resolved.
+ *
+ * The payload file must already be open on the SdManager; fragments are
+ * read sequentially into whole-frame slots (header space reserved) and
+ * held there until they are ACKed or given up, so a resend copies nothing.
+ *
+ * A resumed transfer passes the receiver's PKT_NACK: fragments it holds
+ * count as ACKed without a send, and the payload seeks past them. With FEC
+ * they are still read, since the block's parity covers them.
+ *
+ * Nothing here waits for the ACK; TransferTask drives one window per FSM
+ * round, the way it drives a stop-and-wait fragment:
+ *   begin()        reserve the seqs, no radio traffic
+ *   nextWindow()   slide and refill from SD; false once every fragment is resolved
+ *   sendWindow()   burst, parity, poll; then armWindowAck(pollBase()) and a timer
+ *   windowAcked()  apply the PKT_WINDOW_ACK bitmap (or the miss) to the burst
+ *   finish()       the summary, once nextWindow() says false
+ */
+class WindowedSender {
+ public:
+  WindowedSender(LoRaManager& lora, SdManager& sd);
+
+  void begin(uint16_t totalFrags, uint8_t maxRetries, WindowFragmentLogFn log,
+             const ResumeNack* resume = nullptr);
+  bool nextWindow();
+  /** True if the poll went out; false leaves the burst resolved as missed. */
+  bool sendWindow();
+  /** Resolve the burst; true when nothing in the window needs a resend. */
+  bool windowAcked(bool ackOk, uint32_t bitmap);
+  /** The window still has fragments to (re)send. */
+  bool windowPending() const;
+  uint16_t pollBase() const { return static_cast<uint16_t>(_firstSeq + _base); }
+  const WindowedTransferResult& finish();
+
+ private:
+  enum SlotState : uint8_t {
+    SLOT_PENDING,   // loaded, needs a (re)send
+    SLOT_INFLIGHT,  // sent this burst, waiting on the poll
+    SLOT_ACKED,
+    SLOT_FAILED
+  };
+
+  struct Slot {
+    uint8_t frame[LORA_MAX_PAYLOAD];  // payload at LORA_HEADER_SIZE
+    uint16_t len;
+    uint32_t txTimeMs;
+    uint32_t toaMs;
+    uint32_t txMs;
+    uint8_t retry;
+    SlotState state;
+  };
+
+  Slot& _slot(uint16_t frag) { return _slots[frag % MESH_TX_WINDOW_SIZE]; }
+  const Slot& _slot(uint16_t frag) const { return _slots[frag % MESH_TX_WINDOW_SIZE]; }
+  void _refill();
+  void _report(const Slot& slot, uint16_t frag, bool ackOk, LogStatus status);
+  uint8_t _sendParity(uint16_t blockFrag, uint8_t count);
+
+  LoRaManager& _lora;
+  SdManager& _sd;
+  Slot _slots[MESH_TX_WINDOW_SIZE];
+
+  uint16_t _totalFrags = 0;
+  uint8_t _maxRetries = 0;
+  WindowFragmentLogFn _log = nullptr;
+  const ResumeNack* _resume = nullptr;
+  WindowedTransferResult _result = {};
+  uint16_t _firstSeq = 0;      // fragment i always travels as _firstSeq + i
+  uint16_t _base = 0;          // oldest unresolved fragment
+  uint16_t _loaded = 0;        // fragments read into slots so far
+  bool _freshBlock = false;    // FEC block loaded, its parity not sent yet
+  uint32_t _windowStartUs = 0;
+#if MESH_FEC_PARITY > 0
+  uint8_t _parityFrame[LORA_MAX_PAYLOAD];
+#endif
+};
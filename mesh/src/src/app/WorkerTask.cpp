@@ -0,0 +1,83 @@
+#include "WorkerTask.h"
+#include "../display/StatusDisplay.h"
+
+TaskHandle_t WorkerTask::_task = nullptr;
+SdManager* WorkerTask::_sd = nullptr;
+WorkerTask::Stats WorkerTask::_stats = {};
+
+#if MESH_DUAL_CORE
+
+bool WorkerTask::begin(SdManager* sd) {
+  if (_task != nullptr) {
+    return true;
+  }
+  _sd = sd;
+  TaskHandle_t task = nullptr;
+  if (xTaskCreatePinnedToCore(_run, "mesh_worker", MESH_WORKER_STACK_BYTES, nullptr,
+                              MESH_WORKER_PRIORITY, &task, MESH_WORKER_CORE) != pdPASS) {
+    Serial.println("[CORE] worker task create failed; staying single-core");
+    return false;
+  }
+
+  // The worker waits for this hand-off before its first pass, so nothing
+  // is drained from two tasks at once.
+  if (_sd != nullptr) {
+    _sd->setWriterTask(task);
+  }
+  StatusDisplay::setRenderTask(task);
+  _task = task;
+  vTaskPrioritySet(nullptr, MESH_RADIO_TASK_PRIORITY);
+  xTaskNotifyGive(task);
+
+  Serial.printf("[CORE] radio task core=%d prio=%u, worker core=%d prio=%u\n",
+                static_cast<int>(xPortGetCoreID()), static_cast<unsigned>(MESH_RADIO_TASK_PRIORITY),
+                static_cast<int>(MESH_WORKER_CORE), static_cast<unsigned>(MESH_WORKER_PRIORITY));
+  return true;
+}
+
+void WorkerTask::_run(void*) {
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  for (;;) {
+    const uint32_t startUs = micros();
+    if (_sd != nullptr) {
+      // Payload first: the sender is already on its next fragment.
+      _stats.stores += _sd->serviceStore();
+      _sd->serviceLog();
+    }
+    if (StatusDisplay::service()) {
+      _stats.frames++;
+    }
+    const uint32_t passUs = micros() - startUs;
+    if (passUs > _stats.maxPassUs) {
+      _stats.maxPassUs = passUs;
+    }
+    _stats.passes++;
+    vTaskDelay(pdMS_TO_TICKS(MESH_WORKER_PERIOD_MS));
+  }
+}
+
+void WorkerTask::printStats() {
+  if (_task == nullptr) {
+    return;
+  }
+  Serial.printf("[CORE] worker passes=%lu max_pass_us=%lu stores=%lu store_fail=%lu store_pending=%u log_pending=%u frames=%lu stack_free=%u\n",
+                static_cast<unsigned long>(_stats.passes),
+                static_cast<unsigned long>(_stats.maxPassUs),
+                static_cast<unsigned long>(_stats.stores),
+                static_cast<unsigned long>(_sd != nullptr ? _sd->storeFailed() : 0),
+                static_cast<unsigned>(_sd != nullptr ? _sd->storePending() : 0),
+                static_cast<unsigned>(_sd != nullptr ? _sd->logPending() : 0),
+                static_cast<unsigned long>(_stats.frames),
+                static_cast<unsigned>(uxTaskGetStackHighWaterMark(_task)));
+}
+
+#else
+
+bool WorkerTask::begin(SdManager*) {
+  Serial.println("[CORE] MESH_DUAL_CORE is 0; everything stays on the loop task");
+  return false;
+}
+
+void WorkerTask::printStats() {}
+
+#endif
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "../storage/SdManager.h"
+#include "../../mesh_role_config.h"
+
+/*
+ * WorkerTask - MESH_DUAL_CORE storage / display task
+ *
+ * The Arduino loop task stays the radio task: it keeps LoRaManager, the
+ * state machine and the sketch, and begin() raises it to
+ * MESH_RADIO_TASK_PRIORITY on its core. The worker, pinned to
+ * MESH_WORKER_CORE, owns everything that can stall on a peripheral:
+ *
+ *   - received payload writes, queued by SdManager as fixed-size records
+ *     (SdManager::serviceStore), so an ACK no longer waits on the card
+ *   - the CSV / binary log drain (SdManager::serviceLog, and flushLog
+ *     requests from the radio task)
+ *   - OLED frames (StatusDisplay::service)
+ *
+ * Both SD queues are SpscQueue rings: the radio task only ever pushes,
+ * the worker only ever pops. The card itself is shared through SpiLease,
+ * which now leases per device and per task, so the radio's own SD reads
+ * (the TX payload) wait for a worker write but never for the radio bus.
+ *
+ * Usage (setup(), after sdMgr.init() and StatusDisplay::init()):
+ *   WorkerTask::begin(g_sd_ready ? &sdMgr : nullptr);
+ */
+class WorkerTask {
+public:
+  struct Stats {
+    uint32_t passes;
+    uint32_t maxPassUs;     // longest single pass (a slow card write shows here)
+    uint32_t stores;        // payload records written behind the ACKs
+    uint32_t frames;        // OLED frames drawn
+  };
+
+  /** Start the worker and hand it the SD log, payload writes and display. */
+  static bool begin(SdManager* sd);
+  static bool running() { return _task != nullptr; }
+  static const Stats& stats() { return _stats; }
+  static void printStats();
+
+private:
+  static void _run(void* arg);
+
+  static TaskHandle_t _task;
+  static SdManager* _sd;
+  static Stats _stats;
+};
@@ -0,0 +1,125 @@
+#include "SpiArbiter.h"
+#include "../util/StageProfiler.h"
+
+namespace {
+  portMUX_TYPE s_spiMux = portMUX_INITIALIZER_UNLOCKED;
+
+  const char* deviceName(uint8_t dev) {
+    switch (dev) {
+      case SpiArbiter::RADIO: return "radio";
+      case SpiArbiter::SD:    return "sd";
+      default:                return "none";
+    }
+  }
+}
+
+TaskHandle_t volatile SpiArbiter::_holder[SpiArbiter::DEVICE_COUNT] = {};
+uint8_t SpiArbiter::_depth[SpiArbiter::DEVICE_COUNT] = {};
+SpiArbiter::Device SpiArbiter::_lastOwner = SpiArbiter::NONE;
+int16_t SpiArbiter::_csPin[SpiArbiter::DEVICE_COUNT] = {-1, -1, -1};
+SpiArbiter::Stats SpiArbiter::_stats = {};
+
+void SpiArbiter::attach(Device dev, uint8_t csPin) {
+  if (dev == NONE || dev >= DEVICE_COUNT) {
+    return;
+  }
+  _csPin[dev] = csPin;
+  pinMode(csPin, OUTPUT);
+  digitalWrite(csPin, HIGH);
+}
+
+// Called under s_spiMux; a device another task holds keeps its chip select.
+void SpiArbiter::_deselectOthers(Device dev) {
+  for (uint8_t other = RADIO; other < DEVICE_COUNT; ++other) {
+    if (other != dev && _csPin[other] >= 0 && _holder[other] == nullptr) {
+      digitalWrite(static_cast<uint8_t>(_csPin[other]), HIGH);
+    }
+  }
+}
+
+bool SpiArbiter::acquire(Device dev, uint32_t timeoutMs) {
+  if (dev == NONE || dev >= DEVICE_COUNT) {
+    return false;
+  }
+
+  const TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  const uint32_t startMs = millis();
+#if MESH_PROFILE_ENABLE
+  const uint32_t startUs = micros();
+#endif
+  bool contended = false;
+  for (;;) {
+    bool taken = false;
+    bool outermost = false;
+    portENTER_CRITICAL(&s_spiMux);
+    if (_holder[dev] == nullptr || _holder[dev] == self) {
+      _holder[dev] = self;
+      outermost = (_depth[dev] == 0);
+      _depth[dev]++;
+      taken = true;
+      if (outermost && _lastOwner != dev) {
+        // Only a change of device needs the other chip select parked.
+        _deselectOthers(dev);
+        if (_lastOwner != NONE) {
+          _stats.switches++;
+        }
+        _lastOwner = dev;
+      }
+      if (outermost) {
+        _stats.acquisitions[dev]++;
+      }
+    }
+    portEXIT_CRITICAL(&s_spiMux);
+
+    if (taken) {
+#if MESH_PROFILE_ENABLE
+      if (contended) {
+        PROFILE_RECORD(PROFILE_SPI_WAIT, micros() - startUs);
+      }
+#endif
+      return true;
+    }
+    if (!contended) {
+      contended = true;
+      _stats.contention++;
+    }
+    if (millis() - startMs >= timeoutMs) {
+      _stats.timeouts++;
+      Serial.printf("[SPI] %s acquire timed out, held by another task\n", deviceName(dev));
+      return false;
+    }
+    // The holder is on the other core or lower priority; let it run.
+    vTaskDelay(1);
+  }
+}
+
+void SpiArbiter::release(Device dev) {
+  if (dev == NONE || dev >= DEVICE_COUNT) {
+    return;
+  }
+  portENTER_CRITICAL(&s_spiMux);
+  if (_holder[dev] == xTaskGetCurrentTaskHandle() && _depth[dev] > 0) {
+    _depth[dev]--;
+    if (_depth[dev] == 0) {
+      _holder[dev] = nullptr;
+    }
+  }
+  portEXIT_CRITICAL(&s_spiMux);
+}
+
+void SpiArbiter::noteRecovery(Device dev) {
+  if (dev < DEVICE_COUNT) {
+    _stats.recoveries[dev]++;
+  }
+}
+
+void SpiArbiter::printStats() {
+  Serial.printf("[SPI] acquire radio=%lu sd=%lu switches=%lu contention=%lu timeouts=%lu recover radio=%lu sd=%lu\n",
+                static_cast<unsigned long>(_stats.acquisitions[RADIO]),
+                static_cast<unsigned long>(_stats.acquisitions[SD]),
+                static_cast<unsigned long>(_stats.switches),
+                static_cast<unsigned long>(_stats.contention),
+                static_cast<unsigned long>(_stats.timeouts),
+                static_cast<unsigned long>(_stats.recoveries[RADIO]),
+                static_cast<unsigned long>(_stats.recoveries[SD]));
+}
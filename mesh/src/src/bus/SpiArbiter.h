@@ -0,0 +1,83 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "../../mesh_role_config.h"
+
+/*
+ * SpiArbiter - ownership of the SPI-attached radio and SD card
+ *
+ * The SX1262 sits on the default SPI host and the SD card on its own host
+ * (HSPI), so neither bus has to be torn down and re-begun to switch
+ * devices. Before a device is used it is acquired by the calling task:
+ * an idle device's chip select is driven high and the holder recorded.
+ * Nested acquires by the same task are counted, not re-done. A device
+ * held by another task (the MESH_DUAL_CORE worker on the SD card) is
+ * waited for; the two devices may be held by different tasks at once.
+ * The library drivers (RadioLib, SdFat) still wrap each transfer in
+ * beginTransaction()/endTransaction().
+ *
+ * Usage:
+ *   SpiArbiter::attach(SpiArbiter::SD, SD_CS);   // once per device
+ *   SpiLease bus(SpiArbiter::SD);
+ *   if (!bus) return false;                     // another task held it
+ */
+class SpiArbiter {
+public:
+  enum Device : uint8_t {
+    NONE = 0,
+    RADIO,
+    SD,
+    DEVICE_COUNT
+  };
+
+  struct Stats {
+    uint32_t acquisitions[DEVICE_COUNT];  // outermost acquire() per device
+    uint32_t switches;                    // outermost acquire of a different device than the last
+    uint32_t contention;                  // acquire() found another task holding the device
+    uint32_t timeouts;                    // ... and gave up waiting
+    uint32_t recoveries[DEVICE_COUNT];    // remount / re-init reported by the driver
+  };
+
+  /** Register a device's chip select and park it deselected. */
+  static void attach(Device dev, uint8_t csPin);
+
+  /** Take dev for the calling task, waiting up to timeoutMs for another holder. */
+  static bool acquire(Device dev, uint32_t timeoutMs = MESH_SPI_LEASE_MS);
+  static void release(Device dev);
+
+  /** Report a driver-level recovery (e.g. SD remount) for the counters. */
+  static void noteRecovery(Device dev);
+
+  static bool held(Device dev) { return dev < DEVICE_COUNT && _holder[dev] != nullptr; }
+  static const Stats& stats() { return _stats; }
+  static void printStats();
+
+private:
+  static void _deselectOthers(Device dev);
+
+  static TaskHandle_t volatile _holder[DEVICE_COUNT];
+  static uint8_t _depth[DEVICE_COUNT];
+  static Device _lastOwner;
+  static int16_t _csPin[DEVICE_COUNT];
+  static Stats _stats;
+};
+
+/** Scoped SpiArbiter::acquire()/release(). */
+class SpiLease {
+public:
+  explicit SpiLease(SpiArbiter::Device dev) : _dev(dev), _held(SpiArbiter::acquire(dev)) {}
+  ~SpiLease() {
+    if (_held) {
+      SpiArbiter::release(_dev);
+    }
+  }
+  explicit operator bool() const { return _held; }
+
+  SpiLease(const SpiLease&) = delete;
+  SpiLease& operator=(const SpiLease&) = delete;
+
+private:
+  SpiArbiter::Device _dev;
+  bool _held;
+};
@@ -0,0 +1,104 @@
+#include "ImaAdpcm.h"
+
+namespace {
+  const int8_t kIndexStep[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8,
+    -1, -1, -1, -1, 2, 4, 6, 8,
+  };
+
+  const int16_t kStepSize[IMA_ADPCM_MAX_INDEX + 1] = {
+        7,     8,     9,    10,    11,    12,    13,    14,    16,    17,
+       19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+       50,    55,    60,    66,    73,    80,    88,    97,   107,   118,
+      130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+      337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+      876,   963,  1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+     2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+     5894,  6484,  7132,  7845,  8630,  9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+  };
+
+  // Step the decoder state by one code; the encoder runs the same update
+  // so both ends track an identical predictor.
+  inline void advance(uint8_t code, int32_t& predictor, int& index) {
+    const int32_t step = kStepSize[index];
+    int32_t delta = step >> 3;
+    if (code & 4) delta += step;
+    if (code & 2) delta += step >> 1;
+    if (code & 1) delta += step >> 2;
+    predictor += (code & 8) ? -delta : delta;
+    if (predictor > INT16_MAX) predictor = INT16_MAX;
+    if (predictor < INT16_MIN) predictor = INT16_MIN;
+    index += kIndexStep[code];
+    if (index < 0) index = 0;
+    if (index > IMA_ADPCM_MAX_INDEX) index = IMA_ADPCM_MAX_INDEX;
+  }
+
+  inline uint8_t quantize(int32_t diff, int index) {
+    int32_t step = kStepSize[index];
+    uint8_t code = 0;
+    if (diff < 0) {
+      code = 8;
+      diff = -diff;
+    }
+    if (diff >= step) { code |= 4; diff -= step; }
+    step >>= 1;
+    if (diff >= step) { code |= 2; diff -= step; }
+    step >>= 1;
+    if (diff >= step) { code |= 1; }
+    return code;
+  }
+}
+
+size_t imaAdpcmEncodeBlock(const int16_t* pcm, uint16_t samples, uint8_t& index, uint8_t* out) {
+  if (pcm == nullptr || out == nullptr || samples == 0) {
+    return 0;
+  }
+
+  int32_t predictor = pcm[0];
+  int idx = (index > IMA_ADPCM_MAX_INDEX) ? IMA_ADPCM_MAX_INDEX : index;
+  out[0] = static_cast<uint8_t>(predictor & 0xFF);
+  out[1] = static_cast<uint8_t>((predictor >> 8) & 0xFF);
+  out[2] = static_cast<uint8_t>(idx);
+  out[3] = (samples % 2 == 0) ? IMA_ADPCM_FLAG_PAD : 0;
+
+  uint8_t* dst = out + IMA_ADPCM_HEADER_SIZE;
+  for (uint16_t i = 1; i < samples; i += 2) {
+    const uint8_t lo = quantize(pcm[i] - predictor, idx);
+    advance(lo, predictor, idx);
+    uint8_t hi = 0;
+    if (i + 1 < samples) {
+      hi = quantize(pcm[i + 1] - predictor, idx);
+      advance(hi, predictor, idx);
+    }
+    *dst++ = static_cast<uint8_t>(lo | (hi << 4));
+  }
+
+  index = static_cast<uint8_t>(idx);
+  return static_cast<size_t>(dst - out);
+}
+
+uint16_t imaAdpcmDecodeBlock(const uint8_t* in, size_t len, int16_t* pcm) {
+  if (in == nullptr || pcm == nullptr || len < IMA_ADPCM_HEADER_SIZE || in[2] > IMA_ADPCM_MAX_INDEX) {
+    return 0;
+  }
+
+  int32_t predictor = static_cast<int16_t>(in[0] | (in[1] << 8));
+  int idx = in[2];
+  uint16_t samples = imaAdpcmBlockSamples(static_cast<uint16_t>(len));
+  if ((in[3] & IMA_ADPCM_FLAG_PAD) && samples > 1) {
+    samples--;
+  }
+
+  pcm[0] = static_cast<int16_t>(predictor);
+  uint16_t n = 1;
+  for (size_t b = IMA_ADPCM_HEADER_SIZE; b < len && n < samples; ++b) {
+    advance(in[b] & 0x0F, predictor, idx);
+    pcm[n++] = static_cast<int16_t>(predictor);
+    if (n < samples) {
+      advance(in[b] >> 4, predictor, idx);
+      pcm[n++] = static_cast<int16_t>(predictor);
+    }
+  }
+  return n;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * IMA-ADPCM blocks for CODEC_COMPRESSED payloads (MESH_PAYLOAD_CODEC)
+ *
+ * 16-bit mono PCM to 4 bits per sample. Every DATA fragment is exactly one
+ * block and every block restarts the predictor, so a lost fragment only
+ * silences its own samples and blocks decode in any order:
+ *
+ *   [0-1]  first sample, verbatim (int16)
+ *   [2]    step index at that sample (0..88)
+ *   [3]    flags (IMA_ADPCM_FLAG_PAD: the final nibble is padding)
+ *   [4..]  samples 1..n-1, two per byte, low nibble first
+ *
+ * A 242-byte fragment carries 477 samples (954 PCM bytes, 3.9:1). The
+ * encoder carries the step index over from the previous block so the
+ * quantizer does not re-converge at every fragment boundary.
+ */
+
+#define IMA_ADPCM_HEADER_SIZE 4
+#define IMA_ADPCM_FLAG_PAD 0x01
+#define IMA_ADPCM_MAX_INDEX 88
+
+/** Samples in a block of blockBytes (as many as fit). */
+constexpr uint16_t imaAdpcmBlockSamples(uint16_t blockBytes) {
+  return (blockBytes >= IMA_ADPCM_HEADER_SIZE)
+             ? static_cast<uint16_t>(1 + 2 * (blockBytes - IMA_ADPCM_HEADER_SIZE))
+             : 0;
+}
+
+/** Encoded size of a block holding samples. */
+constexpr uint16_t imaAdpcmBlockBytes(uint16_t samples) {
+  return samples ? static_cast<uint16_t>(IMA_ADPCM_HEADER_SIZE + samples / 2) : 0;
+}
+
+/**
+ * Encode samples (>= 1) into out, at most imaAdpcmBlockBytes(samples) bytes.
+ * index is the running step index: read as the block's start, left at its end.
+ *
+ * @return bytes written
+ */
+size_t imaAdpcmEncodeBlock(const int16_t* pcm, uint16_t samples, uint8_t& index, uint8_t* out);
+
+/**
+ * Decode one block of len bytes into pcm (room for imaAdpcmBlockSamples(len)).
+ *
+ * @return samples written, 0 if the block header is malformed
+ */
+uint16_t imaAdpcmDecodeBlock(const uint8_t* in, size_t len, int16_t* pcm);
@@ -0,0 +1,108 @@
+#include "Airtime.h"
+
+// Reference points from the Semtech LoRa calculator (SX1262, 8-symbol
+// preamble, explicit header, CRC on); a model change that moves them is a bug.
+static_assert(loraTimeOnAirUs(255, 7, 125.0f, 5) == 399616, "SF7/125k/4-5, 255 B: 399.616 ms");
+static_assert(loraTimeOnAirUs(16, 7, 125.0f, 5) == 51456, "SF7/125k/4-5, 16 B: 51.456 ms");
+static_assert(loraTimeOnAirUs(255, 12, 125.0f, 5) == 9019392, "SF12/125k/4-5 with LDRO: 9019.392 ms");
+static_assert(loraTimeOnAirUs(10, 9, 125.0f, 8, 8, false, false) == 148480, "SF9/125k/4-8, implicit header, no CRC");
+
+namespace {
+  // FEC transfers keep LORA_FEC_HEADER_SIZE free for the parity frame.
+  constexpr uint16_t kMaxFragment = (MESH_FEC_PARITY > 0) ? LORA_MAX_FEC_DATA_PAYLOAD : LORA_MAX_DATA_PAYLOAD;
+
+  uint32_t frameQuarterSymbols(uint16_t frameLen, uint8_t sf, float bwKhz, uint8_t cr) {
+    return loraFrameQuarterSymbols(frameLen, sf, bwKhz, cr);
+  }
+}
+
+uint16_t optimalFragmentSize(uint8_t sf, float bwKhz, uint8_t cr) {
+#if MESH_TRANSFER_MODE == MESH_TRANSFER_MODE_SELECTIVE_REPEAT
+  const uint32_t ackCost =
+      (frameQuarterSymbols(LORA_HEADER_SIZE + sizeof(WindowPollPayload), sf, bwKhz, cr) +
+       frameQuarterSymbols(LORA_HEADER_SIZE + sizeof(WindowAckPayload), sf, bwKhz, cr)) /
+      MESH_TX_WINDOW_SIZE;
+#else
+  const uint32_t ackCost = frameQuarterSymbols(LORA_HEADER_SIZE + sizeof(AckPayload), sf, bwKhz, cr);
+#endif
+
+  // Parity frames are one fragment plus the FEC header, shared by the window.
+  auto fragCost = [&](uint16_t len) -> uint32_t {
+    uint32_t cost = frameQuarterSymbols(LORA_HEADER_SIZE + len, sf, bwKhz, cr) + ackCost;
+#if MESH_FEC_PARITY > 0
+    cost += MESH_FEC_PARITY * frameQuarterSymbols(LORA_HEADER_SIZE + LORA_FEC_HEADER_SIZE + len, sf, bwKhz, cr) /
+            MESH_TX_WINDOW_SIZE;
+#endif
+    return cost;
+  };
+
+  // Maximize len / cost; on a tie the larger fragment wins (fewer frames).
+  uint16_t bestLen = 1;
+  uint32_t bestCost = fragCost(1);
+  for (uint16_t len = 2; len <= kMaxFragment; ++len) {
+    const uint32_t cost = fragCost(len);
+    if (static_cast<uint64_t>(len) * bestCost >= static_cast<uint64_t>(bestLen) * cost) {
+      bestLen = len;
+      bestCost = cost;
+    }
+  }
+  return bestLen;
+}
+
+TransferEstimate estimateTransfer(uint16_t totalFrags, uint32_t totalSize, uint16_t fragSize,
+                                  uint8_t sf, float bwKhz, uint8_t cr) {
+  TransferEstimate est = {};
+  if (totalFrags == 0 || fragSize == 0) {
+    return est;
+  }
+  const uint32_t ackUs = loraTimeOnAirUs(LORA_HEADER_SIZE + sizeof(AckPayload), sf, bwKhz, cr);
+  const uint32_t lastLen = totalSize - static_cast<uint32_t>(totalFrags - 1U) * fragSize;
+  const uint32_t fullUs = loraTimeOnAirUs(LORA_HEADER_SIZE + fragSize, sf, bwKhz, cr);
+  const uint32_t lastUs = loraTimeOnAirUs(static_cast<uint16_t>(LORA_HEADER_SIZE + lastLen), sf, bwKhz, cr);
+
+  // START and END, each answered by a PKT_ACK.
+  uint64_t txUs = loraTimeOnAirUs(LORA_HEADER_SIZE + sizeof(AudioStartPayload), sf, bwKhz, cr) +
+                  loraTimeOnAirUs(LORA_HEADER_SIZE + sizeof(AudioEndPayload), sf, bwKhz, cr);
+  uint64_t rxUs = 2ULL * ackUs;
+  uint32_t replies = 2;
+
+  txUs += static_cast<uint64_t>(totalFrags - 1U) * fullUs + lastUs;
+#if MESH_TRANSFER_MODE == MESH_TRANSFER_MODE_SELECTIVE_REPEAT
+  const uint32_t windows = (totalFrags + MESH_TX_WINDOW_SIZE - 1U) / MESH_TX_WINDOW_SIZE;
+  txUs += static_cast<uint64_t>(windows) *
+          (loraTimeOnAirUs(LORA_HEADER_SIZE + sizeof(WindowPollPayload), sf, bwKhz, cr) +
+           MESH_FEC_PARITY * loraTimeOnAirUs(LORA_HEADER_SIZE + LORA_FEC_HEADER_SIZE + fragSize, sf, bwKhz, cr));
+  rxUs += static_cast<uint64_t>(windows) *
+          loraTimeOnAirUs(LORA_HEADER_SIZE + sizeof(WindowAckPayload), sf, bwKhz, cr);
+  replies += windows;
+#else
+  rxUs += static_cast<uint64_t>(totalFrags) * ackUs;
+  replies += totalFrags;
+#endif
+
+  est.txAirtimeMs = static_cast<uint32_t>((txUs + 999U) / 1000U);
+  est.rxAirtimeMs = static_cast<uint32_t>((rxUs + 999U) / 1000U);
+  est.durationMs = est.txAirtimeMs + est.rxAirtimeMs + replies * MESH_RTO_TURNAROUND_MS;
+#if MESH_DUTY_CYCLE_PERMILLE > 0
+  // A fresh budget covers the first window's worth; the rest runs at the duty cycle.
+  const uint32_t budgetMs = static_cast<uint32_t>(
+      (static_cast<uint64_t>(MESH_DUTY_CYCLE_WINDOW_MS) * MESH_DUTY_CYCLE_PERMILLE) / 1000U);
+  if (est.txAirtimeMs > budgetMs) {
+    const uint32_t throttledMs = static_cast<uint32_t>(
+        (static_cast<uint64_t>(est.txAirtimeMs - budgetMs) * 1000U) / MESH_DUTY_CYCLE_PERMILLE);
+    if (throttledMs > est.durationMs) {
+      est.durationMs = throttledMs;
+    }
+  }
+#endif
+  est.goodputBps = static_cast<uint32_t>((static_cast<uint64_t>(totalSize) * 8000ULL) / est.durationMs);
+  return est;
+}
+
+uint16_t configuredFragmentSize() {
+#if MESH_FRAG_SIZE == MESH_FRAG_SIZE_AUTO
+  return optimalFragmentSize(MESH_LORA_SF, MESH_LORA_BW_KHZ, MESH_LORA_CR);
+#else
+  return (MESH_FRAG_SIZE < kMaxFragment) ? MESH_FRAG_SIZE : kMaxFragment;
+#endif
+}
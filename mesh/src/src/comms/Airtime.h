@@ -0,0 +1,97 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "../models/packet.h"
+#include "../../mesh_role_config.h"
+
+#if MESH_FRAG_SIZE != MESH_FRAG_SIZE_AUTO && (MESH_FRAG_SIZE < 1 || MESH_FRAG_SIZE > LORA_MAX_DATA_PAYLOAD)
+#error "MESH_FRAG_SIZE must be MESH_FRAG_SIZE_AUTO (0) or 1..LORA_MAX_DATA_PAYLOAD (242)."
+#endif
+
+/*
+ * LoRa time-on-air helpers (SX126x datasheet 6.1.4)
+ *
+ * The defaults are what LoRaManager::init() configures through RadioLib:
+ * LORA_PREAMBLE_SYMBOLS preamble, explicit header, payload CRC on, and low
+ * data rate optimize switched on automatically once a symbol lasts 16 ms
+ * or more. Everything is constexpr so frame costs can be checked at
+ * compile time (see the static_asserts in Airtime.cpp):
+ *
+ *   symbols = preamble + 4.25 + 8 + ceil((8 PL - 4 SF + 28 + 16 CRC - 20 IH)
+ *                                        / (4 (SF - 2 DE))) * CR
+ *   ToA     = symbols * 2^SF / BW
+ */
+
+#define LORA_PREAMBLE_SYMBOLS 8
+
+constexpr bool loraLowDataRateOptimize(uint8_t sf, float bwKhz) {
+  // Symbol time in ms is 2^SF / BW(kHz); RadioLib enables LDRO from 16 ms.
+  return static_cast<float>(1UL << sf) / bwKhz >= 16.0f;
+}
+
+/** Payload symbols (preamble excluded) for a frameLen-byte frame. */
+constexpr uint16_t loraPayloadSymbols(uint16_t frameLen, uint8_t sf, float bwKhz, uint8_t cr,
+                                      bool explicitHeader = true, bool crcOn = true) {
+  // MESH_LORA_CR is the RadioLib denominator (5..8), i.e. cr symbols per block.
+  const int32_t bits = 8 * static_cast<int32_t>(frameLen) - 4 * sf + 28 + (crcOn ? 16 : 0) -
+                       (explicitHeader ? 0 : 20);
+  const int32_t bitsPerBlock = 4 * (sf - 2 * (loraLowDataRateOptimize(sf, bwKhz) ? 1 : 0));
+  const int32_t blocks = (bits > 0) ? (bits + bitsPerBlock - 1) / bitsPerBlock : 0;
+  return static_cast<uint16_t>(8 + blocks * cr);
+}
+
+/** Whole frame in quarter symbols, so the 4.25-symbol sync tail stays integral. */
+constexpr uint32_t loraFrameQuarterSymbols(uint16_t frameLen, uint8_t sf, float bwKhz, uint8_t cr,
+                                           uint16_t preamble = LORA_PREAMBLE_SYMBOLS,
+                                           bool explicitHeader = true, bool crcOn = true) {
+  return (preamble * 4U + 17U) + 4U * loraPayloadSymbols(frameLen, sf, bwKhz, cr, explicitHeader, crcOn);
+}
+
+/** Whole-frame time on air in us, rounded up. */
+constexpr uint32_t loraTimeOnAirUs(uint16_t frameLen, uint8_t sf, float bwKhz, uint8_t cr,
+                                   uint16_t preamble = LORA_PREAMBLE_SYMBOLS,
+                                   bool explicitHeader = true, bool crcOn = true) {
+  // One quarter symbol lasts 2^SF / (4 * BW) ms = 250 * 2^SF / BW us.
+  const double us = static_cast<double>(loraFrameQuarterSymbols(frameLen, sf, bwKhz, cr, preamble,
+                                                                explicitHeader, crcOn)) *
+                    250.0 * static_cast<double>(1UL << sf) / static_cast<double>(bwKhz);
+  const uint32_t whole = static_cast<uint32_t>(us);
+  return (static_cast<double>(whole) < us) ? whole + 1U : whole;
+}
+
+/** Whole-frame time on air in ms, rounded up. */
+constexpr uint32_t loraTimeOnAirMs(uint16_t frameLen, uint8_t sf, float bwKhz, uint8_t cr,
+                                   uint16_t preamble = LORA_PREAMBLE_SYMBOLS) {
+  return (loraTimeOnAirUs(frameLen, sf, bwKhz, cr, preamble) + 999U) / 1000U;
+}
+
+/*
+ * Expected cost of a whole START / DATA... / END transfer at one rate,
+ * first attempts only: every frame and its ACK (or, in selective-repeat
+ * mode, each window's parity, poll and bitmap), MESH_RTO_TURNAROUND_MS per
+ * reply, stretched to the MESH_DUTY_CYCLE_PERMILLE budget when one is set.
+ */
+struct TransferEstimate {
+  uint32_t txAirtimeMs;   // our frames only, what the duty cycle counts
+  uint32_t rxAirtimeMs;   // the peer's ACKs
+  uint32_t durationMs;    // wall clock if nothing is lost
+  uint32_t goodputBps;    // payload bits per second of durationMs
+};
+
+TransferEstimate estimateTransfer(uint16_t totalFrags, uint32_t totalSize, uint16_t fragSize,
+                                  uint8_t sf, float bwKhz, uint8_t cr);
+
+/**
+ * DATA payload size in 1..LORA_MAX_DATA_PAYLOAD with the lowest airtime per
+ * delivered byte, counting the per-fragment ACK (stop-and-wait) or the
+ * poll/bitmap exchange and any parity frames shared by a window
+ * (selective repeat).
+ */
+uint16_t optimalFragmentSize(uint8_t sf, float bwKhz, uint8_t cr);
+
+/**
+ * MESH_FRAG_SIZE (capped at LORA_MAX_FEC_DATA_PAYLOAD with MESH_FEC_PARITY),
+ * or optimalFragmentSize() for the build's radio config.
+ */
+uint16_t configuredFragmentSize();
@@ -0,0 +1,63 @@
+#include "AirtimeScheduler.h"
+
+static_assert(AirtimeScheduler::kBucketMs > 0, "MESH_DUTY_CYCLE_WINDOW_MS must be at least AIRTIME_BUCKETS - 1 ms");
+
+void AirtimeScheduler::recordTx(uint32_t startMs, uint32_t toaMs) {
+  const uint32_t index = startMs / kBucketMs;
+  const uint8_t slot = index % AIRTIME_BUCKETS;
+  if (_bucketIndex[slot] != index) {
+    _bucketIndex[slot] = index;
+    _bucketUsedMs[slot] = 0;
+  }
+  _bucketUsedMs[slot] += toaMs;
+}
+
+void AirtimeScheduler::noteHeard(uint32_t atMs) {
+  _lastHeardMs = atMs;
+  _heard = true;
+}
+
+uint32_t AirtimeScheduler::usedMs(uint32_t nowMs) const {
+  const uint32_t nowIndex = nowMs / kBucketMs;
+  uint32_t used = 0;
+  for (uint8_t i = 0; i < AIRTIME_BUCKETS; ++i) {
+    if (nowIndex - _bucketIndex[i] < AIRTIME_BUCKETS) {
+      used += _bucketUsedMs[i];
+    }
+  }
+  return used;
+}
+
+uint32_t AirtimeScheduler::delayMs(uint32_t nowMs, uint32_t toaMs, bool reply) const {
+  uint32_t waitMs = 0;
+  if (!reply && _heard && nowMs - _lastHeardMs < MESH_TX_GAP_MS) {
+    waitMs = MESH_TX_GAP_MS - (nowMs - _lastHeardMs);
+  }
+
+#if MESH_DUTY_CYCLE_PERMILLE > 0
+  uint32_t used = usedMs(nowMs);
+  // A frame longer than the whole budget still goes once the window is empty.
+  if (used == 0 || used + toaMs <= kBudgetMs) {
+    return waitMs;
+  }
+
+  // Age buckets out oldest first until the frame fits.
+  const uint32_t nowIndex = nowMs / kBucketMs;
+  for (uint32_t age = AIRTIME_BUCKETS - 1; used > 0; --age) {
+    const uint32_t index = nowIndex - age;
+    const uint8_t slot = index % AIRTIME_BUCKETS;
+    if (_bucketIndex[slot] == index) {
+      used -= _bucketUsedMs[slot];
+    }
+    if (used == 0 || used + toaMs <= kBudgetMs || age == 0) {
+      // Bucket index leaves the window once millis() reaches (index + AIRTIME_BUCKETS) buckets.
+      const uint32_t freeAtMs = (index + AIRTIME_BUCKETS) * kBucketMs;
+      const uint32_t budgetWaitMs = freeAtMs - nowMs;
+      return (budgetWaitMs > waitMs) ? budgetWaitMs : waitMs;
+    }
+  }
+#else
+  (void)toaMs;
+#endif
+  return waitMs;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "../../mesh_role_config.h"
+
+#if MESH_DUTY_CYCLE_PERMILLE < 0 || MESH_DUTY_CYCLE_PERMILLE > 1000
+#error "MESH_DUTY_CYCLE_PERMILLE must be 0 (no budget) to 1000."
+#endif
+
+#define AIRTIME_BUCKETS 16
+
+/*
+ * AirtimeScheduler - when the next frame may go on air
+ *
+ * Two rules, both answered by delayMs():
+ *
+ *   gap     MESH_TX_GAP_MS after the last frame heard, so the peer that just
+ *           sent it is back in RX. Replies (ACKs) skip it; the sender is
+ *           already listening for them.
+ *   budget  modeled time on air of every frame sent in the last
+ *           MESH_DUTY_CYCLE_WINDOW_MS stays within MESH_DUTY_CYCLE_PERMILLE
+ *           of it. Usage is kept in AIRTIME_BUCKETS time buckets and a frame
+ *           counts until its whole bucket has aged out, up to one bucket
+ *           longer than the window (errs on the safe side).
+ *
+ * Usage is tracked even without a budget so usedMs() can be reported.
+ */
+class AirtimeScheduler {
+public:
+  // AIRTIME_BUCKETS - 1 buckets span the window, so the ring always covers all of it.
+  static constexpr uint32_t kBucketMs = MESH_DUTY_CYCLE_WINDOW_MS / (AIRTIME_BUCKETS - 1);
+  static constexpr uint32_t kBudgetMs =
+      static_cast<uint32_t>((static_cast<uint64_t>(MESH_DUTY_CYCLE_WINDOW_MS) * MESH_DUTY_CYCLE_PERMILLE) / 1000U);
+
+  void recordTx(uint32_t startMs, uint32_t toaMs);
+  void noteHeard(uint32_t atMs);
+
+  /** Wait before a toaMs frame may start at nowMs; 0 = send now. */
+  uint32_t delayMs(uint32_t nowMs, uint32_t toaMs, bool reply) const;
+
+  /** Airtime counted against the budget at nowMs. */
+  uint32_t usedMs(uint32_t nowMs) const;
+
+private:
+  uint32_t _bucketUsedMs[AIRTIME_BUCKETS] = {};
+  uint32_t _bucketIndex[AIRTIME_BUCKETS] = {};   // millis() / kBucketMs it holds
+  uint32_t _lastHeardMs = 0;
+  bool _heard = false;
+};
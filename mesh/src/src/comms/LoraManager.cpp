@@ -1,7 +1,12 @@
 #include "LoraManager.h"
 #include <SPI.h>
+#include "../bus/SpiArbiter.h"
+#include "Airtime.h"
+#include "../util/StageProfiler.h"
 
 bool LoRaManager::init(uint16_t *g_session_id, uint16_t *g_seq_num) {
+  SpiArbiter::attach(SpiArbiter::RADIO, LORA_NSS);
+  SpiLease bus(SpiArbiter::RADIO);
   int state = _radio.begin(
     MESH_LORA_FREQ_MHZ,
     MESH_LORA_BW_KHZ,
@@ -13,75 +18,642 @@ bool LoRaManager::init(uint16_t *g_session_id, uint16_t *g_seq_num) {
 
   _session_id = *g_session_id;
   _seq_num = *g_seq_num;
+  _rate = _baseRate;
+  _lastHeardMs = millis();
+  _radioActivityMs = _lastHeardMs;
 
   if (state != RADIOLIB_ERR_NONE) {
     Serial.printf("[LoRa] Init failed, code %d\n", state);
     return false;
   }
 
-  return true;
+  _radio.setDio1Action(_onDio1);
+  return startReceive();
 }
 
-void LoRaManager::resetSPI() {
-  // Ensure SD card is deselected
-  pinMode(34, OUTPUT); // SD_CS
-  digitalWrite(34, HIGH);
-  delayMicroseconds(10);
-  
-  // Reset SPI bus
-  SPI.end();
-  delayMicroseconds(50);
-  SPI.begin();
-  delayMicroseconds(10);
-  
-  // Ensure LoRa NSS is high before operations
-  pinMode(LORA_NSS, OUTPUT);
-  digitalWrite(LORA_NSS, HIGH);
-  delayMicroseconds(5);
+/**
+ * Start a new transfer session. The sketches bump their session counter
+ * between runs; this keeps the header fields in step with it.
+ */
+void LoRaManager::setSession(uint16_t session_id, uint16_t seq_num) {
+  _session_id = session_id;
+  _seq_num = seq_num;
 }
 
 /*
-  #     Helpers
+  #     Interrupt-driven radio I/O
 */
 
+volatile bool LoRaManager::_dio1Fired = false;
+
+// DIO1 = TxDone / RxDone on the SX1262. Only flag it; SPI stays out of the ISR.
+void IRAM_ATTR LoRaManager::_onDio1() {
+  _dio1Fired = true;
+}
+
 /**
- * Send a fully-constructed LoRaAudioPacket over the air.
- * Only transmits header + the portion of the payload that is meaningful
- * for this packet type (avoids sending unused union bytes).
+ * Queue a raw frame for transmission and return immediately.
+ * Completion is reported through service() / onTxDone().
  *
- * @param pkt Pointer to the packet
- * @param payload_len Number of payload bytes to include after the header
- * @return RADIOLIB_ERR_NONE on success
+ * @return false if a TX is already in flight or the radio rejected it
+ */
+bool LoRaManager::startTransmit(const uint8_t* frame, size_t len, uint8_t hop) {
+  if (_radioState == RADIO_TX) {
+    return false;
+  }
+
+  // Pick up a frame that landed while RX was armed before leaving RX mode.
+  service();
+
+  SpiLease bus(SpiArbiter::RADIO);
+  if (!bus) {
+    return false;
+  }
+  _leaveDutyCycle();
+  const uint16_t preamble = txPreamble(hop);
+  if (preamble != _radioPreamble) {
+    const int preambleState = _radio.setPreambleLength(preamble);
+    if (preambleState != RADIOLIB_ERR_NONE) {
+      Serial.printf("[TX] setPreambleLength(%u) failed, code %d\n", preamble, preambleState);
+      startReceive();
+      return false;
+    }
+    _radioPreamble = preamble;
+  }
+  _dio1Fired = false;
+  int state = _radio.startTransmit(frame, len);
+  if (state != RADIOLIB_ERR_NONE) {
+    Serial.printf("[TX] startTransmit failed, code %d\n", state);
+    startReceive();
+    return false;
+  }
+  _radioState = RADIO_TX;
+  if (preamble != LORA_PREAMBLE_SYMBOLS) {
+    _listen.wakeFrames++;
+  }
+  _lastToaMs = loraTimeOnAirMs(static_cast<uint16_t>(len), _rate.sf, bwCodeToKhz(_rate.bwCode), _rate.cr, preamble);
+  _air.recordTx(millis(), _lastToaMs);
+  return true;
+}
+
+/**
+ * Arm continuous RX. Frames are moved into the RX queue by service().
+ * With MESH_RX_DUTY_CYCLE an idle link gets duty-cycled RX instead: the
+ * SX1262 sleeps between preamble searches timed so that a
+ * MESH_LORA_WAKE_PREAMBLE preamble always spans one.
+ */
+bool LoRaManager::startReceive() {
+  SpiLease bus(SpiArbiter::RADIO);
+  if (!bus) {
+    _radioState = RADIO_IDLE;
+    return false;
+  }
+  _dio1Fired = false;
+  _leaveDutyCycle();
+#if MESH_RX_DUTY_CYCLE
+  const bool dutyCycle = _linkIdle(millis());
+  int state = dutyCycle ? _radio.startReceiveDutyCycleAuto(MESH_LORA_WAKE_PREAMBLE, MESH_RX_WAKE_MIN_SYMBOLS)
+                        : _radio.startReceive();
+#else
+  int state = _radio.startReceive();
+#endif
+  if (state != RADIOLIB_ERR_NONE) {
+    Serial.printf("[RX] startReceive failed, code %d\n", state);
+    _radioState = RADIO_IDLE;
+    return false;
+  }
+  _radioState = RADIO_RX;
+#if MESH_RX_DUTY_CYCLE
+  if (dutyCycle) {
+    _dutyCycled = true;
+    _dutyCycleStartMs = millis();
+    _listen.dutyCycleEntries++;
+  }
+#endif
+  return true;
+}
+
+// Back to standby from duty-cycled RX; the caller holds the radio lease.
+void LoRaManager::_leaveDutyCycle() {
+  if (!_dutyCycled) {
+    return;
+  }
+  _radio.standby();
+  _listen.dutyCycleMs += millis() - _dutyCycleStartMs;
+  _dutyCycled = false;
+}
+
+bool LoRaManager::_linkIdle(uint32_t now) const {
+  return now - _radioActivityMs >= MESH_LINK_IDLE_MS;
+}
+
+// Any frame shows its sender awake, whoever it was for. A new neighbour
+// takes the slot of the one heard longest ago.
+void LoRaManager::noteHeardFrom(const LoRaRxFrame& frame) {
+  if (frame.len < LORA_HEADER_SIZE) {
+    return;
+  }
+  LoRaHeader hdr;
+  deserializeHeader(frame.data, &hdr);
+  uint8_t slot = 0;
+  while (slot < _heardCount && _heard[slot].id != hdr.prev_hop) {
+    slot++;
+  }
+  if (slot == kHeardPeers) {
+    slot = 0;
+    for (uint8_t i = 1; i < kHeardPeers; ++i) {
+      if (static_cast<int32_t>(_heard[i].ms - _heard[slot].ms) < 0) {
+        slot = i;
+      }
+    }
+  } else if (slot == _heardCount) {
+    _heardCount++;
+  }
+  _heard[slot] = HeardPeer{hdr.prev_hop, frame.rxMs};
+}
+
+// A hop not heard from for half the idle timeout may already sleep in
+// duty-cycled RX (it stays awake MESH_LINK_IDLE_MS after its last frame).
+// A broadcast may be for anyone, so it always carries the wake preamble.
+uint16_t LoRaManager::txPreamble(uint8_t hop) const {
+#if MESH_RX_DUTY_CYCLE
+  const uint32_t now = millis();
+  for (uint8_t i = 0; i < _heardCount && hop != LORA_BROADCAST_ID; ++i) {
+    if (_heard[i].id == hop) {
+      return (now - _heard[i].ms >= MESH_LINK_IDLE_MS / 2) ? MESH_LORA_WAKE_PREAMBLE : LORA_PREAMBLE_SYMBOLS;
+    }
+  }
+  return MESH_LORA_WAKE_PREAMBLE;
+#else
+  (void)hop;
+  return LORA_PREAMBLE_SYMBOLS;
+#endif
+}
+
+/**
+ * Handle a pending DIO1 event: finish a TX and re-arm RX, or copy a
+ * received frame into the queue. Call often from loop(); cheap when idle.
  */
-int LoRaManager::_sendPacket(const LoRaAudioPacket* pkt, size_t payload_len) {
-  // Total wire bytes = fixed header + actual payload length
-  size_t total_len = LORA_HEADER_SIZE + payload_len;
+void LoRaManager::service() {
+  if (!_dio1Fired) {
+#if MESH_RX_DUTY_CYCLE
+    if (_radioState == RADIO_RX && !_dutyCycled && _linkIdle(millis())) {
+      startReceive();   // the link just went idle
+    }
+#endif
+    return;
+  }
+
+  // Callbacks run after the lease is dropped so they may log to SD.
+  if (_radioState == RADIO_TX) {
+    {
+      SpiLease bus(SpiArbiter::RADIO);
+      if (!bus) {
+        return;  // DIO1 stays flagged; retried on the next service()
+      }
+      _dio1Fired = false;
+      _txOk = (_radio.finishTransmit() == RADIOLIB_ERR_NONE);
+      _radioState = RADIO_IDLE;
+      _radioActivityMs = millis();  // before startReceive(): the reply is due now
+      startReceive();
+    }
+    if (_txDoneFn != nullptr) {
+      _txDoneFn(_txOk);
+    }
+    return;
+  }
+
+  if (_radioState != RADIO_RX) {
+    _dio1Fired = false;
+    return;
+  }
+
+  LoRaRxFrame* frame = nullptr;
+  {
+    SpiLease bus(SpiArbiter::RADIO);
+    if (!bus) {
+      return;
+    }
+    _dio1Fired = false;
+    _radioActivityMs = millis();
+
+    const size_t len = _radio.getPacketLength();
+    if (len == 0 || len > LORA_MAX_PAYLOAD) {
+      startReceive();
+      return;
+    }
+
+    const bool full = (_rxCount == MESH_LORA_RX_QUEUE_DEPTH);
+    if (full && _ackWait != ACK_WAIT_PENDING) {
+      // Keep the oldest frames; they are the ones an ACK wait is after.
+      uint8_t discard[LORA_MAX_PAYLOAD];
+      _radio.readData(discard, len);
+      _rxDropped++;
+      Serial.printf("[RX] Queue full, dropped frame (total %lu)\n", static_cast<unsigned long>(_rxDropped));
+      startReceive();
+      return;
+    }
+
+    // A full queue still lets an armed ACK wait look at the frame.
+    LoRaRxFrame& slot = full ? _rxOverflow : _rxQueue[(_rxHead + _rxCount) % MESH_LORA_RX_QUEUE_DEPTH];
+    const int state = _radio.readData(slot.data, len);
+    slot.len = static_cast<uint8_t>(len);
+    slot.rssi = _radio.getRSSI();
+    slot.snr = _radio.getSNR();
+    slot.rxMs = millis();
+    startReceive();
+    _air.noteHeard(slot.rxMs);
+    _replyGap = false;
+
+    if (state != RADIOLIB_ERR_NONE) {
+      Serial.printf("[RX] readData failed, code %d\n", state);
+      return;
+    }
+    if (getVersion(slot.data[0]) == LORA_COMPACT_VERSION) {
+      // Everything past this point reads v2 headers at LORA_HEADER_SIZE.
+      const size_t expanded = expandCompactFrame(slot.data, len, _wireDefaults());
+      if (expanded == 0) {
+        _rxFiltered++;
+        Serial.printf("[RX] Dropped malformed compact frame (%u bytes)\n", static_cast<unsigned>(len));
+        return;
+      }
+      slot.len = static_cast<uint8_t>(expanded);
+    } else if (len >= LORA_HEADER_SIZE && getVersion(slot.data[0]) != LORA_PROTOCOL_VERSION) {
+      // Other header layouts (v1 firmware) would be misparsed field by field.
+      _rxFiltered++;
+      Serial.printf("[RX] Dropped protocol v%u frame\n", getVersion(slot.data[0]));
+      return;
+    }
+    noteHeardFrom(slot);
+    if (_rxFilterFn != nullptr && !_rxFilterFn(slot)) {
+      _rxFiltered++;  // relayed, duplicate or not for us; the slot is reused
+      return;
+    }
+    bool ackOk = false;
+    if (_ackWait == ACK_WAIT_PENDING &&
+        (_ackWindow ? _matchWindowAck(slot, _ackSeq, false, ackOk) : _matchAck(slot, _ackSeq, false, ackOk))) {
+      _ackWait = ackOk ? ACK_WAIT_OK : ACK_WAIT_REJECTED;
+      _lastRssi = slot.rssi;
+      _lastSnr = slot.snr;
+      _lastRxMs = slot.rxMs;
+      _lastHeardMs = slot.rxMs;
+      return;  // taken by the armed wait; the slot is reused
+    }
+    if (full) {
+      _rxDropped++;
+      Serial.printf("[RX] Queue full, dropped frame (total %lu)\n", static_cast<unsigned long>(_rxDropped));
+      return;
+    }
+    _rxCount++;
+    _lastHeardMs = slot.rxMs;
+    frame = &slot;
+  }
+
+  if (_rxFn != nullptr) {
+    _rxFn(*frame);
+  }
+}
+
+bool LoRaManager::_popFrame(LoRaRxFrame& frame) {
+  service();
+  if (_rxCount == 0) {
+    return false;
+  }
+  frame = _rxQueue[_rxHead];
+  _rxHead = static_cast<uint8_t>((_rxHead + 1) % MESH_LORA_RX_QUEUE_DEPTH);
+  _rxCount--;
+  _lastRssi = frame.rssi;
+  _lastSnr = frame.snr;
+  _lastRxMs = frame.rxMs;
+  return true;
+}
+
+// Wait until a frame is queued or timeout_ms has passed since startMs.
+bool LoRaManager::_nextFrame(LoRaRxFrame& frame, uint32_t startMs, uint32_t timeout_ms) {
+  while (!_popFrame(frame)) {
+    if (millis() - startMs >= timeout_ms) {
+      return false;
+    }
+    if (_idleFn != nullptr) {
+      _idleFn();
+    }
+    delay(1);
+  }
+  return true;
+}
+
+uint32_t LoRaManager::_frameToaMs(size_t len, uint8_t hop) const {
+  return loraTimeOnAirMs(static_cast<uint16_t>(len), _rate.sf, bwCodeToKhz(_rate.bwCode), _rate.cr,
+                         txPreamble(hop));
+}
+
+uint32_t LoRaManager::txWaitMs(size_t len, uint8_t hop) const {
+  return _air.delayMs(millis(), _frameToaMs(len, hop), true);
+}
+
+uint32_t LoRaManager::quietMs() const {
+  if (_radioState == RADIO_TX) {
+    return 0;  // TxDone must re-arm RX before the reply lands
+  }
+  const uint32_t now = millis();
+  if (_pacing) {
+    return (static_cast<int32_t>(_paceUntilMs - now) > 0) ? _paceUntilMs - now : 0;
+  }
+  if (_replyGap && now - _txDoneMs < MESH_TX_GAP_MS) {
+    return MESH_TX_GAP_MS - (now - _txDoneMs);
+  }
+  // No exchange in progress: a frame that arrives waits in the radio buffer.
+  if (now - _lastHeardMs >= MESH_LINK_IDLE_MS && now - _txDoneMs >= MESH_LINK_IDLE_MS) {
+    return UINT32_MAX;
+  }
+  return 0;
+}
+
+/**
+ * Transmit and wait for TxDone. The blocking protocol calls sit on top of
+ * this so the radio is back in RX as soon as the frame is on air. Replies
+ * (ACKs) skip the TX gap but, like every frame, wait for airtime budget.
+ */
+int LoRaManager::_transmitFrame(uint8_t* frame, size_t len, bool reply) {
+  LoRaHeader hdr;
+  deserializeHeader(frame, &hdr);
+#if MESH_WIRE_COMPACT
+  // The compact header is written to end where the v2 one did, so the
+  // payload stays put and goes out from a later start. Callers rewrite the
+  // header before every send (and copy a frame they keep beforehand).
+  {
+    uint8_t compact[LORA_COMPACT_HEADER_MAX];
+    const size_t hdrLen = encodeCompactHeader(&hdr, _wireDefaults(), compact);
+    if (hdrLen < LORA_HEADER_SIZE) {
+      frame += LORA_HEADER_SIZE - hdrLen;
+      len -= LORA_HEADER_SIZE - hdrLen;
+      memcpy(frame, compact, hdrLen);
+    }
+  }
+#endif
+
+  // A relayed frame (MeshRouter) may still be on air; let it finish first.
+  if (_radioState == RADIO_TX) {
+    const uint32_t busyLimitMs = _radio.getTimeOnAir(LORA_MAX_PAYLOAD) / 1000UL + 200UL;
+    const uint32_t busyStartMs = millis();
+    while (_radioState == RADIO_TX && millis() - busyStartMs < busyLimitMs) {
+      service();
+      delay(1);
+    }
+  }
+
+  const uint32_t waitMs = _air.delayMs(millis(), _frameToaMs(len, hdr.next_hop), reply);
+  if (waitMs > 0) {
+    PROFILE_SCOPE(PROFILE_TX_PACE);
+    if (waitMs >= 1000) {
+      Serial.printf("[TX] Airtime budget: waiting %lu ms (%lu of %lu ms used)\n",
+                    static_cast<unsigned long>(waitMs),
+                    static_cast<unsigned long>(_air.usedMs(millis())),
+                    static_cast<unsigned long>(AirtimeScheduler::kBudgetMs));
+    }
+    const uint32_t waitStartMs = millis();
+    _paceUntilMs = waitStartMs + waitMs;
+    _pacing = true;
+    while (millis() - waitStartMs < waitMs) {
+      service();
+      if (_idleFn != nullptr) {
+        _idleFn();
+      }
+      delay(1);
+    }
+    _pacing = false;
+  }
 
-  if (total_len > LORA_MAX_PAYLOAD) {
-    Serial.printf("[TX] Packet too large: %u > %u\n", total_len, LORA_MAX_PAYLOAD);
-    return -1;
+#if MESH_LBT_ENABLE
+  // A reply goes into the turnaround its peer keeps clear for it.
+  if (!reply) {
+    PROFILE_SCOPE(PROFILE_TX_PACE);
+    _listenBeforeTalk(len, hdr.next_hop);
   }
+#endif
 
-  // Reset SPI before transmission
-  resetSPI();
-  
-  // Cast struct to raw bytes for RadioLib
-  return _radio.transmit(reinterpret_cast<const uint8_t*>(pkt), total_len);
+  // Karn: the ACK to a resent seq could answer either copy, so it is no RTT sample.
+  _txResend = _txStartMs != 0 && hdr.seq_num == _txSeq && hdr.session_id == _txSession;
+  _txSeq = hdr.seq_num;
+  _txSession = hdr.session_id;
+  _txStartMs = millis();
+  _lastTxMs = 0;
+  _replyGap = false;
+
+  PROFILE_SCOPE(PROFILE_RADIO_TX);
+  if (!startTransmit(frame, len, hdr.next_hop)) {
+    return RADIOLIB_ERR_TX_TIMEOUT;
+  }
+
+  // Time on air plus margin for BUSY and SPI; getTimeOnAir() is in us.
+  const uint32_t limitMs = _radio.getTimeOnAir(len) / 1000UL + 200UL;
+  const uint32_t startMs = millis();
+  while (_radioState == RADIO_TX) {
+    service();
+    if (millis() - startMs >= limitMs) {
+      Serial.println("[TX] TxDone timeout");
+      startReceive();
+      return RADIOLIB_ERR_TX_TIMEOUT;
+    }
+    if (_idleFn != nullptr) {
+      _idleFn();
+    }
+    delay(1);
+  }
+  _txDoneMs = millis();
+  if (_txOk) {
+    _lastTxMs = _txDoneMs - _txStartMs;
+    _replyGap = reply;
+  }
+  return _txOk ? RADIOLIB_ERR_NONE : RADIOLIB_ERR_TX_TIMEOUT;
 }
 
-void LoRaManager::_fillHeader(LoRaAudioPacket* pkt, uint8_t type) {
+/**
+ * Listen before talk: CAD scans until one finds the channel free, or
+ * MESH_LBT_MAX_DEFERS found it busy in a row. Between scans the radio is
+ * back in RX, so the frame that made the channel busy is still received;
+ * it may be the one this node is waiting for. Leaves the radio in standby
+ * (free channel) or RX, ready for startTransmit().
+ */
+void LoRaManager::_listenBeforeTalk(size_t len, uint8_t hop) {
+  for (uint8_t busy = 0;;) {
+    service();  // take a frame that landed before the scan leaves RX
+    int state;
+    {
+      SpiLease bus(SpiArbiter::RADIO);
+      if (!bus) {
+        return;
+      }
+      _leaveDutyCycle();
+      _radioState = RADIO_IDLE;
+      state = _radio.scanChannel();
+      _dio1Fired = false;  // that was CAD done, not a frame
+    }
+    _listen.cadScans++;
+    if (state != RADIOLIB_LORA_DETECTED) {
+      if (state != RADIOLIB_CHANNEL_FREE) {
+        Serial.printf("[TX] CAD failed, code %d; sending anyway\n", state);
+      }
+      return;
+    }
+    _listen.cadBusy++;
+    startReceive();
+    if (++busy >= MESH_LBT_MAX_DEFERS) {
+      _listen.lbtForced++;
+      Serial.printf("[TX] Channel busy for %u CAD scans; sending anyway\n", static_cast<unsigned>(busy));
+      return;
+    }
+
+    // Up to 2^busy airtimes of our own frame, so contenders spread out.
+    const uint32_t toaMs = _frameToaMs(len, hop);
+    uint32_t backoffMs = toaMs / 2 + static_cast<uint32_t>(random(static_cast<long>(toaMs << busy) + 1));
+    if (backoffMs > MESH_RETRY_BACKOFF_MAX_MS) {
+      backoffMs = MESH_RETRY_BACKOFF_MAX_MS;
+    }
+    // The frame that was on air is answered after a turnaround CAD cannot
+    // see, so the TX gap after anything heard meanwhile applies as well.
+    const uint32_t waitStartMs = millis();
+    while (millis() - waitStartMs < backoffMs || _air.delayMs(millis(), toaMs, false) > 0) {
+      service();
+      if (_idleFn != nullptr) {
+        _idleFn();
+      }
+      delay(1);
+    }
+  }
+}
+
+LoRaManager::ListenStats LoRaManager::listenStats() const {
+  ListenStats stats = _listen;
+  if (_dutyCycled) {
+    stats.dutyCycleMs += millis() - _dutyCycleStartMs;
+  }
+  return stats;
+}
+
+void LoRaManager::printListenStats() const {
+  const ListenStats stats = listenStats();
+  Serial.printf("[LBT] cad=%lu busy=%lu forced=%lu | [RXDC] entries=%lu duty_cycled_ms=%lu rx_on=%lu.%lu%% wake_frames=%lu\n",
+                static_cast<unsigned long>(stats.cadScans), static_cast<unsigned long>(stats.cadBusy),
+                static_cast<unsigned long>(stats.lbtForced), static_cast<unsigned long>(stats.dutyCycleEntries),
+                static_cast<unsigned long>(stats.dutyCycleMs),
+                static_cast<unsigned long>(rxOnPermille() / 10), static_cast<unsigned long>(rxOnPermille() % 10),
+                static_cast<unsigned long>(stats.wakeFrames));
+}
+
+/*
+  #     Helpers
+*/
+
+/**
+ * Claim _txFrame for an internal send. Fails while the caller has it
+ * borrowed, since that would overwrite a DATA payload it may resend.
+ */
+uint8_t* LoRaManager::_claimTxFrame(const char* what) {
+  if (_txBorrowed) {
+    Serial.printf("[TX] %s refused: TX frame is borrowed\n", what);
+    return nullptr;
+  }
+  return _txFrame;
+}
+
+void LoRaManager::_writeHeader(uint8_t* frame, uint8_t type, uint16_t seq) {
+  LoRaHeader hdr;
   buildHeader(
-    &pkt->header,
+    &hdr,
     type,
     MESH_NODE_ID,
     MESH_PEER_NODE_ID,
     MESH_EXPERIMENT_ID,
     _session_id,
-    _seq_num++,
-    MESH_LORA_TX_POWER_DBM,
-    MESH_LORA_SF,
-    MESH_LORA_CR
+    seq,
+    static_cast<uint8_t>(_rate.txPower),
+    _rate.sf,
+    _rate.cr
+  );
+  _setHops(hdr);
+  serializeHeader(&hdr, frame);
+}
+
+// Reply header: addresses swapped, session/seq echoed from the frame being answered.
+// A broadcast is answered from this node's own id.
+void LoRaManager::_writeReplyHeader(uint8_t* frame, uint8_t type, const LoRaHeader& to) {
+  LoRaHeader hdr;
+  buildHeader(
+    &hdr,
+    type,
+    (to.dst_id == LORA_BROADCAST_ID) ? static_cast<uint8_t>(MESH_NODE_ID) : to.dst_id,
+    to.src_id,
+    to.exp_id,
+    to.session_id,
+    to.seq_num,
+    static_cast<uint8_t>(_rate.txPower),
+    _rate.sf,
+    _rate.cr
   );
+  _setHops(hdr);
+  serializeHeader(&hdr, frame);
+}
+
+// What either end of the link can leave out of a compact header.
+LoRaHeaderDefaults LoRaManager::_wireDefaults() const {
+  return LoRaHeaderDefaults{static_cast<uint8_t>(MESH_EXPERIMENT_ID), static_cast<uint8_t>(_rate.txPower),
+                            makeSFCR(_rate.sf, _rate.cr)};
+}
+
+// buildHeader() addressed the hop to dst; a resolver (MeshRouter) may route it.
+void LoRaManager::_setHops(LoRaHeader& hdr) const {
+  hdr.next_hop = (_nextHopFn != nullptr) ? _nextHopFn(hdr.dst_id) : hdr.dst_id;
+}
+
+/*
+  #     Zero-copy DATA frames
+*/
+
+/**
+ * Lend out the TX frame so a DATA payload can be read straight into
+ * frame + LORA_HEADER_SIZE. sendDataFrame() fills the header in place and
+ * keeps the payload intact, so retries resend without re-reading. Other
+ * sends are refused until releaseTxFrame().
+ *
+ * @return LORA_MAX_PAYLOAD-byte frame, or nullptr if already borrowed
+ */
+uint8_t* LoRaManager::borrowTxFrame() {
+  if (_txBorrowed) {
+    return nullptr;
+  }
+  _txBorrowed = true;
+  return _txFrame;
+}
+
+void LoRaManager::releaseTxFrame() {
+  _txBorrowed = false;
+}
+
+/**
+ * Transmit a DATA frame whose payload is already at frame + LORA_HEADER_SIZE.
+ * frame is the borrowed TX frame or any caller-owned LORA_MAX_PAYLOAD buffer
+ * (e.g. a selective-repeat window slot); only the header bytes are written.
+ *
+ * @param frame  Frame buffer with the payload in place
+ * @param seq    Seq from reserveSeqRange() for this fragment
+ * @param len    Payload bytes (must be <= LORA_MAX_DATA_PAYLOAD)
+ * @param type   PKT_AUDIO_DATA or PKT_AUDIO_DATA_WIN
+ */
+bool LoRaManager::sendDataFrame(uint8_t* frame, uint16_t seq, uint8_t len, uint8_t type) {
+  if (frame == nullptr || len > LORA_MAX_DATA_PAYLOAD) {
+    Serial.println("[TX] Invalid DATA frame");
+    return false;
+  }
+
+  _writeHeader(frame, type, seq);
+  int state = _transmitFrame(frame, LORA_HEADER_SIZE + len);
+  if (state == RADIOLIB_ERR_NONE) {
+    Serial.printf("[TX] AUDIO_DATA seq=%u len=%u sent\n", seq, len);
+  } else {
+    Serial.printf("[TX] AUDIO_DATA seq=%u failed, code %d\n", seq, state);
+  }
+  return state == RADIOLIB_ERR_NONE;
 }
 
 /**
@@ -92,29 +664,36 @@ void LoRaManager::_fillHeader(LoRaAudioPacket* pkt, uint8_t type) {
  * @param sample_hz    Original sample rate in Hz
  * @param duration_ms  Audio duration in milliseconds
  * @param total_size   Total audio data size in bytes
+ * @param type         PKT_AUDIO_START, or PKT_RESUME to reopen the session's
+ *                     transfer (answered with PKT_NACK, see lastNack())
  */
 bool LoRaManager::sendAudioStart(uint16_t total_frags, uint8_t codec,
                     uint16_t sample_hz, uint16_t duration_ms,
-                    uint32_t total_size) {
-  LoRaAudioPacket pkt;
-  memset(&pkt, 0, sizeof(pkt));
-  _fillHeader(&pkt, PKT_AUDIO_START);
+                    uint32_t total_size, uint8_t type) {
+  const char* label = type == PKT_RESUME ? "RESUME" : "AUDIO_START";
+  uint8_t* frame = _claimTxFrame(label);
+  if (frame == nullptr) {
+    return false;
+  }
+  _writeHeader(frame, type, _seq_num++);
 
-  AudioStartPayload& sp = pkt.payload.start;
+  AudioStartPayload sp;
   sp.total_frags = total_frags;
   sp.codec_id = codec;
   sp.sample_hz = sample_hz;
   sp.duration_ms = duration_ms;
   sp.total_size = total_size;
-  // CRC covers everything except the crc16 field itself
-  sp.crc16 = crc16(reinterpret_cast<const uint8_t*>(&sp),
-                   sizeof(AudioStartPayload) - sizeof(uint16_t));
+  // CRC covers the serialized bytes before the crc16 field itself
+  sp.crc16 = 0;
+  serializeAudioStart(&sp, frame + LORA_HEADER_SIZE);
+  sp.crc16 = crc16(frame + LORA_HEADER_SIZE, sizeof(AudioStartPayload) - sizeof(uint16_t));
+  serializeAudioStart(&sp, frame + LORA_HEADER_SIZE);
 
-  int state = _sendPacket(&pkt, sizeof(AudioStartPayload));
+  int state = _transmitFrame(frame, LORA_HEADER_SIZE + sizeof(AudioStartPayload));
   if (state == RADIOLIB_ERR_NONE) {
-    Serial.println("[TX] AUDIO_START sent");
+    Serial.printf("[TX] %s sent\n", label);
   } else {
-    Serial.printf("[TX] AUDIO_START failed, code %d\n", state);
+    Serial.printf("[TX] %s failed, code %d\n", label, state);
   }
   return state == RADIOLIB_ERR_NONE;
 }
@@ -132,32 +711,13 @@ bool LoRaManager::sendAudioData(const uint8_t* data, uint8_t len) {
     return false;
   }
 
-  LoRaAudioPacket pkt;
-  memset(&pkt, 0, sizeof(pkt));
-  _fillHeader(&pkt, PKT_AUDIO_DATA);
-
-  AudioDataPayload& dp = pkt.payload.data;
-  memcpy(dp.data, data, len);
-  dp.len = len;
-
-  // Only send header + len byte + actual data bytes (not the full 245-byte buffer)
-  // payload_len = len field (1 byte) + data (len bytes)
-  // Because 'len' is the LAST field after data[], we send len bytes of data + 1 byte for len
-  uint8_t buf[LORA_MAX_PAYLOAD];
-  serializeHeader(&pkt.header, buf);
-  memcpy(buf + LORA_HEADER_SIZE, dp.data, len);
-  
-  // Reset SPI before transmission
-  resetSPI();
-  
-  int state = _radio.transmit(buf, LORA_HEADER_SIZE + len);
-  
-  if (state == RADIOLIB_ERR_NONE) {
-    Serial.printf("[TX] AUDIO_DATA seq=%u len=%u sent\n", _seq_num - 1, len);
-  } else {
-    Serial.printf("[TX] AUDIO_DATA failed, code %d\n", state);
+  uint8_t* frame = _claimTxFrame("AUDIO_DATA");
+  if (frame == nullptr) {
+    return false;
   }
-  return state == RADIOLIB_ERR_NONE;
+  // Only header + data bytes go on air, never the unused rest of the frame.
+  memcpy(frame + LORA_HEADER_SIZE, data, len);
+  return sendDataFrame(frame, _seq_num++, len, PKT_AUDIO_DATA);
 }
 
 
@@ -168,16 +728,19 @@ bool LoRaManager::sendAudioData(const uint8_t* data, uint8_t len) {
  * @param full_crc32  CRC32 of the complete reassembled audio data
  */
 bool LoRaManager::sendAudioEnd(uint16_t frag_count, uint32_t full_crc32) {
-  LoRaAudioPacket pkt;
-  memset(&pkt, 0, sizeof(pkt));
-  _fillHeader(&pkt, PKT_AUDIO_END);
+  uint8_t* frame = _claimTxFrame("AUDIO_END");
+  if (frame == nullptr) {
+    return false;
+  }
+  _writeHeader(frame, PKT_AUDIO_END, _seq_num++);
 
-  AudioEndPayload& ep = pkt.payload.end;
+  AudioEndPayload ep;
   ep.frag_count = frag_count;
   ep.crc32      = full_crc32;
   ep.reserved   = 0;
+  serializeAudioEnd(&ep, frame + LORA_HEADER_SIZE);
 
-  int state = _sendPacket(&pkt, sizeof(AudioEndPayload));
+  int state = _transmitFrame(frame, LORA_HEADER_SIZE + sizeof(AudioEndPayload));
   if (state == RADIOLIB_ERR_NONE) {
     Serial.println("[TX] AUDIO_END sent");
   } else {
@@ -195,63 +758,160 @@ bool LoRaManager::sendAudioEnd(uint16_t frag_count, uint32_t full_crc32) {
  * @param timeout_ms    How long to wait in milliseconds
  */
 bool LoRaManager::waitForAck(uint16_t expected_seq, uint32_t timeout_ms) {
-  // Reset SPI before receive
-  resetSPI();
-  
-  uint8_t buf[LORA_MAX_PAYLOAD];
-  int state = _radio.receive(buf, sizeof(buf), timeout_ms);
+  PROFILE_SCOPE(PROFILE_ACK_WAIT);
+  const uint32_t startMs = millis();
+  LoRaRxFrame frame;
 
-  if (state != RADIOLIB_ERR_NONE) {
-    Serial.printf("[RX] No ACK received (code %d)\n", state);
-    return false;
+  // Frames that are not our ACK are skipped; keep listening until timeout.
+  while (_nextFrame(frame, startMs, timeout_ms)) {
+    bool ok = false;
+    if (_matchAck(frame, expected_seq, true, ok)) {
+      return ok;
+    }
   }
 
+  _adr.record(MESH_PEER_NODE_ID, false, 0.0f, 0.0f);
+  Serial.printf("[RX] No ACK received for seq=%u\n", expected_seq);
+  return false;
+}
+
+/**
+ * True when frame is the ACK for expected_seq; ok is whether its status
+ * was ACK_STATUS_OK. A PKT_NACK (the answer to PKT_RESUME) counts too and
+ * is kept for lastNack(); a plain ACK leaves lastNack() asking for every
+ * fragment. Any answer feeds ADR, and first sends the RTT estimate.
+ * verbose reports the frames that were skipped.
+ */
+// An answer counts only from the peer, to this node, in this session. With
+// several senders on the channel another one's ACK can carry the same seq.
+bool LoRaManager::_replyForUs(const LoRaHeader& hdr, const char* what, bool verbose) const {
+  if (hdr.dst_id == MESH_NODE_ID && hdr.src_id == MESH_PEER_NODE_ID && hdr.session_id == _session_id) {
+    return true;
+  }
+  if (verbose) {
+    Serial.printf("[RX] %s not for this link: src=0x%02X dst=0x%02X sess=0x%04X\n",
+                  what, hdr.src_id, hdr.dst_id, hdr.session_id);
+  }
+  return false;
+}
+
+bool LoRaManager::_matchAck(const LoRaRxFrame& frame, uint16_t expected_seq, bool verbose, bool& ok) {
   // Minimum valid packet = header + AckPayload
-  if (_radio.getPacketLength() < LORA_HEADER_SIZE + sizeof(AckPayload)) {
-    Serial.println("[RX] ACK packet too short");
+  if (frame.len < LORA_HEADER_SIZE + sizeof(AckPayload)) {
+    if (verbose) {
+      Serial.println("[RX] ACK packet too short");
+    }
     return false;
   }
 
   LoRaHeader hdr;
-  deserializeHeader(buf, &hdr);
+  deserializeHeader(frame.data, &hdr);
 
-  if (getType(hdr.ver_type) != PKT_ACK) {
-    Serial.printf("[RX] Expected ACK, got type 0x%02X\n", getType(hdr.ver_type));
+  const uint8_t type = getType(hdr.ver_type);
+  if (type != PKT_ACK && type != PKT_NACK) {
+    if (verbose) {
+      Serial.printf("[RX] Expected ACK, got type 0x%02X\n", type);
+    }
+    return false;
+  }
+  if (!_replyForUs(hdr, type == PKT_NACK ? "NACK" : "ACK", verbose)) {
     return false;
   }
 
   AckPayload ack;
-  memcpy(&ack, buf + LORA_HEADER_SIZE, sizeof(AckPayload));
+  deserializeAck(frame.data + LORA_HEADER_SIZE, &ack);
 
   if (ack.ack_seq != expected_seq) {
-    Serial.printf("[RX] ACK seq mismatch: got %u, expected %u\n",
-                  ack.ack_seq, expected_seq);
+    if (verbose) {
+      Serial.printf("[RX] ACK seq mismatch: got %u, expected %u\n",
+                    ack.ack_seq, expected_seq);
+    }
     return false;
   }
 
-  if (ack.status != ACK_STATUS_OK) {
+  if (type == PKT_NACK) {
+    if (!deserializeNack(frame.data + LORA_HEADER_SIZE, frame.len - LORA_HEADER_SIZE, &_nack)) {
+      if (verbose) {
+        Serial.println("[RX] NACK ranges truncated");
+      }
+      return false;
+    }
+  } else {
+    _nack = ResumeNack{};
+  }
+  _ackStatus = ack.status;
+
+  // Any answer means the frame crossed the link, whatever its status.
+  _adr.record(hdr.src_id, true, frame.snr, frame.rssi);
+  if (!_txResend) {
+    _rtt.sample(hdr.src_id, frame.rxMs - _txDoneMs);
+  }
+
+  ok = (ack.status == ACK_STATUS_OK);
+  if (!ok) {
     Serial.printf("[RX] ACK error status: 0x%02X\n", ack.status);
-    return false;
+    return true;
   }
 
   Serial.printf("[RX] ACK OK for seq=%u  RSSI=%.1f  SNR=%.1f\n",
-                ack.ack_seq, _radio.getRSSI(), _radio.getSNR());
+                ack.ack_seq, frame.rssi, frame.snr);
   return true;
 }
 
+void LoRaManager::armAck(uint16_t expected_seq) {
+  _ackSeq = expected_seq;
+  _ackWindow = false;
+  _ackArmUs = micros();
+  _ackWait = ACK_WAIT_PENDING;
+}
+
+void LoRaManager::armWindowAck(uint16_t base_seq) {
+  _ackSeq = base_seq;
+  _ackWindow = true;
+  _ackBitmap = 0;
+  _ackArmUs = micros();
+  _ackWait = ACK_WAIT_PENDING;
+}
+
+LoRaManager::AckWait LoRaManager::pollAck() {
+  service();
+  const AckWait result = _ackWait;
+  if (result == ACK_WAIT_OK || result == ACK_WAIT_REJECTED) {
+    PROFILE_RECORD(PROFILE_ACK_WAIT, micros() - _ackArmUs);
+    _ackWait = ACK_WAIT_IDLE;
+  }
+  return result;
+}
+
+void LoRaManager::cancelAck(bool timedOut) {
+  if (_ackWait != ACK_WAIT_PENDING) {
+    return;
+  }
+  _ackWait = ACK_WAIT_IDLE;
+  PROFILE_RECORD(PROFILE_ACK_WAIT, micros() - _ackArmUs);
+  if (timedOut) {
+    _adr.record(MESH_PEER_NODE_ID, false, 0.0f, 0.0f);
+    Serial.printf(_ackWindow ? "[RX] No WINDOW_ACK received for base=%u\n" : "[RX] No ACK received for seq=%u\n",
+                  _ackSeq);
+  }
+}
+
+/**
+ * Hand out the oldest queued frame, if any. Never blocks: RX stays armed
+ * in the background and DIO1 fills the queue.
+ */
 bool LoRaManager::receiveRaw(uint8_t* out, size_t out_size, size_t* received_len) {
   if (out == nullptr || out_size == 0) {
     return false;
   }
 
-  resetSPI();
-  // Keep RX polling responsive to avoid stalling the main loop.
-  int state = _radio.receive(out, out_size, 20);
-  if (state != RADIOLIB_ERR_NONE) {
+  LoRaRxFrame frame;
+  if (!_popFrame(frame)) {
     return false;
   }
 
-  size_t packet_len = static_cast<size_t>(_radio.getPacketLength());
+  const size_t packet_len = frame.len < out_size ? frame.len : out_size;
+  memcpy(out, frame.data, packet_len);
   if (received_len != nullptr) {
     *received_len = packet_len;
   }
@@ -259,28 +919,23 @@ bool LoRaManager::receiveRaw(uint8_t* out, size_t out_size, size_t* received_len
   return packet_len > 0;
 }
 
-bool LoRaManager::sendAckFor(const LoRaHeader& receivedHeader, uint8_t status) {
-  LoRaAudioPacket pkt;
-  memset(&pkt, 0, sizeof(pkt));
-
-  buildHeader(
-    &pkt.header,
-    PKT_ACK,
-    receivedHeader.dst_id,
-    receivedHeader.src_id,
-    receivedHeader.exp_id,
-    receivedHeader.session_id,
-    receivedHeader.seq_num,
-    MESH_LORA_TX_POWER_DBM,
-    MESH_LORA_SF,
-    MESH_LORA_CR
-  );
+bool LoRaManager::sendAckFor(const LoRaHeader& receivedHeader, uint8_t status, uint8_t* sentFrame) {
+  uint8_t* frame = _claimTxFrame("ACK");
+  if (frame == nullptr) {
+    return false;
+  }
+  _writeReplyHeader(frame, PKT_ACK, receivedHeader);
 
-  AckPayload& ack = pkt.payload.ack;
+  AckPayload ack;
   ack.ack_seq = receivedHeader.seq_num;
   ack.status = status;
+  serializeAck(&ack, frame + LORA_HEADER_SIZE);
+  // Copied before the send, which may compact the header in place.
+  if (sentFrame != nullptr) {
+    memcpy(sentFrame, frame, LORA_ACK_FRAME_SIZE);
+  }
 
-  int state = _sendPacket(&pkt, sizeof(AckPayload));
+  int state = _transmitFrame(frame, LORA_ACK_FRAME_SIZE, true);
   if (state == RADIOLIB_ERR_NONE) {
     Serial.printf("[TX] ACK sent for seq=%u status=0x%02X\n", ack.ack_seq, ack.status);
     return true;
@@ -289,3 +944,474 @@ bool LoRaManager::sendAckFor(const LoRaHeader& receivedHeader, uint8_t status) {
   Serial.printf("[TX] ACK send failed for seq=%u code=%d\n", ack.ack_seq, state);
   return false;
 }
+
+bool LoRaManager::resendReply(const uint8_t* frame, size_t len) {
+  if (frame == nullptr || len < LORA_HEADER_SIZE || len > LORA_MAX_PAYLOAD) {
+    return false;
+  }
+  uint8_t* out = _claimTxFrame("replay");
+  if (out == nullptr) {
+    return false;
+  }
+  memcpy(out, frame, len);
+
+  int state = _transmitFrame(out, len, true);
+  if (state == RADIOLIB_ERR_NONE) {
+    return true;
+  }
+  Serial.printf("[TX] Reply replay failed len=%u code=%d\n", static_cast<unsigned>(len), state);
+  return false;
+}
+
+
+/*
+  #     Fixed-seq DATA and selective repeat
+*/
+
+/**
+ * Reserve a contiguous block of sequence numbers for the DATA phase.
+ * Fragment i of the transfer is always sent as (first + i), so a
+ * retransmit reuses its original seq and the receiver can place it.
+ *
+ * @param count  Number of seqs to reserve
+ * @return First reserved seq
+ */
+uint16_t LoRaManager::reserveSeqRange(uint16_t count) {
+  const uint16_t first = _seq_num;
+  _seq_num = static_cast<uint16_t>(_seq_num + count);
+  return first;
+}
+
+/**
+ * Send a DATA fragment with an explicit seq. PKT_AUDIO_DATA gets a PKT_ACK
+ * per frame; PKT_AUDIO_DATA_WIN waits for the next PKT_WINDOW_POLL.
+ *
+ * @param seq   Seq from reserveSeqRange() for this fragment
+ * @param data  Pointer to raw audio bytes
+ * @param len   Number of bytes (must be <= LORA_MAX_DATA_PAYLOAD)
+ * @param type  PKT_AUDIO_DATA or PKT_AUDIO_DATA_WIN
+ */
+bool LoRaManager::sendAudioDataAt(uint16_t seq, const uint8_t* data, uint8_t len, uint8_t type) {
+  if (len > LORA_MAX_DATA_PAYLOAD) {
+    Serial.println("[TX] Data chunk too large");
+    return false;
+  }
+
+  uint8_t* frame = _claimTxFrame("AUDIO_DATA");
+  if (frame == nullptr) {
+    return false;
+  }
+  memcpy(frame + LORA_HEADER_SIZE, data, len);
+  return sendDataFrame(frame, seq, len, type);
+}
+
+/**
+ * Send PKT_WINDOW_POLL asking the receiver which seqs of the window
+ * [base_seq, base_seq + count) it holds.
+ */
+bool LoRaManager::sendWindowPoll(uint16_t base_seq, uint8_t count) {
+  if (count == 0 || count > LORA_MAX_WINDOW_SIZE) {
+    Serial.printf("[TX] Invalid window size %u\n", count);
+    return false;
+  }
+
+  uint8_t* frame = _claimTxFrame("WINDOW_POLL");
+  if (frame == nullptr) {
+    return false;
+  }
+  _writeHeader(frame, PKT_WINDOW_POLL, _seq_num++);
+
+  WindowPollPayload poll;
+  poll.base_seq = base_seq;
+  poll.count = count;
+  serializeWindowPoll(&poll, frame + LORA_HEADER_SIZE);
+
+  int state = _transmitFrame(frame, LORA_HEADER_SIZE + sizeof(WindowPollPayload));
+  if (state == RADIOLIB_ERR_NONE) {
+    Serial.printf("[TX] WINDOW_POLL base=%u count=%u sent\n", base_seq, count);
+  } else {
+    Serial.printf("[TX] WINDOW_POLL failed, code %d\n", state);
+  }
+  return state == RADIOLIB_ERR_NONE;
+}
+
+/**
+ * Block and wait for the PKT_WINDOW_ACK that answers a poll (armWindowAck()
+ * is the non-blocking form).
+ *
+ * @param base_seq    base_seq of the poll being answered
+ * @param timeout_ms  How long to wait in milliseconds
+ * @param bitmap      Out: bit i set = (base_seq + i) was received
+ * @return true if a matching ACK_STATUS_OK window ACK arrived
+ */
+bool LoRaManager::waitForWindowAck(uint16_t base_seq, uint32_t timeout_ms, uint32_t* bitmap) {
+  PROFILE_SCOPE(PROFILE_ACK_WAIT);
+  if (bitmap != nullptr) {
+    *bitmap = 0;
+  }
+
+  const uint32_t startMs = millis();
+  LoRaRxFrame frame;
+
+  while (_nextFrame(frame, startMs, timeout_ms)) {
+    bool ok = false;
+    if (_matchWindowAck(frame, base_seq, true, ok)) {
+      if (ok && bitmap != nullptr) {
+        *bitmap = _ackBitmap;
+      }
+      return ok;
+    }
+  }
+
+  _adr.record(MESH_PEER_NODE_ID, false, 0.0f, 0.0f);
+  Serial.printf("[RX] No WINDOW_ACK received for base=%u\n", base_seq);
+  return false;
+}
+
+/**
+ * True when frame is the PKT_WINDOW_ACK for the poll at base_seq; ok is
+ * whether its status was ACK_STATUS_OK, and then its bitmap is kept for
+ * lastWindowBitmap(). Any answer feeds ADR. verbose reports the frames
+ * that were skipped.
+ */
+bool LoRaManager::_matchWindowAck(const LoRaRxFrame& frame, uint16_t base_seq, bool verbose, bool& ok) {
+  if (frame.len < LORA_HEADER_SIZE + sizeof(WindowAckPayload)) {
+    if (verbose) {
+      Serial.println("[RX] WINDOW_ACK packet too short");
+    }
+    return false;
+  }
+
+  LoRaHeader hdr;
+  deserializeHeader(frame.data, &hdr);
+
+  if (getType(hdr.ver_type) != PKT_WINDOW_ACK) {
+    if (verbose) {
+      Serial.printf("[RX] Expected WINDOW_ACK, got type 0x%02X\n", getType(hdr.ver_type));
+    }
+    return false;
+  }
+  if (!_replyForUs(hdr, "WINDOW_ACK", verbose)) {
+    return false;
+  }
+
+  WindowAckPayload ack;
+  deserializeWindowAck(frame.data + LORA_HEADER_SIZE, &ack);
+
+  if (ack.base_seq != base_seq) {
+    if (verbose) {
+      Serial.printf("[RX] WINDOW_ACK base mismatch: got %u, expected %u\n",
+                    ack.base_seq, base_seq);
+    }
+    return false;
+  }
+
+  _adr.record(hdr.src_id, true, frame.snr, frame.rssi);
+
+  ok = (ack.status == ACK_STATUS_OK);
+  if (!ok) {
+    Serial.printf("[RX] WINDOW_ACK error status: 0x%02X\n", ack.status);
+    return true;
+  }
+
+  _ackBitmap = ack.bitmap;
+  Serial.printf("[RX] WINDOW_ACK base=%u bitmap=0x%08lX  RSSI=%.1f  SNR=%.1f\n",
+                ack.base_seq, static_cast<unsigned long>(ack.bitmap),
+                frame.rssi, frame.snr);
+  return true;
+}
+
+/**
+ * Answer a PKT_RESUME with what this node still lacks of the transfer.
+ * nack.head.ack_seq is set here; the rest comes from the reassembler.
+ */
+bool LoRaManager::sendNackFor(const LoRaHeader& resumeHeader, const ResumeNack& nack) {
+  uint8_t* frame = _claimTxFrame("NACK");
+  if (frame == nullptr) {
+    return false;
+  }
+  _writeReplyHeader(frame, PKT_NACK, resumeHeader);
+
+  ResumeNack out = nack;
+  out.head.ack_seq = resumeHeader.seq_num;
+  const size_t len = serializeNack(&out, frame + LORA_HEADER_SIZE);
+
+  int state = _transmitFrame(frame, LORA_HEADER_SIZE + len, true);
+  if (state == RADIOLIB_ERR_NONE) {
+    Serial.printf("[TX] NACK sent for seq=%u status=0x%02X held=%u ranges=%u covered=%u\n",
+                  out.head.ack_seq, out.head.status, out.head.received,
+                  out.head.range_count, out.head.covered);
+    return true;
+  }
+
+  Serial.printf("[TX] NACK send failed for seq=%u code=%d\n", out.head.ack_seq, state);
+  return false;
+}
+
+bool LoRaManager::sendWindowAckFor(const LoRaHeader& pollHeader, uint16_t base_seq,
+                                   uint32_t bitmap, uint8_t status) {
+  uint8_t* frame = _claimTxFrame("WINDOW_ACK");
+  if (frame == nullptr) {
+    return false;
+  }
+  _writeReplyHeader(frame, PKT_WINDOW_ACK, pollHeader);
+
+  WindowAckPayload ack;
+  ack.base_seq = base_seq;
+  ack.bitmap = bitmap;
+  ack.status = status;
+  serializeWindowAck(&ack, frame + LORA_HEADER_SIZE);
+
+  int state = _transmitFrame(frame, LORA_HEADER_SIZE + sizeof(WindowAckPayload), true);
+  if (state == RADIOLIB_ERR_NONE) {
+    Serial.printf("[TX] WINDOW_ACK sent base=%u bitmap=0x%08lX\n",
+                  base_seq, static_cast<unsigned long>(bitmap));
+    return true;
+  }
+
+  Serial.printf("[TX] WINDOW_ACK send failed base=%u code=%d\n", base_seq, state);
+  return false;
+}
+
+/*
+  #     Adaptive ACK timeout
+*/
+
+/**
+ * How long to wait for the ACK to the frame just sent, given it is
+ * attempt number attempt (0 = first send). Call right after the send.
+ * The floor is the modeled ACK airtime at the current rate plus the
+ * receiver's turnaround; ceilingMs is also the wait before any sample.
+ */
+uint32_t LoRaManager::ackWaitMs(uint8_t attempt, uint32_t ceilingMs) {
+#if MESH_RTO_ADAPTIVE
+  const float bwKhz = bwCodeToKhz(_rate.bwCode);
+  uint32_t floorMs = loraTimeOnAirMs(LORA_HEADER_SIZE + sizeof(AckPayload), _rate.sf, bwKhz, _rate.cr) +
+                     MESH_RTO_TURNAROUND_MS;
+#if MESH_ROUTING_ENABLE
+  // A resend inside a relay's duplicate window would be dropped there as a copy.
+  if (floorMs < MESH_DUP_WINDOW_MS) {
+    floorMs = MESH_DUP_WINDOW_MS;
+  }
+#endif
+  const uint32_t waitMs = _rtt.timeoutMs(MESH_PEER_NODE_ID, floorMs, ceilingMs, attempt);
+#else
+  const uint32_t waitMs = ceilingMs;
+#endif
+  // Logged from the send call, like rtt_ms, so the two columns compare directly.
+  _lastRtoMs = (_txDoneMs - _txStartMs) + waitMs;
+  return waitMs;
+}
+
+uint32_t LoRaManager::retryBackoffMs(uint8_t attempt) const {
+#if MESH_RTO_ADAPTIVE
+  return RttEstimator::backoffMs(attempt);
+#else
+  return MESH_RETRY_BACKOFF_BASE_MS;
+#endif
+}
+
+/*
+  #     Adaptive data rate
+*/
+
+bool LoRaManager::_rateSupported(const LoRaRate& rate) const {
+  return rate.sf >= 7 && rate.sf <= 12 &&
+         rate.cr >= 5 && rate.cr <= 8 &&
+         rate.bwCode <= LORA_BW_CODE_62_5 &&
+         rate.txPower >= -9 && rate.txPower <= 22;
+}
+
+// Slowest SF at which a full DATA frame and its ACK still fit the ACK wait.
+uint8_t LoRaManager::_maxSfForTimeout(uint32_t timeout_ms) const {
+  const float bwKhz = bwCodeToKhz(_rate.bwCode);
+  uint8_t sf = MESH_ADR_MAX_SF;
+  while (sf > _rate.sf) {
+    const uint32_t exchangeMs = loraTimeOnAirMs(LORA_MAX_PAYLOAD, sf, bwKhz, _rate.cr) +
+                                loraTimeOnAirMs(LORA_HEADER_SIZE + sizeof(AckPayload), sf, bwKhz, _rate.cr);
+    if (exchangeMs < timeout_ms) {
+      break;
+    }
+    sf--;
+  }
+  return sf;
+}
+
+/**
+ * Reprogram the modem. Only call once the peer has agreed (or for the
+ * fallback to the base rate, which both ends take on their own).
+ */
+bool LoRaManager::applyRate(const LoRaRate& rate) {
+  if (!_rateSupported(rate) || _radioState == RADIO_TX) {
+    return false;
+  }
+
+  int state = RADIOLIB_ERR_NONE;
+  {
+    SpiLease bus(SpiArbiter::RADIO);
+    if (!bus) {
+      return false;
+    }
+    _leaveDutyCycle();
+    _radio.standby();
+    state = _radio.setSpreadingFactor(rate.sf);
+    if (state == RADIOLIB_ERR_NONE) {
+      state = _radio.setBandwidth(bwCodeToKhz(rate.bwCode));
+    }
+    if (state == RADIOLIB_ERR_NONE) {
+      state = _radio.setCodingRate(rate.cr);
+    }
+    if (state == RADIOLIB_ERR_NONE) {
+      state = _radio.setOutputPower(rate.txPower);
+    }
+  }
+
+  if (state != RADIOLIB_ERR_NONE) {
+    Serial.printf("[ADR] Rate change failed, code %d; restoring SF%u\n", state, _rate.sf);
+    SpiLease bus(SpiArbiter::RADIO);
+    if (bus) {
+      _radio.setSpreadingFactor(_rate.sf);
+      _radio.setBandwidth(bwCodeToKhz(_rate.bwCode));
+      _radio.setCodingRate(_rate.cr);
+      _radio.setOutputPower(_rate.txPower);
+    }
+    startReceive();
+    return false;
+  }
+
+  _rate = rate;
+  _adr.resetAll();
+  _rtt.resetAll();
+  Serial.printf("[ADR] Rate SF%u BW%.1f CR4/%u %ddBm\n",
+                _rate.sf, static_cast<double>(bwCodeToKhz(_rate.bwCode)), _rate.cr, _rate.txPower);
+  return startReceive();
+}
+
+/**
+ * Propose next to the peer and switch once it confirms. The peer switches
+ * as soon as its CONFIRM is on air, so a lost CONFIRM leaves the two ends
+ * apart until both fall back to the base rate (MESH_ADR_FALLBACK_MS).
+ */
+bool LoRaManager::negotiateRate(const LoRaRate& next, uint32_t timeout_ms) {
+  if (!_rateSupported(next)) {
+    return false;
+  }
+
+  for (uint8_t attempt = 0; attempt < 2; ++attempt) {
+    uint8_t* frame = _claimTxFrame("RATE_CTRL");
+    if (frame == nullptr) {
+      return false;
+    }
+    const uint16_t seq = _seq_num++;
+    _writeHeader(frame, PKT_RATE_CTRL, seq);
+
+    RateCtrlPayload req;
+    req.op = RATE_OP_REQUEST;
+    req.sf = next.sf;
+    req.cr = next.cr;
+    req.bw_code = next.bwCode;
+    req.tx_pow = next.txPower;
+    serializeRateCtrl(&req, frame + LORA_HEADER_SIZE);
+
+    if (_transmitFrame(frame, LORA_HEADER_SIZE + sizeof(RateCtrlPayload)) != RADIOLIB_ERR_NONE) {
+      Serial.println("[ADR] RATE_CTRL request failed to send");
+      continue;
+    }
+    Serial.printf("[ADR] Proposed SF%u CR4/%u BW%.1f %ddBm (seq=%u)\n", next.sf, next.cr,
+                  static_cast<double>(bwCodeToKhz(next.bwCode)), next.txPower, seq);
+
+    const uint32_t startMs = millis();
+    LoRaRxFrame reply;
+    while (_nextFrame(reply, startMs, timeout_ms)) {
+      if (reply.len < LORA_HEADER_SIZE + sizeof(RateCtrlPayload)) {
+        continue;
+      }
+      LoRaHeader hdr;
+      deserializeHeader(reply.data, &hdr);
+      if (getType(hdr.ver_type) != PKT_RATE_CTRL || hdr.seq_num != seq ||
+          !_replyForUs(hdr, "RATE_CTRL", false)) {
+        continue;
+      }
+      RateCtrlPayload ans;
+      deserializeRateCtrl(reply.data + LORA_HEADER_SIZE, &ans);
+      if (ans.op == RATE_OP_CONFIRM) {
+        return applyRate(next);
+      }
+      Serial.printf("[ADR] Peer rejected the rate (op=0x%02X)\n", ans.op);
+      return false;
+    }
+    Serial.printf("[ADR] No RATE_CTRL reply for seq=%u\n", seq);
+  }
+  return false;
+}
+
+/**
+ * Answer a PKT_RATE_CTRL request at the current rate, then switch.
+ * @return true if the rate changed
+ */
+bool LoRaManager::handleRateCtrl(const LoRaHeader& hdr, const uint8_t* body, size_t len) {
+  if (body == nullptr || len < sizeof(RateCtrlPayload)) {
+    return false;
+  }
+  RateCtrlPayload req;
+  deserializeRateCtrl(body, &req);
+  if (req.op != RATE_OP_REQUEST) {
+    return false;
+  }
+
+  const LoRaRate next = {req.sf, req.cr, req.bw_code, req.tx_pow};
+#if MESH_RX_SESSIONS > 1
+  // The radio has one rate for every session in the table: moving it for
+  // one sender would cut the others off, so a shared receiver stays put.
+  const bool ok = _rateSupported(next) && next == _baseRate;
+#else
+  const bool ok = _rateSupported(next);
+#endif
+
+  uint8_t* frame = _claimTxFrame("RATE_CTRL reply");
+  if (frame == nullptr) {
+    return false;
+  }
+  _writeReplyHeader(frame, PKT_RATE_CTRL, hdr);
+  RateCtrlPayload ans = req;
+  ans.op = ok ? RATE_OP_CONFIRM : RATE_OP_REJECT;
+  serializeRateCtrl(&ans, frame + LORA_HEADER_SIZE);
+
+  const int state = _transmitFrame(frame, LORA_HEADER_SIZE + sizeof(RateCtrlPayload), true);
+  if (state != RADIOLIB_ERR_NONE) {
+    Serial.printf("[ADR] RATE_CTRL reply failed, code %d\n", state);
+    return false;
+  }
+  if (!ok) {
+    Serial.printf("[ADR] Rejected SF%u CR4/%u bw_code=%u %ddBm\n", req.sf, req.cr, req.bw_code, req.tx_pow);
+    return false;
+  }
+  return applyRate(next);
+}
+
+/**
+ * Between transfers: fall back to the base rate if the link went quiet,
+ * otherwise (MESH_ADR_ENABLE) ask RateController for the next step.
+ */
+bool LoRaManager::serviceAdr(uint32_t timeout_ms) {
+  if (_rate != _baseRate && millis() - _lastHeardMs >= MESH_ADR_FALLBACK_MS) {
+    Serial.println("[ADR] Link quiet, back to the base rate");
+    _lastHeardMs = millis();  // one fallback per quiet spell
+    return applyRate(_baseRate);
+  }
+
+#if MESH_ADR_ENABLE
+  LoRaRate next;
+  if (_adr.decide(MESH_PEER_NODE_ID, _rate, _maxSfForTimeout(timeout_ms), next)) {
+    RateController::PeerStats st;
+    if (_adr.stats(MESH_PEER_NODE_ID, st)) {
+      Serial.printf("[ADR] Window: ack=%u%% snr=%.1f rssi=%d over %u samples\n",
+                    st.ackPct, static_cast<double>(st.meanSnr), st.meanRssi, st.samples);
+    }
+    return negotiateRate(next, timeout_ms);
+  }
+#else
+  (void)timeout_ms;
+#endif
+  return false;
+}
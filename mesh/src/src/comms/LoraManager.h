@@ -2,6 +2,10 @@
 #include <RadioLib.h>
 #include "../storage/SdManager.h"
 #include "../models/packet.h"
+#include "RateController.h"
+#include "RttEstimator.h"
+#include "Airtime.h"
+#include "AirtimeScheduler.h"
 #include "../../mesh_role_config.h"
 
 // Heltec ESP32 LoRa V3 SX1262 pin mapping
@@ -43,31 +47,272 @@
 #define MESH_EXPERIMENT_ID 0x01
 #endif
 
+// Frames buffered between DIO1 and the sketch draining receiveRaw()
+#ifndef MESH_LORA_RX_QUEUE_DEPTH
+#define MESH_LORA_RX_QUEUE_DEPTH 4
+#endif
+
+// RadioLib sleeps MESH_LORA_WAKE_PREAMBLE - 2 * MESH_RX_WAKE_MIN_SYMBOLS symbols per cycle.
+#if MESH_RX_DUTY_CYCLE && MESH_LORA_WAKE_PREAMBLE <= 2 * MESH_RX_WAKE_MIN_SYMBOLS
+#error "MESH_LORA_WAKE_PREAMBLE must exceed 2 * MESH_RX_WAKE_MIN_SYMBOLS."
+#endif
+
+struct LoRaRxFrame {
+  uint8_t  data[LORA_MAX_PAYLOAD];
+  uint8_t  len;
+  float    rssi;
+  float    snr;
+  uint32_t rxMs;
+};
+
+typedef void (*LoRaTxDoneFn)(bool ok);
+typedef void (*LoRaRxFn)(const LoRaRxFrame& frame);
+typedef void (*LoRaIdleFn)();
+// Runs in service() as each frame comes off the radio; false = not queued.
+typedef bool (*LoRaRxFilterFn)(const LoRaRxFrame& frame);
+// Picks the next_hop for a frame bound for dst (LORA_BROADCAST_ID = flood).
+typedef uint8_t (*LoRaNextHopFn)(uint8_t dst);
+
 class LoRaManager {
     public:
         bool init(uint16_t *g_session_id, uint16_t *g_seq_num);
-        void resetSPI();
+        void setSession(uint16_t session_id, uint16_t seq_num);
 
         bool sendAudioStart(uint16_t total_frags, uint8_t codec,
                     uint16_t sample_hz, uint16_t duration_ms,
-                    uint32_t total_size);
+                    uint32_t total_size, uint8_t type = PKT_AUDIO_START);
         bool sendAudioData(const uint8_t* data, uint8_t len);
         bool sendAudioEnd(uint16_t frag_count, uint32_t full_crc32);
         bool waitForAck(uint16_t expected_seq, uint32_t timeout_ms);
         bool receiveRaw(uint8_t* out, size_t out_size, size_t* received_len = nullptr);
-        bool sendAckFor(const LoRaHeader& receivedHeader, uint8_t status = ACK_STATUS_OK);
+        // sentFrame (LORA_ACK_FRAME_SIZE bytes) gets a copy of the ACK once it is on air.
+        bool sendAckFor(const LoRaHeader& receivedHeader, uint8_t status = ACK_STATUS_OK,
+                        uint8_t* sentFrame = nullptr);
+        // PKT_NACK answer to a PKT_RESUME (MESH_RESUME_ENABLE).
+        bool sendNackFor(const LoRaHeader& resumeHeader, const ResumeNack& nack);
+        // Status of the last ACK matched, and the fragments its PKT_NACK
+        // asked for (all of them when it was a plain ACK).
+        uint8_t lastAckStatus() const { return _ackStatus; }
+        const ResumeNack& lastNack() const { return _nack; }
+        // Sends a reply frame built earlier, byte for byte (ACK replay for a retransmit).
+        bool resendReply(const uint8_t* frame, size_t len);
+
+        // Non-blocking waitForAck() for the event-driven sender: armAck()
+        // after the send, then pollAck() from loop() until it stops saying
+        // PENDING. The matching ACK is taken in service() and never queued;
+        // every other frame queues for receiveRaw() as usual. The caller owns
+        // the deadline; cancelAck(true) records the miss for ADR.
+        // armWindowAck() waits the same way for the PKT_WINDOW_ACK that
+        // answers a poll; its bitmap is lastWindowBitmap() once OK.
+        enum AckWait : uint8_t { ACK_WAIT_IDLE, ACK_WAIT_PENDING, ACK_WAIT_OK, ACK_WAIT_REJECTED };
+        void armAck(uint16_t expected_seq);
+        void armWindowAck(uint16_t base_seq);
+        uint32_t lastWindowBitmap() const { return _ackBitmap; }
+        AckWait pollAck();          // OK / REJECTED (error status) once, then IDLE
+        void cancelAck(bool timedOut);
+
+        // Fixed-seq DATA (fragment i = first + i) for retransmits and windows
+        uint16_t reserveSeqRange(uint16_t count);
+        bool sendAudioDataAt(uint16_t seq, const uint8_t* data, uint8_t len,
+                             uint8_t type = PKT_AUDIO_DATA);
+
+        // Zero-copy DATA: the payload is read straight into
+        // frame + LORA_HEADER_SIZE and the header written in place.
+        uint8_t* borrowTxFrame();   // nullptr while already borrowed
+        void releaseTxFrame();
+        bool sendDataFrame(uint8_t* frame, uint16_t seq, uint8_t len,
+                           uint8_t type = PKT_AUDIO_DATA);
+
+        // Selective-repeat (windowed) transfer
+        bool sendWindowPoll(uint16_t base_seq, uint8_t count);
+        bool waitForWindowAck(uint16_t base_seq, uint32_t timeout_ms, uint32_t* bitmap);
+        bool sendWindowAckFor(const LoRaHeader& pollHeader, uint16_t base_seq,
+                              uint32_t bitmap, uint8_t status = ACK_STATUS_OK);
+
+        // Non-blocking radio I/O, driven by the SX1262 DIO1 interrupt.
+        // service() does the SPI work the ISR flags; RX re-arms after every
+        // TX so the receiver stays open between transfers. hop is the node
+        // that must hear the frame (its next_hop), for the wake preamble.
+        bool startTransmit(const uint8_t* frame, size_t len, uint8_t hop = LORA_BROADCAST_ID);
+        bool startReceive();
+        void service();
+        bool isTxBusy() const { return _radioState == RADIO_TX; }
+        void onTxDone(LoRaTxDoneFn fn) { _txDoneFn = fn; }
+        void onReceive(LoRaRxFn fn) { _rxFn = fn; }
+        // Run while a blocking call waits on the air (TxDone, ACK, window ACK),
+        // e.g. to drain the SD log queue. Keep it short; it delays the wait's wake-up.
+        void onIdle(LoRaIdleFn fn) { _idleFn = fn; }
+        // Mesh hooks (see MeshRouter). Without them every frame is queued
+        // and next_hop is the destination itself.
+        void setRxFilter(LoRaRxFilterFn fn) { _rxFilterFn = fn; }
+        void setNextHopResolver(LoRaNextHopFn fn) { _nextHopFn = fn; }
+        uint8_t rxQueued() const { return _rxCount; }
+        uint32_t rxDropped() const { return _rxDropped; }
+        uint32_t rxFiltered() const { return _rxFiltered; }
+
+        // Channel access (MESH_LBT_ENABLE, MESH_RX_DUTY_CYCLE). cadBusy
+        // scans deferred a send; lbtForced sends went out on a busy channel
+        // after MESH_LBT_MAX_DEFERS. dutyCycleMs is time spent in duty-cycled
+        // RX, of which the radio listened about rxOnPermille() / 1000.
+        struct ListenStats {
+          uint32_t cadScans;
+          uint32_t cadBusy;
+          uint32_t lbtForced;
+          uint32_t dutyCycleEntries;
+          uint32_t dutyCycleMs;
+          uint32_t wakeFrames;     // sent with MESH_LORA_WAKE_PREAMBLE
+        };
+        ListenStats listenStats() const;
+        bool rxDutyCycled() const { return _dutyCycled; }
+        static constexpr uint32_t rxOnPermille() {
+          return 1000UL * (MESH_RX_WAKE_MIN_SYMBOLS + 1) /
+                 (MESH_LORA_WAKE_PREAMBLE - MESH_RX_WAKE_MIN_SYMBOLS + 1);
+        }
+        void printListenStats() const;
+
+        // Adaptive data rate. The MESH_LORA_* values are the base rate;
+        // serviceAdr() (between transfers) negotiates with MESH_PEER_NODE_ID
+        // and falls back to the base rate after MESH_ADR_FALLBACK_MS of
+        // silence. Receivers pass PKT_RATE_CTRL frames to handleRateCtrl().
+        const LoRaRate& rate() const { return _rate; }
+        const LoRaRate& baseRate() const { return _baseRate; }
+        bool applyRate(const LoRaRate& rate);
+        bool negotiateRate(const LoRaRate& next, uint32_t timeout_ms);
+        bool handleRateCtrl(const LoRaHeader& hdr, const uint8_t* body, size_t len);
+        bool serviceAdr(uint32_t timeout_ms);   // true if the rate changed
+        const RateController& adr() const { return _adr; }
+
+        // Adaptive ACK timeout (MESH_RTO_ADAPTIVE). waitForAck() feeds the
+        // peer's RTT estimate; after each send, ackWaitMs() is the wait to
+        // pass it and retryBackoffMs() the pause before the next attempt.
+        // lastRtoMs() is that deadline measured from the send, for the log.
+        uint32_t ackWaitMs(uint8_t attempt, uint32_t ceilingMs = MESH_ACK_TIMEOUT_MS);
+        uint32_t retryBackoffMs(uint8_t attempt) const;
+        uint32_t lastRtoMs() const { return _lastRtoMs; }
+        const RttEstimator& rtt() const { return _rtt; }
 
-        // Expose for logging after ACK
-        float getLastRSSI() { return _radio.getRSSI(); }
-        float getLastSNR() { return _radio.getSNR(); }
+        // Airtime (AirtimeScheduler). Every send waits out the TX gap and
+        // duty-cycle budget first; txWaitMs() is that wait for a len-byte
+        // relayed frame to hop, for callers that must not block (MeshRouter).
+        // lastToaMs() is the modeled time on air of the last frame started,
+        // lastTxMs() its measured send-to-TxDone time (0 if it failed).
+        uint32_t txWaitMs(size_t len, uint8_t hop = LORA_BROADCAST_ID) const;
+        uint32_t lastToaMs() const { return _lastToaMs; }
+        uint32_t lastTxMs() const { return _lastTxMs; }
+        const AirtimeScheduler& airtime() const { return _air; }
+
+        // Preamble of the next frame to hop (MESH_RX_DUTY_CYCLE): the wake
+        // preamble unless hop was heard from within MESH_LINK_IDLE_MS / 2,
+        // and always for a broadcast. service() feeds noteHeardFrom() every
+        // frame it takes off the radio.
+        uint16_t txPreamble(uint8_t hop) const;
+        void noteHeardFrom(const LoRaRxFrame& frame);
+
+        // How long the air is known to stay clear, for work that must not
+        // delay a frame or its ACK (StatusDisplay::service()): the rest of
+        // an airtime wait, or of the MESH_TX_GAP_MS a peer keeps after our
+        // reply before sending again. UINT32_MAX once nothing was heard or
+        // sent for MESH_LINK_IDLE_MS; 0 while a frame may be due any moment.
+        uint32_t quietMs() const;
+
+        // Expose for logging after ACK (values of the last frame handed out)
+        float getLastRSSI() { return _lastRssi; }
+        float getLastSNR() { return _lastSnr; }
+        uint32_t getLastRxMs() { return _lastRxMs; } // millis() when that frame was taken off the radio
         uint16_t getLastSeqNum() { return _seq_num - 1; } // Return the last sent seq num
+        uint16_t session() const { return _session_id; }
     private:
+      enum RadioState : uint8_t { RADIO_IDLE, RADIO_TX, RADIO_RX };
+
+      static void _onDio1();
+      static volatile bool _dio1Fired;
+
       // Radio obj
       SX1262 _radio = new Module(LORA_NSS, LORA_DIO1, LORA_NRST, LORA_BUSY);
 
       uint16_t _session_id;
       uint16_t _seq_num;
 
-      int  _sendPacket(const LoRaAudioPacket* pkt, size_t payload_len);
-      void _fillHeader(LoRaAudioPacket* pkt, uint8_t type);
+      volatile RadioState _radioState = RADIO_IDLE;
+      bool _txOk = false;
+      LoRaTxDoneFn _txDoneFn = nullptr;
+      LoRaRxFn _rxFn = nullptr;
+      LoRaIdleFn _idleFn = nullptr;
+      LoRaRxFilterFn _rxFilterFn = nullptr;
+      LoRaNextHopFn _nextHopFn = nullptr;
+
+      LoRaRxFrame _rxQueue[MESH_LORA_RX_QUEUE_DEPTH];
+      LoRaRxFrame _rxOverflow;     // a frame read while the queue is full, for an armed ACK wait
+      uint8_t _rxHead = 0;
+      uint8_t _rxCount = 0;
+      uint32_t _rxDropped = 0;
+      uint32_t _rxFiltered = 0;
+      float _lastRssi = 0.0f;
+      float _lastSnr = 0.0f;
+      uint32_t _lastRxMs = 0;
+      uint32_t _lastHeardMs = 0;   // last frame queued, for the ADR fallback
+      // Last frame from each neighbour (its prev_hop): may it be asleep?
+      struct HeardPeer {
+        uint8_t id;
+        uint32_t ms;
+      };
+      static constexpr uint8_t kHeardPeers = 8;
+      HeardPeer _heard[kHeardPeers] = {};
+      uint8_t _heardCount = 0;
+      uint32_t _radioActivityMs = 0;  // last RxDone or TxDone, for duty-cycled RX
+
+      ListenStats _listen = {};
+      bool _dutyCycled = false;    // RX armed in duty-cycled mode
+      uint32_t _dutyCycleStartMs = 0;
+      uint16_t _radioPreamble = LORA_PREAMBLE_SYMBOLS;
+
+      LoRaRate _baseRate = {MESH_LORA_SF, MESH_LORA_CR, bwKhzToCode(MESH_LORA_BW_KHZ), MESH_LORA_TX_POWER_DBM};
+      LoRaRate _rate = _baseRate;
+      RateController _adr;
+
+      RttEstimator _rtt;
+      uint32_t _txStartMs = 0;    // last _transmitFrame() call
+      uint32_t _txDoneMs = 0;     // and its TxDone
+      uint16_t _txSeq = 0;
+      uint16_t _txSession = 0;
+      bool _txResend = false;     // same session/seq as the frame before it
+      uint32_t _lastRtoMs = 0;
+
+      AirtimeScheduler _air;
+      uint32_t _paceUntilMs = 0;  // end of the airtime wait _transmitFrame() is in
+      bool _pacing = false;
+      bool _replyGap = false;     // last TX was a reply and nothing was heard since
+      uint32_t _lastToaMs = 0;
+      uint32_t _lastTxMs = 0;
+
+      // One TX frame for every send: the radio has a single frame in flight
+      // and startTransmit() copies it into the SX1262 FIFO before returning.
+      uint8_t _txFrame[LORA_MAX_PAYLOAD];
+      bool _txBorrowed = false;
+
+      AckWait _ackWait = ACK_WAIT_IDLE;
+      uint16_t _ackSeq = 0;        // ACK seq, or the poll's base_seq when _ackWindow
+      bool _ackWindow = false;
+      uint32_t _ackBitmap = 0;
+      uint8_t _ackStatus = ACK_STATUS_OK;
+      ResumeNack _nack = {};
+      uint32_t _ackArmUs = 0;
+
+      int  _transmitFrame(uint8_t* frame, size_t len, bool reply = false);
+      void _listenBeforeTalk(size_t len, uint8_t hop);
+      bool _linkIdle(uint32_t now) const;
+      void _leaveDutyCycle();
+      uint32_t _frameToaMs(size_t len, uint8_t hop) const;
+      bool _popFrame(LoRaRxFrame& frame);
+      bool _nextFrame(LoRaRxFrame& frame, uint32_t startMs, uint32_t timeout_ms);
+      bool _matchAck(const LoRaRxFrame& frame, uint16_t expected_seq, bool verbose, bool& ok);
+      bool _matchWindowAck(const LoRaRxFrame& frame, uint16_t base_seq, bool verbose, bool& ok);
+      bool _replyForUs(const LoRaHeader& hdr, const char* what, bool verbose) const;
+      uint8_t* _claimTxFrame(const char* what);
+      void _writeHeader(uint8_t* frame, uint8_t type, uint16_t seq);
+      void _writeReplyHeader(uint8_t* frame, uint8_t type, const LoRaHeader& to);
+      void _setHops(LoRaHeader& hdr) const;
+      LoRaHeaderDefaults _wireDefaults() const;
+      bool _rateSupported(const LoRaRate& rate) const;
+      uint8_t _maxSfForTimeout(uint32_t timeout_ms) const;
 };
\ No newline at end of file
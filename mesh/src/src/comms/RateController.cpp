@@ -0,0 +1,115 @@
+#include "RateController.h"
+
+RateController::PeerLink* RateController::_find(uint8_t peer) {
+  for (PeerLink& link : _links) {
+    if (link.used && link.peer == peer) {
+      return &link;
+    }
+  }
+  return nullptr;
+}
+
+const RateController::PeerLink* RateController::_find(uint8_t peer) const {
+  for (const PeerLink& link : _links) {
+    if (link.used && link.peer == peer) {
+      return &link;
+    }
+  }
+  return nullptr;
+}
+
+void RateController::record(uint8_t peer, bool acked, float snr, float rssi) {
+  const uint32_t nowMs = millis();
+  PeerLink* link = _find(peer);
+  if (link == nullptr) {
+    // Free slot, else the peer heard from least recently.
+    link = &_links[0];
+    for (PeerLink& candidate : _links) {
+      if (!candidate.used) {
+        link = &candidate;
+        break;
+      }
+      if (nowMs - candidate.lastMs > nowMs - link->lastMs) {
+        link = &candidate;
+      }
+    }
+    *link = PeerLink{};
+    link->peer = peer;
+    link->used = true;
+  }
+
+  Sample& s = link->samples[(link->head + link->count) % MESH_ADR_WINDOW];
+  s.acked = acked;
+  s.snr = snr;
+  s.rssi = static_cast<int16_t>(rssi);
+  if (link->count < MESH_ADR_WINDOW) {
+    link->count++;
+  } else {
+    link->head = static_cast<uint8_t>((link->head + 1) % MESH_ADR_WINDOW);
+  }
+  link->lastMs = nowMs;
+}
+
+void RateController::reset(uint8_t peer) {
+  PeerLink* link = _find(peer);
+  if (link != nullptr) {
+    link->head = 0;
+    link->count = 0;
+  }
+}
+
+void RateController::resetAll() {
+  for (PeerLink& link : _links) {
+    link.head = 0;
+    link.count = 0;
+  }
+}
+
+bool RateController::stats(uint8_t peer, PeerStats& out) const {
+  const PeerLink* link = _find(peer);
+  if (link == nullptr || link->count == 0) {
+    return false;
+  }
+
+  uint8_t acked = 0;
+  float snrSum = 0.0f;
+  int32_t rssiSum = 0;
+  for (uint8_t i = 0; i < link->count; ++i) {
+    const Sample& s = link->samples[(link->head + i) % MESH_ADR_WINDOW];
+    if (s.acked) {
+      acked++;
+      snrSum += s.snr;
+      rssiSum += s.rssi;
+    }
+  }
+  out.samples = link->count;
+  out.ackPct = static_cast<uint8_t>((acked * 100U) / link->count);
+  out.meanSnr = acked ? snrSum / acked : 0.0f;
+  out.meanRssi = acked ? static_cast<int16_t>(rssiSum / acked) : 0;
+  return true;
+}
+
+bool RateController::decide(uint8_t peer, const LoRaRate& current, uint8_t maxSf, LoRaRate& next) const {
+  PeerStats st;
+  if (!stats(peer, st) || st.samples < MESH_ADR_WINDOW) {
+    return false;
+  }
+
+  next = current;
+  if (st.ackPct < MESH_ADR_MIN_ACK_PCT) {
+    // Power first: it costs no airtime.
+    if (current.txPower + MESH_ADR_POWER_STEP_DB <= MESH_ADR_MAX_TX_POWER_DBM) {
+      next.txPower = static_cast<int8_t>(current.txPower + MESH_ADR_POWER_STEP_DB);
+    } else if (current.sf < maxSf) {
+      next.sf = static_cast<uint8_t>(current.sf + 1);
+    }
+  } else if (current.sf > MESH_ADR_MIN_SF &&
+             st.meanSnr - requiredSnrDb(current.sf - 1) >= MESH_ADR_SNR_MARGIN_DB) {
+    next.sf = static_cast<uint8_t>(current.sf - 1);
+  } else if (current.sf == MESH_ADR_MIN_SF &&
+             st.meanSnr - requiredSnrDb(current.sf) >= 2.0f * MESH_ADR_SNR_MARGIN_DB &&
+             current.txPower - MESH_ADR_POWER_STEP_DB >= MESH_ADR_MIN_TX_POWER_DBM) {
+    next.txPower = static_cast<int8_t>(current.txPower - MESH_ADR_POWER_STEP_DB);
+  }
+  return next != current;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "../models/packet.h"
+#include "../../mesh_role_config.h"
+
+/*
+ * RateController - adaptive data rate decisions from ACK outcomes
+ *
+ * Keeps the last MESH_ADR_WINDOW link samples (ACKed or not, SNR, RSSI)
+ * per peer and, once a window is full, proposes one step:
+ *
+ *   ACK rate < MESH_ADR_MIN_ACK_PCT      -> more TX power, then SF + 1
+ *   mean SNR clears the SF - 1 floor     -> SF - 1 (shorter time on air)
+ *     by MESH_ADR_SNR_MARGIN_DB
+ *   at the fastest SF with margin again  -> less TX power
+ *
+ * Only the decision lives here. LoRaManager applies it after the peer has
+ * confirmed it (PKT_RATE_CTRL) and resets the window, so every window
+ * measures a single rate.
+ */
+
+struct LoRaRate {
+  uint8_t sf;
+  uint8_t cr;        // RadioLib denominator (5..8)
+  uint8_t bwCode;    // LORA_BW_CODE_*
+  int8_t  txPower;   // dBm
+
+  bool operator==(const LoRaRate& o) const {
+    return sf == o.sf && cr == o.cr && bwCode == o.bwCode && txPower == o.txPower;
+  }
+  bool operator!=(const LoRaRate& o) const { return !(*this == o); }
+};
+
+class RateController {
+public:
+  struct PeerStats {
+    uint8_t samples;   // in the current window
+    uint8_t ackPct;
+    float   meanSnr;   // over ACKed samples
+    int16_t meanRssi;
+  };
+
+  /** SX126x demodulation floor for sf, in dB SNR (datasheet table 6-1). */
+  static float requiredSnrDb(uint8_t sf) { return -2.5f * (static_cast<float>(sf) - 4.0f); }
+
+  void record(uint8_t peer, bool acked, float snr, float rssi);
+  /** Start a fresh window for peer (after its rate changed). */
+  void reset(uint8_t peer);
+  void resetAll();
+
+  bool stats(uint8_t peer, PeerStats& out) const;
+
+  /**
+   * Next rate for peer, no slower than maxSf allows. False while the
+   * window is not full or the current rate is the right one.
+   */
+  bool decide(uint8_t peer, const LoRaRate& current, uint8_t maxSf, LoRaRate& next) const;
+
+private:
+  struct Sample {
+    float   snr;
+    int16_t rssi;
+    bool    acked;
+  };
+
+  struct PeerLink {
+    uint8_t  peer;
+    bool     used;
+    uint8_t  head;
+    uint8_t  count;
+    uint32_t lastMs;
+    Sample   samples[MESH_ADR_WINDOW];
+  };
+
+  PeerLink* _find(uint8_t peer);
+  const PeerLink* _find(uint8_t peer) const;
+
+  PeerLink _links[MESH_ADR_MAX_PEERS] = {};
+};
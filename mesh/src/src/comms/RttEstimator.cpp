@@ -0,0 +1,97 @@
+#include "RttEstimator.h"
+
+RttEstimator::PeerEntry* RttEstimator::_find(uint8_t peer) {
+  for (PeerEntry& e : _peers) {
+    if (e.used && e.peer == peer) {
+      return &e;
+    }
+  }
+  return nullptr;
+}
+
+const RttEstimator::PeerEntry* RttEstimator::_find(uint8_t peer) const {
+  for (const PeerEntry& e : _peers) {
+    if (e.used && e.peer == peer) {
+      return &e;
+    }
+  }
+  return nullptr;
+}
+
+void RttEstimator::sample(uint8_t peer, uint32_t rttMs) {
+  const uint32_t nowMs = millis();
+  PeerEntry* e = _find(peer);
+  if (e == nullptr) {
+    // Free slot, else the peer sampled least recently.
+    e = &_peers[0];
+    for (PeerEntry& candidate : _peers) {
+      if (!candidate.used) {
+        e = &candidate;
+        break;
+      }
+      if (nowMs - candidate.lastMs > nowMs - e->lastMs) {
+        e = &candidate;
+      }
+    }
+    *e = PeerEntry{};
+    e->peer = peer;
+    e->used = true;
+  }
+
+  if (e->samples == 0) {
+    e->srttMs = rttMs;
+    e->rttvarMs = rttMs / 2;
+  } else {
+    const uint32_t err = (rttMs > e->srttMs) ? rttMs - e->srttMs : e->srttMs - rttMs;
+    e->rttvarMs = (3 * e->rttvarMs + err + 2) / 4;
+    e->srttMs = (7 * e->srttMs + rttMs + 4) / 8;
+  }
+  if (e->samples < UINT16_MAX) {
+    e->samples++;
+  }
+  e->lastMs = nowMs;
+}
+
+void RttEstimator::resetAll() {
+  for (PeerEntry& e : _peers) {
+    e.samples = 0;
+  }
+}
+
+bool RttEstimator::stats(uint8_t peer, PeerRtt& out) const {
+  const PeerEntry* e = _find(peer);
+  if (e == nullptr || e->samples == 0) {
+    return false;
+  }
+  out.srttMs = e->srttMs;
+  out.rttvarMs = e->rttvarMs;
+  out.samples = e->samples;
+  return true;
+}
+
+uint32_t RttEstimator::timeoutMs(uint8_t peer, uint32_t floorMs, uint32_t ceilingMs, uint8_t attempt) const {
+  const PeerEntry* e = _find(peer);
+  if (e == nullptr || e->samples == 0) {
+    return ceilingMs;
+  }
+
+  uint32_t rto = e->srttMs + 4 * e->rttvarMs;
+  if (rto < floorMs) {
+    rto = floorMs;
+  }
+  for (uint8_t i = 0; i < attempt && rto < ceilingMs; ++i) {
+    rto *= 2;
+  }
+  return (rto < ceilingMs) ? rto : ceilingMs;
+}
+
+uint32_t RttEstimator::backoffMs(uint8_t attempt) {
+  uint32_t cap = MESH_RETRY_BACKOFF_BASE_MS;
+  for (uint8_t i = 0; i < attempt && cap < MESH_RETRY_BACKOFF_MAX_MS; ++i) {
+    cap *= 2;
+  }
+  if (cap > MESH_RETRY_BACKOFF_MAX_MS) {
+    cap = MESH_RETRY_BACKOFF_MAX_MS;
+  }
+  return cap / 2 + static_cast<uint32_t>(random(0, static_cast<long>(cap / 2) + 1));
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "../../mesh_role_config.h"
+
+/*
+ * RttEstimator - per-peer ACK round-trip estimate and retransmit timeout
+ *
+ * RFC 6298 smoothing over integer milliseconds:
+ *
+ *   first sample R   SRTT = R, RTTVAR = R / 2
+ *   then             RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|
+ *                    SRTT   = 7/8 SRTT   + 1/8 R
+ *   timeout          max(floor, SRTT + 4 * RTTVAR) * 2^attempt, <= ceiling
+ *
+ * A sample is the time from our TxDone to the ACK coming off the radio, so
+ * a 242-byte DATA frame and a 20-byte START share one estimate; the caller
+ * supplies the floor from the time-on-air model. Samples must come from
+ * first transmissions only (Karn): an ACK after a resend of the same seq
+ * could answer either copy.
+ *
+ * Until a peer has a sample the timeout is the ceiling, the fixed
+ * MESH_ACK_TIMEOUT_MS the link used before.
+ */
+class RttEstimator {
+public:
+  struct PeerRtt {
+    uint32_t srttMs;
+    uint32_t rttvarMs;
+    uint16_t samples;
+  };
+
+  void sample(uint8_t peer, uint32_t rttMs);
+  /** Forget every estimate (the rate changed, so every round trip did too). */
+  void resetAll();
+
+  bool stats(uint8_t peer, PeerRtt& out) const;
+
+  /** ACK wait for attempt (0 = first send), clamped to floorMs..ceilingMs. */
+  uint32_t timeoutMs(uint8_t peer, uint32_t floorMs, uint32_t ceilingMs, uint8_t attempt) const;
+
+  /**
+   * Pause before resend attempt + 1: MESH_RETRY_BACKOFF_BASE_MS * 2^attempt,
+   * capped at MESH_RETRY_BACKOFF_MAX_MS, drawn from the upper half of that
+   * so two senders that collided do not collide again.
+   */
+  static uint32_t backoffMs(uint8_t attempt);
+
+private:
+  struct PeerEntry {
+    uint8_t  peer;
+    bool     used;
+    uint16_t samples;
+    uint32_t srttMs;
+    uint32_t rttvarMs;
+    uint32_t lastMs;
+  };
+
+  PeerEntry* _find(uint8_t peer);
+  const PeerEntry* _find(uint8_t peer) const;
+
+  PeerEntry _peers[MESH_RTT_MAX_PEERS] = {};
+};
@@ -1,5 +1,8 @@
 #include "StatusDisplay.h"
 
+#include <stdio.h>
+#include <string.h>
+
 // ── Static member definitions ────────────────────────────────────
 // Heltec V3: I2C address 0x3C, SDA=17, SCL=18
 SSD1306Wire StatusDisplay::_display(0x3c, SDA_OLED, SCL_OLED, GEOMETRY_128_64, I2C_ONE, 500000);
@@ -8,20 +11,28 @@ bool              StatusDisplay::_sdGood    = false;
 StatusDisplay::LoRaState StatusDisplay::_loraState = StatusDisplay::LORA_FAIL;
 uint32_t StatusDisplay::_txCount   = 0;
 uint32_t StatusDisplay::_rxCount   = 0;
-String StatusDisplay::_message   = "";
-bool StatusDisplay::_dirty = false;
+FixedString<StatusDisplay::kMessageChars> StatusDisplay::_message;
+uint8_t  StatusDisplay::_dirty        = 0;
+uint32_t StatusDisplay::_lastFrameMs  = 0;
+bool     StatusDisplay::_blinkOn      = false;
+TaskHandle_t StatusDisplay::_renderTask = nullptr;
+StatusDisplay::View StatusDisplay::_view = {};
 
-bool StatusDisplay::shouldDeferRedraw() {
-  return _loraState == LORA_TRANSMITTING || _loraState == LORA_RECEIVING;
-}
+namespace {
+  constexpr uint32_t kBlinkMs = 300;
+
+  // Guards the state setters write and render() copies (MESH_DUAL_CORE).
+  portMUX_TYPE s_stateMux = portMUX_INITIALIZER_UNLOCKED;
+
+  // Row bands (y, height), each cleared on its own before it is redrawn.
+  constexpr int16_t kSdRowY = 16,       kSdRowH = 12;
+  constexpr int16_t kLoRaRowY = 30,     kLoRaRowH = 12;
+  constexpr int16_t kCounterRowY = 42,  kCounterRowH = 11;
+  constexpr int16_t kMessageRowY = 53,  kMessageRowH = 11;
 
-void StatusDisplay::requestRedraw(bool force) {
-  if (!force && shouldDeferRedraw()) {
-    _dirty = true;
-    return;
+  bool isBusy(StatusDisplay::LoRaState state) {
+    return state == StatusDisplay::LORA_TRANSMITTING || state == StatusDisplay::LORA_RECEIVING;
   }
-  _dirty = false;
-  redraw();
 }
 
 // ── Lifecycle ────────────────────────────────────────────────────
@@ -57,116 +68,219 @@ void StatusDisplay::init() {
   _display.display();
   delay(1200);
 
-  redraw();
+  refresh();
 }
 
-// ── Public Endpoints ─────────────────────────────────────────────
-void StatusDisplay::setSD(bool ok) {
-  _sdGood = ok;
-  requestRedraw();
-}
-
-void StatusDisplay::setLoRa(LoRaState state) {
-  const bool wasBusy = (_loraState == LORA_TRANSMITTING || _loraState == LORA_RECEIVING);
-  const bool willBeBusy = (state == LORA_TRANSMITTING || state == LORA_RECEIVING);
-
-  if (_loraState == state && willBeBusy) {
-    return;
+bool StatusDisplay::service(uint32_t quietMs) {
+  if (!mayRender()) {
+    return false;
   }
+  // The TX/RX indicator blinks, so its row changes with time alone.
+  const uint32_t now = millis();
+  portENTER_CRITICAL(&s_stateMux);
+  const bool blinkOn = isBusy(_loraState) && (now / kBlinkMs) % 2 == 0;
+  if (blinkOn != _blinkOn) {
+    _blinkOn = blinkOn;
+    _dirty |= DIRTY_LORA;
+  }
+  const uint8_t dirty = _dirty;
+  portEXIT_CRITICAL(&s_stateMux);
 
-  bool leavingBusy = (wasBusy && !willBeBusy);
-  _loraState = state;
-
-  if (willBeBusy) {
-    requestRedraw(true);
-    return;
+  // A full redraw (refresh() handed over by another task) skips the cap.
+  const bool capped = (now - _lastFrameMs < MESH_DISPLAY_FRAME_MS || quietMs < MESH_DISPLAY_RENDER_MS);
+  if (dirty == 0 || ((dirty & DIRTY_FULL) == 0 && capped)) {
+    return false;
   }
+  render();
+  return true;
+}
 
-  if (leavingBusy && _dirty) {
-    requestRedraw(true);
-    return;
+// ── Public Endpoints ─────────────────────────────────────────────
+void StatusDisplay::setSD(bool ok) {
+  portENTER_CRITICAL(&s_stateMux);
+  if (_sdGood != ok) {
+    _sdGood = ok;
+    _dirty |= DIRTY_SD;
   }
+  portEXIT_CRITICAL(&s_stateMux);
+}
 
-  requestRedraw();
+void StatusDisplay::setLoRa(LoRaState state) {
+  portENTER_CRITICAL(&s_stateMux);
+  if (_loraState != state) {
+    _loraState = state;
+    _dirty |= DIRTY_LORA;
+  }
+  portEXIT_CRITICAL(&s_stateMux);
 }
 
 void StatusDisplay::onPacketSent() {
+  portENTER_CRITICAL(&s_stateMux);
   _txCount++;
-  requestRedraw();
+  _dirty |= DIRTY_COUNTERS;
+  portEXIT_CRITICAL(&s_stateMux);
 }
 
 void StatusDisplay::onPacketReceived() {
+  portENTER_CRITICAL(&s_stateMux);
   _rxCount++;
-  requestRedraw();
+  _dirty |= DIRTY_COUNTERS;
+  portEXIT_CRITICAL(&s_stateMux);
 }
 
-void StatusDisplay::setMessage(const String& msg) {
-  _message = msg;
-  requestRedraw();
+void StatusDisplay::setMessage(const char* msg) {
+  if (msg == nullptr) {
+    msg = "";
+  }
+  portENTER_CRITICAL(&s_stateMux);
+  if (strncmp(_message.c_str(), msg, kMessageChars) != 0) {
+    _message.assign(msg);
+    _dirty |= DIRTY_MESSAGE;
+  }
+  portEXIT_CRITICAL(&s_stateMux);
 }
 
 void StatusDisplay::clearMessage() {
-  _message = "";
-  requestRedraw();
+  setMessage("");
 }
 
 void StatusDisplay::refresh() {
-  requestRedraw(true);
+  portENTER_CRITICAL(&s_stateMux);
+  _dirty |= DIRTY_FULL;
+  portEXIT_CRITICAL(&s_stateMux);
+  if (mayRender()) {
+    render();
+  }
 }
 
-// ── Private Redraw ───────────────────────────────────────────────
-void StatusDisplay::redraw() {
-  _display.clear();
-  _display.setTextAlignment(TEXT_ALIGN_LEFT);
+void StatusDisplay::setRenderTask(TaskHandle_t task) {
+  _renderTask = task;
+}
+
+bool StatusDisplay::mayRender() {
+  return _renderTask == nullptr || _renderTask == xTaskGetCurrentTaskHandle();
+}
+
+// ── Private Rendering ────────────────────────────────────────────
+void StatusDisplay::render() {
+  // Copy what changed and draw from the copy; the I2C push runs unlocked.
+  portENTER_CRITICAL(&s_stateMux);
+  uint8_t dirty = _dirty;
+  _dirty = 0;
+  _view.sdGood = _sdGood;
+  _view.loraState = _loraState;
+  _view.blinkOn = _blinkOn;
+  _view.txCount = _txCount;
+  _view.rxCount = _rxCount;
+  if (dirty & (DIRTY_MESSAGE | DIRTY_FULL)) {
+    _view.message = _message;
+  }
+  portEXIT_CRITICAL(&s_stateMux);
 
-  // ── Title bar ─────────────────────────────────
+  _display.setTextAlignment(TEXT_ALIGN_LEFT);
   _display.setFont(ArialMT_Plain_10);
-  _display.drawString(0, 0, "[ Node Status ]");
-  _display.drawLine(0, 12, 127, 12);
-
-  // ── SD Card row (y=16) ────────────────────────
-  _display.drawString(0, 16, "SD:");
-  if (_sdGood) {
-    _display.drawString(24, 16, "GOOD");
-    _display.fillRect(110, 16, 8, 8);   // solid square = OK
+
+  if (dirty & DIRTY_FULL) {
+    _display.clear();
+    // ── Title bar ─────────────────────────────────
+    drawText(0, 0, "[ Node Status ]");
+    _display.drawLine(0, 12, 127, 12);
+    dirty = DIRTY_SD | DIRTY_LORA | DIRTY_COUNTERS | DIRTY_MESSAGE;
+  }
+
+  if (dirty & DIRTY_SD) {
+    clearRow(kSdRowY, kSdRowH);
+    drawSdRow();
+  }
+  if (dirty & DIRTY_LORA) {
+    clearRow(kLoRaRowY, kLoRaRowH);
+    drawLoRaRow();
+  }
+  if (dirty & DIRTY_COUNTERS) {
+    clearRow(kCounterRowY, kCounterRowH);
+    drawCounterRow();
+  }
+  if (dirty & DIRTY_MESSAGE) {
+    clearRow(kMessageRowY, kMessageRowH);
+    drawMessageRow();
+  }
+
+  _display.display();
+  _lastFrameMs = millis();
+}
+
+void StatusDisplay::clearRow(int16_t y, int16_t height) {
+  _display.setColor(BLACK);
+  _display.fillRect(0, y, 128, height);
+  _display.setColor(WHITE);
+}
+
+// drawString() takes a String; feed it pieces that fit the inline buffer.
+// ASCII only, a piece boundary could split a UTF-8 sequence.
+void StatusDisplay::drawText(int16_t x, int16_t y, const char* text) {
+  char piece[kInlineChars + 1];
+  size_t len = strlen(text);
+  while (len > 0) {
+    const size_t n = (len < kInlineChars) ? len : kInlineChars;
+    memcpy(piece, text, n);
+    piece[n] = '\0';
+    _display.drawString(x, y, piece);
+    x = static_cast<int16_t>(x + _display.getStringWidth(piece, static_cast<uint16_t>(n)));
+    text += n;
+    len -= n;
+  }
+}
+
+// ── SD Card row (y=16) ────────────────────────
+void StatusDisplay::drawSdRow() {
+  _display.drawString(0, kSdRowY, "SD:");
+  if (_view.sdGood) {
+    _display.drawString(24, kSdRowY, "GOOD");
+    _display.fillRect(110, kSdRowY, 8, 8);   // solid square = OK
   } else {
-    _display.drawString(24, 16, "FAIL");
+    _display.drawString(24, kSdRowY, "FAIL");
     // Draw an X
-    _display.drawLine(110, 16, 118, 24);
-    _display.drawLine(118, 16, 110, 24);
+    _display.drawLine(110, kSdRowY, 118, kSdRowY + 8);
+    _display.drawLine(118, kSdRowY, 110, kSdRowY + 8);
   }
+}
 
-  // ── LoRa row (y=30) ───────────────────────────
-  _display.drawString(0, 30, "LoRa:");
-  switch (_loraState) {
+// ── LoRa row (y=30) ───────────────────────────
+void StatusDisplay::drawLoRaRow() {
+  _display.drawString(0, kLoRaRowY, "LoRa:");
+  switch (_view.loraState) {
     case LORA_OK_IDLE:
-      _display.drawString(38, 30, "IDLE");
-      _display.drawRect(110, 30, 8, 8);   // hollow square = idle
+      _display.drawString(38, kLoRaRowY, "IDLE");
+      _display.drawRect(110, kLoRaRowY, 8, 8);   // hollow square = idle
       break;
     case LORA_TRANSMITTING:
-      _display.drawString(38, 30, "TX >>>");
-      // Animate with a simple blink via millis parity
-      if ((millis() / 300) % 2 == 0) _display.fillRect(110, 30, 8, 8);
+      _display.drawString(38, kLoRaRowY, "TX >>>");
+      if (_view.blinkOn) _display.fillRect(110, kLoRaRowY, 8, 8);
       break;
     case LORA_RECEIVING:
-      _display.drawString(38, 30, "<<< RX");
-      if ((millis() / 300) % 2 == 0) _display.fillRect(110, 30, 8, 8);
+      _display.drawString(38, kLoRaRowY, "<<< RX");
+      if (_view.blinkOn) _display.fillRect(110, kLoRaRowY, 8, 8);
       break;
     case LORA_FAIL:
-      _display.drawString(38, 30, "FAIL");
-      _display.drawLine(110, 30, 118, 38);
-      _display.drawLine(118, 30, 110, 38);
+      _display.drawString(38, kLoRaRowY, "FAIL");
+      _display.drawLine(110, kLoRaRowY, 118, kLoRaRowY + 8);
+      _display.drawLine(118, kLoRaRowY, 110, kLoRaRowY + 8);
       break;
   }
+}
 
-  // ── Packet counters (y=44) ────────────────────
-  _display.drawString(0, 44, "TX:" + String(_txCount) + "  RX:" + String(_rxCount));
+// ── Packet counters (y=44) ────────────────────
+void StatusDisplay::drawCounterRow() {
+  char line[32];
+  snprintf(line, sizeof(line), "TX:%lu  RX:%lu",
+           static_cast<unsigned long>(_view.txCount), static_cast<unsigned long>(_view.rxCount));
+  drawText(0, 44, line);
+}
 
-  // ── Message line (y=54) ───────────────────────
-  if (_message.length() > 0) {
-    _display.drawLine(0, 53, 127, 53);
-    _display.drawString(0, 54, _message);
+// ── Message line (y=54) ───────────────────────
+void StatusDisplay::drawMessageRow() {
+  if (!_view.message.empty()) {
+    _display.drawLine(0, kMessageRowY, 127, kMessageRowY);
+    drawText(0, kMessageRowY + 1, _view.message.c_str());
   }
-
-  _display.display();
 }
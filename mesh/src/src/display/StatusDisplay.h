@@ -1,6 +1,9 @@
 #pragma once
 
+#include <Arduino.h>
 #include <SSD1306Wire.h>
+#include "../util/FixedString.h"
+#include "../../mesh_role_config.h"
 
 // ── OLED Pin Definitions for Heltec WiFi LoRa 32 V3 ──
 #define SDA_OLED 17
@@ -13,15 +16,29 @@
  *
  * Usage:
  *   1. Call StatusDisplay::init() once in setup()
- *   2. Call any status endpoint (setSD, setLoRa, etc.) anywhere in your code
- *   3. The display updates automatically on every set call
+ *   2. Call any status endpoint (setSD, setLoRa, etc.) anywhere in your code;
+ *      they only record the change and mark its row dirty
+ *   3. Call StatusDisplay::service() where the radio can spare the time
+ *      (idle loop, LoRaManager::onIdle hook) to draw the dirty rows
+ *
+ * service() draws at most one frame per MESH_DISPLAY_FRAME_MS and only
+ * with MESH_DISPLAY_RENDER_MS of quiet ahead, so an I2C flush never sits
+ * between a frame and its ACK. Only the rows that changed are cleared and
+ * redrawn (a packet touches just the counters row). Text is formatted
+ * into fixed buffers and handed to the driver in pieces short enough to
+ * stay off the heap.
+ *
+ * Setters may run on any task. With MESH_DUAL_CORE the worker is made the
+ * render task (setRenderTask): setters still only mark rows, render()
+ * draws from a copy of the state taken under a spinlock, and service()
+ * or refresh() on any other task leave the drawing to the worker.
  *
  * Example:
  *   StatusDisplay::init();
  *   StatusDisplay::setSD(true);
- *   StatusDisplay::setLoRa(StatusDisplay::IDLE);
- *   StatusDisplay::setLoRa(StatusDisplay::TRANSMITTING);
+ *   StatusDisplay::setLoRa(StatusDisplay::LORA_TRANSMITTING);
  *   StatusDisplay::setMessage("Joined network");
+ *   StatusDisplay::service(lora.quietMs());
  */
 
 class StatusDisplay {
@@ -35,6 +52,9 @@ public:
     LORA_FAIL           // Failed to initialize
   };
 
+  // quietMs for service() when no radio exchange is in progress.
+  static constexpr uint32_t kRadioIdle = UINT32_MAX;
+
   // ── Lifecycle ─────────────────────────────────────────────────
 
   /**
@@ -43,6 +63,14 @@ public:
    */
   static void init();
 
+  /**
+   * Draw the rows changed since the last frame, if the frame-rate cap
+   * allows and quietMs (the time the radio is known to stay clear, see
+   * LoRaManager::quietMs()) fits a render.
+   * @return true if a frame was pushed to the panel
+   */
+  static bool service(uint32_t quietMs = kRadioIdle);
+
   // ── Status Endpoints ──────────────────────────────────────────
 
   /**
@@ -58,7 +86,7 @@ public:
   static void setLoRa(LoRaState state);
 
   /**
-   * Increment the TX packet counter and briefly show TX animation.
+   * Increment the TX packet counter.
    * Call this each time a LoRa packet is successfully sent.
    */
   static void onPacketSent();
@@ -70,11 +98,11 @@ public:
   static void onPacketReceived();
 
   /**
-   * Display a temporary message on the bottom status line.
-   * Shown until the next call to any set* method or clearMessage().
+   * Display a message on the bottom status line until it is replaced
+   * or cleared. Copied into a fixed buffer; longer text is cut.
    * @param msg  Short string (fits ~21 chars at small font)
    */
-  static void setMessage(const String& msg);
+  static void setMessage(const char* msg);
 
   /**
    * Clear the bottom status message line.
@@ -82,15 +110,48 @@ public:
   static void clearMessage();
 
   /**
-   * Force a full redraw of the current state.
+   * Force a full redraw of the current state now, ignoring the frame cap.
    * Useful after waking from sleep or after display glitches.
    */
   static void refresh();
 
+  /**
+   * Only task draws from now on; nullptr (the default) lets any caller.
+   * refresh() on another task then marks a full redraw for it instead.
+   */
+  static void setRenderTask(TaskHandle_t task);
+
 private:
-  static bool shouldDeferRedraw();
-  static void requestRedraw(bool force = false);
-  static void redraw();
+  enum DirtyRow : uint8_t {
+    DIRTY_SD       = 1 << 0,
+    DIRTY_LORA     = 1 << 1,
+    DIRTY_COUNTERS = 1 << 2,
+    DIRTY_MESSAGE  = 1 << 3,
+    DIRTY_FULL     = 1 << 4,   // title bar and every row, from a cleared buffer
+  };
+
+  // The ESP32 core's String holds up to this many chars without the heap.
+  static constexpr size_t kInlineChars = 10;
+  static constexpr size_t kMessageChars = 31;
+
+  // What render() draws: the state as copied under the lock.
+  struct View {
+    bool      sdGood;
+    LoRaState loraState;
+    bool      blinkOn;
+    uint32_t  txCount;
+    uint32_t  rxCount;
+    FixedString<kMessageChars> message;
+  };
+
+  static bool mayRender();
+  static void render();
+  static void clearRow(int16_t y, int16_t height);
+  static void drawText(int16_t x, int16_t y, const char* text);
+  static void drawSdRow();
+  static void drawLoRaRow();
+  static void drawCounterRow();
+  static void drawMessageRow();
 
   static SSD1306Wire _display;
 
@@ -98,6 +159,10 @@ private:
   static LoRaState  _loraState;
   static uint32_t   _txCount;
   static uint32_t   _rxCount;
-  static String     _message;
-  static bool       _dirty;
+  static FixedString<kMessageChars> _message;
+  static uint8_t    _dirty;          // DirtyRow bits
+  static uint32_t   _lastFrameMs;
+  static bool       _blinkOn;
+  static TaskHandle_t _renderTask;
+  static View       _view;
 };
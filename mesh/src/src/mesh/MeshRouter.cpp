@@ -0,0 +1,224 @@
+#include "MeshRouter.h"
+
+LoRaManager* MeshRouter::_lora = nullptr;
+MeshRouter::Route MeshRouter::_routes[MESH_ROUTE_TABLE_SIZE] = {};
+uint8_t MeshRouter::_routeCount = 0;
+MeshRouter::DupEntry MeshRouter::_dups[MESH_DUP_CACHE_SIZE] = {};
+uint8_t MeshRouter::_dupCount = 0;
+MeshRouter::Forward MeshRouter::_fwd[MESH_FORWARD_QUEUE_DEPTH] = {};
+uint8_t MeshRouter::_fwdHead = 0;
+uint8_t MeshRouter::_fwdCount = 0;
+MeshRouter::Stats MeshRouter::_stats = {};
+
+void MeshRouter::begin(LoRaManager& lora) {
+#if !MESH_ROUTING_ENABLE
+  Serial.println("[MESH] Routing disabled (MESH_ROUTING_ENABLE=0), single hop");
+  return;
+#endif
+  _lora = &lora;
+  lora.setRxFilter(filter);
+  lora.setNextHopResolver(nextHopFor);
+}
+
+bool MeshRouter::filter(const LoRaRxFrame& frame) {
+  if (frame.len < LORA_HEADER_SIZE) {
+    _stats.runts++;
+    return false;
+  }
+
+  LoRaHeader hdr;
+  deserializeHeader(frame.data, &hdr);
+  if (hdr.src_id == MESH_NODE_ID) {
+    _stats.echoes++;
+    return false;
+  }
+
+  // Learn from everything heard, including frames for other nodes.
+  const uint32_t nowMs = millis();
+  const int16_t rssi = static_cast<int16_t>(frame.rssi);
+  const uint8_t hops = (hdr.ttl >= LORA_DEFAULT_TTL) ? 1 : static_cast<uint8_t>(LORA_DEFAULT_TTL - hdr.ttl + 1);
+  _learn(hdr.src_id, hdr.prev_hop, hops, rssi, nowMs);
+  if (hdr.prev_hop != hdr.src_id) {
+    _learn(hdr.prev_hop, hdr.prev_hop, 1, rssi, nowMs);
+  }
+
+  if (hdr.next_hop != MESH_NODE_ID && hdr.next_hop != LORA_BROADCAST_ID) {
+    _stats.overheard++;
+    return false;
+  }
+  if (_isDuplicate(hdr, nowMs)) {
+    _stats.duplicates++;
+    return false;
+  }
+
+  const bool forUs = (hdr.dst_id == MESH_NODE_ID);
+  const bool broadcast = (hdr.dst_id == LORA_BROADCAST_ID);
+  if (!forUs) {
+#if MESH_FORWARD_ENABLE
+    if (hdr.ttl > 1) {
+      _queueForward(frame, hdr, nowMs);
+    } else {
+      _stats.ttlExpired++;
+    }
+#endif
+  }
+  if (forUs || broadcast) {
+    _stats.delivered++;
+    return true;
+  }
+  return false;
+}
+
+uint8_t MeshRouter::nextHopFor(uint8_t dst) {
+  if (dst == LORA_BROADCAST_ID) {
+    return LORA_BROADCAST_ID;
+  }
+  const uint32_t nowMs = millis();
+  for (uint8_t i = 0; i < _routeCount; ++i) {
+    const Route& r = _routes[i];
+    if (r.dest == dst && nowMs - r.seenMs < MESH_ROUTE_TIMEOUT_MS) {
+      return r.nextHop;
+    }
+  }
+  return LORA_BROADCAST_ID;
+}
+
+void MeshRouter::service() {
+  if (_lora == nullptr || _fwdCount == 0) {
+    return;
+  }
+
+  Forward& f = _fwd[_fwdHead];
+  const uint32_t nowMs = millis();
+  if (static_cast<int32_t>(nowMs - f.readyMs) < 0) {
+    return;
+  }
+
+  bool done = false;
+  if (nowMs - f.readyMs > MESH_DUP_WINDOW_MS) {
+    // The origin is about to retransmit anyway; this copy would only add to it.
+    _stats.stale++;
+    done = true;
+  } else if (!_lora->isTxBusy() && _lora->txWaitMs(f.len, f.nextHop) == 0 &&
+             _lora->startTransmit(f.data, f.len, f.nextHop)) {
+    // Over the airtime budget the frame stays queued, and goes stale above.
+    _stats.forwarded++;
+    done = true;
+  }
+
+  if (done) {
+    _fwdHead = static_cast<uint8_t>((_fwdHead + 1) % MESH_FORWARD_QUEUE_DEPTH);
+    _fwdCount--;
+  }
+}
+
+// Keep the shorter (or equally short, fresher) path; the oldest entry makes room.
+void MeshRouter::_learn(uint8_t dest, uint8_t nextHop, uint8_t hops, int16_t rssi, uint32_t nowMs) {
+  if (dest == MESH_NODE_ID || dest == LORA_BROADCAST_ID) {
+    return;
+  }
+
+  Route* slot = nullptr;
+  for (uint8_t i = 0; i < _routeCount; ++i) {
+    if (_routes[i].dest == dest) {
+      slot = &_routes[i];
+      break;
+    }
+  }
+
+  if (slot != nullptr) {
+    const bool expired = (nowMs - slot->seenMs >= MESH_ROUTE_TIMEOUT_MS);
+    if (!expired && hops > slot->hops && nextHop != slot->nextHop) {
+      return;
+    }
+  } else if (_routeCount < MESH_ROUTE_TABLE_SIZE) {
+    slot = &_routes[_routeCount++];
+  } else {
+    slot = &_routes[0];
+    for (uint8_t i = 1; i < _routeCount; ++i) {
+      if (nowMs - _routes[i].seenMs > nowMs - slot->seenMs) {
+        slot = &_routes[i];
+      }
+    }
+  }
+
+  slot->dest = dest;
+  slot->nextHop = nextHop;
+  slot->hops = hops;
+  slot->rssi = rssi;
+  slot->seenMs = nowMs;
+}
+
+// Records the frame as seen. A match older than MESH_DUP_WINDOW_MS is an
+// end-to-end retransmission and passes, restarting the window.
+bool MeshRouter::_isDuplicate(const LoRaHeader& hdr, uint32_t nowMs) {
+  DupEntry* oldest = nullptr;
+  for (uint8_t i = 0; i < _dupCount; ++i) {
+    DupEntry& e = _dups[i];
+    if (e.src == hdr.src_id && e.session == hdr.session_id && e.seq == hdr.seq_num) {
+      if (nowMs - e.seenMs < MESH_DUP_WINDOW_MS) {
+        return true;
+      }
+      e.seenMs = nowMs;
+      return false;
+    }
+    if (oldest == nullptr || nowMs - e.seenMs > nowMs - oldest->seenMs) {
+      oldest = &e;
+    }
+  }
+
+  DupEntry* slot = (_dupCount < MESH_DUP_CACHE_SIZE) ? &_dups[_dupCount++] : oldest;
+  slot->src = hdr.src_id;
+  slot->session = hdr.session_id;
+  slot->seq = hdr.seq_num;
+  slot->seenMs = nowMs;
+  return false;
+}
+
+bool MeshRouter::_queueForward(const LoRaRxFrame& frame, const LoRaHeader& hdr, uint32_t nowMs) {
+  if (_fwdCount == MESH_FORWARD_QUEUE_DEPTH) {
+    _stats.queueFull++;
+    return false;
+  }
+
+  Forward& f = _fwd[(_fwdHead + _fwdCount) % MESH_FORWARD_QUEUE_DEPTH];
+  memcpy(f.data, frame.data, frame.len);
+  f.len = frame.len;
+
+  LoRaHeader out = hdr;
+  out.ttl = static_cast<uint8_t>(hdr.ttl - 1);
+  out.prev_hop = MESH_NODE_ID;
+  out.next_hop = nextHopFor(hdr.dst_id);
+  serializeHeader(&out, f.data);
+  f.nextHop = out.next_hop;
+
+  f.readyMs = nowMs + static_cast<uint32_t>(random(0, MESH_FORWARD_JITTER_MS + 1));
+  _fwdCount++;
+  return true;
+}
+
+void MeshRouter::printStats() {
+  Serial.printf("[MESH] delivered=%lu forwarded=%lu dup=%lu echo=%lu overheard=%lu ttl=%lu runt=%lu qfull=%lu stale=%lu pending=%u routes=%u\n",
+                static_cast<unsigned long>(_stats.delivered),
+                static_cast<unsigned long>(_stats.forwarded),
+                static_cast<unsigned long>(_stats.duplicates),
+                static_cast<unsigned long>(_stats.echoes),
+                static_cast<unsigned long>(_stats.overheard),
+                static_cast<unsigned long>(_stats.ttlExpired),
+                static_cast<unsigned long>(_stats.runts),
+                static_cast<unsigned long>(_stats.queueFull),
+                static_cast<unsigned long>(_stats.stale),
+                static_cast<unsigned>(_fwdCount),
+                static_cast<unsigned>(_routeCount));
+}
+
+void MeshRouter::printRoutes() {
+  const uint32_t nowMs = millis();
+  for (uint8_t i = 0; i < _routeCount; ++i) {
+    const Route& r = _routes[i];
+    Serial.printf("[MESH] route 0x%02X via 0x%02X hops=%u rssi=%d age=%lums%s\n",
+                  r.dest, r.nextHop, r.hops, r.rssi,
+                  static_cast<unsigned long>(nowMs - r.seenMs),
+                  (nowMs - r.seenMs >= MESH_ROUTE_TIMEOUT_MS) ? " (expired)" : "");
+  }
+}
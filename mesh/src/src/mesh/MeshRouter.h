@@ -0,0 +1,106 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+#include "../comms/LoraManager.h"
+#include "../models/packet.h"
+#include "../../mesh_role_config.h"
+
+/*
+ * MeshRouter - multi-hop forwarding over the v2 header
+ *
+ * src_id/dst_id name the two ends of a transfer; next_hop/prev_hop/ttl
+ * change on every hop. MeshRouter installs itself as LoRaManager's RX
+ * filter, so each frame is classified as it comes off the radio:
+ *
+ *   runt, own frame echoed back             -> dropped
+ *   next_hop is another node                -> dropped (overheard)
+ *   (src, session, seq) seen in the window  -> dropped (duplicate)
+ *   dst is this node or broadcast           -> queued for the sketch
+ *   otherwise, ttl > 1                      -> copied to the forward queue
+ *
+ * Every frame heard also refreshes the route table: src is reachable via
+ * prev_hop in (LORA_DEFAULT_TTL - ttl + 1) hops, and prev_hop is a direct
+ * neighbour. LoRaManager asks nextHopFor() when it writes a header; an
+ * unknown destination gets LORA_BROADCAST_ID, so the first frames of a
+ * transfer flood and the replies come back on learned routes.
+ *
+ * The filter is a few fixed-size table scans and no SPI, so it runs inside
+ * LoRaManager::service(). Forwards go out from MeshRouter::service(), once
+ * the jitter delay has passed and the radio is free.
+ *
+ * Usage:
+ *   lora.init(...);
+ *   MeshRouter::begin(lora);
+ *   // loop():
+ *   lora.service();
+ *   MeshRouter::service();
+ */
+class MeshRouter {
+public:
+  struct Route {
+    uint8_t  dest;
+    uint8_t  nextHop;
+    uint8_t  hops;
+    int16_t  rssi;      // of the last frame that refreshed the route
+    uint32_t seenMs;
+  };
+
+  struct Stats {
+    uint32_t delivered;    // queued for the sketch
+    uint32_t forwarded;    // relayed copies put on air
+    uint32_t duplicates;
+    uint32_t echoes;       // our own frames relayed back to us
+    uint32_t overheard;    // next_hop was another node
+    uint32_t ttlExpired;
+    uint32_t runts;        // shorter than a header
+    uint32_t queueFull;    // forward dropped, queue had no room
+    uint32_t stale;        // forward dropped, radio never came free in time
+  };
+
+  /** Install the RX filter and next-hop resolver on lora (no-op unless MESH_ROUTING_ENABLE). */
+  static void begin(LoRaManager& lora);
+
+  /** LoRaRxFilterFn: true = deliver to the sketch. */
+  static bool filter(const LoRaRxFrame& frame);
+
+  /** LoRaNextHopFn: learned next hop for dst, or LORA_BROADCAST_ID. */
+  static uint8_t nextHopFor(uint8_t dst);
+
+  /** Transmit the next due forward if the radio is idle. Call from loop(). */
+  static void service();
+
+  static uint8_t forwardPending() { return _fwdCount; }
+  static const Stats& stats() { return _stats; }
+  static void printStats();
+  static void printRoutes();
+
+private:
+  struct DupEntry {
+    uint8_t  src;
+    uint16_t session;
+    uint16_t seq;
+    uint32_t seenMs;
+  };
+
+  struct Forward {
+    uint8_t  data[LORA_MAX_PAYLOAD];
+    uint8_t  len;
+    uint8_t  nextHop;
+    uint32_t readyMs;
+  };
+
+  static void _learn(uint8_t dest, uint8_t nextHop, uint8_t hops, int16_t rssi, uint32_t nowMs);
+  static bool _isDuplicate(const LoRaHeader& hdr, uint32_t nowMs);
+  static bool _queueForward(const LoRaRxFrame& frame, const LoRaHeader& hdr, uint32_t nowMs);
+
+  static LoRaManager* _lora;
+  static Route _routes[MESH_ROUTE_TABLE_SIZE];
+  static uint8_t _routeCount;
+  static DupEntry _dups[MESH_DUP_CACHE_SIZE];
+  static uint8_t _dupCount;
+  static Forward _fwd[MESH_FORWARD_QUEUE_DEPTH];
+  static uint8_t _fwdHead;
+  static uint8_t _fwdCount;
+  static Stats _stats;
+};
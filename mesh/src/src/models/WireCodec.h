@@ -0,0 +1,123 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+
+/*
+ * wire - little-endian field codec for the packet structs
+ *
+ * A struct goes on air through a Layout that lists its fields, each with
+ * a fixed wire offset. encode() and decode() move one field at a time with
+ * shifts, so the bytes do not depend on the struct's padding or on the
+ * CPU's byte order. Every layout is checked at compile time: the fields
+ * must cover [0, kSize) in order, with no gap and no overlap.
+ *
+ * The packet structs stay #pragma pack(1) and the frame builders still use
+ * sizeof() for frame lengths, so packet.cpp also checks each kSize against
+ * its struct.
+ *
+ * Usage:
+ *   WIRE_FIELD(AckSeq, AckPayload, ack_seq, 0);
+ *   WIRE_FIELD(AckStatus, AckPayload, status, 2);
+ *   using AckLayout = wire::Layout<3, AckSeq, AckStatus>;
+ *   AckLayout::encode(ack, frame + LORA_HEADER_SIZE);
+ */
+namespace wire {
+
+template <typename T>
+inline void putLe(uint8_t* buf, T value) {
+  static_assert(std::is_integral<T>::value, "wire fields are integers");
+  using U = typename std::make_unsigned<T>::type;
+  U bits = static_cast<U>(value);
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    buf[i] = static_cast<uint8_t>(bits & 0xFFU);
+    bits = static_cast<U>(bits >> 8);
+  }
+}
+
+template <typename T>
+inline T getLe(const uint8_t* buf) {
+  static_assert(std::is_integral<T>::value, "wire fields are integers");
+  using U = typename std::make_unsigned<T>::type;
+  U bits = 0;
+  for (size_t i = sizeof(T); i-- > 0;) {
+    bits = static_cast<U>((bits << 8) | buf[i]);
+  }
+  return static_cast<T>(bits);
+}
+
+// LEB128 for a 16-bit value: 7 bits per byte, low group first, 1..3 bytes.
+constexpr size_t kVarint16Max = 3;
+
+constexpr size_t varint16Size(uint16_t value) {
+  return value < 0x80U ? 1 : (value < 0x4000U ? 2 : 3);
+}
+
+inline size_t putVarint16(uint8_t* buf, uint16_t value) {
+  size_t n = 0;
+  while (value >= 0x80U) {
+    buf[n++] = static_cast<uint8_t>(value | 0x80U);
+    value = static_cast<uint16_t>(value >> 7);
+  }
+  buf[n++] = static_cast<uint8_t>(value);
+  return n;
+}
+
+/** Bytes read, or 0 if the varint is cut off by len or does not fit 16 bits. */
+inline size_t getVarint16(const uint8_t* buf, size_t len, uint16_t& value) {
+  uint32_t acc = 0;
+  for (size_t n = 0; n < len && n < kVarint16Max; ++n) {
+    acc |= static_cast<uint32_t>(buf[n] & 0x7FU) << (7 * n);
+    if ((buf[n] & 0x80U) == 0) {
+      if (acc > 0xFFFFU) {
+        return 0;
+      }
+      value = static_cast<uint16_t>(acc);
+      return n + 1;
+    }
+  }
+  return 0;
+}
+
+// Fields of a Layout must tile [0, size) in the order they are listed.
+template <typename... Fields>
+constexpr bool tiles(size_t size) {
+  size_t at = 0;
+  bool ok = true;
+  ((ok = ok && Fields::kOffset == at, at = Fields::kEnd), ...);
+  return ok && at == size;
+}
+
+template <size_t Size, typename... Fields>
+struct Layout {
+  static_assert(tiles<Fields...>(Size), "wire layout has a gap, an overlap or a field out of order");
+  static constexpr size_t kSize = Size;
+
+  template <typename S>
+  static void encode(const S& s, uint8_t* buf) {
+    (Fields::put(s, buf), ...);
+  }
+  template <typename S>
+  static void decode(const uint8_t* buf, S& s) {
+    (Fields::get(buf, s), ...);
+  }
+};
+
+}  // namespace wire
+
+// Declares Name, the integer field S::member at wire byte offset. Fields are
+// read and written by value, never through a pointer or reference, so
+// members of packed structs are safe on cores that trap unaligned access.
+#define WIRE_FIELD(Name, S, member, offset)                                     \
+  struct Name {                                                                 \
+    using Type = decltype(S::member);                                           \
+    static constexpr size_t kOffset = (offset);                                 \
+    static constexpr size_t kEnd = (offset) + sizeof(Type);                     \
+    static void put(const S& s, uint8_t* buf) {                                 \
+      wire::putLe<Type>(buf + (offset), s.member);                              \
+    }                                                                           \
+    static void get(const uint8_t* buf, S& s) {                                 \
+      s.member = wire::getLe<Type>(buf + (offset));                             \
+    }                                                                           \
+  }
@@ -1,4 +1,5 @@
 #include "packet.h"
+#include "WireCodec.h"
 
 // ─── Header builder ───────────────────────────────────────────────────────────
 
@@ -22,60 +23,349 @@ void buildHeader(
   hdr->seq_num = seq;
   hdr->tx_pow = tx_pow;
   hdr->sf_cr = makeSFCR(sf, cr);
+  // Single hop until a router picks a next hop (see MeshRouter).
+  hdr->next_hop = dst;
+  hdr->prev_hop = src;
+  hdr->ttl = LORA_DEFAULT_TTL;
 }
 
+// ─── Wire layouts ─────────────────────────────────────────────────────────────
 
-// ─── CRC ─────────────────────────────────────────────────────────────────────
+namespace {
 
-uint16_t crc16(const uint8_t* data, size_t len) {
-  uint16_t crc = 0xFFFF;
-  for (size_t i = 0; i < len; i++) {
-    crc ^= (uint16_t)data[i] << 8;
-    for (uint8_t j = 0; j < 8; j++) {
-      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1);
-    }
-  }
-  return crc;
-}
+// v2 header, LORA_HEADER_SIZE bytes
+WIRE_FIELD(HdrVerType, LoRaHeader, ver_type, 0);
+WIRE_FIELD(HdrSrc, LoRaHeader, src_id, 1);
+WIRE_FIELD(HdrDst, LoRaHeader, dst_id, 2);
+WIRE_FIELD(HdrExp, LoRaHeader, exp_id, 3);
+WIRE_FIELD(HdrSession, LoRaHeader, session_id, 4);
+WIRE_FIELD(HdrSeq, LoRaHeader, seq_num, 6);
+WIRE_FIELD(HdrTxPow, LoRaHeader, tx_pow, 8);
+WIRE_FIELD(HdrSfCr, LoRaHeader, sf_cr, 9);
+WIRE_FIELD(HdrNextHop, LoRaHeader, next_hop, 10);
+WIRE_FIELD(HdrPrevHop, LoRaHeader, prev_hop, 11);
+WIRE_FIELD(HdrTtl, LoRaHeader, ttl, 12);
 
-uint32_t crc32(const uint8_t* data, size_t len) {
-  uint32_t crc = 0xFFFFFFFF;
-  for (size_t i = 0; i < len; i++) {
-    crc ^= data[i];
-    for (uint8_t j = 0; j < 8; j++) {
-      crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : (crc >> 1);
-    }
-  }
-  return ~crc;
-}
+template <uint8_t Version> struct HeaderLayout;
+template <> struct HeaderLayout<2>
+    : wire::Layout<13, HdrVerType, HdrSrc, HdrDst, HdrExp, HdrSession, HdrSeq, HdrTxPow, HdrSfCr,
+                   HdrNextHop, HdrPrevHop, HdrTtl> {};
+using Header = HeaderLayout<LORA_PROTOCOL_VERSION>;
+
+WIRE_FIELD(StartFrags, AudioStartPayload, total_frags, 0);
+WIRE_FIELD(StartCodec, AudioStartPayload, codec_id, 2);
+WIRE_FIELD(StartHz, AudioStartPayload, sample_hz, 3);
+WIRE_FIELD(StartDuration, AudioStartPayload, duration_ms, 5);
+WIRE_FIELD(StartSize, AudioStartPayload, total_size, 7);
+WIRE_FIELD(StartCrc, AudioStartPayload, crc16, 11);
+using Start = wire::Layout<13, StartFrags, StartCodec, StartHz, StartDuration, StartSize, StartCrc>;
+
+WIRE_FIELD(EndFrags, AudioEndPayload, frag_count, 0);
+WIRE_FIELD(EndCrc, AudioEndPayload, crc32, 2);
+WIRE_FIELD(EndReserved, AudioEndPayload, reserved, 6);
+using End = wire::Layout<7, EndFrags, EndCrc, EndReserved>;
+
+WIRE_FIELD(AckSeq, AckPayload, ack_seq, 0);
+WIRE_FIELD(AckStatus, AckPayload, status, 2);
+using Ack = wire::Layout<3, AckSeq, AckStatus>;
+
+WIRE_FIELD(PollBase, WindowPollPayload, base_seq, 0);
+WIRE_FIELD(PollCount, WindowPollPayload, count, 2);
+using Poll = wire::Layout<3, PollBase, PollCount>;
 
+WIRE_FIELD(WackBase, WindowAckPayload, base_seq, 0);
+WIRE_FIELD(WackBitmap, WindowAckPayload, bitmap, 2);
+WIRE_FIELD(WackStatus, WindowAckPayload, status, 6);
+using WindowAck = wire::Layout<7, WackBase, WackBitmap, WackStatus>;
+
+WIRE_FIELD(RateOp, RateCtrlPayload, op, 0);
+WIRE_FIELD(RateSf, RateCtrlPayload, sf, 1);
+WIRE_FIELD(RateCr, RateCtrlPayload, cr, 2);
+WIRE_FIELD(RateBw, RateCtrlPayload, bw_code, 3);
+WIRE_FIELD(RatePow, RateCtrlPayload, tx_pow, 4);
+using RateCtrl = wire::Layout<5, RateOp, RateSf, RateCr, RateBw, RatePow>;
+
+WIRE_FIELD(ParityBlock, FecParityPayload, block_frag, 0);
+WIRE_FIELD(ParityData, FecParityPayload, data_count, 2);
+WIRE_FIELD(ParityIndex, FecParityPayload, parity_index, 3);
+WIRE_FIELD(ParityCount, FecParityPayload, parity_count, 4);
+using FecParity = wire::Layout<5, ParityBlock, ParityData, ParityIndex, ParityCount>;
+
+WIRE_FIELD(NackSeq, NackPayload, ack_seq, 0);
+WIRE_FIELD(NackStatus, NackPayload, status, 2);
+WIRE_FIELD(NackReceived, NackPayload, received, 3);
+WIRE_FIELD(NackCovered, NackPayload, covered, 5);
+WIRE_FIELD(NackCount, NackPayload, range_count, 7);
+using Nack = wire::Layout<8, NackSeq, NackStatus, NackReceived, NackCovered, NackCount>;
+
+WIRE_FIELD(RangeFirst, NackRange, first_frag, 0);
+WIRE_FIELD(RangeCount, NackRange, count, 2);
+using NackRangeLayout = wire::Layout<4, RangeFirst, RangeCount>;
+
+}  // namespace
+
+// Frame lengths are still LORA_HEADER_SIZE + sizeof(payload struct).
+static_assert(Header::kSize == LORA_HEADER_SIZE && Header::kSize == sizeof(LoRaHeader),
+              "v2 header layout does not match LORA_HEADER_SIZE");
+static_assert(Start::kSize == sizeof(AudioStartPayload), "AudioStartPayload layout changed");
+static_assert(End::kSize == sizeof(AudioEndPayload), "AudioEndPayload layout changed");
+static_assert(Ack::kSize == sizeof(AckPayload), "AckPayload layout changed");
+static_assert(Poll::kSize == sizeof(WindowPollPayload), "WindowPollPayload layout changed");
+static_assert(WindowAck::kSize == sizeof(WindowAckPayload), "WindowAckPayload layout changed");
+static_assert(RateCtrl::kSize == sizeof(RateCtrlPayload), "RateCtrlPayload layout changed");
+static_assert(FecParity::kSize == sizeof(FecParityPayload) && FecParity::kSize == LORA_FEC_HEADER_SIZE,
+              "FecParityPayload layout changed");
+static_assert(Nack::kSize == LORA_NACK_HEADER_SIZE && NackRangeLayout::kSize == LORA_NACK_RANGE_SIZE,
+              "NackPayload / NackRange layout changed");
+static_assert(LORA_COMPACT_HEADER_MAX == 6 + wire::kVarint16Max + 6, "compact header bound changed");
 
 // ─── Serialization ────────────────────────────────────────────────────────────
 
 void serializeHeader(const LoRaHeader* hdr, uint8_t* buf) {
-  memcpy(buf, hdr, LORA_HEADER_SIZE);
+  Header::encode(*hdr, buf);
 }
 
 void deserializeHeader(const uint8_t* buf, LoRaHeader* hdr) {
-  memcpy(hdr, buf, LORA_HEADER_SIZE);
+  Header::decode(buf, *hdr);
 }
 
 void serializeAudioStart(const AudioStartPayload* payload, uint8_t* buf) {
-  memcpy(buf, payload, sizeof(AudioStartPayload));
+  Start::encode(*payload, buf);
 }
 
 void deserializeAudioStart(const uint8_t* buf, AudioStartPayload* payload) {
-  memcpy(payload, buf, sizeof(AudioStartPayload));
+  Start::decode(buf, *payload);
 }
 
 void serializeAudioEnd(const AudioEndPayload* payload, uint8_t* buf) {
-  memcpy(buf, payload, sizeof(AudioEndPayload));
+  End::encode(*payload, buf);
 }
 
 void deserializeAudioEnd(const uint8_t* buf, AudioEndPayload* payload) {
-  memcpy(payload, buf, sizeof(AudioEndPayload));
+  End::decode(buf, *payload);
+}
+
+void serializeAck(const AckPayload* payload, uint8_t* buf) {
+  Ack::encode(*payload, buf);
+}
+
+void deserializeAck(const uint8_t* buf, AckPayload* payload) {
+  Ack::decode(buf, *payload);
 }
 
+void serializeWindowPoll(const WindowPollPayload* payload, uint8_t* buf) {
+  Poll::encode(*payload, buf);
+}
+
+void deserializeWindowPoll(const uint8_t* buf, WindowPollPayload* payload) {
+  Poll::decode(buf, *payload);
+}
+
+void serializeWindowAck(const WindowAckPayload* payload, uint8_t* buf) {
+  WindowAck::encode(*payload, buf);
+}
+
+void deserializeWindowAck(const uint8_t* buf, WindowAckPayload* payload) {
+  WindowAck::decode(buf, *payload);
+}
+
+void serializeRateCtrl(const RateCtrlPayload* payload, uint8_t* buf) {
+  RateCtrl::encode(*payload, buf);
+}
+
+void deserializeRateCtrl(const uint8_t* buf, RateCtrlPayload* payload) {
+  RateCtrl::decode(buf, *payload);
+}
+
+void serializeFecParity(const FecParityPayload* payload, uint8_t* buf) {
+  FecParity::encode(*payload, buf);
+}
+
+void deserializeFecParity(const uint8_t* buf, FecParityPayload* payload) {
+  FecParity::decode(buf, *payload);
+}
+
+size_t serializeNack(const ResumeNack* nack, uint8_t* buf) {
+  const uint8_t count = nack->head.range_count < LORA_MAX_NACK_RANGES ? nack->head.range_count
+                                                                      : LORA_MAX_NACK_RANGES;
+  NackPayload head = nack->head;
+  head.range_count = count;
+  Nack::encode(head, buf);
+  for (uint8_t i = 0; i < count; ++i) {
+    NackRangeLayout::encode(nack->ranges[i], buf + Nack::kSize + i * NackRangeLayout::kSize);
+  }
+  return Nack::kSize + count * NackRangeLayout::kSize;
+}
+
+bool deserializeNack(const uint8_t* buf, size_t len, ResumeNack* nack) {
+  if (len < Nack::kSize) {
+    return false;
+  }
+  Nack::decode(buf, nack->head);
+  if (nack->head.range_count > LORA_MAX_NACK_RANGES ||
+      len < Nack::kSize + nack->head.range_count * NackRangeLayout::kSize) {
+    return false;
+  }
+  for (uint8_t i = 0; i < nack->head.range_count; ++i) {
+    NackRangeLayout::decode(buf + Nack::kSize + i * NackRangeLayout::kSize, nack->ranges[i]);
+  }
+  return true;
+}
+
+// ─── NACK ranges ──────────────────────────────────────────────────────────────
+
+bool nackMissing(const ResumeNack& nack, uint16_t frag) {
+  if (frag >= nack.head.covered) {
+    return true;
+  }
+  for (uint8_t i = 0; i < nack.head.range_count; ++i) {
+    const NackRange& r = nack.ranges[i];
+    if (frag >= r.first_frag && static_cast<uint32_t>(frag) < static_cast<uint32_t>(r.first_frag) + r.count) {
+      return true;
+    }
+  }
+  return false;
+}
+
+uint16_t nackNextMissing(const ResumeNack& nack, uint16_t from, uint16_t totalFrags) {
+  for (uint8_t i = 0; i < nack.head.range_count && from < nack.head.covered; ++i) {
+    const NackRange& r = nack.ranges[i];
+    const uint32_t end = static_cast<uint32_t>(r.first_frag) + r.count;
+    if (from < end) {
+      const uint16_t next = from > r.first_frag ? from : r.first_frag;
+      return next < totalFrags ? next : totalFrags;
+    }
+  }
+  // Past the listed ranges: held up to covered, missing from there on.
+  const uint16_t next = from > nack.head.covered ? from : nack.head.covered;
+  return next < totalFrags ? next : totalFrags;
+}
+
+uint16_t nackMissingCount(const ResumeNack& nack, uint16_t totalFrags) {
+  uint32_t missing = 0;
+  for (uint8_t i = 0; i < nack.head.range_count; ++i) {
+    const NackRange& r = nack.ranges[i];
+    const uint32_t limit = nack.head.covered < totalFrags ? nack.head.covered : totalFrags;
+    const uint32_t end = static_cast<uint32_t>(r.first_frag) + r.count;
+    if (r.first_frag < limit) {
+      missing += (end < limit ? end : limit) - r.first_frag;
+    }
+  }
+  if (nack.head.covered < totalFrags) {
+    missing += totalFrags - nack.head.covered;
+  }
+  return static_cast<uint16_t>(missing < totalFrags ? missing : totalFrags);
+}
+
+// ─── Compact header ───────────────────────────────────────────────────────────
+//
+//   ver_type  (version LORA_COMPACT_VERSION, type as in v2)
+//   flags     LORA_COMPACT_HAS_*
+//   src_id, dst_id
+//   session_id (2, little-endian)
+//   seq_num   (varint, 1..3)
+//   exp_id, tx_pow, sf_cr          each only if its flag is set
+//   next_hop, prev_hop, ttl        only with LORA_COMPACT_HAS_HOPS
+//
+// Hops are left out when they are the single-hop values buildHeader() sets.
+
+size_t encodeCompactHeader(const LoRaHeader* hdr, const LoRaHeaderDefaults& d, uint8_t* buf) {
+  uint8_t flags = 0;
+  flags |= (hdr->exp_id != d.exp_id) ? LORA_COMPACT_HAS_EXP : 0;
+  flags |= (hdr->tx_pow != d.tx_pow) ? LORA_COMPACT_HAS_POW : 0;
+  flags |= (hdr->sf_cr != d.sf_cr) ? LORA_COMPACT_HAS_SFCR : 0;
+  if (hdr->next_hop != hdr->dst_id || hdr->prev_hop != hdr->src_id || hdr->ttl != LORA_DEFAULT_TTL) {
+    flags |= LORA_COMPACT_HAS_HOPS;
+  }
+
+  size_t n = 0;
+  buf[n++] = makeVerType(LORA_COMPACT_VERSION, getType(hdr->ver_type));
+  buf[n++] = flags;
+  buf[n++] = hdr->src_id;
+  buf[n++] = hdr->dst_id;
+  wire::putLe<uint16_t>(buf + n, hdr->session_id);
+  n += sizeof(uint16_t);
+  n += wire::putVarint16(buf + n, hdr->seq_num);
+  if (flags & LORA_COMPACT_HAS_EXP)  buf[n++] = hdr->exp_id;
+  if (flags & LORA_COMPACT_HAS_POW)  buf[n++] = hdr->tx_pow;
+  if (flags & LORA_COMPACT_HAS_SFCR) buf[n++] = hdr->sf_cr;
+  if (flags & LORA_COMPACT_HAS_HOPS) {
+    buf[n++] = hdr->next_hop;
+    buf[n++] = hdr->prev_hop;
+    buf[n++] = hdr->ttl;
+  }
+  return n;
+}
+
+size_t decodeCompactHeader(const uint8_t* buf, size_t len, const LoRaHeaderDefaults& d, LoRaHeader* hdr) {
+  if (len < LORA_COMPACT_HEADER_MIN || getVersion(buf[0]) != LORA_COMPACT_VERSION ||
+      (buf[1] & ~LORA_COMPACT_FLAGS_MASK) != 0) {
+    return 0;
+  }
+  const uint8_t flags = buf[1];
+  hdr->ver_type = makeVerType(LORA_PROTOCOL_VERSION, getType(buf[0]));
+  hdr->src_id = buf[2];
+  hdr->dst_id = buf[3];
+  hdr->session_id = wire::getLe<uint16_t>(buf + 4);
+  size_t n = 6;
+  const size_t seqLen = wire::getVarint16(buf + n, len - n, hdr->seq_num);
+  if (seqLen == 0) {
+    return 0;
+  }
+  n += seqLen;
+
+  const size_t optional = ((flags & LORA_COMPACT_HAS_EXP) ? 1 : 0) + ((flags & LORA_COMPACT_HAS_POW) ? 1 : 0) +
+                          ((flags & LORA_COMPACT_HAS_SFCR) ? 1 : 0) + ((flags & LORA_COMPACT_HAS_HOPS) ? 3 : 0);
+  if (len - n < optional) {
+    return 0;
+  }
+  hdr->exp_id = (flags & LORA_COMPACT_HAS_EXP) ? buf[n++] : d.exp_id;
+  hdr->tx_pow = (flags & LORA_COMPACT_HAS_POW) ? buf[n++] : d.tx_pow;
+  hdr->sf_cr = (flags & LORA_COMPACT_HAS_SFCR) ? buf[n++] : d.sf_cr;
+  if (flags & LORA_COMPACT_HAS_HOPS) {
+    hdr->next_hop = buf[n++];
+    hdr->prev_hop = buf[n++];
+    hdr->ttl = buf[n++];
+  } else {
+    hdr->next_hop = hdr->dst_id;
+    hdr->prev_hop = hdr->src_id;
+    hdr->ttl = LORA_DEFAULT_TTL;
+  }
+  return n;
+}
+
+size_t expandCompactFrame(uint8_t* frame, size_t len, const LoRaHeaderDefaults& d) {
+  LoRaHeader hdr;
+  const size_t hdrLen = decodeCompactHeader(frame, len, d, &hdr);
+  if (hdrLen == 0) {
+    return 0;
+  }
+  const size_t body = len - hdrLen;
+  if (LORA_HEADER_SIZE + body > LORA_MAX_PAYLOAD) {
+    return 0;
+  }
+  memmove(frame + LORA_HEADER_SIZE, frame + hdrLen, body);
+  serializeHeader(&hdr, frame);
+  return LORA_HEADER_SIZE + body;
+}
+
+
+const char* packetTypeLabel(uint8_t type) {
+  switch (type) {
+    case PKT_AUDIO_START:    return "START";
+    case PKT_AUDIO_DATA:     return "DATA";
+    case PKT_AUDIO_END:      return "END";
+    case PKT_ACK:            return "ACK";
+    case PKT_AUDIO_DATA_WIN: return "DATA";
+    case PKT_AUDIO_PARITY:   return "PARITY";
+    case PKT_WINDOW_POLL:    return "POLL";
+    case PKT_WINDOW_ACK:     return "WACK";
+    case PKT_RATE_CTRL:      return "RATE";
+    case PKT_RESUME:         return "RESUME";
+    case PKT_NACK:           return "NACK";
+    default:                 return "UNKNOWN";
+  }
+}
 
 // ─── Debug printing ───────────────────────────────────────────────────────────
 
@@ -92,6 +382,9 @@ void printHeader(const LoRaHeader* hdr) {
   Serial.printf("  TX Power   : %d dBm\n",   hdr->tx_pow);
   Serial.printf("  SF         : %d\n",        getSF(hdr->sf_cr));
   Serial.printf("  CR         : 4/%d\n",      getCodingRate(hdr->sf_cr));  // fixed: was getCR()
+  Serial.printf("  Next Hop   : 0x%02X\n",   hdr->next_hop);
+  Serial.printf("  Prev Hop   : 0x%02X\n",   hdr->prev_hop);
+  Serial.printf("  TTL        : %d\n",        hdr->ttl);
   Serial.println(F("-------------------"));
 }
 
@@ -1,17 +1,35 @@
 #pragma once
 #include <Arduino.h>
 #include <stdint.h>
+#include "../util/Crc.h"  // crc16 / crc32 used by the packet builders
 
-// Packet format for our audio file transfer
-#define LORA_PROTOCOL_VERSION 1
+// Packet format for our audio file transfer.
+// v2 adds the mesh hop fields (next_hop, prev_hop, ttl); v1 frames are dropped.
+// Every struct below goes on air little-endian through its wire::Layout in
+// packet.cpp, whose offsets are checked at compile time.
+#define LORA_PROTOCOL_VERSION 2
+
+// Compact header: the v2 fields with the per-link constants left out (see
+// encodeCompactHeader). Receivers expand it back to v2 before anything
+// else looks at the frame; senders use it with MESH_WIRE_COMPACT.
+#define LORA_COMPACT_VERSION 3
+#define LORA_COMPACT_HEADER_MIN 7    // ver_type, flags, src, dst, session, 1-byte seq
+#define LORA_COMPACT_HEADER_MAX 15   // 3-byte seq and every optional field
+
+// Compact header flags: the field follows because it differs from the default
+#define LORA_COMPACT_HAS_EXP 0x01
+#define LORA_COMPACT_HAS_POW 0x02
+#define LORA_COMPACT_HAS_SFCR 0x04
+#define LORA_COMPACT_HAS_HOPS 0x08   // next_hop, prev_hop, ttl
+#define LORA_COMPACT_FLAGS_MASK 0x0F
 
 // Defines what type of audio file is being sent
 #define CODEC_RAW_PCM 0x00
-#define CODEC_COMPRESSED 0x01
+#define CODEC_COMPRESSED 0x01   // IMA-ADPCM, one block per DATA fragment (src/codec/ImaAdpcm.h)
 
 // LoRa protocol constraints
 #define LORA_MAX_PAYLOAD 255
-#define LORA_HEADER_SIZE 10
+#define LORA_HEADER_SIZE 13
 #define LORA_MAX_DATA_PAYLOAD (LORA_MAX_PAYLOAD - LORA_HEADER_SIZE)
 
 // Packet type enums
@@ -19,6 +37,45 @@
 #define PKT_AUDIO_DATA 0x02
 #define PKT_AUDIO_END 0x03
 #define PKT_ACK 0x04
+#define PKT_AUDIO_DATA_WIN 0x05   // windowed DATA fragment, not ACKed individually
+#define PKT_WINDOW_POLL 0x06      // end of a burst, requests a PKT_WINDOW_ACK
+#define PKT_WINDOW_ACK 0x07       // cumulative + bitmap ACK for a window
+#define PKT_RATE_CTRL 0x08        // ADR: propose / confirm a new SF, BW, CR, TX power
+#define PKT_AUDIO_PARITY 0x09     // FEC: XOR parity over a window's DATA fragments
+#define PKT_RESUME 0x0A           // reopen an interrupted transfer; AudioStartPayload body
+#define PKT_NACK 0x0B             // answers PKT_RESUME: fragments the receiver still lacks
+
+// Mesh addressing: src_id/dst_id are end to end, next_hop/prev_hop per hop
+#define LORA_BROADCAST_ID 0xFF   // next_hop: any neighbour may take it (route unknown)
+#define LORA_DEFAULT_TTL 3       // hops a frame may still travel when it leaves its origin
+
+// Selective-repeat window limits (bitmap is 32 bits wide)
+#define LORA_MAX_WINDOW_SIZE 32
+
+// FEC parity frames: FecParityPayload, then the parity bytes. Fragments of
+// an FEC transfer must leave room for that header in the parity frame.
+#define LORA_MAX_FEC_PARITY 4
+#define LORA_FEC_HEADER_SIZE 5
+#define LORA_MAX_FEC_DATA_PAYLOAD (LORA_MAX_DATA_PAYLOAD - LORA_FEC_HEADER_SIZE)
+
+// PKT_NACK: NackPayload, then range_count NackRange entries. A receiver
+// with more gaps than fit lists the first ones and sets covered to where
+// the list stops; everything from there on counts as missing.
+#define LORA_NACK_HEADER_SIZE 8
+#define LORA_NACK_RANGE_SIZE 4
+#define LORA_MAX_NACK_RANGES 16
+
+// PKT_RATE_CTRL ops. The reply echoes the request's seq and goes out at the
+// old rate; both ends switch once it is on air.
+#define RATE_OP_REQUEST 0x01
+#define RATE_OP_CONFIRM 0x02
+#define RATE_OP_REJECT 0x03
+
+// Bandwidth codes carried in RateCtrlPayload::bw_code
+#define LORA_BW_CODE_125 0x00
+#define LORA_BW_CODE_250 0x01
+#define LORA_BW_CODE_500 0x02
+#define LORA_BW_CODE_62_5 0x03
 
 // ACK status codes
 #define ACK_STATUS_OK 0x00
@@ -31,16 +88,21 @@
 #pragma pack(push, 1)
 struct LoRaHeader {
   uint8_t ver_type;    // VERSION (high nibble) | TYPE (low nibble)
-  uint8_t src_id;
-  uint8_t dst_id;
+  uint8_t src_id;      // origin node
+  uint8_t dst_id;      // final destination
   uint8_t exp_id;
   uint16_t session_id;
   uint16_t seq_num;
   uint8_t tx_pow;
   uint8_t sf_cr;
+  uint8_t next_hop;    // node that should take this hop, or LORA_BROADCAST_ID
+  uint8_t prev_hop;    // node that transmitted this hop
+  uint8_t ttl;         // hops left; a relay forwards only while ttl > 1
 };
 #pragma pack(pop)
 
+static_assert(sizeof(LoRaHeader) == LORA_HEADER_SIZE, "LoRaHeader layout changed; update LORA_HEADER_SIZE and tests/packet_test.py");
+
 #pragma pack(push, 1)
 struct AudioStartPayload{
   uint16_t total_frags;
@@ -52,10 +114,13 @@ struct AudioStartPayload{
 };
 #pragma pack(pop)
 
+// A DATA body is data[0, len) and nothing else: len is not on air, it is
+// the frame length less the header. It comes first so a write that runs
+// off the end of data[] cannot corrupt it.
 #pragma pack(push, 1)
 struct AudioDataPayload{
-  uint8_t data[LORA_MAX_DATA_PAYLOAD];
   uint8_t len;
+  uint8_t data[LORA_MAX_DATA_PAYLOAD];
 };
 #pragma pack(pop)
 
@@ -74,6 +139,75 @@ struct AckPayload{
 };
 #pragma pack(pop)
 
+// A whole PKT_ACK frame, as the receiver caches it for replay.
+#define LORA_ACK_FRAME_SIZE (LORA_HEADER_SIZE + sizeof(AckPayload))
+
+#pragma pack(push, 1)
+struct WindowPollPayload{
+  uint16_t base_seq;   // first seq of the window the sender is asking about
+  uint8_t count;       // number of seqs in the window (<= LORA_MAX_WINDOW_SIZE)
+};
+#pragma pack(pop)
+
+#pragma pack(push, 1)
+struct WindowAckPayload{
+  uint16_t base_seq;   // echoes WindowPollPayload::base_seq
+  uint32_t bitmap;     // bit i set = seq (base_seq + i) received
+  uint8_t status;
+};
+#pragma pack(pop)
+
+#pragma pack(push, 1)
+struct RateCtrlPayload{
+  uint8_t op;        // RATE_OP_*
+  uint8_t sf;        // 7..12
+  uint8_t cr;        // RadioLib denominator, 5..8 (4/5..4/8)
+  uint8_t bw_code;   // LORA_BW_CODE_*
+  int8_t tx_pow;     // dBm
+};
+#pragma pack(pop)
+
+#pragma pack(push, 1)
+struct FecParityPayload{
+  uint16_t block_frag;    // fragment index of the block's first DATA fragment
+  uint8_t data_count;     // DATA fragments in the block
+  uint8_t parity_index;   // covers block fragments i with i % parity_count == parity_index
+  uint8_t parity_count;   // parity frames per block (1..LORA_MAX_FEC_PARITY)
+};
+#pragma pack(pop)
+
+static_assert(sizeof(FecParityPayload) == LORA_FEC_HEADER_SIZE, "FecParityPayload layout changed; update LORA_FEC_HEADER_SIZE");
+
+// Starts like AckPayload, so the sender's ACK wait takes it as the answer
+// to its PKT_RESUME.
+#pragma pack(push, 1)
+struct NackPayload{
+  uint16_t ack_seq;     // seq of the PKT_RESUME answered
+  uint8_t status;       // ACK_STATUS_OK = context open, ranges are current
+  uint16_t received;    // fragments the receiver holds
+  uint16_t covered;     // ranges describe [0, covered); fragments past it are missing
+  uint8_t range_count;  // <= LORA_MAX_NACK_RANGES
+};
+#pragma pack(pop)
+
+#pragma pack(push, 1)
+struct NackRange{
+  uint16_t first_frag;
+  uint16_t count;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(NackPayload) == LORA_NACK_HEADER_SIZE && sizeof(NackRange) == LORA_NACK_RANGE_SIZE,
+              "NACK layout changed; update LORA_NACK_HEADER_SIZE / LORA_NACK_RANGE_SIZE");
+static_assert(LORA_NACK_HEADER_SIZE + LORA_MAX_NACK_RANGES * LORA_NACK_RANGE_SIZE <= LORA_MAX_DATA_PAYLOAD,
+              "LORA_MAX_NACK_RANGES does not fit one frame");
+
+// A whole PKT_NACK body, ranges ascending and disjoint.
+struct ResumeNack {
+  NackPayload head;
+  NackRange ranges[LORA_MAX_NACK_RANGES];
+};
+
 struct LoRaAudioPacket{
   LoRaHeader header;
   union {
@@ -81,6 +215,10 @@ struct LoRaAudioPacket{
     AudioDataPayload data;
     AudioEndPayload end;
     AckPayload ack;
+    WindowPollPayload poll;
+    WindowAckPayload window_ack;
+    RateCtrlPayload rate;
+    FecParityPayload parity;
     uint8_t raw[LORA_MAX_DATA_PAYLOAD];
   } payload;
 };
@@ -95,12 +233,33 @@ inline uint8_t makeVerType(uint8_t version, uint8_t type) {
 inline uint8_t getVersion(uint8_t ver_type) { return (ver_type >> 4) & 0x0F; }
 inline uint8_t getType(uint8_t ver_type)    { return ver_type & 0x0F; }
 
+// Only the stop-and-wait families get a per-frame PKT_ACK. ACKs are never
+// ACKed, windowed DATA waits for a poll, and polls get a PKT_WINDOW_ACK.
+inline bool expectsPerFrameAck(uint8_t type) {
+  return type == PKT_AUDIO_START || type == PKT_AUDIO_DATA || type == PKT_AUDIO_END;
+}
+
 inline uint8_t makeSFCR(uint8_t sf, uint8_t cr) {
   return ((sf & 0x0F) << 4) | (cr & 0x0F);
 }
 inline uint8_t getSF(uint8_t sf_cr)         { return (sf_cr >> 4) & 0x0F; }
 inline uint8_t getCodingRate(uint8_t sf_cr) { return sf_cr & 0x0F; }
 
+inline float bwCodeToKhz(uint8_t code) {
+  switch (code) {
+    case LORA_BW_CODE_250:  return 250.0f;
+    case LORA_BW_CODE_500:  return 500.0f;
+    case LORA_BW_CODE_62_5: return 62.5f;
+    default:                return 125.0f;
+  }
+}
+inline uint8_t bwKhzToCode(float khz) {
+  if (khz > 375.0f) return LORA_BW_CODE_500;
+  if (khz > 187.5f) return LORA_BW_CODE_250;
+  if (khz < 93.75f) return LORA_BW_CODE_62_5;
+  return LORA_BW_CODE_125;
+}
+
 
 // ─── Function declarations (implemented in loraProtocol.cpp) ─────────────────
 
@@ -117,15 +276,54 @@ void buildHeader(
   uint8_t cr
 );
 
-uint16_t crc16(const uint8_t* data, size_t len);
-uint32_t crc32(const uint8_t* data, size_t len);
-
 void serializeHeader(const LoRaHeader* hdr, uint8_t* buf);
 void deserializeHeader(const uint8_t* buf, LoRaHeader* hdr);
+void serializeAck(const AckPayload* payload, uint8_t* buf);
+void deserializeAck(const uint8_t* buf, AckPayload* payload);
 void serializeAudioStart(const AudioStartPayload* payload, uint8_t* buf);
 void deserializeAudioStart(const uint8_t* buf, AudioStartPayload* payload);
 void serializeAudioEnd(const AudioEndPayload* payload, uint8_t* buf);
 void deserializeAudioEnd(const uint8_t* buf, AudioEndPayload* payload);
+void serializeWindowPoll(const WindowPollPayload* payload, uint8_t* buf);
+void deserializeWindowPoll(const uint8_t* buf, WindowPollPayload* payload);
+void serializeWindowAck(const WindowAckPayload* payload, uint8_t* buf);
+void deserializeWindowAck(const uint8_t* buf, WindowAckPayload* payload);
+void serializeRateCtrl(const RateCtrlPayload* payload, uint8_t* buf);
+void deserializeRateCtrl(const uint8_t* buf, RateCtrlPayload* payload);
+void serializeFecParity(const FecParityPayload* payload, uint8_t* buf);
+void deserializeFecParity(const uint8_t* buf, FecParityPayload* payload);
+// Bytes written (header + range_count ranges).
+size_t serializeNack(const ResumeNack* nack, uint8_t* buf);
+// False if len is short for the ranges it announces, or there are too many.
+bool deserializeNack(const uint8_t* buf, size_t len, ResumeNack* nack);
+
+// What a NACK asks the sender to resend: fragment frag is missing if a
+// range holds it or it is at or past covered. nackNextMissing() is the
+// first missing fragment >= from, or totalFrags if there is none.
+bool nackMissing(const ResumeNack& nack, uint16_t frag);
+uint16_t nackNextMissing(const ResumeNack& nack, uint16_t from, uint16_t totalFrags);
+uint16_t nackMissingCount(const ResumeNack& nack, uint16_t totalFrags);
+
+// What a compact header leaves out: the experiment and the link's power,
+// SF and CR, which both ends of a link already share. Each side builds
+// them from its own config and LoRaManager::rate().
+struct LoRaHeaderDefaults {
+  uint8_t exp_id;
+  uint8_t tx_pow;
+  uint8_t sf_cr;
+};
+
+// Compact header for hdr into buf (up to LORA_COMPACT_HEADER_MAX bytes);
+// returns its length. Only fields that differ from d are written.
+size_t encodeCompactHeader(const LoRaHeader* hdr, const LoRaHeaderDefaults& d, uint8_t* buf);
+// Bytes of compact header read into hdr, or 0 if it is malformed or cut short.
+size_t decodeCompactHeader(const uint8_t* buf, size_t len, const LoRaHeaderDefaults& d, LoRaHeader* hdr);
+// Rewrite a received compact frame in place as a v2 frame (body moved up
+// to LORA_HEADER_SIZE); returns the new length, or 0 to drop the frame.
+size_t expandCompactFrame(uint8_t* frame, size_t len, const LoRaHeaderDefaults& d);
+
+// packet_type column text for a PKT_* value (windowed DATA logs as "DATA").
+const char* packetTypeLabel(uint8_t type);
 
 #ifdef LORA_DEBUG
 void printHeader(const LoRaHeader* hdr);
@@ -0,0 +1,78 @@
+#pragma once
+#include <stdint.h>
+
+/*
+ * Binary log records (MESH_LOG_FORMAT_BINARY), written to lora_log.bin.
+ *
+ * Layout, little-endian as the ESP32 stores it:
+ *   LogFileHeader   once, when the file is created
+ *   LogMetaRecord   once per boot, before that boot's first row
+ *   LogRowRecord    one per logTransmission() call
+ *
+ * Every record after the file header starts with a one-byte tag so a
+ * decoder can resync after a torn write. Timestamps are raw millis();
+ * LogMetaRecord carries the epoch base that turns them into the CSV's
+ * *_utc columns. tests/log_decoder.py reads this and must change with it.
+ */
+
+#define LOG_BIN_MAGIC   0x474C524CUL  // "LRLG"
+#define LOG_BIN_VERSION 4   // 2: LogRowRecord.rtoMs, 3: toaMs / txMs, 4: dup
+
+#define LOG_TAG_META 'M'
+#define LOG_TAG_ROW  'R'
+
+#define LOG_RUN_ID_LEN      24
+#define LOG_ROLE_LEN        8
+#define LOG_PACKET_TYPE_LEN 12
+#define LOG_STATUS_LEN      24
+
+#pragma pack(push, 1)
+struct LogFileHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t headerLen;   // sizeof(LogFileHeader)
+  uint16_t metaLen;     // sizeof(LogMetaRecord)
+  uint16_t rowLen;      // sizeof(LogRowRecord)
+  uint32_t reserved;
+};
+#pragma pack(pop)
+
+#pragma pack(push, 1)
+struct LogMetaRecord {
+  uint8_t  tag;             // LOG_TAG_META
+  uint64_t epochBaseMs;     // UTC ms at millis() == 0
+  uint8_t  nodeId;
+  uint8_t  sf;
+  uint8_t  transferMode;    // MESH_TRANSFER_MODE_*
+  uint32_t ackTimeoutMs;
+  char     runId[LOG_RUN_ID_LEN];
+  char     role[LOG_ROLE_LEN];
+};
+#pragma pack(pop)
+
+#pragma pack(push, 1)
+struct LogRowRecord {
+  uint8_t  tag;             // LOG_TAG_ROW
+  uint32_t nowMs;
+  uint32_t txTime;
+  uint32_t ackTime;
+  uint32_t rtoMs;           // 0 when the row had no ACK wait
+  uint16_t toaMs;           // modeled time on air of the frame sent
+  uint16_t txMs;            // measured send to TxDone, 0 if it failed
+  float    lat;
+  float    lon;
+  float    snr;
+  int16_t  rssi;
+  uint16_t sessionId;
+  uint16_t seqNum;
+  int16_t  fragIndex;
+  uint16_t fragLen;
+  char     packetType[LOG_PACKET_TYPE_LEN];
+  char     status[LOG_STATUS_LEN];
+  uint8_t  dup;             // 1 = retransmit of a frame already received
+};
+#pragma pack(pop)
+
+static_assert(sizeof(LogFileHeader) == 16, "LogFileHeader layout changed; update tests/log_decoder.py");
+static_assert(sizeof(LogMetaRecord) == 48, "LogMetaRecord layout changed; update tests/log_decoder.py");
+static_assert(sizeof(LogRowRecord) == 80, "LogRowRecord layout changed; update tests/log_decoder.py");
@@ -0,0 +1,45 @@
+#include "LogStatus.h"
+
+const char* logStatusLabel(LogStatus status) {
+  switch (status) {
+    case LOG_STATUS_ACK_OK:             return "ACK_OK";
+    case LOG_STATUS_ACK_TIMEOUT:        return "ACK_TIMEOUT";
+    case LOG_STATUS_TX_FAIL:            return "TX_FAIL";
+    case LOG_STATUS_ACK_SENT:           return "ACK_SENT";
+    case LOG_STATUS_ACK_SEND_FAIL:      return "ACK_SEND_FAIL";
+    case LOG_STATUS_WACK_SENT:          return "WACK_SENT";
+    case LOG_STATUS_WACK_SEND_FAIL:     return "WACK_SEND_FAIL";
+    case LOG_STATUS_NACK_SENT:          return "NACK_SENT";
+    case LOG_STATUS_NACK_SEND_FAIL:     return "NACK_SEND_FAIL";
+    case LOG_STATUS_RATE_APPLIED:       return "RATE_APPLIED";
+    case LOG_STATUS_RATE_KEPT:          return "RATE_KEPT";
+    case LOG_STATUS_RX_RECV:            return "RX_RECV";
+    case LOG_STATUS_RX_START_OK:        return "RX_START_OK";
+    case LOG_STATUS_RX_DUP:             return "RX_DUP";
+    case LOG_STATUS_RX_PARITY:          return "RX_PARITY";
+    case LOG_STATUS_RX_FEC_RECOVERED:   return "RX_FEC_RECOVERED";
+    case LOG_STATUS_RX_CRC_OK:          return "RX_CRC_OK";
+    case LOG_STATUS_RX_CRC_FAIL:        return "RX_CRC_FAIL";
+    case LOG_STATUS_RX_INCOMPLETE:      return "RX_INCOMPLETE";
+    case LOG_STATUS_RX_NO_SESSION:      return "RX_NO_SESSION";
+    case LOG_STATUS_RX_OUT_OF_RANGE:    return "RX_OUT_OF_RANGE";
+    case LOG_STATUS_RX_STORE_FAIL:      return "RX_STORE_FAIL";
+    case LOG_STATUS_RX_BAD_START:       return "RX_BAD_START";
+    case LOG_STATUS_RX_TABLE_FULL:      return "RX_TABLE_FULL";
+    case LOG_STATUS_RX_RESUMED:         return "RX_RESUMED";
+    case LOG_STATUS_BENCH:              return "BENCH";
+    default:                            return "UNKNOWN";
+  }
+}
+
+bool logStatusHasRetry(LogStatus status) {
+  return status == LOG_STATUS_ACK_OK || status == LOG_STATUS_ACK_TIMEOUT || status == LOG_STATUS_TX_FAIL;
+}
+
+LogStatusText logStatusText(LogStatus status, uint8_t retryIndex) {
+  LogStatusText text(logStatusLabel(status));
+  if (logStatusHasRetry(status)) {
+    text.appendf("_R%u", static_cast<unsigned>(retryIndex));
+  }
+  return text;
+}
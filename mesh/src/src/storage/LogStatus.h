@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include "LogFormat.h"
+#include "../util/FixedString.h"
+
+/*
+ * Log row outcomes. Callers pass the enum (plus the attempt's retry index)
+ * to SdManager::logTransmission(); the text in the status column is only
+ * produced when the row is written, so queueing a row copies no strings.
+ *
+ * Sender attempt statuses are written with an "_R<retry>" suffix
+ * (ACK_OK_R0, ACK_TIMEOUT_R1, ...), which r2_sweep_report.py parses.
+ */
+enum LogStatus : uint8_t {
+  LOG_STATUS_UNKNOWN,
+  // Sender, one row per attempt
+  LOG_STATUS_ACK_OK,
+  LOG_STATUS_ACK_TIMEOUT,
+  LOG_STATUS_TX_FAIL,
+  // Receiver replies
+  LOG_STATUS_ACK_SENT,
+  LOG_STATUS_ACK_SEND_FAIL,
+  LOG_STATUS_WACK_SENT,
+  LOG_STATUS_WACK_SEND_FAIL,
+  LOG_STATUS_NACK_SENT,
+  LOG_STATUS_NACK_SEND_FAIL,
+  LOG_STATUS_RATE_APPLIED,
+  LOG_STATUS_RATE_KEPT,
+  // Receiver, where a frame landed (Reassembler::logStatus())
+  LOG_STATUS_RX_RECV,
+  LOG_STATUS_RX_START_OK,
+  LOG_STATUS_RX_DUP,
+  LOG_STATUS_RX_PARITY,
+  LOG_STATUS_RX_FEC_RECOVERED,
+  LOG_STATUS_RX_CRC_OK,
+  LOG_STATUS_RX_CRC_FAIL,
+  LOG_STATUS_RX_INCOMPLETE,
+  LOG_STATUS_RX_NO_SESSION,
+  LOG_STATUS_RX_OUT_OF_RANGE,
+  LOG_STATUS_RX_STORE_FAIL,
+  LOG_STATUS_RX_BAD_START,
+  LOG_STATUS_RX_TABLE_FULL,
+  LOG_STATUS_RX_RESUMED,
+  // tests/benchmarks
+  LOG_STATUS_BENCH,
+  LOG_STATUS_COUNT
+};
+
+typedef FixedString<LOG_STATUS_LEN - 1> LogStatusText;
+
+const char* logStatusLabel(LogStatus status);   // without the retry suffix
+bool logStatusHasRetry(LogStatus status);
+LogStatusText logStatusText(LogStatus status, uint8_t retryIndex);
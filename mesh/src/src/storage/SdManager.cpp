@@ -1,19 +1,32 @@
 #include "SdManager.h"
 #include <time.h>
+#include "../bus/SpiArbiter.h"
+#include "../util/StageProfiler.h"
+#include "../app/SessionTable.h"
 
-SdManager::SdManager() : _spiSD(FSPI) {}
+// The SD card gets its own SPI host so the radio bus never has to be torn down.
+SdManager::SdManager() : _spiSD(HSPI) {}
 
 namespace {
   constexpr uint8_t kSdCmd18Error = 0x0C;
-  constexpr uint8_t kLoRaNssPin = 8;
+  // Nothing else is wired to HSPI, so SdFat may keep multi-sector state.
+  constexpr uint8_t kSdSpiOption = DEDICATED_SPI;
 
   constexpr int kIso8601BufferLen = 32;
 
-  inline void quiesceSharedSpiDevices() {
-    pinMode(kLoRaNssPin, OUTPUT);
-    digitalWrite(kLoRaNssPin, HIGH);
-    delayMicroseconds(5);
-  }
+#if MESH_LOG_FORMAT == MESH_LOG_FORMAT_BINARY
+  constexpr const char* kLogFileName = "lora_log.bin";
+  constexpr const char* kLogLegacyName = "lora_log_legacy.bin";
+#else
+  constexpr const char* kLogFileName = "lora_log.csv";
+  constexpr const char* kLogLegacyName = "lora_log_legacy.csv";
+#endif
+
+  constexpr const char* kProfileFileName = "lora_prof.csv";
+  constexpr const char* kSessionsFileName = "lora_sessions.csv";
+
+  constexpr uint32_t kPayloadMetaMagic = 0x54454D50UL;  // "PMET"
+  constexpr uint32_t kPayloadMetaTailBytes = 64;
 
   bool hasBinExtension(const char* filename) {
     if (!filename) return false;
@@ -27,6 +40,11 @@ namespace {
     return b && i && n && end;
   }
 
+  // Rows queued without a PKT_* type keep the old "GENERIC" column text.
+  const char* logPacketTypeText(uint8_t packetType) {
+    return (packetType == 0) ? "GENERIC" : packetTypeLabel(packetType);
+  }
+
   int monthFromShortName(const char* month) {
     static const char* kMonths[] = {
       "Jan", "Feb", "Mar", "Apr", "May", "Jun",
@@ -80,9 +98,10 @@ bool SdManager::init() {
     Serial.println("SPI Started");
   }
 
-  quiesceSharedSpiDevices();
+  SpiArbiter::attach(SpiArbiter::SD, SD_CS);
+  SpiLease bus(SpiArbiter::SD);
 
-  SdSpiConfig sdConfig(SD_CS, SHARED_SPI, SD_SCK_MHZ(2), &_spiSD);
+  SdSpiConfig sdConfig(SD_CS, kSdSpiOption, SD_SCK_MHZ(MESH_SD_SCK_MHZ), &_spiSD);
 
   Serial.println("Testing SD card presence...");
   pinMode(SD_CS, OUTPUT);
@@ -93,7 +112,15 @@ bool SdManager::init() {
   digitalWrite(SD_CS, HIGH);
   delay(100);
 
-  if (!_sd.begin(sdConfig)) {
+  bool mounted = _sd.begin(sdConfig);
+  if (!mounted && MESH_SD_SCK_MHZ > 2) {
+    // Long leads or an old card: the 2 MHz the bus used to run at.
+    Serial.printf("SD mount at %u MHz failed (0x%02X); retrying at 2 MHz\n",
+                  static_cast<unsigned>(MESH_SD_SCK_MHZ), static_cast<unsigned>(_sd.sdErrorCode()));
+    SdSpiConfig slowConfig(SD_CS, kSdSpiOption, SD_SCK_MHZ(2), &_spiSD);
+    mounted = _sd.begin(slowConfig);
+  }
+  if (!mounted) {
     Serial.print("SD Error Code - ");
     Serial.println(_sd.sdErrorCode(), HEX);
     _sd.initErrorHalt(&Serial);
@@ -124,46 +151,427 @@ bool SdManager::init() {
   return true;
 }
 
-void SdManager::resetSPI() {
-  // Ensure LoRa is deselected
-  pinMode(kLoRaNssPin, OUTPUT);
-  digitalWrite(kLoRaNssPin, HIGH);
-  delayMicroseconds(10);
-  
-  // Reset SPI bus
-  SPI.end();
-  delayMicroseconds(50);
-  
-  // Restart SPI for SD card
-  _spiSD.end();
-  delayMicroseconds(10);
-  _spiSD.begin(SD_SCK, SD_MISO, SD_MOSI, SD_CS);
-  delayMicroseconds(10);
-  
-  // Ensure SD CS is high before operations
-  pinMode(SD_CS, OUTPUT);
-  digitalWrite(SD_CS, HIGH);
-  delayMicroseconds(5);
-}
-
 // :: is a scope resolution operator
 bool SdManager::openAudioFile(const char* filename) {
   if (!_ready || !filename) {
     return false;
   }
-  resetSPI();
+  SpiLease bus(SpiArbiter::SD);
+  if (!bus) {
+    return false;
+  }
   _audioFile.close();
+  _adpcmIndex = 0;
+  _streamCrc = 0;
+  _encodeUs = 0;
+  _nextChunk = 0;
+  _resetReadAhead();
   return _audioFile.open(filename, O_READ);
 }
 
+/**
+ * Open a payload for transmit and fill in its AUDIO_START metadata.
+ * Unchanged files are described from the RAM cache or the sidecar after a
+ * single stat; an appended file only has its new tail scanned.
+ */
+bool SdManager::openAudioFile(const char* filename, PayloadMeta& meta) {
+  meta = PayloadMeta{};
+  SpiLease bus(SpiArbiter::SD);
+  if (!bus) {
+    return false;
+  }
+  if (!openAudioFile(filename)) {
+    Serial.printf("[SD] Unable to open payload file: %s\n", filename ? filename : "(null)");
+    return false;
+  }
+  if (!_describeAudioFile(filename, meta) || !_audioFile.seekSet(0)) {
+    _audioFile.close();
+    return false;
+  }
+  // The first buffers load now, with START, so no fragment waits on the card.
+  _resetReadAhead();
+  serviceReadAhead();
+  return true;
+}
+
+bool SdManager::_describeAudioFile(const char* filename, PayloadMeta& meta) {
+  uint16_t fatDate = 0;
+  uint16_t fatTime = 0;
+  _audioFile.getModifyDateTime(&fatDate, &fatTime);
+  const uint32_t size = _audioFile.fileSize();
+  const uint32_t modified = (static_cast<uint32_t>(fatDate) << 16) | fatTime;
+
+  if (size == 0) {
+    Serial.println("[SD] Payload file is empty");
+    return false;
+  }
+
+  if (_payloadCodec == CODEC_COMPRESSED) {
+    return _describeCompressed(size, modified, meta);
+  }
+
+  const uint32_t frags = (size + _chunkSize - 1) / _chunkSize;
+  if (frags > 0xFFFF) {
+    Serial.printf("[SD] Payload too large, fragments=%lu exceeds protocol max\n",
+                  static_cast<unsigned long>(frags));
+    return false;
+  }
+
+  char metaName[sizeof(_metaCacheName)];
+  const int nameLen = snprintf(metaName, sizeof(metaName), "%s.meta", filename);
+  const bool haveSidecar = nameLen > 0 && static_cast<size_t>(nameLen) < sizeof(metaName);
+
+  PayloadMetaRecord rec = {};
+  bool known = false;
+  if (haveSidecar && strcmp(_metaCacheName, metaName) == 0) {
+    rec = _metaCache;
+    known = true;
+  } else if (haveSidecar) {
+    known = _loadMetaSidecar(metaName, rec);
+  }
+
+  uint32_t crc = 0;
+  bool cached = false;
+  if (known && rec.size == size && rec.modified == modified) {
+    crc = rec.crc32;
+    cached = true;
+  } else {
+    uint32_t from = 0;
+    uint32_t tail = 0;
+    if (known && rec.size > 0 && rec.size < size && _tailCrc(rec.size, tail) && tail == rec.tailCrc) {
+      from = rec.size;
+      crc = rec.crc32;
+      Serial.printf("[SD] Payload grew %lu -> %lu bytes; scanning the new tail\n",
+                    static_cast<unsigned long>(rec.size), static_cast<unsigned long>(size));
+    }
+    if (!_scanAudioFile(from, size, crc)) {
+      Serial.println("[SD] Payload scan failed");
+      return false;
+    }
+
+    rec.magic = kPayloadMetaMagic;
+    rec.size = size;
+    rec.modified = modified;
+    rec.crc32 = crc;
+    if (!_tailCrc(size, rec.tailCrc)) {
+      rec.tailCrc = 0;
+    }
+    if (haveSidecar && !_saveMetaSidecar(metaName, rec)) {
+      Serial.printf("[SD] Metadata sidecar write failed: %s\n", metaName);
+    }
+  }
+
+  if (haveSidecar) {
+    _metaCache = rec;
+    memcpy(_metaCacheName, metaName, sizeof(_metaCacheName));
+  }
+
+  meta.size = size;
+  meta.totalFrags = static_cast<uint16_t>(frags);
+  meta.crc32 = crc;
+  meta.sourceSize = size;
+  meta.modified = modified;
+  meta.cached = cached;
+  return true;
+}
+
+// Encoded size follows from the sample count alone, so nothing is scanned;
+// the CRC32 is folded in as readAudioChunk() encodes each block.
+bool SdManager::_describeCompressed(uint32_t size, uint32_t modified, PayloadMeta& meta) {
+  const uint32_t samples = size / sizeof(int16_t);
+  const uint16_t perBlock = imaAdpcmBlockSamples(_chunkSize);
+  if (samples == 0 || perBlock == 0) {
+    Serial.println("[SD] Payload too short for ADPCM (needs 16-bit PCM)");
+    return false;
+  }
+
+  const uint32_t frags = (samples + perBlock - 1) / perBlock;
+  if (frags > 0xFFFF) {
+    Serial.printf("[SD] Payload too large, fragments=%lu exceeds protocol max\n",
+                  static_cast<unsigned long>(frags));
+    return false;
+  }
+  const uint32_t lastSamples = samples - (frags - 1) * perBlock;
+
+  meta.size = (frags - 1) * _chunkSize + imaAdpcmBlockBytes(static_cast<uint16_t>(lastSamples));
+  meta.totalFrags = static_cast<uint16_t>(frags);
+  meta.crc32 = 0;
+  meta.sourceSize = size;
+  meta.modified = modified;
+  meta.cached = false;
+  return true;
+}
+
+bool SdManager::_scanAudioFile(uint32_t from, uint32_t to, uint32_t& crc) {
+  uint8_t buf[512];
+  if (!_audioFile.seekSet(from)) {
+    return false;
+  }
+  uint32_t remaining = to - from;
+  while (remaining > 0) {
+    const size_t want = remaining < sizeof(buf) ? remaining : sizeof(buf);
+    const int got = _audioFile.read(buf, want);
+    if (got <= 0) {
+      return false;
+    }
+    crc = crc32Update(crc, buf, static_cast<size_t>(got));
+    remaining -= static_cast<uint32_t>(got);
+  }
+  return true;
+}
+
+bool SdManager::_tailCrc(uint32_t end, uint32_t& crc) {
+  uint8_t buf[kPayloadMetaTailBytes];
+  const uint32_t len = end < sizeof(buf) ? end : sizeof(buf);
+  if (!_audioFile.seekSet(end - len)) {
+    return false;
+  }
+  if (_audioFile.read(buf, len) != static_cast<int>(len)) {
+    return false;
+  }
+  crc = crc32(buf, len);
+  return true;
+}
+
+bool SdManager::_loadMetaSidecar(const char* metaName, PayloadMetaRecord& rec) {
+  File32 file;
+  if (!file.open(metaName, O_READ)) {
+    return false;
+  }
+  const int readCount = file.read(&rec, sizeof(rec));
+  file.close();
+  return readCount == static_cast<int>(sizeof(rec)) && rec.magic == kPayloadMetaMagic;
+}
+
+bool SdManager::_saveMetaSidecar(const char* metaName, const PayloadMetaRecord& rec) {
+  File32 file;
+  if (!file.open(metaName, O_WRITE | O_CREAT | O_TRUNC)) {
+    return false;
+  }
+  const size_t written = file.write(&rec, sizeof(rec));
+  file.flush();
+  file.close();
+  return written == sizeof(rec);
+}
+
 bool SdManager::readAudioChunk(AudioPacket& packet) {
-  resetSPI();
-  packet.bytesRead = _audioFile.read(packet.buffer, sizeof(packet.buffer));
-  return packet.bytesRead > 0;
+  uint16_t bytesRead = 0;
+  const bool ok = readAudioChunk(packet.buffer, bytesRead);
+  packet.bytesRead = bytesRead;
+  return ok;
+}
+
+bool SdManager::readAudioChunk(uint8_t* dst, uint16_t& bytesRead) {
+  bytesRead = 0;
+  if (dst == nullptr) {
+    return false;
+  }
+  PROFILE_SCOPE(PROFILE_SD_READ);
+  SpiLease bus(SpiArbiter::SD);
+  if (!bus) {
+    return false;
+  }
+  _readAheadStats.chunks++;
+  if (_payloadCodec == CODEC_COMPRESSED) {
+    const size_t want = imaAdpcmBlockSamples(_chunkSize) * sizeof(int16_t);
+    const size_t got = _readStream(reinterpret_cast<uint8_t*>(_pcmBlock), want);
+    if (got < sizeof(int16_t)) {
+      return false;
+    }
+    const uint32_t start = micros();
+    bytesRead = static_cast<uint16_t>(imaAdpcmEncodeBlock(
+        _pcmBlock, static_cast<uint16_t>(got / sizeof(int16_t)), _adpcmIndex, dst));
+    _encodeUs += micros() - start;
+  } else {
+    const size_t got = _readStream(dst, _chunkSize);
+    if (got == 0) {
+      return false;
+    }
+    bytesRead = static_cast<uint16_t>(got);
+  }
+  _streamCrc = crc32Update(_streamCrc, dst, bytesRead);
+  _nextChunk++;
+  return true;
+}
+
+/**
+ * Raw payloads restart the read-ahead at the sector holding the fragment.
+ * ADPCM carries its step index from block to block, so a compressed
+ * payload cannot jump: it encodes forward (from the start when frag is
+ * behind) and throws the blocks away, which keeps every fragment's bytes
+ * and streamCrc32() identical to a straight read.
+ */
+bool SdManager::seekAudioChunk(uint16_t frag) {
+  if (!_ready || !_audioFile.isOpen()) {
+    return false;
+  }
+  if (frag == _nextChunk) {
+    return true;
+  }
+  SpiLease bus(SpiArbiter::SD);
+  if (!bus) {
+    return false;
+  }
+  if (_payloadCodec == CODEC_COMPRESSED) {
+    if (frag < _nextChunk) {
+      _adpcmIndex = 0;
+      _streamCrc = 0;
+      _nextChunk = 0;
+      if (!_seekReadAhead(0)) {
+        return false;
+      }
+    }
+    uint8_t scratch[LORA_MAX_DATA_PAYLOAD];
+    uint16_t len = 0;
+    while (_nextChunk < frag) {
+      if (!readAudioChunk(scratch, len)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  if (!_seekReadAhead(static_cast<uint32_t>(frag) * _chunkSize)) {
+    return false;
+  }
+  _nextChunk = frag;
+  return true;
+}
+
+// ─── Payload read-ahead ──────────────────────────────────────────────────────
+
+void SdManager::_resetReadAhead() {
+  while (_readAhead.front() != nullptr) {
+    _readAhead.pop();
+  }
+  _readAheadNext = 0;
+  _readAheadEof = false;
+  _readAheadStats = ReadAheadStats{};
+}
+
+// Drop the buffers and refill from offset: the fill starts at the sector
+// boundary below it and the front buffer skips the difference.
+bool SdManager::_seekReadAhead(uint32_t offset) {
+  while (_readAhead.front() != nullptr) {
+    _readAhead.pop();
+  }
+  _readAheadNext = offset & ~static_cast<uint32_t>(511);
+  _readAheadEof = false;
+  if (!_fillReadBlock()) {
+    return false;
+  }
+  ReadBlock* block = _readAhead.front();
+  const uint32_t skip = offset - block->offset;
+  block->pos = static_cast<uint16_t>(skip < block->len ? skip : block->len);
+  if (block->pos >= block->len) {
+    _readAhead.pop();
+  }
+  return true;
+}
+
+/**
+ * Read the next MESH_SD_READAHEAD_BYTES of the payload into a free buffer.
+ * The file position stays sector aligned, so SdFat reads whole sectors
+ * straight into the buffer with one multi-block command. False on a read
+ * error, or when there is no free buffer or nothing left to read.
+ */
+bool SdManager::_fillReadBlock() {
+  if (_readAheadEof || !_audioFile.isOpen()) {
+    return false;
+  }
+  ReadBlock* block = _readAhead.claim();
+  if (block == nullptr) {
+    return false;
+  }
+  SpiLease bus(SpiArbiter::SD);
+  if (!bus) {
+    return false;
+  }
+  const uint32_t start = micros();
+  if (_audioFile.curPosition() != _readAheadNext && !_audioFile.seekSet(_readAheadNext)) {
+    return false;
+  }
+  const int got = _audioFile.read(block->data, sizeof(block->data));
+  if (got < 0) {
+    Serial.printf("[SD] Payload read failed at %lu\n", static_cast<unsigned long>(_readAheadNext));
+    return false;
+  }
+  block->offset = _readAheadNext;
+  block->len = static_cast<uint16_t>(got);
+  block->pos = 0;
+  _readAheadNext += static_cast<uint32_t>(got);
+  _readAheadEof = static_cast<size_t>(got) < sizeof(block->data);
+  _readAhead.commit();
+  _readAheadStats.blocks++;
+  _readAheadStats.bytes += static_cast<uint32_t>(got);
+  _readAheadStats.fillUs += micros() - start;
+  return true;
+}
+
+bool SdManager::serviceReadAhead() {
+  if (!_ready || !_audioFile.isOpen()) {
+    return true;
+  }
+  while (!_readAheadEof && _readAhead.size() < _readAhead.capacity()) {
+    if (!_fillReadBlock()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Copy up to `want` payload bytes out of the buffers. A buffer that is not
+// ready yet is filled here (a stall, counted), so a missed service call
+// costs time but never data.
+size_t SdManager::_readStream(uint8_t* dst, size_t want) {
+  size_t copied = 0;
+  bool stalled = false;
+  while (copied < want) {
+    ReadBlock* block = _readAhead.front();
+    if (block == nullptr) {
+      if (_readAheadEof) {
+        break;
+      }
+      stalled = true;
+      if (!_fillReadBlock()) {
+        break;
+      }
+      continue;
+    }
+    const size_t avail = block->len - block->pos;
+    const size_t n = (want - copied < avail) ? want - copied : avail;
+    memcpy(dst + copied, block->data + block->pos, n);
+    block->pos = static_cast<uint16_t>(block->pos + n);
+    copied += n;
+    if (block->pos >= block->len) {
+      _readAhead.pop();
+    }
+  }
+  if (stalled) {
+    _readAheadStats.stalls++;
+  }
+  return copied;
+}
+
+void SdManager::setChunkSize(uint16_t bytes) {
+  if (bytes == 0 || bytes > sizeof(AudioPacket::buffer)) {
+    bytes = sizeof(AudioPacket::buffer);
+  }
+  _chunkSize = bytes;
 }
 
 void SdManager::closeAudioFile() {
+  if (_readAheadStats.chunks > 0) {
+    const ReadAheadStats& s = _readAheadStats;
+    Serial.printf("[SD] read-ahead chunks=%lu stalls=%lu fills=%lu bytes=%lu fill_us=%lu (%u x %u B, %u MHz)\n",
+                  static_cast<unsigned long>(s.chunks), static_cast<unsigned long>(s.stalls),
+                  static_cast<unsigned long>(s.blocks), static_cast<unsigned long>(s.bytes),
+                  static_cast<unsigned long>(s.fillUs),
+                  static_cast<unsigned>(MESH_SD_READAHEAD_BUFS), static_cast<unsigned>(MESH_SD_READAHEAD_BYTES),
+                  static_cast<unsigned>(MESH_SD_SCK_MHZ));
+  }
+  SpiLease bus(SpiArbiter::SD);
   _audioFile.close();
+  _resetReadAhead();
 }
 
 bool SdManager::writeBinaryFile(const char* filename, const uint8_t* data, size_t length, bool append) {
@@ -174,9 +582,20 @@ bool SdManager::writeBinaryFile(const char* filename, const uint8_t* data, size_
     Serial.println("Binary write rejected: filename must end with .bin");
     return false;
   }
+#if MESH_DUAL_CORE
+  if (_writeBehind()) {
+    return _queueStore(filename, append ? STORE_APPEND : STORE_TRUNCATE, 0, data, length);
+  }
+#endif
+  return _writeFile(filename, data, length, append);
+}
+
+bool SdManager::_writeFile(const char* filename, const uint8_t* data, size_t length, bool append) {
+  SpiLease bus(SpiArbiter::SD);
+  if (!bus) {
+    return false;
+  }
 
-  resetSPI();
-  
   File32 file;
   oflag_t flags = O_WRITE | O_CREAT;
   flags |= append ? O_APPEND : O_TRUNC;
@@ -200,6 +619,113 @@ bool SdManager::writeBinaryFile(const char* filename, const uint8_t* data, size_
   return true;
 }
 
+/**
+ * Append StageProfiler::formatCsv() rows to lora_prof.csv, writing the
+ * PROFILE_CSV_HEADER line first when the file is new.
+ */
+bool SdManager::writeProfile(const char* rows, size_t length) {
+  return _appendCsv(kProfileFileName, PROFILE_CSV_HEADER, rows, length);
+}
+
+/** SessionTable summary rows (SESSION_CSV_HEADER) to lora_sessions.csv. */
+bool SdManager::writeSessions(const char* rows, size_t length) {
+  return _appendCsv(kSessionsFileName, SESSION_CSV_HEADER, rows, length);
+}
+
+bool SdManager::_appendCsv(const char* filename, const char* header, const char* rows, size_t length) {
+  if (!_ready || rows == nullptr || length == 0) {
+    return false;
+  }
+
+  SpiLease bus(SpiArbiter::SD);
+  if (!bus) {
+    return false;
+  }
+
+  const bool fresh = !_sd.exists(filename);
+  File32 file;
+  if (!file.open(filename, O_WRITE | O_CREAT | O_APPEND)) {
+    Serial.printf("[SD] %s open failed\n", filename);
+    return false;
+  }
+  bool ok = true;
+  if (fresh) {
+    const size_t headerLen = strlen(header);
+    ok = file.write(header, headerLen) == headerLen;
+  }
+  ok = ok && file.write(rows, length) == length;
+  file.close();
+  return ok;
+}
+
+/**
+ * Write `length` bytes at `offset`, zero-filling any gap past the current
+ * end of file. Used by the RX reassembler to place fragments by sequence.
+ */
+bool SdManager::writeBinaryFile(const char* filename, uint32_t offset, const uint8_t* data, size_t length) {
+  if (!_ready || !filename || !data) {
+    return false;
+  }
+  if (!hasBinExtension(filename)) {
+    Serial.println("Binary write rejected: filename must end with .bin");
+    return false;
+  }
+#if MESH_DUAL_CORE
+  if (_writeBehind()) {
+    return _queueStore(filename, STORE_AT, offset, data, length);
+  }
+#endif
+  return _writeFileAt(filename, offset, data, length);
+}
+
+bool SdManager::_writeFileAt(const char* filename, uint32_t offset, const uint8_t* data, size_t length) {
+  SpiLease bus(SpiArbiter::SD);
+  if (!bus) {
+    return false;
+  }
+
+  File32 file;
+  if (!file.open(filename, O_RDWR | O_CREAT)) {
+    Serial.print("Binary write open failed: ");
+    Serial.println(filename);
+    return false;
+  }
+
+  const uint32_t size = file.fileSize();
+  if (offset > size) {
+    static const uint8_t kZeros[64] = {0};
+    file.seekSet(size);
+    uint32_t gap = offset - size;
+    while (gap > 0) {
+      const size_t step = gap < sizeof(kZeros) ? gap : sizeof(kZeros);
+      if (file.write(kZeros, step) != step) {
+        file.close();
+        Serial.println("Binary write gap fill failed");
+        return false;
+      }
+      gap -= step;
+    }
+  }
+
+  if (!file.seekSet(offset)) {
+    file.close();
+    Serial.printf("Binary write seek failed: offset=%lu\n", static_cast<unsigned long>(offset));
+    return false;
+  }
+
+  const size_t written = file.write(data, length);
+  file.flush();
+  file.close();
+
+  if (written != length) {
+    Serial.printf("Binary write short: wanted=%u wrote=%u\n",
+                  static_cast<unsigned>(length), static_cast<unsigned>(written));
+    return false;
+  }
+
+  return true;
+}
+
 bool SdManager::readBinaryFile(const char* filename, uint8_t* outBuffer, size_t maxLength, size_t& bytesRead) {
   bytesRead = 0;
   if (!_ready || !filename || !outBuffer || maxLength == 0) {
@@ -209,9 +735,20 @@ bool SdManager::readBinaryFile(const char* filename, uint8_t* outBuffer, size_t
     Serial.println("Binary read rejected: filename must end with .bin");
     return false;
   }
+#if MESH_DUAL_CORE
+  // What was queued must be on the card before it is read back.
+  if (!waitStoreDrained()) {
+    Serial.printf("[SD] read of %s refused: %u queued writes still pending\n", filename,
+                  static_cast<unsigned>(storePending()));
+    return false;
+  }
+#endif
+
+  SpiLease bus(SpiArbiter::SD);
+  if (!bus) {
+    return false;
+  }
 
-  resetSPI();
-  
   File32 file;
   if (!file.open(filename, O_READ)) {
     Serial.print("Binary read open failed: ");
@@ -230,10 +767,51 @@ bool SdManager::readBinaryFile(const char* filename, uint8_t* outBuffer, size_t
   return true;
 }
 
+// Exactly length bytes at offset, or false (the FEC repair path reads fragments back).
+bool SdManager::readBinaryFile(const char* filename, uint32_t offset, uint8_t* outBuffer, size_t length) {
+  if (!_ready || !filename || !outBuffer) {
+    return false;
+  }
+  if (!hasBinExtension(filename)) {
+    Serial.println("Binary read rejected: filename must end with .bin");
+    return false;
+  }
+#if MESH_DUAL_CORE
+  // What was queued must be on the card before it is read back.
+  if (!waitStoreDrained()) {
+    Serial.printf("[SD] read of %s refused: %u queued writes still pending\n", filename,
+                  static_cast<unsigned>(storePending()));
+    return false;
+  }
+#endif
+
+  SpiLease bus(SpiArbiter::SD);
+  if (!bus) {
+    return false;
+  }
+
+  File32 file;
+  if (!file.open(filename, O_READ)) {
+    Serial.print("Binary read open failed: ");
+    Serial.println(filename);
+    return false;
+  }
+
+  const bool ok = file.seekSet(offset) && file.read(outBuffer, length) == static_cast<int>(length);
+  file.close();
+  if (!ok) {
+    Serial.printf("Binary read short at offset %lu\n", static_cast<unsigned long>(offset));
+  }
+  return ok;
+}
+
 bool SdManager::writeLogHeader() {
-  resetSPI();
+  SpiLease bus(SpiArbiter::SD);
+  if (!bus) {
+    return false;
+  }
   // O_EXCL ensures we only write the header if the file doesn't exist yet
-  if (!_logFile.open("lora_log.csv", O_WRITE | O_CREAT | O_EXCL)) return false;
+  if (!_logFile.open(kLogFileName, O_WRITE | O_CREAT | O_EXCL)) return false;
   _writeLogHeader(_logFile);
   _logFile.close();
   return true;
@@ -242,77 +820,298 @@ bool SdManager::writeLogHeader() {
 bool SdManager::logTransmission(float lat, float lon, uint32_t txTime,
                                  uint32_t ackTime, int rssi, float snr,
                                  uint16_t sessionId, uint16_t seqNum, int16_t fragIndex, uint16_t fragLen,
-                                 const char* packetType, const char* status) {
+                                 uint8_t packetType, LogStatus status, uint8_t retryIndex,
+                                 uint32_t rtoMs, uint32_t toaMs, uint32_t txMs, bool duplicate) {
   if (!_ready) {
-    Serial.println("Log skipped: SD not ready");
     return false;
   }
 
-  resetSPI();
-  
-  if (!_ensureLogFile()) {
-    Serial.println("Log open failed");
+  LogRow* slot = _logRing.claim();
+  if (slot == nullptr) {
+    // Never block the caller on the card; the counter shows up in every flush line.
+    _logDropped++;
     return false;
   }
 
-  LogRow row{
-    .nowMs  = millis(),
-    .txTime = txTime,
-    .ackTime = ackTime,
-    .rttMs  = static_cast<int32_t>(ackTime) - static_cast<int32_t>(txTime),
-    .runId = MESH_RUN_ID,
-    .role = MESH_LOG_ROLE,
-    .nodeId = static_cast<uint8_t>(MESH_NODE_ID),
-    .sf = static_cast<uint8_t>(MESH_LORA_SF),
-    .ackTimeoutMs = static_cast<uint32_t>(MESH_ACK_TIMEOUT_MS),
-    .lat    = lat,
-    .lon    = lon,
-    .rssi   = rssi,
-    .snr    = snr,
-    .sessionId = sessionId,
-    .seqNum = seqNum,
-    .fragIndex = fragIndex,
-    .fragLen = fragLen,
-    .packetType = packetType ? packetType : "GENERIC",
-    .status = status ? status : "UNKNOWN"
-  };
+  LogRow& row = *slot;
+  row.nowMs = millis();
+  row.txTime = txTime;
+  row.ackTime = ackTime;
+  row.rttMs = static_cast<int32_t>(ackTime) - static_cast<int32_t>(txTime);
+  row.runId = MESH_RUN_ID;
+  row.role = MESH_LOG_ROLE;
+  row.nodeId = static_cast<uint8_t>(MESH_NODE_ID);
+  row.sf = _linkSf;
+  row.ackTimeoutMs = static_cast<uint32_t>(MESH_ACK_TIMEOUT_MS);
+  row.rtoMs = rtoMs;
+  row.toaMs = static_cast<uint16_t>((toaMs < UINT16_MAX) ? toaMs : UINT16_MAX);
+  row.txMs = static_cast<uint16_t>((txMs < UINT16_MAX) ? txMs : UINT16_MAX);
+  row.transferMode = (MESH_TRANSFER_MODE == MESH_TRANSFER_MODE_SELECTIVE_REPEAT) ? "SR" : "SAW";
+  row.lat = lat;
+  row.lon = lon;
+  row.rssi = rssi;
+  row.snr = snr;
+  row.sessionId = sessionId;
+  row.seqNum = seqNum;
+  row.fragIndex = fragIndex;
+  row.fragLen = fragLen;
+  row.packetType = packetType;
+  row.status = status;
+  row.retry = retryIndex;
+  row.duplicate = duplicate;
+  _logRing.commit();
+  return true;
+}
+
+bool SdManager::serviceLog() {
+  if (!_ready || !_onWriter()) {
+    return true;
+  }
+  if (_flushRequested.exchange(false)) {
+    return _drainLog(MESH_LOG_RING_ROWS, true);
+  }
+  const LogRow* oldest = _logRing.front();
+  if (oldest == nullptr && _logBatchLen == 0) {
+    return true;
+  }
 
-  quiesceSharedSpiDevices();
+  const uint32_t now = millis();
+  const bool aged = (oldest != nullptr)
+                      ? (now - oldest->nowMs >= MESH_LOG_FLUSH_MS)
+                      : (now - _logBatchSinceMs >= MESH_LOG_FLUSH_MS);
+  if (_logRing.size() < MESH_LOG_FLUSH_ROWS && !aged) {
+    return true;
+  }
+  return _drainLog(MESH_LOG_MAX_ROWS_PER_FLUSH, aged);
+}
 
-  bool writeOk = _writeLogRow(_logFile, row);
+bool SdManager::flushLog() {
+  if (!_ready) {
+    return false;
+  }
+  if (!_onWriter()) {
+    _flushRequested = true;   // the writer's next serviceLog() does it
+    return true;
+  }
+  return _drainLog(MESH_LOG_RING_ROWS, true);
+}
 
-  if (!writeOk) {
-    Serial.printf("[SD] LOG WRITE RETRY type=%s status=%s seq=%u frag=%d len=%u write=%s\n",
-                  row.packetType, row.status, row.seqNum, row.fragIndex, row.fragLen,
-                  writeOk ? "OK" : "FAIL");
+bool SdManager::_onWriter() const {
+  return _writer == nullptr || _writer == xTaskGetCurrentTaskHandle();
+}
 
-    if (_logFile.isOpen()) {
-      _logFile.close();
-      digitalWrite(SD_CS, HIGH);
+#if MESH_DUAL_CORE
+bool SdManager::_writeBehind() const {
+  return _writer != nullptr && _writer != xTaskGetCurrentTaskHandle();
+}
+
+/**
+ * Hand a payload write to the writer task. A fragment that finds the queue
+ * full is refused (the reassembler reports STORAGE_FAIL and the sender
+ * resends); truncates and appends wait for room so they stay in order.
+ * Writes too large for a record go straight to the card once the queue
+ * has drained.
+ */
+bool SdManager::_queueStore(const char* filename, StoreMode mode, uint32_t offset,
+                            const uint8_t* data, size_t length) {
+  if (length > sizeof(StoreRecord::data) || strlen(filename) >= sizeof(StoreRecord::file)) {
+    if (!waitStoreDrained()) {
+      Serial.printf("[SD] direct write of %s refused: %u queued writes still pending\n", filename,
+                    static_cast<unsigned>(storePending()));
+      return false;
     }
+    return (mode == STORE_AT) ? _writeFileAt(filename, offset, data, length)
+                              : _writeFile(filename, data, length, mode == STORE_APPEND);
+  }
 
-    if (_sd.sdErrorCode() == kSdCmd18Error) {
-      Serial.println("[SD] CMD18 transport error detected, remounting SD and resetting SPI...");
-      resetSPI();
-      quiesceSharedSpiDevices();
-      SdSpiConfig recoverCfg(SD_CS, SHARED_SPI, SD_SCK_MHZ(2), &_spiSD);
-      if (_sd.begin(recoverCfg)) {
-        _logHeaderChecked = false;
+  StoreRecord* rec = _store.claim();
+  const uint32_t startMs = millis();
+  while (rec == nullptr && mode != STORE_AT && millis() - startMs < MESH_SPI_LEASE_MS) {
+    vTaskDelay(1);
+    rec = _store.claim();
+  }
+  if (rec == nullptr) {
+    Serial.printf("[SD] store queue full, refused %s @%lu\n", filename, static_cast<unsigned long>(offset));
+    return false;
+  }
+  memcpy(rec->file, filename, strlen(filename) + 1);  // length checked above
+  rec->offset = offset;
+  rec->len = static_cast<uint16_t>(length);
+  rec->mode = mode;
+  memcpy(rec->data, data, length);
+  _store.commit();
+  return true;
+}
+
+uint16_t SdManager::serviceStore() {
+  uint16_t written = 0;
+  while (StoreRecord* rec = _store.front()) {
+    const bool ok = (rec->mode == STORE_AT)
+                      ? _writeFileAt(rec->file, rec->offset, rec->data, rec->len)
+                      : _writeFile(rec->file, rec->data, rec->len, rec->mode == STORE_APPEND);
+    if (!ok) {
+      // Already ACKed: the radio core has to hear about it to ask again.
+      // With no room to report it the record stays put and is retried.
+      StoreFailure* failed = _storeFailures.claim();
+      if (failed == nullptr) {
+        break;
       }
+      memcpy(failed->file, rec->file, sizeof(failed->file));
+      failed->offset = rec->offset;
+      failed->len = rec->len;
+      _storeFailures.commit();
+      _storeFailed++;
+      Serial.printf("[SD] write-behind failed %s @%lu\n", rec->file, static_cast<unsigned long>(rec->offset));
     }
+    _store.pop();
+    written++;
+  }
+  return written;
+}
 
-    resetSPI();
-    if (_ensureLogFile()) {
-      writeOk = _writeLogRow(_logFile, row);
+bool SdManager::takeStoreFailure(StoreFailure& out) {
+  const StoreFailure* failed = _storeFailures.front();
+  if (failed == nullptr) {
+    return false;
+  }
+  out = *failed;
+  _storeFailures.pop();
+  return true;
+}
+
+// A failure is reported before its record leaves the queue, so once this
+// returns true takeStoreFailure() has every failure there is.
+bool SdManager::waitStoreDrained() {
+  const uint32_t startMs = millis();
+  while (_writeBehind() && !_store.empty() && millis() - startMs < MESH_SPI_LEASE_MS) {
+    vTaskDelay(1);
+  }
+  return !_writeBehind() || _store.empty();
+}
+#endif
+
+bool SdManager::_drainLog(uint16_t maxRows, bool syncTail) {
+  SpiLease bus(SpiArbiter::SD);
+  if (!bus) {
+    return false;
+  }
+
+  if (!_ensureLogFile()) {
+    Serial.println("Log open failed");
+    return false;
+  }
+
+  uint16_t rows = 0;
+  bool ok = true;
+
+  while (rows < maxRows) {
+    const LogRow* row = _logRing.front();
+    if (row == nullptr) {
+      break;
+    }
+#if MESH_LOG_FORMAT == MESH_LOG_FORMAT_BINARY
+    // Run metadata goes out once per boot instead of on every row, and
+    // again whenever ADR has moved the SF the following rows ran at.
+    const uint8_t rowSf = row->sf;
+    if (!_logMetaWritten || rowSf != _logMetaSf) {
+      char meta[sizeof(LogMetaRecord)];
+      const size_t metaLen = _encodeLogMeta(rowSf, meta, sizeof(meta));
+      if (_logBatchLen == 0) {
+        _logBatchSinceMs = millis();
+      }
+      if (!_appendLogBytes(meta, metaLen)) {
+        ok = false;
+        break;
+      }
+      _logMetaWritten = true;
+      _logMetaSf = rowSf;
+    }
+#endif
+    char line[320];
+#if MESH_LOG_FORMAT == MESH_LOG_FORMAT_BINARY
+    const size_t len = _encodeLogRow(*row, line, sizeof(line));
+#else
+    const size_t len = _formatLogRow(*row, line, sizeof(line));
+#endif
+    _logRing.pop();
+    rows++;
+
+    if (_logBatchLen == 0) {
+      _logBatchSinceMs = millis();
+    }
+    _logBatchRows++;
+    if (!_appendLogBytes(line, len)) {
+      ok = false;
+      break;
+    }
+  }
+
+  // The partial tail is only written once the queue is drained; everything
+  // before it has gone out as whole sectors.
+  if (ok && syncTail && _logRing.empty() && _logBatchLen > 0) {
+    const uint16_t tailRows = _logBatchRows;
+    ok = _writeLogBatch(_logBatchLen);
+    if (ok) {
+      _logBatchRows = 0;
     } else {
-      writeOk = false;
+      _logDropped += tailRows;
+      _logBatchLen = 0;
+      _logBatchRows = 0;
+    }
+  }
+
+  if (ok && _logFile.isOpen()) {
+    _logFile.flush();
+  }
+
+  Serial.printf("[SD] LOG flush rows=%u pending=%u buffered=%u dropped=%lu %s\n",
+                static_cast<unsigned>(rows), static_cast<unsigned>(_logRing.size()),
+                static_cast<unsigned>(_logBatchLen), static_cast<unsigned long>(_logDropped.load()),
+                ok ? "OK" : "FAIL");
+  return ok;
+}
+
+bool SdManager::_appendLogBytes(const char* data, size_t len) {
+  while (len > 0) {
+    // The first write after opening only tops the file up to a sector
+    // boundary; after that every write is a full, aligned sector.
+    const size_t target = kLogSectorBytes - (_logFilePos % kLogSectorBytes);
+    const size_t room = target - _logBatchLen;
+    const size_t take = (len < room) ? len : room;
+    memcpy(_logBatch + _logBatchLen, data, take);
+    _logBatchLen += take;
+    data += take;
+    len -= take;
+
+    if (_logBatchLen == target) {
+      if (!_writeLogBatch(target)) {
+        // Every row with bytes in the lost batch is counted, including the one
+        // that was being appended.
+        _logDropped += _logBatchRows;
+        _logBatchLen = 0;
+        _logBatchRows = 0;
+        return false;
+      }
+      _logBatchRows = (len > 0) ? 1 : 0;
+      _logBatchSinceMs = millis();
     }
   }
+  return true;
+}
+
+bool SdManager::_writeLogBatch(size_t len) {
+  PROFILE_SCOPE(PROFILE_SD_LOG);
+  bool writeOk = _logFile.isOpen() && _logFile.write(_logBatch, len) == len;
+
+  if (!writeOk) {
+    Serial.printf("[SD] LOG WRITE RETRY bytes=%u\n", static_cast<unsigned>(len));
+    _recoverLogFile();
+    writeOk = _ensureLogFile() && _logFile.write(_logBatch, len) == len;
+  }
 
   if (!writeOk) {
-    Serial.printf("[SD] LOG WRITE FAIL type=%s status=%s seq=%u frag=%d len=%u tx=%lu ack=%lu write=%s\n",
-                  row.packetType, row.status, row.seqNum, row.fragIndex, row.fragLen,
-                  row.txTime, row.ackTime, writeOk ? "OK" : "FAIL");
+    Serial.printf("[SD] LOG WRITE FAIL bytes=%u rows=%u\n",
+                  static_cast<unsigned>(len), static_cast<unsigned>(_logBatchRows));
     Serial.print("[SD] Error code: ");
     Serial.println(_sd.sdErrorCode(), HEX);
     Serial.print("[SD] Error detail: ");
@@ -320,16 +1119,27 @@ bool SdManager::logTransmission(float lat, float lon, uint32_t txTime,
     return false;
   }
 
-  Serial.printf("[SD] LOG WRITE OK type=%s status=%s sid=%u seq=%u frag=%d len=%u tx=%lu ack=%lu rtt=%ldms RSSI=%d SNR=%.1f\n",
-                row.packetType, row.status, row.sessionId, row.seqNum, row.fragIndex, row.fragLen,
-                row.txTime, row.ackTime, row.rttMs, row.rssi, row.snr);
-  Serial.printf("[SD] CSV: %lu,%lu,%lu,%ld,%.6f,%.6f,%d,%.1f,%u,%u,%d,%u,%s,%s\n",
-                row.nowMs, row.txTime, row.ackTime, row.rttMs,
-                row.lat, row.lon, row.rssi, row.snr,
-                row.sessionId, row.seqNum, row.fragIndex, row.fragLen, row.packetType, row.status);
+  _logFilePos += len;
+  _logBatchLen = 0;
   return true;
 }
 
+void SdManager::_recoverLogFile() {
+  if (_logFile.isOpen()) {
+    _logFile.close();
+    digitalWrite(SD_CS, HIGH);
+  }
+
+  if (_sd.sdErrorCode() == kSdCmd18Error) {
+    Serial.println("[SD] CMD18 transport error detected, remounting SD...");
+    SpiArbiter::noteRecovery(SpiArbiter::SD);
+    SdSpiConfig recoverCfg(SD_CS, kSdSpiOption, SD_SCK_MHZ(2), &_spiSD);
+    if (_sd.begin(recoverCfg)) {
+      _logHeaderChecked = false;
+    }
+  }
+}
+
 // Helpers to keep CSV order consistent and avoid brittle manual prints
 namespace {
   constexpr const char* LOG_COLUMNS[] = {
@@ -345,6 +1155,10 @@ namespace {
     "node_id",
     "sf",
     "ack_timeout_ms",
+    "rto_ms",
+    "toa_ms",
+    "tx_ms",
+    "transfer_mode",
     "lat",
     "lon",
     "rssi",
@@ -354,11 +1168,12 @@ namespace {
     "frag_index",
     "frag_len",
     "packet_type",
-    "status"
+    "status",
+    "dup"
   };
   constexpr size_t LOG_COLUMN_COUNT = sizeof(LOG_COLUMNS) / sizeof(LOG_COLUMNS[0]);
   constexpr const char* EXPECTED_LOG_HEADER =
-    "timestamp_utc,millis,tx_time_utc,tx_time,ack_time_utc,ack_time,rtt_ms,run_id,role,node_id,sf,ack_timeout_ms,lat,lon,rssi,snr,session_id,seq_num,frag_index,frag_len,packet_type,status";
+    "timestamp_utc,millis,tx_time_utc,tx_time,ack_time_utc,ack_time,rtt_ms,run_id,role,node_id,sf,ack_timeout_ms,rto_ms,toa_ms,tx_ms,transfer_mode,lat,lon,rssi,snr,session_id,seq_num,frag_index,frag_len,packet_type,status,dup";
 }
 
 void SdManager::_initializeTimeBase() {
@@ -398,34 +1213,32 @@ void SdManager::_formatIso8601(uint64_t epochMs, char* out, size_t outLen) const
 }
 
 bool SdManager::_ensureLogFile() {
-  quiesceSharedSpiDevices();
-
   if (_logFile.isOpen()) {
     return true;
   }
 
   if (!_logHeaderChecked) {
-    if (_sd.exists("lora_log.csv") && !_hasExpectedLogHeader()) {
-      const char* legacyName = "lora_log_legacy.csv";
-      if (_sd.exists(legacyName)) {
-        _sd.remove(legacyName);
+    if (_sd.exists(kLogFileName) && !_hasExpectedLogHeader()) {
+      if (_sd.exists(kLogLegacyName)) {
+        _sd.remove(kLogLegacyName);
       }
 
-      if (!_sd.rename("lora_log.csv", legacyName)) {
-        Serial.println("[SD] Failed to rotate legacy CSV header");
+      if (!_sd.rename(kLogFileName, kLogLegacyName)) {
+        Serial.println("[SD] Failed to rotate legacy log header");
         return false;
       }
-      Serial.println("[SD] Rotated legacy CSV to lora_log_legacy.csv");
+      Serial.printf("[SD] Rotated legacy log to %s\n", kLogLegacyName);
     }
 
     const bool headerCreated = writeLogHeader();
     if (headerCreated) {
-      Serial.println("[SD] Created lora_log.csv with header");
+      Serial.printf("[SD] Created %s with header\n", kLogFileName);
+      _logMetaWritten = false;  // a fresh file needs its own run metadata
     }
     _logHeaderChecked = true;
   }
 
-  if (!_logFile.open("lora_log.csv", O_WRITE | O_CREAT | O_APPEND)) {
+  if (!_logFile.open(kLogFileName, O_WRITE | O_CREAT | O_APPEND)) {
     Serial.print("File open error: ");
     Serial.println(_sd.sdErrorCode(), HEX);
     Serial.print("File open error sym: ");
@@ -436,17 +1249,28 @@ bool SdManager::_ensureLogFile() {
     Serial.println(_sd.sectorsPerCluster());
     return false;
   }
+  _logFilePos = _logFile.fileSize();
 
   return true;
 }
 
 bool SdManager::_hasExpectedLogHeader() {
   File32 headerFile;
-  if (!headerFile.open("lora_log.csv", O_READ)) {
+  if (!headerFile.open(kLogFileName, O_READ)) {
     return false;
   }
 
-  char headerLine[196];
+#if MESH_LOG_FORMAT == MESH_LOG_FORMAT_BINARY
+  LogFileHeader header = {};
+  const bool complete = headerFile.read(&header, sizeof(header)) == static_cast<int>(sizeof(header));
+  headerFile.close();
+
+  // Any layout change rotates the file rather than mixing record sizes.
+  return complete && header.magic == LOG_BIN_MAGIC && header.version == LOG_BIN_VERSION &&
+         header.headerLen == sizeof(LogFileHeader) && header.metaLen == sizeof(LogMetaRecord) &&
+         header.rowLen == sizeof(LogRowRecord);
+#else
+  char headerLine[256];
   size_t index = 0;
   while (headerFile.available() && index < (sizeof(headerLine) - 1)) {
     const int raw = headerFile.read();
@@ -465,18 +1289,27 @@ bool SdManager::_hasExpectedLogHeader() {
   headerFile.close();
 
   return strcmp(headerLine, EXPECTED_LOG_HEADER) == 0;
+#endif
 }
 
 void SdManager::_writeLogHeader(File32& file) {
+#if MESH_LOG_FORMAT == MESH_LOG_FORMAT_BINARY
+  LogFileHeader header = {};
+  header.magic = LOG_BIN_MAGIC;
+  header.version = LOG_BIN_VERSION;
+  header.headerLen = sizeof(LogFileHeader);
+  header.metaLen = sizeof(LogMetaRecord);
+  header.rowLen = sizeof(LogRowRecord);
+  file.write(&header, sizeof(header));
+#else
   for (size_t i = 0; i < LOG_COLUMN_COUNT; ++i) {
     file.print(LOG_COLUMNS[i]);
     file.print((i + 1 < LOG_COLUMN_COUNT) ? ',' : '\n');
   }
+#endif
 }
 
-bool SdManager::_writeLogRow(File32& file, const LogRow& row) {
-  const float lat = row.lat;
-  const float lon = row.lon;
+size_t SdManager::_formatLogRow(const LogRow& row, char* out, size_t outLen) const {
   char nowIso[kIso8601BufferLen];
   char txIso[kIso8601BufferLen];
   char ackIso[kIso8601BufferLen];
@@ -485,44 +1318,80 @@ bool SdManager::_writeLogRow(File32& file, const LogRow& row) {
   _formatIso8601(_toEpochMs(row.txTime), txIso, sizeof(txIso));
   _formatIso8601(_toEpochMs(row.ackTime), ackIso, sizeof(ackIso));
 
-  bool ok = true;
+  // Same order as LOG_COLUMNS; lat/lon at 6 decimals and snr at 2, as
+  // Print::print(float) wrote them before rows were batched.
+  const int n = snprintf(out, outLen,
+                         "%s,%lu,%s,%lu,%s,%lu,%ld,%s,%s,%u,%u,%lu,%lu,%u,%u,%s,%.6f,%.6f,%d,%.2f,%u,%u,%d,%u,%s,%s,%u\r\n",
+                         nowIso, static_cast<unsigned long>(row.nowMs),
+                         txIso, static_cast<unsigned long>(row.txTime),
+                         ackIso, static_cast<unsigned long>(row.ackTime),
+                         static_cast<long>(row.rttMs),
+                         row.runId, row.role,
+                         static_cast<unsigned>(row.nodeId), static_cast<unsigned>(row.sf),
+                         static_cast<unsigned long>(row.ackTimeoutMs),
+                         static_cast<unsigned long>(row.rtoMs),
+                         static_cast<unsigned>(row.toaMs), static_cast<unsigned>(row.txMs),
+                         row.transferMode,
+                         static_cast<double>(row.lat), static_cast<double>(row.lon),
+                         row.rssi, static_cast<double>(row.snr),
+                         static_cast<unsigned>(row.sessionId), static_cast<unsigned>(row.seqNum),
+                         static_cast<int>(row.fragIndex), static_cast<unsigned>(row.fragLen),
+                         logPacketTypeText(row.packetType), logStatusText(row.status, row.retry).c_str(),
+                         row.duplicate ? 1U : 0U);
+  if (n < 0) {
+    return 0;
+  }
+  return (static_cast<size_t>(n) < outLen) ? static_cast<size_t>(n) : outLen - 1;
+}
 
-  auto mustWrite = [&](size_t count) {
-    if (count == 0) {
-      ok = false;
-    }
-  };
+size_t SdManager::_encodeLogRow(const LogRow& row, char* out, size_t outLen) const {
+  if (outLen < sizeof(LogRowRecord)) {
+    return 0;
+  }
 
-  // Print in the exact same order as LOG_COLUMNS
-  mustWrite(file.print(nowIso)); mustWrite(file.print(','));
-  mustWrite(file.print(row.nowMs)); mustWrite(file.print(','));
-  mustWrite(file.print(txIso)); mustWrite(file.print(','));
-  mustWrite(file.print(row.txTime)); mustWrite(file.print(','));
-  mustWrite(file.print(ackIso)); mustWrite(file.print(','));
-  mustWrite(file.print(row.ackTime)); mustWrite(file.print(','));
-  mustWrite(file.print(row.rttMs)); mustWrite(file.print(','));
-  mustWrite(file.print(row.runId)); mustWrite(file.print(','));
-  mustWrite(file.print(row.role)); mustWrite(file.print(','));
-  mustWrite(file.print(row.nodeId)); mustWrite(file.print(','));
-  mustWrite(file.print(row.sf)); mustWrite(file.print(','));
-  mustWrite(file.print(row.ackTimeoutMs)); mustWrite(file.print(','));
-  mustWrite(file.print(lat, 6)); mustWrite(file.print(','));
-  mustWrite(file.print(lon, 6)); mustWrite(file.print(','));
-  mustWrite(file.print(row.rssi)); mustWrite(file.print(','));
-  mustWrite(file.print(row.snr)); mustWrite(file.print(','));
-  mustWrite(file.print(row.sessionId)); mustWrite(file.print(','));
-  mustWrite(file.print(row.seqNum)); mustWrite(file.print(','));
-  mustWrite(file.print(row.fragIndex)); mustWrite(file.print(','));
-  mustWrite(file.print(row.fragLen)); mustWrite(file.print(','));
-  mustWrite(file.print(row.packetType)); mustWrite(file.print(','));
-  mustWrite(file.println(row.status));
+  LogRowRecord rec = {};
+  rec.tag = LOG_TAG_ROW;
+  rec.nowMs = row.nowMs;
+  rec.txTime = row.txTime;
+  rec.ackTime = row.ackTime;
+  rec.rtoMs = row.rtoMs;
+  rec.toaMs = row.toaMs;
+  rec.txMs = row.txMs;
+  rec.lat = row.lat;
+  rec.lon = row.lon;
+  rec.snr = row.snr;
+  rec.rssi = static_cast<int16_t>(row.rssi);
+  rec.sessionId = row.sessionId;
+  rec.seqNum = row.seqNum;
+  rec.fragIndex = row.fragIndex;
+  rec.fragLen = row.fragLen;
+  // rec is zeroed and both copies stop short of the last byte, so the fields
+  // stay NUL-terminated and stale ring bytes never reach the card.
+  strncpy(rec.packetType, logPacketTypeText(row.packetType), sizeof(rec.packetType) - 1);
+  const LogStatusText status = logStatusText(row.status, row.retry);
+  static_assert(LogStatusText::capacity() < sizeof(rec.status), "status text must fit with its NUL");
+  memcpy(rec.status, status.c_str(), status.length());
+  rec.dup = row.duplicate ? 1 : 0;
+  memcpy(out, &rec, sizeof(rec));
+  return sizeof(rec);
+}
 
-  if (!ok) {
-    return false;
+size_t SdManager::_encodeLogMeta(uint8_t sf, char* out, size_t outLen) const {
+  if (outLen < sizeof(LogMetaRecord)) {
+    return 0;
   }
 
-  file.flush();
-  return file.isOpen();
+  LogMetaRecord rec = {};
+  rec.tag = LOG_TAG_META;
+  rec.epochBaseMs = _epochBaseMs;
+  rec.nodeId = static_cast<uint8_t>(MESH_NODE_ID);
+  rec.sf = sf;
+  rec.transferMode = static_cast<uint8_t>(MESH_TRANSFER_MODE);
+  rec.ackTimeoutMs = static_cast<uint32_t>(MESH_ACK_TIMEOUT_MS);
+  strncpy(rec.runId, MESH_RUN_ID, sizeof(rec.runId) - 1);
+  strncpy(rec.role, MESH_LOG_ROLE, sizeof(rec.role) - 1);
+  memcpy(out, &rec, sizeof(rec));
+  return sizeof(rec);
 }
 
 /*
@@ -3,6 +3,12 @@
 #include <SdFat.h>
 #include <SPI.h>
 #include <stdint.h>
+#include <atomic>
+#include "../models/packet.h"
+#include "LogFormat.h"
+#include "LogStatus.h"
+#include "../codec/ImaAdpcm.h"
+#include "../util/SpscQueue.h"
 #include "../../mesh_role_config.h"
 
 // Heltex ESP32 LoRa V3 SDI pins
@@ -12,25 +18,95 @@
 #define SD_SCK 36
 
 struct AudioPacket {
-  uint8_t buffer[128];  // generic transport chunk; payload is pre-converted .bin data
+  uint8_t buffer[LORA_MAX_DATA_PAYLOAD];  // one DATA fragment of pre-converted .bin data
   int bytesRead;
 };
 
+// Size, fragment count and CRC32 of a payload file, as AUDIO_START needs
+// them. Cached in RAM and in a "<file>.meta" sidecar keyed by size + mtime.
+// For CODEC_COMPRESSED, size and totalFrags describe the encoded stream and
+// the CRC32 is only known once it has been read (SdManager::streamCrc32).
+struct PayloadMeta {
+  uint32_t size;
+  uint16_t totalFrags;   // at chunkSize()
+  uint32_t crc32;        // 0 for CODEC_COMPRESSED
+  uint32_t sourceSize;   // bytes in the file (16-bit PCM when compressed)
+  uint32_t modified;     // FAT (date << 16) | time
+  bool     cached;       // true = no full-file scan was needed
+};
+
 class SdManager {
   public:
     SdManager();
     bool init();
-    void resetSPI();
     bool openAudioFile(const char* filename);
+    bool openAudioFile(const char* filename, PayloadMeta& meta);  // opens + describes, rewound to 0
     bool readAudioChunk(AudioPacket& packet); // returns false when EOF
-    void closeAudioFile();
+    // Up to chunkSize() bytes into dst (e.g. a TX frame's payload area); false at EOF.
+    // CODEC_COMPRESSED reads one block of PCM and encodes it into dst.
+    bool readAudioChunk(uint8_t* dst, uint16_t& bytesRead);
+    // Next readAudioChunk() returns fragment frag (a resumed transfer skips
+    // what the receiver already holds). Compressed payloads encode their way
+    // there, so streamCrc32() still covers every fragment before frag.
+    bool seekAudioChunk(uint16_t frag);
+    uint16_t nextChunk() const { return _nextChunk; }
+    void setChunkSize(uint16_t bytes);        // clamped to 1..sizeof(AudioPacket::buffer)
+    uint16_t chunkSize() const { return _chunkSize; }
+    // CODEC_RAW_PCM sends the file as is; CODEC_COMPRESSED IMA-ADPCM encodes it.
+    void setPayloadCodec(uint8_t codec) { _payloadCodec = codec; }
+    uint8_t payloadCodec() const { return _payloadCodec; }
+    // CRC32 of every chunk returned since the payload was opened.
+    uint32_t streamCrc32() const { return _streamCrc; }
+    uint32_t encodeUs() const { return _encodeUs; }  // total ADPCM encode time this payload
+    // Tops up the payload read-ahead buffers; call while the radio is busy
+    // (LoRaManager::onIdle) and from the idle loop. Cheap when they are full.
+    bool serviceReadAhead();
+    void closeAudioFile();   // prints the read-ahead counters for the payload
     bool writeBinaryFile(const char* filename, const uint8_t* data, size_t length, bool append = false);
+    bool writeBinaryFile(const char* filename, uint32_t offset, const uint8_t* data, size_t length);
+    bool writeProfile(const char* rows, size_t length);  // StageProfiler CSV rows, appended to lora_prof.csv
+    bool writeSessions(const char* rows, size_t length); // SessionTable CSV rows, appended to lora_sessions.csv
     bool readBinaryFile(const char* filename, uint8_t* outBuffer, size_t maxLength, size_t& bytesRead);
+    bool readBinaryFile(const char* filename, uint32_t offset, uint8_t* outBuffer, size_t length);
     void getAudio();
     bool writeLogHeader();
+    // Queues one row in RAM; false (and logDropped() bumped) when the ring is full.
+    // packetType is a PKT_* value (0 logs as GENERIC); the packet_type and
+    // status text is produced when the row is written, not here.
     bool logTransmission(float lat, float lon, uint32_t txTime, uint32_t ackTime, int rssi, float snr,
            uint16_t sessionId, uint16_t seqNum, int16_t fragIndex, uint16_t fragLen,
-           const char* packetType = "GENERIC", const char* status = "UNKNOWN");
+           uint8_t packetType = 0, LogStatus status = LOG_STATUS_UNKNOWN,
+           uint8_t retryIndex = 0,   // sender attempt, written as the status "_R<n>" suffix
+           uint32_t rtoMs = 0,   // ACK deadline this attempt used, from txTime (0 = none)
+           uint32_t toaMs = 0,   // modeled time on air of the frame sent (LoRaManager::lastToaMs)
+           uint32_t txMs = 0,    // and its measured send-to-TxDone time (lastTxMs)
+           bool duplicate = false);  // a retransmit already received (dup column)
+    bool serviceLog();   // call when idle: writes a bounded batch once the flush policy triggers
+    bool flushLog();     // writes every queued row and syncs the file (end of transfer)
+    uint16_t logPending() const { return _logRing.size(); }
+    uint32_t logDropped() const { return _logDropped.load(); }
+    // MESH_DUAL_CORE: only writer drains the log from now on. On any other
+    // task serviceLog() does nothing and flushLog() asks writer for a full
+    // flush on its next serviceLog(). Received payload writes queue for
+    // writer too (serviceStore()); reads wait until they have landed.
+    void setWriterTask(TaskHandle_t writer) { _writer = writer; }
+#if MESH_DUAL_CORE
+    // A queued write that failed on writer, after its fragment was ACKed.
+    // The radio core takes these and un-marks what they carried.
+    struct StoreFailure {
+      char     file[24];
+      uint32_t offset;
+      uint16_t len;
+    };
+    uint16_t serviceStore();   // writer: the queued payload writes, returns how many
+    uint16_t storePending() const { return _store.size(); }
+    uint32_t storeFailed() const { return _storeFailed; }
+    bool takeStoreFailure(StoreFailure& out);
+    // false when writer has not landed every queued write within MESH_SPI_LEASE_MS
+    bool waitStoreDrained();
+#endif
+    // SF stamped on rows queued from now on; ADR changes it at runtime.
+    void setLinkSf(uint8_t sf) { _linkSf = sf; }
     //bool printLogToSerial(size_t maxLines = 0);
     bool isReady() const { return _ready; }
 
@@ -45,6 +121,10 @@ class SdManager {
         uint8_t  nodeId;
         uint8_t  sf;
         uint32_t ackTimeoutMs;
+        uint32_t rtoMs;
+        uint16_t toaMs;
+        uint16_t txMs;
+        const char* transferMode;
         float    lat;
         float    lon;
         int      rssi;
@@ -53,15 +133,80 @@ class SdManager {
         uint16_t seqNum;
         int16_t  fragIndex;
         uint16_t fragLen;
-        const char* packetType;
-        const char* status;
+        uint8_t  packetType;
+        LogStatus status;
+        uint8_t  retry;
+        bool     duplicate;
       };
 
+      static constexpr size_t kLogSectorBytes = 512;
+
+#if MESH_DUAL_CORE
+      enum StoreMode : uint8_t { STORE_TRUNCATE, STORE_APPEND, STORE_AT };
+      // One received fragment (or its decoded PCM block) on its way to the card.
+      struct StoreRecord {
+        char     file[sizeof(StoreFailure::file)];
+        uint32_t offset;
+        uint16_t len;
+        StoreMode mode;
+        uint8_t  data[sizeof(int16_t) * imaAdpcmBlockSamples(LORA_MAX_DATA_PAYLOAD)];
+      };
+      bool _writeBehind() const;
+      bool _queueStore(const char* filename, StoreMode mode, uint32_t offset, const uint8_t* data, size_t length);
+#endif
+      bool _writeFile(const char* filename, const uint8_t* data, size_t length, bool append);
+      bool _writeFileAt(const char* filename, uint32_t offset, const uint8_t* data, size_t length);
+      bool _onWriter() const;
+      bool _appendCsv(const char* filename, const char* header, const char* rows, size_t length);
+
+      bool _drainLog(uint16_t maxRows, bool syncTail);
+      bool _appendLogBytes(const char* data, size_t len);
+      bool _writeLogBatch(size_t len);
+      void _recoverLogFile();
+
       bool _ensureLogFile();
       bool _hasExpectedLogHeader();
       void _writeLogHeader(File32& file);
-      bool _writeLogRow(File32& file, const LogRow& row);
+      size_t _formatLogRow(const LogRow& row, char* out, size_t outLen) const;
+      size_t _encodeLogRow(const LogRow& row, char* out, size_t outLen) const;
+      size_t _encodeLogMeta(uint8_t sf, char* out, size_t outLen) const;
       void _initializeTimeBase();
+      struct PayloadMetaRecord {
+        uint32_t magic;
+        uint32_t size;
+        uint32_t modified;
+        uint32_t crc32;
+        uint32_t tailCrc;  // crc32 of the bytes just before `size`, guards append-only updates
+      };
+
+      bool _describeAudioFile(const char* filename, PayloadMeta& meta);
+      bool _describeCompressed(uint32_t size, uint32_t modified, PayloadMeta& meta);
+      bool _loadMetaSidecar(const char* metaName, PayloadMetaRecord& rec);
+      bool _saveMetaSidecar(const char* metaName, const PayloadMetaRecord& rec);
+      bool _scanAudioFile(uint32_t from, uint32_t to, uint32_t& crc);
+      bool _tailCrc(uint32_t end, uint32_t& crc);
+
+      // One read-ahead buffer: file bytes [offset, offset + len), served from pos.
+      struct ReadBlock {
+        uint32_t offset;
+        uint16_t len;
+        uint16_t pos;
+        uint8_t  data[MESH_SD_READAHEAD_BYTES];
+      };
+      static_assert(MESH_SD_READAHEAD_BYTES >= 512 && MESH_SD_READAHEAD_BYTES % 512 == 0 &&
+                    MESH_SD_READAHEAD_BYTES <= 32768,
+                    "MESH_SD_READAHEAD_BYTES must be whole 512-byte sectors, at most 32 KiB");
+      struct ReadAheadStats {
+        uint32_t chunks;   // readAudioChunk() calls served
+        uint32_t stalls;   // times a chunk had to wait for a fill
+        uint32_t blocks;   // buffers filled
+        uint32_t bytes;
+        uint32_t fillUs;   // time spent in fills, inline or not
+      };
+      void _resetReadAhead();
+      bool _seekReadAhead(uint32_t offset);
+      bool _fillReadBlock();
+      size_t _readStream(uint8_t* dst, size_t want);
       uint64_t _toEpochMs(uint32_t msSinceBoot) const;
       void _formatIso8601(uint64_t epochMs, char* out, size_t outLen) const;
 
@@ -69,12 +214,46 @@ class SdManager {
       File32 _audioFile;
       File32 _logFile;
 
-      // FSPI - Means Fast SPI
+      // HSPI - the radio stays on the default SPI host
       SPIClass _spiSD; // This is the SPI controller for the SD card
 
       bool _ready = false;
+      uint16_t _chunkSize = sizeof(AudioPacket::buffer);
+      uint8_t _payloadCodec = CODEC_RAW_PCM;
+      uint8_t _adpcmIndex = 0;        // step index carried from block to block
+      uint32_t _streamCrc = 0;
+      uint32_t _encodeUs = 0;
+      uint16_t _nextChunk = 0;        // fragment the next readAudioChunk() returns
+      int16_t _pcmBlock[imaAdpcmBlockSamples(LORA_MAX_DATA_PAYLOAD)];
+      // Filled and drained by the task sending the payload; the queue only
+      // keeps buffer order and never hands one out half filled.
+      SpscQueue<ReadBlock, MESH_SD_READAHEAD_BUFS> _readAhead;
+      uint32_t _readAheadNext = 0;    // file offset of the next buffer to fill
+      bool _readAheadEof = false;
+      ReadAheadStats _readAheadStats = {};
+      PayloadMetaRecord _metaCache = {};
+      char _metaCacheName[64] = {0};
       bool _logHeaderChecked = false;
+
+      // Log rows wait here until serviceLog()/flushLog(); the batch collects
+      // formatted bytes so the card sees whole, sector-aligned writes.
+      // Single producer (logTransmission) and single consumer (_drainLog).
+      SpscQueue<LogRow, MESH_LOG_RING_ROWS> _logRing;
+      std::atomic<uint32_t> _logDropped{0};
+      TaskHandle_t _writer = nullptr;
+      std::atomic<bool> _flushRequested{false};
+#if MESH_DUAL_CORE
+      SpscQueue<StoreRecord, MESH_STORE_QUEUE_DEPTH> _store;
+      SpscQueue<StoreFailure, MESH_STORE_QUEUE_DEPTH> _storeFailures;  // writer -> radio core
+      uint32_t _storeFailed = 0;
+#endif
+      char _logBatch[kLogSectorBytes];
+      size_t _logBatchLen = 0;
+      uint16_t _logBatchRows = 0;     // rows with bytes in _logBatch
+      uint32_t _logBatchSinceMs = 0;
+      uint32_t _logFilePos = 0;       // end of the log file, for sector alignment
+      bool _logMetaWritten = false;   // binary format: this boot's LogMetaRecord queued
+      uint8_t _logMetaSf = 0;         // binary format: sf of the last LogMetaRecord
+      uint8_t _linkSf = MESH_LORA_SF;
       uint64_t _epochBaseMs = 0;
 };
-
-enum LogStatus { LOG_OK, LOG_FAIL };
@@ -0,0 +1,188 @@
+#include "Crc.h"
+#include <string.h>
+
+#if MESH_CRC_USE_ROM
+#include <esp_rom_crc.h>
+#endif
+
+namespace {
+  constexpr uint32_t kCrc32Poly = 0xEDB88320UL;  // reflected 0x04C11DB7
+  constexpr uint16_t kCrc16Poly = 0x1021;
+
+  struct Crc32Tables {
+    uint32_t t[4][256];
+  };
+
+  struct Crc16Table {
+    uint16_t t[256];
+  };
+
+  // t[0] is the classic byte table; t[k][b] advances t[0][b] by k more zero
+  // bytes, which is what slice-by-4 folds in per input byte.
+  constexpr Crc32Tables makeCrc32Tables() {
+    Crc32Tables tables{};
+    for (uint32_t b = 0; b < 256; ++b) {
+      uint32_t reg = b;
+      for (int bit = 0; bit < 8; ++bit) {
+        reg = (reg & 1) ? (reg >> 1) ^ kCrc32Poly : (reg >> 1);
+      }
+      tables.t[0][b] = reg;
+    }
+    for (uint32_t b = 0; b < 256; ++b) {
+      for (int k = 1; k < 4; ++k) {
+        const uint32_t prev = tables.t[k - 1][b];
+        tables.t[k][b] = (prev >> 8) ^ tables.t[0][prev & 0xFF];
+      }
+    }
+    return tables;
+  }
+
+  constexpr Crc16Table makeCrc16Table() {
+    Crc16Table table{};
+    for (uint32_t b = 0; b < 256; ++b) {
+      uint16_t reg = static_cast<uint16_t>(b << 8);
+      for (int bit = 0; bit < 8; ++bit) {
+        reg = (reg & 0x8000) ? static_cast<uint16_t>((reg << 1) ^ kCrc16Poly)
+                             : static_cast<uint16_t>(reg << 1);
+      }
+      table.t[b] = reg;
+    }
+    return table;
+  }
+
+  constexpr Crc32Tables kCrc32 = makeCrc32Tables();
+  constexpr Crc16Table kCrc16 = makeCrc16Table();
+
+  static_assert(kCrc32.t[0][1] == 0x77073096UL, "CRC32 table generation is off");
+  static_assert(kCrc32.t[0][255] == 0x2D02EF8DUL, "CRC32 table generation is off");
+  static_assert(kCrc16.t[1] == 0x1021 && kCrc16.t[255] == 0x1EF0, "CRC16 table generation is off");
+
+  uint32_t crc32FeedTable(uint32_t reg, const uint8_t* data, size_t len) {
+    while (len--) {
+      reg = (reg >> 8) ^ kCrc32.t[0][(reg ^ *data++) & 0xFF];
+    }
+    return reg;
+  }
+
+  uint32_t crc32FeedSlice4(uint32_t reg, const uint8_t* data, size_t len) {
+    // Byte-wise until aligned, then four bytes per step (ESP32 is little-endian).
+    while (len && (reinterpret_cast<uintptr_t>(data) & 3) != 0) {
+      reg = (reg >> 8) ^ kCrc32.t[0][(reg ^ *data++) & 0xFF];
+      len--;
+    }
+    while (len >= 4) {
+      uint32_t word;
+      memcpy(&word, data, sizeof(word));
+      reg ^= word;
+      reg = kCrc32.t[3][reg & 0xFF] ^
+            kCrc32.t[2][(reg >> 8) & 0xFF] ^
+            kCrc32.t[1][(reg >> 16) & 0xFF] ^
+            kCrc32.t[0][reg >> 24];
+      data += 4;
+      len -= 4;
+    }
+    return crc32FeedTable(reg, data, len);
+  }
+
+  // a * b modulo the reflected CRC32 polynomial (zlib's multmodp).
+  uint32_t crc32MulModP(uint32_t a, uint32_t b) {
+    uint32_t m = 1UL << 31;
+    uint32_t p = 0;
+    for (;;) {
+      if (a & m) {
+        p ^= b;
+        if ((a & (m - 1)) == 0) {
+          break;
+        }
+      }
+      m >>= 1;
+      b = (b & 1) ? (b >> 1) ^ kCrc32Poly : (b >> 1);
+    }
+    return p;
+  }
+}
+
+// ─── CRC16 ───────────────────────────────────────────────────────────────────
+
+uint16_t crc16Feed(uint16_t reg, const uint8_t* data, size_t len) {
+  while (len--) {
+    reg = static_cast<uint16_t>((reg << 8) ^ kCrc16.t[((reg >> 8) ^ *data++) & 0xFF]);
+  }
+  return reg;
+}
+
+uint16_t crc16(const uint8_t* data, size_t len) {
+  return crc16Feed(CRC16_INIT, data, len);
+}
+
+uint16_t crc16Bitwise(const uint8_t* data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (uint8_t j = 0; j < 8; j++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ kCrc16Poly : (crc << 1);
+    }
+  }
+  return crc;
+}
+
+// ─── CRC32 ───────────────────────────────────────────────────────────────────
+
+uint32_t crc32Feed(uint32_t reg, const uint8_t* data, size_t len) {
+  return crc32FeedSlice4(reg, data, len);
+}
+
+uint32_t crc32(const uint8_t* data, size_t len) {
+  return crc32Update(0, data, len);
+}
+
+uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t len) {
+#if MESH_CRC_USE_ROM
+  return crc32UpdateRom(crc, data, len);
+#else
+  return crc32UpdateSlice4(crc, data, len);
+#endif
+}
+
+uint32_t crc32UpdateBitwise(uint32_t crc, const uint8_t* data, size_t len) {
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (uint8_t j = 0; j < 8; j++) {
+      crc = (crc & 1) ? (crc >> 1) ^ kCrc32Poly : (crc >> 1);
+    }
+  }
+  return ~crc;
+}
+
+uint32_t crc32UpdateTable(uint32_t crc, const uint8_t* data, size_t len) {
+  return ~crc32FeedTable(~crc, data, len);
+}
+
+uint32_t crc32UpdateSlice4(uint32_t crc, const uint8_t* data, size_t len) {
+  return ~crc32FeedSlice4(~crc, data, len);
+}
+
+#if MESH_CRC_USE_ROM
+uint32_t crc32UpdateRom(uint32_t crc, const uint8_t* data, size_t len) {
+  // ROM crc32_le inverts on entry and exit like zlib, so it chains the same way.
+  return esp_rom_crc32_le(crc, data, static_cast<uint32_t>(len));
+}
+#endif
+
+uint32_t crc32ShiftOperator(size_t len) {
+  // x^(8 * len) mod P by square-and-multiply.
+  uint32_t result = 1UL << 31;  // x^0
+  uint32_t square = 1UL << 30;  // x^1
+  for (uint64_t n = static_cast<uint64_t>(len) * 8ULL; n != 0; n >>= 1) {
+    if (n & 1) {
+      result = crc32MulModP(square, result);
+    }
+    square = crc32MulModP(square, square);
+  }
+  return result;
+}
+
+uint32_t crc32Combine(uint32_t crcA, uint32_t crcB, uint32_t shiftOp) {
+  return crc32MulModP(shiftOp, crcA) ^ crcB;
+}
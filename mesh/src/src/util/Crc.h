@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * CRC16 (CCITT-FALSE) and CRC32 (zlib / IEEE 802.3)
+ *
+ * Outputs match tests/packet_test.py's crc16()/crc32() bit for bit; the
+ * check values are CRC16("123456789") = 0x29B1, CRC32 = 0xCBF43926.
+ *
+ * crc32Update() uses the ESP32 ROM crc32_le() when the core provides it
+ * (it has the same pre/post inversion, so running CRCs chain the same way)
+ * and slice-by-4 tables otherwise. crc16 uses a 256-entry table. All tables
+ * are built at compile time and live in flash. The *Bitwise variants are
+ * the original one-bit-at-a-time code, kept as the reference and baseline
+ * for tests/benchmarks.
+ *
+ * Streaming:
+ *   Crc32Stream crc;            // or crc32Update(0, ...) chained by hand
+ *   crc.update(a, lenA);
+ *   crc.update(b, lenB);
+ *   uint32_t value = crc.final();  // == crc32(a||b)
+ */
+
+#ifndef MESH_CRC_USE_ROM
+#if defined(ESP32) && defined(__has_include)
+#if __has_include(<esp_rom_crc.h>)
+#define MESH_CRC_USE_ROM 1
+#endif
+#endif
+#endif
+
+#ifndef MESH_CRC_USE_ROM
+#define MESH_CRC_USE_ROM 0
+#endif
+
+#define CRC16_INIT 0xFFFF
+#define CRC32_INIT 0xFFFFFFFFUL
+
+uint16_t crc16(const uint8_t* data, size_t len);
+uint32_t crc32(const uint8_t* data, size_t len);
+// Running CRC32: crc32Update(crc32(A), B, len(B)) == crc32(A||B); start from 0.
+uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t len);
+
+// Raw register updates: no inversion, so init/update/final can be split.
+uint16_t crc16Feed(uint16_t reg, const uint8_t* data, size_t len);
+uint32_t crc32Feed(uint32_t reg, const uint8_t* data, size_t len);
+
+// Individual implementations, for the benchmark and cross-checks.
+uint16_t crc16Bitwise(const uint8_t* data, size_t len);
+uint32_t crc32UpdateBitwise(uint32_t crc, const uint8_t* data, size_t len);
+uint32_t crc32UpdateTable(uint32_t crc, const uint8_t* data, size_t len);
+uint32_t crc32UpdateSlice4(uint32_t crc, const uint8_t* data, size_t len);
+#if MESH_CRC_USE_ROM
+uint32_t crc32UpdateRom(uint32_t crc, const uint8_t* data, size_t len);
+#endif
+
+// CRC32 of A||B from crc32(A), crc32(B) and len(B), so fragments can be
+// checked as they land instead of re-reading the whole file at END.
+uint32_t crc32ShiftOperator(size_t len);
+uint32_t crc32Combine(uint32_t crcA, uint32_t crcB, uint32_t shiftOp);
+
+class Crc16Stream {
+public:
+  void init() { _reg = CRC16_INIT; }
+  void update(const uint8_t* data, size_t len) { _reg = crc16Feed(_reg, data, len); }
+  uint16_t final() const { return _reg; }  // CCITT-FALSE has no output XOR
+
+private:
+  uint16_t _reg = CRC16_INIT;
+};
+
+class Crc32Stream {
+public:
+  void init() { _crc = 0; }
+  void update(const uint8_t* data, size_t len) { _crc = crc32Update(_crc, data, len); }
+  uint32_t final() const { return _crc; }
+
+private:
+  uint32_t _crc = 0;  // finalised value of the bytes so far, as crc32Update() chains it
+};
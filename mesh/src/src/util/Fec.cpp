@@ -0,0 +1,19 @@
+#include "Fec.h"
+#include <string.h>
+
+void fecXor(uint8_t* acc, const uint8_t* src, size_t len) {
+  size_t i = 0;
+  // Word loop through memcpy: no alignment assumption on either buffer,
+  // and the compiler turns each copy into a single 32-bit load or store.
+  for (; i + 4 <= len; i += 4) {
+    uint32_t a;
+    uint32_t b;
+    memcpy(&a, acc + i, sizeof(a));
+    memcpy(&b, src + i, sizeof(b));
+    a ^= b;
+    memcpy(acc + i, &a, sizeof(a));
+  }
+  for (; i < len; ++i) {
+    acc[i] ^= src[i];
+  }
+}
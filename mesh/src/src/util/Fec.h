@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Interleaved XOR parity for selective-repeat blocks (MESH_FEC_PARITY)
+ *
+ * A block is one window of k DATA fragments followed by m parity frames.
+ * Parity p is the XOR of the block fragments i with i % m == p, each
+ * zero-padded to the longest of them, so m parity frames repair any loss
+ * pattern that leaves at most one fragment missing per group. A burst of
+ * up to m consecutive losses always qualifies.
+ *
+ *   uint8_t parity[LORA_MAX_FEC_DATA_PAYLOAD] = {0};
+ *   for each fragment i of group p: fecXor(parity, frag_i, len_i);
+ *   // RX, one fragment of the group missing:
+ *   //   copy parity, fecXor() every fragment held -> the missing one
+ *
+ * XOR instead of Reed-Solomon keeps encode and decode at one pass over
+ * the bytes (see bench_fec in tests/cpp_breaking_tests) with no tables.
+ */
+
+/** acc[0..len) ^= src[0..len), four bytes at a time. */
+void fecXor(uint8_t* acc, const uint8_t* src, size_t len);
+
+/** Fragments in parity group p of a block with dataCount fragments and m groups. */
+inline uint8_t fecGroupSize(uint8_t dataCount, uint8_t m, uint8_t p) {
+  return (p < dataCount) ? static_cast<uint8_t>((dataCount - p + m - 1) / m) : 0;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * FixedString<N> - text in an inline buffer of N chars (plus the NUL)
+ *
+ * For text rewritten in steady state (the display message, log status
+ * labels) where Arduino String would go to the heap and, over multi-hour
+ * sweeps, fragment it. Nothing here allocates: writes past N are cut and
+ * truncated() says so. Copying copies the buffer.
+ *
+ * Usage:
+ *   FixedString<23> status;
+ *   status.assign("ACK_OK").appendf("_R%u", retry);
+ *   Serial.println(status.c_str());
+ */
+template <size_t N>
+class FixedString {
+public:
+  static_assert(N > 0 && N < UINT16_MAX, "FixedString capacity must be 1..65534");
+
+  FixedString() { clear(); }
+  FixedString(const char* text) { assign(text); }   // implicit, so literals convert
+
+  void clear() {
+    _buf[0] = '\0';
+    _len = 0;
+    _truncated = false;
+  }
+
+  FixedString& assign(const char* text) {
+    clear();
+    return append(text);
+  }
+
+  FixedString& append(const char* text) {
+    if (text == nullptr) {
+      return *this;
+    }
+    const size_t want = strlen(text);
+    const size_t room = N - _len;
+    const size_t n = (want < room) ? want : room;
+    memcpy(_buf + _len, text, n);
+    _len = static_cast<uint16_t>(_len + n);
+    _buf[_len] = '\0';
+    _truncated = _truncated || n < want;
+    return *this;
+  }
+
+  __attribute__((format(printf, 2, 3)))
+  FixedString& appendf(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    const int n = vsnprintf(_buf + _len, N + 1 - _len, fmt, args);
+    va_end(args);
+    if (n < 0) {
+      _buf[_len] = '\0';
+      return *this;
+    }
+    if (static_cast<size_t>(n) > N - _len) {
+      _truncated = true;
+      _len = N;
+    } else {
+      _len = static_cast<uint16_t>(_len + n);
+    }
+    return *this;
+  }
+
+  const char* c_str() const { return _buf; }
+  size_t length() const { return _len; }
+  bool empty() const { return _len == 0; }
+  bool truncated() const { return _truncated; }
+  static constexpr size_t capacity() { return N; }
+
+  bool operator==(const char* text) const { return strcmp(_buf, text ? text : "") == 0; }
+  bool operator!=(const char* text) const { return !(*this == text); }
+
+private:
+  char _buf[N + 1];
+  uint16_t _len;
+  bool _truncated;
+};
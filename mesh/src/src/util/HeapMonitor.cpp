@@ -0,0 +1,28 @@
+#include "HeapMonitor.h"
+
+HeapMonitor::Sample HeapMonitor::_mark = {0, 0, 0};
+bool HeapMonitor::_marked = false;
+
+HeapMonitor::Sample HeapMonitor::sample() {
+  Sample s;
+  s.freeBytes = ESP.getFreeHeap();
+  s.minFreeBytes = ESP.getMinFreeHeap();
+  s.largestBlock = ESP.getMaxAllocHeap();
+  return s;
+}
+
+void HeapMonitor::mark() {
+  _mark = sample();
+  _marked = true;
+}
+
+void HeapMonitor::printStats() {
+  const Sample now = sample();
+  // Negative = less free heap than at mark(): something kept an allocation.
+  const long delta = _marked ? static_cast<long>(now.freeBytes) - static_cast<long>(_mark.freeBytes) : 0;
+  Serial.printf("[HEAP] free=%lu min_free=%lu largest=%lu since_mark=%ld\n",
+                static_cast<unsigned long>(now.freeBytes),
+                static_cast<unsigned long>(now.minFreeBytes),
+                static_cast<unsigned long>(now.largestBlock),
+                delta);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stdint.h>
+
+/*
+ * HeapMonitor - heap high-water report for long unattended runs
+ *
+ * Steady-state paths (log rows, display text, frame buffers) are meant to
+ * allocate nothing once setup() is done. mark() records the free heap at
+ * that point; printStats() reports how far it has moved since, the lowest
+ * free heap the allocator has seen, and the largest block still available.
+ * A shrinking largest block with a steady free total is fragmentation.
+ *
+ * Usage:
+ *   HeapMonitor::mark();         // end of setup()
+ *   HeapMonitor::printStats();   // after each transfer, or on 'h'
+ */
+class HeapMonitor {
+public:
+  struct Sample {
+    uint32_t freeBytes;      // ESP.getFreeHeap()
+    uint32_t minFreeBytes;   // ESP.getMinFreeHeap(), low-water mark since boot
+    uint32_t largestBlock;   // ESP.getMaxAllocHeap()
+  };
+
+  static Sample sample();
+  static void mark();
+  static void printStats();
+
+private:
+  static Sample _mark;
+  static bool _marked;
+};
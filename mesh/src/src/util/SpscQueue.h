@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * SpscQueue<T, N> - lock-free ring between one producer and one consumer
+ *
+ * For records handed from the radio task to the MESH_DUAL_CORE worker
+ * (log rows, payload writes): the producer never waits on the card and
+ * the consumer never stops the radio. One task may push and one other
+ * task may pop; nothing else is safe. head and tail run free and wrap
+ * with the index type, so N must be a power of two and all N slots are
+ * usable.
+ *
+ * claim()/commit() and front()/pop() work in place, so a record is
+ * written into its slot once and read from there.
+ *
+ * Usage:
+ *   SpscQueue<LogRow, 32> rows;
+ *   if (LogRow* row = rows.claim()) { fill(*row); rows.commit(); }
+ *   while (const LogRow* row = rows.front()) { write(*row); rows.pop(); }
+ */
+template <typename T, uint16_t N>
+class SpscQueue {
+public:
+  static_assert(N > 0 && (N & (N - 1)) == 0, "SpscQueue depth must be a power of two");
+
+  // ── Producer ──────────────────────────────────────────────────
+  /** The next free slot, or nullptr when full; commit() publishes it. */
+  T* claim() {
+    const uint16_t tail = _tail.load(std::memory_order_relaxed);
+    if (static_cast<uint16_t>(tail - _head.load(std::memory_order_acquire)) >= N) {
+      return nullptr;
+    }
+    return &_slots[tail % N];
+  }
+  void commit() { _tail.store(static_cast<uint16_t>(_tail.load(std::memory_order_relaxed) + 1), std::memory_order_release); }
+
+  bool push(const T& item) {
+    T* slot = claim();
+    if (slot == nullptr) {
+      return false;
+    }
+    *slot = item;
+    commit();
+    return true;
+  }
+
+  // ── Consumer ──────────────────────────────────────────────────
+  /** The oldest record, or nullptr when empty; pop() frees it. */
+  T* front() {
+    const uint16_t head = _head.load(std::memory_order_relaxed);
+    if (head == _tail.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    return &_slots[head % N];
+  }
+  void pop() { _head.store(static_cast<uint16_t>(_head.load(std::memory_order_relaxed) + 1), std::memory_order_release); }
+
+  // ── Either side (a snapshot) ──────────────────────────────────
+  uint16_t size() const {
+    return static_cast<uint16_t>(_tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire));
+  }
+  bool empty() const { return size() == 0; }
+  static constexpr uint16_t capacity() { return N; }
+
+private:
+  T _slots[N];
+  std::atomic<uint16_t> _head{0};   // written by the consumer only
+  std::atomic<uint16_t> _tail{0};   // written by the producer only
+};
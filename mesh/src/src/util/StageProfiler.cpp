@@ -0,0 +1,148 @@
+#include "StageProfiler.h"
+
+#if MESH_PROFILE_ENABLE
+
+static_assert(PROFILE_SUB_BUCKETS == 4, "bucket math below assumes 2 sub-bucket bits");
+
+StageProfiler::Histogram StageProfiler::_stages[PROFILE_STAGE_COUNT] = {};
+
+namespace {
+  // MESH_DUAL_CORE: the radio task and the worker both record.
+  portMUX_TYPE s_profMux = portMUX_INITIALIZER_UNLOCKED;
+}
+
+// 0..3 us map 1:1; from there each octave 2^o splits into four equal buckets.
+uint16_t StageProfiler::bucketFor(uint32_t us) {
+  if (us < PROFILE_SUB_BUCKETS) {
+    return static_cast<uint16_t>(us);
+  }
+  const uint8_t octave = static_cast<uint8_t>(31 - __builtin_clz(us));
+  const uint16_t index = static_cast<uint16_t>((octave - 1) * PROFILE_SUB_BUCKETS + ((us >> (octave - 2)) & 3));
+  return (index < PROFILE_BUCKETS) ? index : PROFILE_BUCKETS - 1;
+}
+
+uint32_t StageProfiler::bucketTop(uint16_t index) {
+  if (index < PROFILE_SUB_BUCKETS) {
+    return index;
+  }
+  const uint8_t octave = static_cast<uint8_t>(index / PROFILE_SUB_BUCKETS + 1);
+  const uint32_t width = 1UL << (octave - 2);
+  return (PROFILE_SUB_BUCKETS + index % PROFILE_SUB_BUCKETS) * width + width - 1;
+}
+
+void StageProfiler::record(ProfileStage stage, uint32_t us) {
+  if (stage >= PROFILE_STAGE_COUNT) {
+    return;
+  }
+  const uint16_t bucket = bucketFor(us);
+  Histogram& h = _stages[stage];
+  portENTER_CRITICAL(&s_profMux);
+  h.buckets[bucket]++;
+  if (h.count == 0 || us < h.minUs) {
+    h.minUs = us;
+  }
+  if (us > h.maxUs) {
+    h.maxUs = us;
+  }
+  h.count++;
+  h.totalUs += us;
+  portEXIT_CRITICAL(&s_profMux);
+}
+
+uint32_t StageProfiler::_percentile(const Histogram& h, uint8_t pct) {
+  const uint32_t rank = static_cast<uint32_t>((static_cast<uint64_t>(h.count) * pct + 99) / 100);
+  uint32_t seen = 0;
+  for (uint16_t i = 0; i < PROFILE_BUCKETS; ++i) {
+    seen += h.buckets[i];
+    if (seen >= rank) {
+      // The bucket top can overshoot what was actually seen.
+      const uint32_t top = bucketTop(i);
+      if (top > h.maxUs) {
+        return h.maxUs;
+      }
+      return (top < h.minUs) ? h.minUs : top;
+    }
+  }
+  return h.maxUs;
+}
+
+bool StageProfiler::summary(ProfileStage stage, Summary& out) {
+  if (stage >= PROFILE_STAGE_COUNT || _stages[stage].count == 0) {
+    return false;
+  }
+  const Histogram& h = _stages[stage];
+  out.count = h.count;
+  out.minUs = h.minUs;
+  out.p50Us = _percentile(h, 50);
+  out.p99Us = _percentile(h, 99);
+  out.maxUs = h.maxUs;
+  out.totalUs = h.totalUs;
+  return true;
+}
+
+void StageProfiler::reset() {
+  for (Histogram& h : _stages) {
+    h = Histogram{};
+  }
+}
+
+const char* StageProfiler::stageName(ProfileStage stage) {
+  switch (stage) {
+    case PROFILE_SD_READ:  return "sd_read";
+    case PROFILE_SD_LOG:   return "sd_log";
+    case PROFILE_SPI_WAIT: return "spi_wait";
+    case PROFILE_TX_PACE:  return "tx_pace";
+    case PROFILE_RADIO_TX: return "radio_tx";
+    case PROFILE_ACK_WAIT: return "ack_wait";
+    case PROFILE_FRAGMENT: return "fragment";
+    case PROFILE_WINDOW:   return "window";
+    default:               return "unknown";
+  }
+}
+
+void StageProfiler::printStats() {
+  Serial.println("[PROF] stage      count     min_us     p50_us     p99_us     max_us   total_ms");
+  for (uint8_t i = 0; i < PROFILE_STAGE_COUNT; ++i) {
+    Summary s;
+    if (!summary(static_cast<ProfileStage>(i), s)) {
+      continue;
+    }
+    Serial.printf("[PROF] %-9s %6lu %10lu %10lu %10lu %10lu %10lu\n",
+                  stageName(static_cast<ProfileStage>(i)),
+                  static_cast<unsigned long>(s.count),
+                  static_cast<unsigned long>(s.minUs),
+                  static_cast<unsigned long>(s.p50Us),
+                  static_cast<unsigned long>(s.p99Us),
+                  static_cast<unsigned long>(s.maxUs),
+                  static_cast<unsigned long>(s.totalUs / 1000ULL));
+  }
+}
+
+size_t StageProfiler::formatCsv(char* out, size_t outLen, const char* runId, uint16_t sessionId) {
+  if (out == nullptr || outLen == 0) {
+    return 0;
+  }
+  size_t used = 0;
+  for (uint8_t i = 0; i < PROFILE_STAGE_COUNT; ++i) {
+    Summary s;
+    if (!summary(static_cast<ProfileStage>(i), s)) {
+      continue;
+    }
+    const int n = snprintf(out + used, outLen - used, "%s,%u,%s,%lu,%lu,%lu,%lu,%lu,%llu\n",
+                           runId ? runId : "", static_cast<unsigned>(sessionId),
+                           stageName(static_cast<ProfileStage>(i)),
+                           static_cast<unsigned long>(s.count),
+                           static_cast<unsigned long>(s.minUs),
+                           static_cast<unsigned long>(s.p50Us),
+                           static_cast<unsigned long>(s.p99Us),
+                           static_cast<unsigned long>(s.maxUs),
+                           static_cast<unsigned long long>(s.totalUs));
+    if (n < 0 || static_cast<size_t>(n) >= outLen - used) {
+      return 0;  // a cut row would corrupt the file
+    }
+    used += static_cast<size_t>(n);
+  }
+  return used;
+}
+
+#endif
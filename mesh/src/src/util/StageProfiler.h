@@ -0,0 +1,116 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../../mesh_role_config.h"
+
+/*
+ * StageProfiler - where a fragment's time goes (MESH_PROFILE_ENABLE)
+ *
+ * Each hot-path stage gets a fixed histogram of durations in microseconds:
+ * PROFILE_SUB_BUCKETS buckets per power of two from 1 us to about 134 s,
+ * so a percentile is read back as the top of its bucket, within a quarter
+ * octave (a p50 of 1200 us reports 1279). min, max, count and the sum are exact.
+ * Recording is a bit scan and an increment; nothing allocates.
+ *
+ * micros() rather than the cycle counter: stages run from a few us (SD
+ * read of a cached sector) to seconds (ACK wait at SF12), and the 240 MHz
+ * CCOUNT register wraps every 17.9 s.
+ *
+ * With MESH_PROFILE_ENABLE 0 the PROFILE_SCOPE() / PROFILE_RECORD() macros
+ * expand to nothing and none of this is linked in.
+ *
+ * Usage:
+ *   { PROFILE_SCOPE(PROFILE_SD_READ); sd.readAudioChunk(...); }
+ *   StageProfiler::printStats();            // serial, e.g. on 'p'
+ *   StageProfiler::formatCsv(buf, len, ...) // rows for SdManager::writeProfile()
+ */
+
+enum ProfileStage : uint8_t {
+  PROFILE_SD_READ,     // SdManager::readAudioChunk (file read + ADPCM encode)
+  PROFILE_SD_LOG,      // one batched log write to the card
+  PROFILE_SPI_WAIT,    // SpiArbiter::acquire() waiting on the other device
+  PROFILE_TX_PACE,     // AirtimeScheduler gap / duty-cycle wait, LBT scans and backoff before a send
+  PROFILE_RADIO_TX,    // startTransmit() to TxDone
+  PROFILE_ACK_WAIT,    // waitForAck / waitForWindowAck
+  PROFILE_FRAGMENT,    // one stop-and-wait fragment, first send to ACK (retries included)
+  PROFILE_WINDOW,      // one selective-repeat round: refill, burst, parity, poll, window ACK
+  PROFILE_STAGE_COUNT
+};
+
+#define PROFILE_CSV_HEADER "run_id,session_id,stage,count,min_us,p50_us,p99_us,max_us,total_us\n"
+
+#define PROFILE_SUB_BUCKETS 4
+#define PROFILE_OCTAVES 26
+#define PROFILE_BUCKETS (PROFILE_OCTAVES * PROFILE_SUB_BUCKETS)
+
+#if MESH_PROFILE_ENABLE
+
+class StageProfiler {
+public:
+  struct Summary {
+    uint32_t count;
+    uint32_t minUs;
+    uint32_t p50Us;
+    uint32_t p99Us;
+    uint32_t maxUs;
+    uint64_t totalUs;
+  };
+
+  static void record(ProfileStage stage, uint32_t us);
+  static bool summary(ProfileStage stage, Summary& out);   // false if nothing recorded
+  static void reset();
+
+  static const char* stageName(ProfileStage stage);
+  static void printStats();
+
+  /** Histogram bucket of a duration; bucketTop() is the largest duration in a bucket. */
+  static uint16_t bucketFor(uint32_t us);
+  static uint32_t bucketTop(uint16_t index);
+
+  /**
+   * One CSV row per recorded stage (PROFILE_CSV_HEADER columns) into out.
+   * @return bytes written, 0 if nothing was recorded or out is too small
+   */
+  static size_t formatCsv(char* out, size_t outLen, const char* runId, uint16_t sessionId);
+
+private:
+  struct Histogram {
+    uint32_t buckets[PROFILE_BUCKETS];
+    uint32_t count;
+    uint32_t minUs;
+    uint32_t maxUs;
+    uint64_t totalUs;
+  };
+
+  static uint32_t _percentile(const Histogram& h, uint8_t pct);
+
+  static Histogram _stages[PROFILE_STAGE_COUNT];
+};
+
+/** Records the lifetime of the scope under stage. */
+class StageTimer {
+public:
+  explicit StageTimer(ProfileStage stage) : _stage(stage), _startUs(micros()) {}
+  ~StageTimer() { StageProfiler::record(_stage, micros() - _startUs); }
+
+  StageTimer(const StageTimer&) = delete;
+  StageTimer& operator=(const StageTimer&) = delete;
+
+private:
+  ProfileStage _stage;
+  uint32_t _startUs;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(stage) StageTimer PROFILE_CONCAT(_profileScope, __LINE__)(stage)
+#define PROFILE_RECORD(stage, us) StageProfiler::record((stage), (us))
+
+#else
+
+#define PROFILE_SCOPE(stage) do {} while (0)
+#define PROFILE_RECORD(stage, us) do {} while (0)
+
+#endif
@@ -3,3 +3,4 @@
 #include "src/comms/LoraManager.h"
 #include "src/app/ResearchStateMachine.h"
 #include "src/display/StatusDisplay.h"
+#include "src/mesh/MeshRouter.h"
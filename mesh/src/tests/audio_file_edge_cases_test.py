@@ -18,9 +18,10 @@ Usage:
 import argparse
 import sys
 import io
+import zlib
 
 
-LORA_MAX_DATA_PAYLOAD = 245  # From packet.h
+LORA_MAX_DATA_PAYLOAD = 242  # From packet.h
 
 
 class AudioFile:
@@ -91,6 +92,36 @@ class FragmentationEngine:
         return fragments
 
 
+class PayloadMetaCache:
+    """Mirrors SdManager::openAudioFile(name, meta): size + mtime keyed CRC cache"""
+
+    TAIL_BYTES = 64  # kPayloadMetaTailBytes
+
+    def __init__(self):
+        self.records = {}  # name -> (size, mtime, crc32, tail_crc)
+        self.bytes_scanned = 0
+
+    def _tail_crc(self, data, end):
+        return zlib.crc32(data[max(0, end - self.TAIL_BYTES):end])
+
+    def describe(self, name, data, mtime, chunk=LORA_MAX_DATA_PAYLOAD):
+        """Returns (size, frags, crc32, cached) or None for an empty file"""
+        size = len(data)
+        if size == 0:
+            return None
+        rec = self.records.get(name)
+        if rec and rec[0] == size and rec[1] == mtime:
+            return size, -(-size // chunk), rec[2], True
+
+        start, crc = 0, 0
+        if rec and 0 < rec[0] < size and self._tail_crc(data, rec[0]) == rec[3]:
+            start, crc = rec[0], rec[2]
+        crc = zlib.crc32(data[start:], crc)
+        self.bytes_scanned += size - start
+        self.records[name] = (size, mtime, crc, self._tail_crc(data, size))
+        return size, -(-size // chunk), crc, False
+
+
 class EdgeCaseTester:
     """Test suite for audio file edge cases"""
     
@@ -301,8 +332,8 @@ class EdgeCaseTester:
             (3, 1),    # 3 bytes = 1 fragment
             (7, 1),    # 7 bytes = 1 fragment
             (127, 1),  # 127 bytes = 1 fragment
-            (246, 2),  # 246 bytes = 2 fragments (245 + 1)
-            (491, 3),  # 491 bytes = 3 fragments (245 + 245 + 1)
+            (243, 2),  # 243 bytes = 2 fragments (242 + 1)
+            (485, 3),  # 485 bytes = 3 fragments (242 + 242 + 1)
         ]
         
         fragmenter = FragmentationEngine()
@@ -395,6 +426,38 @@ class EdgeCaseTester:
                                "Re-reading produces same fragments",
                                f"Fragment count: {len(fragments1)}")
     
+    def test_payload_metadata_cache(self):
+        """Test 13: Payload metadata is scanned once and reused"""
+        print("\n[Test 13] Payload Metadata Cache")
+
+        data = bytes([(i * 31) % 256 for i in range(5000)])
+        cache = PayloadMetaCache()
+
+        first = cache.describe("payload.bin", data, mtime=1)
+        self.assert_test(not first[3] and first[2] == zlib.crc32(data),
+                        "First describe scans the file",
+                        f"CRC32=0x{first[2]:08X}")
+
+        again = cache.describe("payload.bin", data, mtime=1)
+        self.assert_test(again[3] and cache.bytes_scanned == len(data),
+                        "Unchanged file is described without reading it",
+                        f"Bytes scanned: {cache.bytes_scanned}")
+
+        grown = data + bytes([0xAB] * 300)
+        appended = cache.describe("payload.bin", grown, mtime=2)
+        self.assert_test(appended[2] == zlib.crc32(grown) and cache.bytes_scanned == len(grown),
+                        "Appended file only scans the new tail",
+                        f"Bytes scanned: {cache.bytes_scanned}")
+
+        rewritten = bytes([0x00]) + grown[1:]
+        changed = cache.describe("payload.bin", rewritten, mtime=3)
+        self.assert_test(changed[2] == zlib.crc32(rewritten),
+                        "Rewritten file with same size is rescanned",
+                        f"CRC32=0x{changed[2]:08X}")
+
+        return self.assert_test(cache.describe("empty.bin", b'', mtime=1) is None,
+                               "Empty payload is rejected")
+
     def run_all_tests(self):
         """Run all test cases"""
         print("=" * 60)
@@ -415,6 +478,7 @@ class EdgeCaseTester:
         self.test_fragment_data_integrity()
         self.test_maximum_fragment_size()
         self.test_file_open_close_cycle()
+        self.test_payload_metadata_cache()
         
         # Print summary
         print("\n" + "=" * 60)
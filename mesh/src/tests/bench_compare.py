@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+"""
+Compare two captures of tests/benchmarks/benchmarks.ino serial output.
+
+Each capture is the raw serial log; only lines of the form
+  BENCH,<name>,<param>,<iters>,<us_per_op>,<rate>,<unit>
+are read, keyed by (name, param). For every key in both runs the report
+shows the baseline and current us_per_op and the change. A key whose
+us_per_op grew by more than --threshold percent is a regression and makes
+the script exit 1. radio_tx rows are skipped by default, since time on air
+is set by the SF and not by the code (--radio to include them).
+
+Usage:
+  python bench_compare.py baseline.txt current.txt [--threshold 10] [--radio]
+"""
+
+from __future__ import annotations
+
+import argparse
+import sys
+from dataclasses import dataclass
+from pathlib import Path
+from typing import Dict, Iterable, List, Tuple
+
+
+@dataclass
+class BenchResult:
+    name: str
+    param: int
+    iters: int
+    us_per_op: float
+    rate: float
+    unit: str
+
+
+Key = Tuple[str, int]
+
+
+def parse_lines(lines: Iterable[str]) -> Dict[Key, BenchResult]:
+    results: Dict[Key, BenchResult] = {}
+    for line in lines:
+        fields = line.strip().split(",")
+        if len(fields) != 7 or fields[0] != "BENCH":
+            continue
+        try:
+            result = BenchResult(fields[1], int(fields[2]), int(fields[3]),
+                                 float(fields[4]), float(fields[5]), fields[6])
+        except ValueError:
+            continue  # a line cut by a reset or a serial glitch
+        results[(result.name, result.param)] = result
+    return results
+
+
+def compare(baseline: Dict[Key, BenchResult], current: Dict[Key, BenchResult],
+            threshold_pct: float, include_radio: bool = False) -> Tuple[List[str], List[Key]]:
+    lines = [f"{'name':<20} {'param':>6} {'base_us':>12} {'cur_us':>12} {'change':>8}"]
+    regressions: List[Key] = []
+    for key in sorted(set(baseline) | set(current)):
+        if key[0] == "radio_tx" and not include_radio:
+            continue
+        base, cur = baseline.get(key), current.get(key)
+        if base is None or cur is None:
+            side = "baseline" if base is None else "current"
+            lines.append(f"{key[0]:<20} {key[1]:>6}  missing from {side}")
+            continue
+        if cur.iters == 0 or base.iters == 0:
+            lines.append(f"{key[0]:<20} {key[1]:>6}  no iterations")
+            continue
+        change = (cur.us_per_op - base.us_per_op) / base.us_per_op * 100.0 if base.us_per_op else 0.0
+        flag = ""
+        if change > threshold_pct:
+            regressions.append(key)
+            flag = "  REGRESSION"
+        lines.append(f"{key[0]:<20} {key[1]:>6} {base.us_per_op:>12.3f} {cur.us_per_op:>12.3f} "
+                     f"{change:>+7.1f}%{flag}")
+    return lines, regressions
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description="Diff two on-target benchmark captures.")
+    parser.add_argument("baseline", help="Serial capture of the reference run")
+    parser.add_argument("current", help="Serial capture of the run under test")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="Percent slowdown in us_per_op that counts as a regression")
+    parser.add_argument("--radio", action="store_true", help="Also compare radio_tx rows")
+    args = parser.parse_args()
+
+    try:
+        baseline = parse_lines(Path(args.baseline).read_text(encoding="utf-8", errors="replace").splitlines())
+        current = parse_lines(Path(args.current).read_text(encoding="utf-8", errors="replace").splitlines())
+    except OSError as exc:
+        print(f"Cannot read capture: {exc}", file=sys.stderr)
+        return 2
+
+    lines, regressions = compare(baseline, current, args.threshold, args.radio)
+    print("\n".join(lines))
+    if regressions:
+        print(f"\n{len(regressions)} regression(s) over {args.threshold:.0f}%")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
@@ -0,0 +1,302 @@
+/**
+ * On-target Benchmarks - protocol, storage and radio primitives
+ * =============================================================
+ * Times the building blocks a transfer is made of, on the board itself:
+ *
+ *   crc      CRC16 / CRC32 per implementation, on a fragment and on 4 KB
+ *   header   LoRaHeader build + serialize, deserialize
+ *   sd_read  SdManager::readAudioChunk() at several chunk sizes
+ *   sd_log   logTransmission() queueing and the flushLog() that writes it
+ *   display  StatusDisplay::refresh() (one full OLED redraw)
+ *   radio_tx one frame per SF, startTransmit() to TxDone, next to the model
+ *
+ * Every result is one machine-readable line:
+ *
+ *   BENCH,<name>,<param>,<iters>,<us_per_op>,<rate>,<unit>
+ *
+ * Capture the serial output to a file and diff it against a saved run with
+ *   python tests/bench_compare.py baseline.txt current.txt
+ *
+ * Needs the SD card and radio of a normal node. The SD stage writes
+ * /bench.bin and appends BENCH rows to the research log, so use a scratch
+ * card. The radio stage transmits to BENCH_DST_ID, which no node answers.
+ *
+ * Upload to ESP32 and monitor Serial at 115200 baud.
+ */
+
+#include <Arduino.h>
+#include "src/comms/Airtime.h"
+#include "src/comms/LoraManager.h"
+#include "src/storage/SdManager.h"
+#include "src/display/StatusDisplay.h"
+#include "src/models/packet.h"
+#include "src/util/Crc.h"
+
+#define BENCH_FILE "/bench.bin"
+#define BENCH_FILE_BYTES (64UL * 1024UL)
+#define BENCH_DST_ID 0xFE
+#define BENCH_RADIO_PAYLOAD 64
+
+LoRaManager lora;
+SdManager sd;
+
+uint16_t g_session_id = 0xBE00;
+uint16_t g_seq_num = 0;
+
+// Keeps the optimizer from dropping a loop whose result is never used.
+volatile uint32_t bench_sink = 0;
+
+static uint8_t bench_buf[4096];
+
+void report(const char* name, uint32_t param, uint32_t iters, uint32_t totalUs,
+            double rate, const char* unit) {
+  const double perOp = iters ? static_cast<double>(totalUs) / iters : 0.0;
+  Serial.printf("BENCH,%s,%lu,%lu,%.3f,%.3f,%s\n", name, static_cast<unsigned long>(param),
+                static_cast<unsigned long>(iters), perOp, rate, unit);
+}
+
+// Bytes per us is MB/s.
+double mbPerS(uint32_t bytes, uint32_t iters, uint32_t us) {
+  return (static_cast<double>(bytes) * iters) / (us ? us : 1);
+}
+
+double opsPerS(uint32_t iters, uint32_t us) {
+  return (1e6 * iters) / (us ? us : 1);
+}
+
+
+// ═══════════════════════════════════════════════════════════════════════════
+//  Protocol
+// ═══════════════════════════════════════════════════════════════════════════
+
+void bench_crc() {
+  typedef uint32_t (*Crc32Fn)(uint32_t, const uint8_t*, size_t);
+  struct Variant { const char* name; Crc32Fn fn; };
+  const Variant variants[] = {
+    {"crc32_bitwise", crc32UpdateBitwise},
+    {"crc32_table", crc32UpdateTable},
+    {"crc32_slice4", crc32UpdateSlice4},
+#if MESH_CRC_USE_ROM
+    {"crc32_rom", crc32UpdateRom},
+#endif
+  };
+  const uint32_t lens[] = {LORA_MAX_DATA_PAYLOAD, sizeof(bench_buf)};
+
+  for (uint32_t len : lens) {
+    const uint32_t iters = (len == sizeof(bench_buf)) ? 64 : 1024;
+    for (const Variant& v : variants) {
+      const uint32_t start = micros();
+      for (uint32_t i = 0; i < iters; i++) {
+        bench_sink ^= v.fn(0, bench_buf, len);
+      }
+      const uint32_t us = micros() - start;
+      report(v.name, len, iters, us, mbPerS(len, iters, us), "MB/s");
+    }
+
+    uint32_t start = micros();
+    for (uint32_t i = 0; i < iters; i++) {
+      bench_sink ^= crc16Bitwise(bench_buf, len);
+    }
+    uint32_t us = micros() - start;
+    report("crc16_bitwise", len, iters, us, mbPerS(len, iters, us), "MB/s");
+
+    start = micros();
+    for (uint32_t i = 0; i < iters; i++) {
+      bench_sink ^= crc16(bench_buf, len);
+    }
+    us = micros() - start;
+    report("crc16_table", len, iters, us, mbPerS(len, iters, us), "MB/s");
+  }
+}
+
+void bench_header() {
+  const uint32_t iters = 10000;
+  LoRaHeader hdr;
+  uint8_t wire[LORA_HEADER_SIZE];
+
+  uint32_t start = micros();
+  for (uint32_t i = 0; i < iters; i++) {
+    buildHeader(&hdr, PKT_AUDIO_DATA, MESH_NODE_ID, BENCH_DST_ID, MESH_EXPERIMENT_ID,
+                g_session_id, static_cast<uint16_t>(i), MESH_LORA_TX_POWER_DBM, MESH_LORA_SF, MESH_LORA_CR);
+    serializeHeader(&hdr, wire);
+    bench_sink ^= wire[6];
+  }
+  uint32_t us = micros() - start;
+  report("header_serialize", LORA_HEADER_SIZE, iters, us, opsPerS(iters, us), "ops/s");
+
+  start = micros();
+  for (uint32_t i = 0; i < iters; i++) {
+    wire[6] = static_cast<uint8_t>(i);
+    deserializeHeader(wire, &hdr);
+    bench_sink ^= hdr.seq_num;
+  }
+  us = micros() - start;
+  report("header_deserialize", LORA_HEADER_SIZE, iters, us, opsPerS(iters, us), "ops/s");
+}
+
+
+// ═══════════════════════════════════════════════════════════════════════════
+//  Storage
+// ═══════════════════════════════════════════════════════════════════════════
+
+bool makeBenchFile() {
+  for (uint32_t written = 0; written < BENCH_FILE_BYTES; written += sizeof(bench_buf)) {
+    if (!sd.writeBinaryFile(BENCH_FILE, bench_buf, sizeof(bench_buf), written > 0)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void bench_sd_read() {
+  if (!makeBenchFile()) {
+    Serial.println("[BENCH] sd_read skipped: cannot write " BENCH_FILE);
+    return;
+  }
+
+  const uint16_t chunks[] = {32, 64, 128, LORA_MAX_DATA_PAYLOAD};
+  uint8_t dst[LORA_MAX_DATA_PAYLOAD];
+  sd.setPayloadCodec(CODEC_RAW_PCM);
+  for (uint16_t chunk : chunks) {
+    if (!sd.openAudioFile(BENCH_FILE)) {
+      Serial.println("[BENCH] sd_read skipped: cannot open " BENCH_FILE);
+      return;
+    }
+    sd.setChunkSize(chunk);
+    uint32_t reads = 0;
+    uint32_t bytes = 0;
+    uint16_t got = 0;
+    const uint32_t start = micros();
+    while (sd.readAudioChunk(dst, got)) {
+      reads++;
+      bytes += got;
+    }
+    const uint32_t us = micros() - start;
+    sd.closeAudioFile();
+    report("sd_read", chunk, reads, us, mbPerS(bytes, 1, us), "MB/s");
+  }
+  sd.setChunkSize(LORA_MAX_DATA_PAYLOAD);
+}
+
+void bench_sd_log() {
+  const uint32_t rows = 64;
+  uint32_t queued = 0;
+  uint32_t start = micros();
+  for (uint32_t i = 0; i < rows; i++) {
+    const uint32_t now = millis();
+    queued += sd.logTransmission(0.0f, 0.0f, now, now, 0, 0.0f, g_session_id,
+                                 static_cast<uint16_t>(i), static_cast<int16_t>(i),
+                                 LORA_MAX_DATA_PAYLOAD, PKT_AUDIO_DATA, LOG_STATUS_BENCH) ? 1 : 0;
+  }
+  const uint32_t queueUs = micros() - start;
+  report("sd_log_queue", rows, queued, queueUs, opsPerS(queued, queueUs), "rows/s");
+
+  start = micros();
+  const bool flushed = sd.flushLog();
+  const uint32_t flushUs = micros() - start;
+  if (!flushed) {
+    Serial.println("[BENCH] sd_log flush failed");
+    return;
+  }
+  report("sd_log_flush", rows, queued, flushUs, opsPerS(queued, flushUs), "rows/s");
+}
+
+
+// ═══════════════════════════════════════════════════════════════════════════
+//  Display & Radio
+// ═══════════════════════════════════════════════════════════════════════════
+
+void bench_display() {
+  const uint32_t iters = 20;
+  const uint32_t start = micros();
+  for (uint32_t i = 0; i < iters; i++) {
+    StatusDisplay::refresh();
+  }
+  const uint32_t us = micros() - start;
+  report("display_redraw", 0, iters, us, opsPerS(iters, us), "ops/s");
+}
+
+// One radio, so no true loopback: each SF times startTransmit() to TxDone
+// and reports the model's time on air alongside for the same frame.
+void bench_radio() {
+  const uint8_t len = LORA_HEADER_SIZE + BENCH_RADIO_PAYLOAD;
+  uint8_t frame[LORA_HEADER_SIZE + BENCH_RADIO_PAYLOAD];
+  memset(frame, 0xA5, sizeof(frame));
+  LoRaHeader hdr;
+
+  const LoRaRate base = lora.baseRate();
+  for (uint8_t sf = 7; sf <= 12; sf++) {
+    LoRaRate rate = base;
+    rate.sf = sf;
+    if (!lora.applyRate(rate)) {
+      Serial.printf("[BENCH] radio_tx SF%u skipped: rate not applied\n", sf);
+      continue;
+    }
+    const uint32_t iters = (sf <= 9) ? 5 : 2;
+    uint32_t sent = 0;
+    uint32_t totalUs = 0;
+    for (uint32_t i = 0; i < iters; i++) {
+      buildHeader(&hdr, PKT_AUDIO_DATA, MESH_NODE_ID, BENCH_DST_ID, MESH_EXPERIMENT_ID,
+                  g_session_id, g_seq_num++, static_cast<uint8_t>(rate.txPower), sf, rate.cr);
+      serializeHeader(&hdr, frame);
+      const uint32_t start = micros();
+      if (!lora.startTransmit(frame, len)) {
+        continue;
+      }
+      while (lora.isTxBusy()) {
+        lora.service();
+        yield();
+      }
+      totalUs += micros() - start;
+      sent++;
+      delay(MESH_TX_GAP_MS);
+    }
+    const double modelMs = loraTimeOnAirUs(len, sf, bwCodeToKhz(rate.bwCode), rate.cr) / 1000.0;
+    report("radio_tx", sf, sent, totalUs, modelMs, "model_ms");
+  }
+  lora.applyRate(base);
+}
+
+
+// ═══════════════════════════════════════════════════════════════════════════
+//  Arduino Setup & Loop
+// ═══════════════════════════════════════════════════════════════════════════
+
+void setup() {
+  Serial.begin(115200);
+  delay(3000);  // Wait for serial connection
+
+  for (size_t i = 0; i < sizeof(bench_buf); i++) {
+    bench_buf[i] = static_cast<uint8_t>(i * 31 + 1);
+  }
+
+  Serial.println();
+  Serial.println("# LoRa mesh on-target benchmarks");
+  Serial.println("# BENCH,name,param,iters,us_per_op,rate,unit");
+
+  StatusDisplay::init();
+  const bool sdOk = sd.init();
+  const bool loraOk = lora.init(&g_session_id, &g_seq_num);
+
+  bench_crc();
+  bench_header();
+  if (sdOk) {
+    bench_sd_read();
+    bench_sd_log();
+  } else {
+    Serial.println("[BENCH] SD init failed; storage benchmarks skipped");
+  }
+  bench_display();
+  if (loraOk) {
+    bench_radio();
+  } else {
+    Serial.println("[BENCH] LoRa init failed; radio benchmarks skipped");
+  }
+
+  Serial.println("# BENCH done");
+}
+
+void loop() {
+  // Benchmarks run once in setup()
+  delay(10000);
+}
@@ -12,6 +12,22 @@
 
 #include <Arduino.h>
 #include "src/models/packet.h"
+#include "src/util/Fec.h"
+#include "src/codec/ImaAdpcm.h"
+#include "src/util/SpscQueue.h"
+#include "src/util/StageProfiler.h"
+#include "src/storage/LogStatus.h"
+#include "src/comms/Airtime.h"
+#include "src/comms/AirtimeScheduler.h"
+#include "src/comms/RttEstimator.h"
+#include "src/comms/RateController.h"
+#include "src/comms/LoraManager.h"
+#include "src/app/ResearchStateMachine.h"
+#include "src/app/SessionTable.h"
+#include "src/app/Reassembler.h"
+#include "src/app/ReplayWindow.h"
+#include "src/mesh/MeshRouter.h"
+#include "src/display/StatusDisplay.h"
 
 // Test statistics
 uint16_t tests_run = 0;
@@ -106,6 +122,299 @@ void test_zero_length_crc() {
   ASSERT_EQUAL(0xFFFFFFFF, ~crc32_result, "crc32(data, 0) returns initial value");
 }
 
+void test_crc_check_values() {
+  TEST_START("CRC Check Values (packet_test.py)");
+
+  // Standard check string plus the "Hello LoRa" vector printed by packet_test.py test_crc().
+  const uint8_t check[] = {'1','2','3','4','5','6','7','8','9'};
+  const uint8_t hello[] = {'H','e','l','l','o',' ','L','o','R','a'};
+  ASSERT_EQUAL(0x29B1, crc16(check, sizeof(check)), "crc16(\"123456789\") == 0x29B1");
+  ASSERT_EQUAL(0xCBF43926UL, crc32(check, sizeof(check)), "crc32(\"123456789\") == 0xCBF43926");
+  ASSERT_EQUAL(0x3BFE, crc16(hello, sizeof(hello)), "crc16(\"Hello LoRa\") == 0x3BFE");
+  ASSERT_EQUAL(0xAB53EFA7UL, crc32(hello, sizeof(hello)), "crc32(\"Hello LoRa\") == 0xAB53EFA7");
+}
+
+void test_crc_variants_match() {
+  TEST_START("CRC Variants Agree (lengths x alignments)");
+
+  static uint8_t buf[1032];
+  for (size_t i = 0; i < sizeof(buf); i++) {
+    buf[i] = static_cast<uint8_t>(i * 131 + 7);
+  }
+
+  bool ok = true;
+  const size_t lengths[] = {0, 1, 3, 4, 5, 17, 245, 1024};
+  for (size_t off = 0; off < 4; off++) {
+    for (size_t n : lengths) {
+      const uint8_t* p = buf + off;
+      const uint32_t ref = crc32UpdateBitwise(0x1234, p, n);
+      ok = ok && crc32UpdateTable(0x1234, p, n) == ref;
+      ok = ok && crc32UpdateSlice4(0x1234, p, n) == ref;
+#if MESH_CRC_USE_ROM
+      ok = ok && crc32UpdateRom(0x1234, p, n) == ref;
+#endif
+      ok = ok && crc16(p, n) == crc16Bitwise(p, n);
+    }
+  }
+  ASSERT_TRUE(ok, "table / slice-by-4 / ROM match the bitwise reference");
+
+  Crc32Stream s32;
+  s32.update(buf, 100);
+  s32.update(buf + 100, 900);
+  ASSERT_EQUAL(crc32(buf, 1000), s32.final(), "Crc32Stream split == one-shot crc32");
+
+  Crc16Stream s16;
+  s16.update(buf, 7);
+  s16.update(buf + 7, 38);
+  ASSERT_EQUAL(crc16(buf, 45), s16.final(), "Crc16Stream split == one-shot crc16");
+}
+
+void test_crc32_combine() {
+  TEST_START("CRC32 Combine (crc32(A||B) from crc32(A), crc32(B))");
+
+  const uint8_t check[] = "123456789";
+  ASSERT_EQUAL(0xCBF43926UL, crc32Combine(crc32(check, 5), crc32(check + 5, 4), crc32ShiftOperator(4)),
+               "Check value from \"12345\" and \"6789\"");
+  ASSERT_EQUAL(crc32(check, 9), crc32Combine(0, crc32(check, 9), crc32ShiftOperator(9)),
+               "An empty prefix leaves crc32(B)");
+  ASSERT_EQUAL(crc32(check, 9), crc32Combine(crc32(check, 9), 0, crc32ShiftOperator(0)),
+               "An empty suffix leaves crc32(A)");
+
+  // Every split point of a buffer longer than a fragment, as a frontier walk does.
+  static uint8_t buf[600];
+  for (size_t i = 0; i < sizeof(buf); i++) {
+    buf[i] = static_cast<uint8_t>(i * 131 + 7);
+  }
+  const uint32_t whole = crc32(buf, sizeof(buf));
+  bool ok = true;
+  for (size_t cut = 0; cut <= sizeof(buf); cut++) {
+    const size_t tail = sizeof(buf) - cut;
+    ok = ok && crc32Combine(crc32(buf, cut), crc32(buf + cut, tail), crc32ShiftOperator(tail)) == whole;
+  }
+  ASSERT_TRUE(ok, "Every split of 600 bytes combines to the one-shot CRC32");
+
+  // A reused operator, as Reassembler caches it for the fragment size.
+  const uint32_t op = crc32ShiftOperator(LORA_MAX_DATA_PAYLOAD);
+  uint32_t running = 0;
+  for (size_t off = 0; off + LORA_MAX_DATA_PAYLOAD <= sizeof(buf); off += LORA_MAX_DATA_PAYLOAD) {
+    running = crc32Combine(running, crc32(buf + off, LORA_MAX_DATA_PAYLOAD), op);
+  }
+  ASSERT_EQUAL(crc32(buf, 2 * LORA_MAX_DATA_PAYLOAD), running, "Fragment-size operator chains fragments");
+}
+
+// Not a pass/fail test: per-variant throughput over a 4 KB buffer.
+void bench_crc() {
+  TEST_START("CRC Micro-benchmark (4 KB x 64)");
+
+  static uint8_t buf[4096];
+  for (size_t i = 0; i < sizeof(buf); i++) {
+    buf[i] = static_cast<uint8_t>(i * 31 + 1);
+  }
+
+  typedef uint32_t (*Crc32Fn)(uint32_t, const uint8_t*, size_t);
+  struct Variant { const char* name; Crc32Fn fn; };
+  const Variant variants[] = {
+    {"crc32 bitwise", crc32UpdateBitwise},
+    {"crc32 table  ", crc32UpdateTable},
+    {"crc32 slice4 ", crc32UpdateSlice4},
+#if MESH_CRC_USE_ROM
+    {"crc32 ROM    ", crc32UpdateRom},
+#endif
+  };
+  const uint16_t rounds = 64;
+
+  for (const Variant& v : variants) {
+    volatile uint32_t sink = 0;
+    const uint32_t start = micros();
+    for (uint16_t r = 0; r < rounds; r++) {
+      sink ^= v.fn(0, buf, sizeof(buf));
+    }
+    const uint32_t us = micros() - start;
+    Serial.printf("  %s %7lu us  %6.2f MB/s\n", v.name, static_cast<unsigned long>(us),
+                  (static_cast<double>(sizeof(buf)) * rounds) / (us ? us : 1));
+  }
+
+  volatile uint16_t sink16 = 0;
+  uint32_t start = micros();
+  for (uint16_t r = 0; r < rounds; r++) sink16 ^= crc16Bitwise(buf, sizeof(buf));
+  const uint32_t bitUs = micros() - start;
+  start = micros();
+  for (uint16_t r = 0; r < rounds; r++) sink16 ^= crc16(buf, sizeof(buf));
+  const uint32_t tableUs = micros() - start;
+  Serial.printf("  crc16 bitwise %7lu us, table %7lu us\n",
+                static_cast<unsigned long>(bitUs), static_cast<unsigned long>(tableUs));
+  ASSERT_TRUE(true, "Benchmark completed");
+}
+
+// FEC encode cost per block and a single-loss repair round trip.
+void bench_fec() {
+  TEST_START("FEC XOR Parity (8-fragment block)");
+
+  const uint8_t k = 8;
+  static uint8_t frags[k][LORA_MAX_DATA_PAYLOAD];
+  for (uint8_t i = 0; i < k; i++) {
+    for (size_t b = 0; b < LORA_MAX_DATA_PAYLOAD; b++) {
+      frags[i][b] = static_cast<uint8_t>(i * 53 + b * 7 + 1);
+    }
+  }
+
+  const uint16_t rounds = 256;
+  const size_t lens[] = {LORA_MAX_FEC_DATA_PAYLOAD, 64};
+  for (size_t len : lens) {
+    for (uint8_t m = 1; m <= 2; m++) {
+      uint8_t parity[2][LORA_MAX_DATA_PAYLOAD];
+      const uint32_t start = micros();
+      for (uint16_t r = 0; r < rounds; r++) {
+        memset(parity, 0, sizeof(parity));
+        for (uint8_t i = 0; i < k; i++) {
+          fecXor(parity[i % m], frags[i], len);
+        }
+      }
+      const uint32_t us = micros() - start;
+      Serial.printf("  k=%u m=%u len=%3u  %6.2f us/block\n", k, m,
+                    static_cast<unsigned>(len), static_cast<double>(us) / rounds);
+    }
+  }
+
+  // m = 2: lose fragment 5, rebuild it from parity 1 and fragments 1, 3, 7.
+  uint8_t parity[LORA_MAX_FEC_DATA_PAYLOAD] = {0};
+  for (uint8_t i = 1; i < k; i += 2) {
+    fecXor(parity, frags[i], LORA_MAX_FEC_DATA_PAYLOAD);
+  }
+  for (uint8_t i = 1; i < k; i += 2) {
+    if (i != 5) {
+      fecXor(parity, frags[i], LORA_MAX_FEC_DATA_PAYLOAD);
+    }
+  }
+  ASSERT_TRUE(memcmp(parity, frags[5], LORA_MAX_FEC_DATA_PAYLOAD) == 0,
+              "Lost fragment rebuilt from parity");
+  ASSERT_TRUE(fecGroupSize(k, 2, 1) == 4 && fecGroupSize(7, 2, 1) == 3,
+              "Parity group sizes");
+}
+
+// ADPCM cost per 242-byte fragment, ratio, and that blocks decode alone.
+void bench_adpcm() {
+  TEST_START("IMA-ADPCM Block Codec (242-byte fragments)");
+
+  const uint16_t perBlock = imaAdpcmBlockSamples(LORA_MAX_DATA_PAYLOAD);
+  const uint8_t blocks = 16;
+  static int16_t pcm[blocks * imaAdpcmBlockSamples(LORA_MAX_DATA_PAYLOAD)];
+  static int16_t out[imaAdpcmBlockSamples(LORA_MAX_DATA_PAYLOAD)];
+  static uint8_t wire[blocks][LORA_MAX_DATA_PAYLOAD];
+  for (size_t i = 0; i < sizeof(pcm) / sizeof(pcm[0]); i++) {
+    pcm[i] = static_cast<int16_t>(8000.0f * sinf(i * 0.3456f) + 3000.0f * sinf(i * 0.9661f));
+  }
+
+  uint8_t index = 0;
+  size_t wireBytes = 0;
+  uint32_t start = micros();
+  for (uint8_t b = 0; b < blocks; b++) {
+    wireBytes += imaAdpcmEncodeBlock(pcm + b * perBlock, perBlock, index, wire[b]);
+  }
+  const uint32_t encUs = micros() - start;
+
+  double errSq = 0;
+  double sigSq = 0;
+  bool counts = true;
+  start = micros();
+  for (uint8_t b = 0; b < blocks; b++) {
+    counts &= imaAdpcmDecodeBlock(wire[b], LORA_MAX_DATA_PAYLOAD, out) == perBlock;
+  }
+  const uint32_t decUs = micros() - start;
+  // Decode the last block on its own, as after losing everything before it.
+  imaAdpcmDecodeBlock(wire[blocks - 1], LORA_MAX_DATA_PAYLOAD, out);
+  for (uint16_t i = 0; i < perBlock; i++) {
+    const double e = pcm[(blocks - 1) * perBlock + i] - out[i];
+    errSq += e * e;
+    sigSq += static_cast<double>(pcm[(blocks - 1) * perBlock + i]) * pcm[(blocks - 1) * perBlock + i];
+  }
+  const double snrDb = 10.0 * log10(sigSq / (errSq > 0 ? errSq : 1));
+
+  Serial.printf("  %u samples/frag, ratio %.2f:1, encode %.1f us/frag, decode %.1f us/frag, SNR %.1f dB\n",
+                perBlock, static_cast<double>(sizeof(pcm)) / wireBytes,
+                static_cast<double>(encUs) / blocks, static_cast<double>(decUs) / blocks, snrDb);
+  ASSERT_TRUE(counts && wireBytes == blocks * LORA_MAX_DATA_PAYLOAD, "Blocks fill whole fragments");
+  ASSERT_TRUE(snrDb > 20.0, "Isolated block decodes cleanly");
+  ASSERT_TRUE(imaAdpcmBlockBytes(2) == 5 && imaAdpcmEncodeBlock(pcm, 2, index, wire[0]) == 5 &&
+                  imaAdpcmDecodeBlock(wire[0], 5, out) == 2,
+              "Padded final nibble is dropped");
+}
+
+void test_ima_adpcm_blocks() {
+  TEST_START("IMA-ADPCM: Odd/Even Blocks, PAD Flag, Step-Index Carry");
+
+  const uint16_t perBlock = imaAdpcmBlockSamples(LORA_MAX_DATA_PAYLOAD);
+  static int16_t pcm[8 * imaAdpcmBlockSamples(LORA_MAX_DATA_PAYLOAD)];
+  static int16_t out[imaAdpcmBlockSamples(LORA_MAX_DATA_PAYLOAD) + 1];
+  static uint8_t wire[8][LORA_MAX_DATA_PAYLOAD];
+  for (size_t i = 0; i < sizeof(pcm) / sizeof(pcm[0]); i++) {
+    pcm[i] = static_cast<int16_t>(8000.0f * sinf(i * 0.3456f));
+  }
+
+  ASSERT_EQUAL(477, perBlock, "A 242-byte fragment holds 477 samples");
+  ASSERT_TRUE(imaAdpcmBlockBytes(477) == 242 && imaAdpcmBlockBytes(476) == 242 &&
+                  imaAdpcmBlockBytes(1) == 4 && imaAdpcmBlockBytes(0) == 0,
+              "Block sizes: an even count rounds up to a padded byte");
+  ASSERT_TRUE(imaAdpcmBlockSamples(4) == 1 && imaAdpcmBlockSamples(3) == 0, "Header-only and short blocks");
+
+  // Odd count: every nibble is a sample, no PAD flag.
+  uint8_t index = 0;
+  ASSERT_EQUAL(242U, imaAdpcmEncodeBlock(pcm, perBlock, index, wire[0]), "477 samples encode to 242 bytes");
+  ASSERT_EQUAL(0, wire[0][3] & IMA_ADPCM_FLAG_PAD, "Odd count: PAD clear");
+  ASSERT_EQUAL(perBlock, imaAdpcmDecodeBlock(wire[0], 242, out), "... and all 477 decode");
+  ASSERT_EQUAL(pcm[0], out[0], "First sample is carried verbatim");
+
+  // Even count: the last nibble is padding and must not become a sample.
+  index = 0;
+  out[perBlock - 1] = 0x5A5A;
+  ASSERT_EQUAL(242U, imaAdpcmEncodeBlock(pcm, perBlock - 1, index, wire[1]), "476 samples encode to 242 bytes");
+  ASSERT_EQUAL(IMA_ADPCM_FLAG_PAD, wire[1][3] & IMA_ADPCM_FLAG_PAD, "Even count: PAD set");
+  ASSERT_EQUAL(perBlock - 1, imaAdpcmDecodeBlock(wire[1], 242, out), "... and 476 decode");
+  ASSERT_EQUAL(0x5A5A, out[perBlock - 1], "Nothing written past the last sample");
+  wire[1][3] &= ~IMA_ADPCM_FLAG_PAD;
+  ASSERT_EQUAL(perBlock, imaAdpcmDecodeBlock(wire[1], 242, out), "Without the flag the pad nibble decodes");
+
+  // The stream size _describeCompressed() predicts: full blocks plus the short tail.
+  const uint16_t tails[] = {1, 2, 101, 200};
+  bool sizes = true;
+  for (uint16_t tail : tails) {
+    index = 0;
+    sizes = sizes && imaAdpcmEncodeBlock(pcm, tail, index, wire[2]) == imaAdpcmBlockBytes(tail) &&
+            imaAdpcmDecodeBlock(wire[2], imaAdpcmBlockBytes(tail), out) == tail;
+  }
+  ASSERT_TRUE(sizes, "Short final blocks round-trip their own sample count");
+  imaAdpcmEncodeBlock(pcm + 5, 1, index, wire[2]);
+  ASSERT_TRUE(imaAdpcmDecodeBlock(wire[2], IMA_ADPCM_HEADER_SIZE, out) == 1 && out[0] == pcm[5],
+              "A one-sample block is the sample itself");
+
+  // The step index carries over, so a block can only be re-encoded (a
+  // compressed seek, SdManager::seekAudioChunk) from the blocks before it.
+  index = 0;
+  for (uint8_t b = 0; b < 8; b++) {
+    imaAdpcmEncodeBlock(pcm + b * perBlock, perBlock, index, wire[b]);
+  }
+  uint8_t replay = 0;
+  uint8_t seek[LORA_MAX_DATA_PAYLOAD];
+  for (uint8_t b = 0; b < 6; b++) {
+    imaAdpcmEncodeBlock(pcm + b * perBlock, perBlock, replay, seek);
+  }
+  ASSERT_EQUAL(wire[6][2], replay, "Block header holds the carried step index");
+  imaAdpcmEncodeBlock(pcm + 6 * perBlock, perBlock, replay, seek);
+  ASSERT_TRUE(memcmp(seek, wire[6], LORA_MAX_DATA_PAYLOAD) == 0, "Re-encoding from block 0 reproduces block 6");
+  uint8_t cold = 0;
+  imaAdpcmEncodeBlock(pcm + 6 * perBlock, perBlock, cold, seek);
+  ASSERT_TRUE(memcmp(seek, wire[6], LORA_MAX_DATA_PAYLOAD) != 0, "Encoded cold it differs");
+
+  // Malformed input.
+  uint8_t big = 200;
+  imaAdpcmEncodeBlock(pcm, 3, big, seek);
+  ASSERT_TRUE(seek[2] <= IMA_ADPCM_MAX_INDEX && big <= IMA_ADPCM_MAX_INDEX, "Out-of-range index is clamped");
+  seek[2] = IMA_ADPCM_MAX_INDEX + 1;
+  ASSERT_EQUAL(0, imaAdpcmDecodeBlock(seek, 5, out), "Header with a bad step index is refused");
+  ASSERT_EQUAL(0, imaAdpcmDecodeBlock(wire[0], IMA_ADPCM_HEADER_SIZE - 1, out), "Truncated header is refused");
+  ASSERT_EQUAL(0U, imaAdpcmEncodeBlock(pcm, 0, index, seek), "Zero samples encode nothing");
+}
+
 void test_massive_length_crc() {
   TEST_START("Massive Length CRC (Integer Overflow)");
   
@@ -121,12 +430,12 @@ void test_massive_length_crc() {
 void test_header_struct_size() {
   TEST_START("Header Struct Size Validation");
   
-  // Header should be exactly 10 bytes
+  // Header should be exactly 13 bytes (v2: + next_hop, prev_hop, ttl)
   size_t actual_size = sizeof(LoRaHeader);
   ASSERT_EQUAL(LORA_HEADER_SIZE, actual_size, "LoRaHeader size matches expected");
   
   // Check packing worked correctly
-  ASSERT_TRUE(actual_size == 10, "Struct packing successful (no padding)");
+  ASSERT_TRUE(actual_size == 13, "Struct packing successful (no padding)");
 }
 
 void test_packet_size_overflow() {
@@ -192,6 +501,72 @@ void test_serialize_deserialize_round_trip() {
   ASSERT_TRUE(match, "Round trip preserves all header fields");
 }
 
+void test_compact_header_round_trip() {
+  TEST_START("Compact Header: encodeCompactHeader / expandCompactFrame Round Trip");
+
+  const LoRaHeaderDefaults d = {0x07, 14, makeSFCR(9, 5)};
+  uint8_t v2[LORA_MAX_PAYLOAD];
+  uint8_t wire[LORA_MAX_PAYLOAD];
+  LoRaHeader hdr;
+
+  // A single-hop frame at the link's rate only carries its seq as a varint.
+  const uint16_t seqs[] = {5, 300, 40000};
+  const size_t saved[] = {6, 5, 4};
+  bool roundTrip = true;
+  bool sizes = true;
+  for (uint8_t i = 0; i < 3; i++) {
+    buildHeader(&hdr, PKT_AUDIO_DATA, 0x01, 0x02, 0x07, 0xABCD, seqs[i], 14, 9, 5);
+    serializeHeader(&hdr, v2);
+    for (uint8_t b = 0; b < 200; b++) {
+      v2[LORA_HEADER_SIZE + b] = b;
+    }
+    const size_t head = encodeCompactHeader(&hdr, d, wire);
+    memcpy(wire + head, v2 + LORA_HEADER_SIZE, 200);
+    const size_t len = expandCompactFrame(wire, head + 200, d);
+    roundTrip = roundTrip && len == LORA_HEADER_SIZE + 200U && memcmp(wire, v2, len) == 0;
+    sizes = sizes && LORA_HEADER_SIZE - head == saved[i];
+  }
+  ASSERT_TRUE(roundTrip, "Expanded frame is the v2 frame byte for byte");
+  ASSERT_TRUE(sizes, "6 / 5 / 4 bytes off for a 1 / 2 / 3-byte seq");
+  // The same vectors as test_compact_wire_header() in tests/packet_test.py.
+  static const uint8_t kSeq300[] = {0x32, 0x00, 0x01, 0x02, 0xCD, 0xAB, 0xAC, 0x02};
+  buildHeader(&hdr, PKT_AUDIO_DATA, 0x01, 0x02, 0x07, 0xABCD, 300, 14, 9, 5);
+  ASSERT_TRUE(encodeCompactHeader(&hdr, d, wire) == sizeof(kSeq300) && memcmp(wire, kSeq300, sizeof(kSeq300)) == 0,
+              "seq 300 encodes to the fixed vector");
+
+  // Fields off the link's defaults travel, and so do hops once routed.
+  buildHeader(&hdr, PKT_ACK, 0x02, 0x01, 0x09, 0x1111, 5, 20, 9, 5);
+  hdr.next_hop = 0x03;
+  hdr.ttl = 2;
+  static const uint8_t kRouted[] = {0x34, 0x0B, 0x02, 0x01, 0x11, 0x11, 0x05, 0x09, 0x14, 0x03, 0x02, 0x02};
+  const size_t head = encodeCompactHeader(&hdr, d, wire);
+  ASSERT_TRUE(head == sizeof(kRouted) && memcmp(wire, kRouted, sizeof(kRouted)) == 0,
+              "Exp, power and hops flagged and written");
+  LoRaHeader back = {};
+  ASSERT_TRUE(decodeCompactHeader(wire, head, d, &back) == head && back.exp_id == 0x09 && back.tx_pow == 20 &&
+              back.sf_cr == hdr.sf_cr && back.next_hop == 0x03 && back.prev_hop == 0x02 && back.ttl == 2 &&
+              back.seq_num == 5 && back.session_id == 0x1111 && getVersion(back.ver_type) == LORA_PROTOCOL_VERSION,
+              "decodeCompactHeader restores every field as v2");
+
+  // Malformed frames are dropped, not misparsed.
+  buildHeader(&hdr, PKT_AUDIO_DATA, 1, 2, 7, 1, 40000, 14, 9, 5);
+  uint8_t good[LORA_COMPACT_HEADER_MAX];
+  const size_t goodLen = encodeCompactHeader(&hdr, d, good);
+  memcpy(wire, good, goodLen);
+  ASSERT_EQUAL(0, expandCompactFrame(wire, 7, d), "Seq cut off");
+  memcpy(wire, good, goodLen);
+  wire[1] = 0x10;
+  ASSERT_EQUAL(0, expandCompactFrame(wire, goodLen, d), "Reserved flag set");
+  memcpy(wire, good, goodLen);
+  wire[6] = 0xFF;
+  wire[7] = 0xFF;
+  wire[8] = 0x7F;
+  ASSERT_EQUAL(0, expandCompactFrame(wire, goodLen, d), "Seq past 16 bits");
+  memcpy(wire, good, goodLen);
+  wire[1] = LORA_COMPACT_HAS_HOPS;
+  ASSERT_EQUAL(0, expandCompactFrame(wire, goodLen, d), "Hop bytes missing");
+}
+
 void test_serialize_buffer_too_small() {
   TEST_START("Serialize: Buffer Too Small");
   
@@ -342,9 +717,9 @@ void test_data_payload_length_overflow() {
   TEST_START("AudioData: Length Exceeds Buffer");
   
   AudioDataPayload payload;
-  payload.len = 255;  // Exceeds LORA_MAX_DATA_PAYLOAD (245)
+  payload.len = 255;  // Exceeds LORA_MAX_DATA_PAYLOAD (242)
   
-  // BUG: len field says 255 but buffer is only 245
+  // BUG: len field says 255 but buffer is only 242
   // This would cause out-of-bounds read on receiver
   ASSERT_FALSE(payload.len <= LORA_MAX_DATA_PAYLOAD, 
                "Invalid length accepted - BUFFER OVERREAD RISK");
@@ -409,6 +784,907 @@ void test_union_size_consistency() {
 }
 
 
+// ═══════════════════════════════════════════════════════════════════════════
+//  MODULE TESTS - the classes the sketches run, driven directly
+// ═══════════════════════════════════════════════════════════════════════════
+
+// A frame as MeshRouter::filter() sees it off the radio.
+static LoRaRxFrame meshFrame(uint8_t src, uint8_t dst, uint8_t prevHop, uint8_t nextHop,
+                             uint8_t ttl, uint16_t seq) {
+  LoRaHeader hdr;
+  buildHeader(&hdr, PKT_AUDIO_DATA, src, dst, 0x01, 0x1234, seq, 14, 7, 5);
+  hdr.prev_hop = prevHop;
+  hdr.next_hop = nextHop;
+  hdr.ttl = ttl;
+  LoRaRxFrame frame = {};
+  serializeHeader(&hdr, frame.data);
+  frame.len = LORA_HEADER_SIZE + 8;
+  frame.rssi = -60.0f;
+  return frame;
+}
+
+void test_mesh_router_filter() {
+  TEST_START("MeshRouter: Delivery, Duplicates, Forwarding, TTL");
+
+  // This node sits between A (a direct neighbour) and B, which is behind R.
+  const uint8_t A = 0x21, R = 0x22, B = 0x23;
+  const MeshRouter::Stats before = MeshRouter::stats();
+
+  LoRaRxFrame f = meshFrame(A, MESH_NODE_ID, A, LORA_BROADCAST_ID, LORA_DEFAULT_TTL, 1);
+  ASSERT_TRUE(MeshRouter::filter(f), "Flooded frame for this node is delivered");
+  ASSERT_EQUAL(A, MeshRouter::nextHopFor(A), "Sender heard directly is its own next hop");
+
+  f = meshFrame(B, MESH_NODE_ID, R, MESH_NODE_ID, LORA_DEFAULT_TTL - 1, 1);
+  ASSERT_TRUE(MeshRouter::filter(f), "Relayed frame for this node is delivered");
+  ASSERT_EQUAL(R, MeshRouter::nextHopFor(B), "Route to B is learned via the relay");
+  ASSERT_FALSE(MeshRouter::filter(f), "Second copy of the same hop is dropped");
+  ASSERT_EQUAL(before.duplicates + 1, MeshRouter::stats().duplicates, "... and counted as a duplicate");
+
+  f = meshFrame(A, B, A, 0x44, LORA_DEFAULT_TTL, 2);
+  ASSERT_FALSE(MeshRouter::filter(f), "Frame whose next hop is another node is dropped");
+  ASSERT_EQUAL(before.overheard + 1, MeshRouter::stats().overheard, "... and counted as overheard");
+
+  f = meshFrame(MESH_NODE_ID, B, R, MESH_NODE_ID, LORA_DEFAULT_TTL - 1, 3);
+  ASSERT_FALSE(MeshRouter::filter(f), "Own frame relayed back is dropped");
+
+#if MESH_FORWARD_ENABLE
+  const uint8_t pending = MeshRouter::forwardPending();
+  f = meshFrame(A, B, A, MESH_NODE_ID, LORA_DEFAULT_TTL, 4);
+  ASSERT_FALSE(MeshRouter::filter(f), "Frame for B is not delivered here");
+  ASSERT_EQUAL(pending + 1, MeshRouter::forwardPending(), "... it is queued to be relayed");
+  f = meshFrame(A, B, A, MESH_NODE_ID, 1, 5);
+  MeshRouter::filter(f);
+  ASSERT_EQUAL(before.ttlExpired + 1, MeshRouter::stats().ttlExpired, "ttl 1 is not relayed");
+#endif
+
+  f = meshFrame(A, MESH_NODE_ID, A, MESH_NODE_ID, LORA_DEFAULT_TTL, 6);
+  MeshRouter::filter(f);
+  delay(MESH_DUP_WINDOW_MS);
+  ASSERT_TRUE(MeshRouter::filter(f), "Same seq after MESH_DUP_WINDOW_MS is a retransmission and passes");
+
+  f.len = LORA_HEADER_SIZE - 1;
+  ASSERT_FALSE(MeshRouter::filter(f), "Runt frame is dropped");
+}
+
+void test_rtt_estimator() {
+  TEST_START("RttEstimator: ACK Timeout from Measured RTT");
+
+  RttEstimator rtt;
+  const uint8_t peer = 0x02;
+  const uint32_t floorMs = loraTimeOnAirMs(LORA_ACK_FRAME_SIZE, 7, 125.0f, 5) + MESH_RTO_TURNAROUND_MS;
+  ASSERT_EQUAL(MESH_ACK_TIMEOUT_MS, rtt.timeoutMs(peer, floorMs, MESH_ACK_TIMEOUT_MS, 0),
+               "No sample yet: the fixed timeout");
+
+  // SF7 ACKs cluster around their airtime plus the receiver's turnaround.
+  const uint32_t samples[] = {102, 98, 111, 100, 105, 99, 103, 101, 100, 104};
+  for (uint32_t ms : samples) {
+    rtt.sample(peer, ms);
+  }
+  const uint32_t rto0 = rtt.timeoutMs(peer, floorMs, MESH_ACK_TIMEOUT_MS, 0);
+  ASSERT_TRUE(rto0 > floorMs && rto0 < 150, "Steady RTT: timeout just above it");
+  ASSERT_EQUAL(2 * rto0, rtt.timeoutMs(peer, floorMs, MESH_ACK_TIMEOUT_MS, 1), "A retry doubles it");
+  ASSERT_EQUAL(MESH_ACK_TIMEOUT_MS, rtt.timeoutMs(peer, floorMs, MESH_ACK_TIMEOUT_MS, 8),
+               "Doubling stops at the ceiling");
+
+  RttEstimator::PeerRtt before;
+  RttEstimator::PeerRtt after;
+  rtt.stats(peer, before);
+  rtt.sample(peer, 400);
+  rtt.stats(peer, after);
+  ASSERT_TRUE(after.srttMs - before.srttMs <= (400 - before.srttMs) / 8 + 1, "A delay spike moves SRTT by 1/8");
+  ASSERT_TRUE(after.rttvarMs > 2 * before.rttvarMs, "... and widens RTTVAR at once");
+
+  const uint8_t quiet = 0x03;
+  for (uint8_t i = 0; i < 20; i++) {
+    rtt.sample(quiet, 1);
+  }
+  ASSERT_EQUAL(floorMs, rtt.timeoutMs(quiet, floorMs, MESH_ACK_TIMEOUT_MS, 0), "The airtime floor holds");
+
+  rtt.resetAll();
+  ASSERT_EQUAL(MESH_ACK_TIMEOUT_MS, rtt.timeoutMs(peer, floorMs, MESH_ACK_TIMEOUT_MS, 0),
+               "resetAll() goes back to the fixed timeout");
+
+  bool inRange = true;
+  for (uint8_t attempt = 0; attempt < 8; attempt++) {
+    uint32_t cap = static_cast<uint32_t>(MESH_RETRY_BACKOFF_BASE_MS) << attempt;
+    if (cap > MESH_RETRY_BACKOFF_MAX_MS) {
+      cap = MESH_RETRY_BACKOFF_MAX_MS;
+    }
+    const uint32_t waitMs = RttEstimator::backoffMs(attempt);
+    inRange = inRange && waitMs >= cap / 2 && waitMs <= cap;
+  }
+  ASSERT_TRUE(inRange, "Retry backoff is drawn from the upper half of base * 2^attempt, capped");
+}
+
+void test_fragment_size() {
+  TEST_START("Airtime: optimalFragmentSize() Fills Its Last Block");
+
+  const uint16_t maxFrag = (MESH_FEC_PARITY > 0) ? LORA_MAX_FEC_DATA_PAYLOAD : LORA_MAX_DATA_PAYLOAD;
+  const uint8_t sfs[] = {7, 9, 11, 12, 12};
+  const float bws[] = {125.0f, 125.0f, 125.0f, 125.0f, 500.0f};
+  bool inRange = true;
+  bool filled = true;
+  for (uint8_t i = 0; i < sizeof(sfs); i++) {
+    const uint16_t size = optimalFragmentSize(sfs[i], bws[i], 5);
+    Serial.printf("  SF%u/%.0fkHz: %u B/fragment\n", sfs[i], static_cast<double>(bws[i]), size);
+    inRange = inRange && size >= 1 && size <= maxFrag;
+    // One more byte would start a payload block the pick could not fill.
+    filled = filled && (size == maxFrag ||
+                        loraPayloadSymbols(LORA_HEADER_SIZE + size + 1, sfs[i], bws[i], 5) >
+                            loraPayloadSymbols(LORA_HEADER_SIZE + size, sfs[i], bws[i], 5));
+  }
+  ASSERT_TRUE(inRange, "Pick stays in 1..the largest fragment the mode allows");
+  ASSERT_TRUE(filled, "Pick never spills into a block it leaves empty");
+#if MESH_TRANSFER_MODE == MESH_TRANSFER_MODE_STOP_AND_WAIT && MESH_FEC_PARITY == 0
+  ASSERT_EQUAL(240, optimalFragmentSize(7, 125.0f, 5), "SF7/125k stop-and-wait: 240 B");
+#endif
+
+  const uint16_t configured = configuredFragmentSize();
+  ASSERT_TRUE(configured >= 1 && configured <= maxFrag, "configuredFragmentSize() fits the build's payload");
+#if MESH_FRAG_SIZE == MESH_FRAG_SIZE_AUTO
+  ASSERT_EQUAL(optimalFragmentSize(MESH_LORA_SF, MESH_LORA_BW_KHZ, MESH_LORA_CR), configured,
+               "MESH_FRAG_SIZE_AUTO picks for the build's radio config");
+#else
+  ASSERT_EQUAL(MESH_FRAG_SIZE < maxFrag ? MESH_FRAG_SIZE : maxFrag, configured, "MESH_FRAG_SIZE is used as set");
+#endif
+}
+
+void test_airtime_scheduler() {
+  TEST_START("AirtimeScheduler: TX Gap and Duty-Cycle Budget");
+
+  AirtimeScheduler gap;
+  gap.noteHeard(1000);
+  ASSERT_EQUAL(MESH_TX_GAP_MS - 10, gap.delayMs(1010, 50, false), "A send waits out the gap after a frame heard");
+  ASSERT_EQUAL(0, gap.delayMs(1010, 50, true), "A reply does not");
+  ASSERT_EQUAL(0, gap.delayMs(1000 + MESH_TX_GAP_MS, 50, false), "Past the gap: send now");
+
+  AirtimeScheduler usage;
+  usage.recordTx(5, 400);
+  usage.recordTx(AirtimeScheduler::kBucketMs + 5, 400);
+  ASSERT_EQUAL(800, usage.usedMs(2 * AirtimeScheduler::kBucketMs), "Every frame in the window is counted");
+  ASSERT_EQUAL(400, usage.usedMs(AIRTIME_BUCKETS * AirtimeScheduler::kBucketMs),
+               "A frame ages out with its bucket");
+
+#if MESH_DUTY_CYCLE_PERMILLE > 0
+  // Full SF9 frames back to back: no window ever carries more than the budget.
+  AirtimeScheduler budget;
+  const uint32_t toaMs = loraTimeOnAirMs(LORA_MAX_PAYLOAD, 9, 125.0f, 5);
+  const uint8_t kFrames = 40;
+  uint32_t starts[kFrames];
+  uint32_t nowMs = 0;
+  for (uint8_t i = 0; i < kFrames; i++) {
+    nowMs += budget.delayMs(nowMs, toaMs, true);
+    budget.recordTx(nowMs, toaMs);
+    starts[i] = nowMs;
+    nowMs += toaMs;
+  }
+  bool within = true;
+  for (uint8_t i = 0; i < kFrames; i++) {
+    uint32_t inWindowMs = 0;
+    for (uint8_t j = i; j < kFrames && starts[j] - starts[i] < MESH_DUTY_CYCLE_WINDOW_MS; j++) {
+      inWindowMs += toaMs;
+    }
+    within = within && inWindowMs <= AirtimeScheduler::kBudgetMs;
+  }
+  ASSERT_TRUE(within, "No MESH_DUTY_CYCLE_WINDOW_MS span exceeds the budget");
+  const uint64_t permille = 1000ULL * kFrames * toaMs / (starts[kFrames - 1] + toaMs);
+  ASSERT_TRUE(permille > MESH_DUTY_CYCLE_PERMILLE / 2, "... and most of the budget is used");
+#else
+  Serial.println(F("  (budget checks need MESH_DUTY_CYCLE_PERMILLE > 0)"));
+#endif
+}
+
+// What the entry / exit handlers saw, and the machine they drive.
+struct FsmProbe {
+  ResearchStateMachine* fsm;
+  uint8_t sends;
+  ResearchEvent waitExitCause;
+};
+
+static void probeEnterTx(void* ctx, ResearchEvent) {
+  FsmProbe* p = static_cast<FsmProbe*>(ctx);
+  p->sends++;
+  p->fsm->post(ResearchEvent::TX_COMPLETE);
+}
+
+static void probeEnterWaitAck(void* ctx, ResearchEvent) {
+  static_cast<FsmProbe*>(ctx)->fsm->startTimer(ResearchEvent::ACK_TIMEOUT, 400);
+}
+
+static void probeExitWaitAck(void* ctx, ResearchEvent cause) {
+  FsmProbe* p = static_cast<FsmProbe*>(ctx);
+  p->waitExitCause = cause;
+  p->fsm->cancelTimer(ResearchEvent::ACK_TIMEOUT);
+}
+
+static void probeEnterBackoff(void* ctx, ResearchEvent) {
+  static_cast<FsmProbe*>(ctx)->fsm->startTimer(ResearchEvent::RETRY_DUE, 100);
+}
+
+void test_state_machine_executor() {
+  TEST_START("ResearchStateMachine: Queued Events and Timers");
+
+  ResearchStateMachine fsm("TEST");
+  FsmProbe probe = {&fsm, 0, ResearchEvent::SETUP_COMPLETE};
+  fsm.onEnter(ResearchState::TX, probeEnterTx, &probe);
+  fsm.onEnter(ResearchState::WAIT_ACK, probeEnterWaitAck, &probe);
+  fsm.onExit(ResearchState::WAIT_ACK, probeExitWaitAck, &probe);
+  fsm.onEnter(ResearchState::BACKOFF, probeEnterBackoff, &probe);
+
+  ASSERT_TRUE(fsm.transition(ResearchEvent::SETUP_COMPLETE), "INIT -> IDLE");
+  ASSERT_FALSE(fsm.transition(ResearchEvent::ACK_VALID), "An event with no transition is ignored");
+
+  fsm.post(ResearchEvent::PAYLOAD_AVAILABLE);
+  ASSERT_TRUE(fsm.state() == ResearchState::IDLE, "post() only queues");
+  fsm.run();
+  ASSERT_TRUE(fsm.state() == ResearchState::WAIT_ACK && probe.sends == 1,
+              "run() applies the event, then what its handlers posted");
+
+  delay(350);
+  fsm.run();
+  ASSERT_TRUE(fsm.state() == ResearchState::WAIT_ACK, "ACK timer not due yet: still waiting");
+  delay(100);
+  fsm.run();
+  ASSERT_TRUE(fsm.state() == ResearchState::BACKOFF && probe.waitExitCause == ResearchEvent::ACK_TIMEOUT,
+              "ACK_TIMEOUT fires once due");
+  delay(150);
+  fsm.run();
+  ASSERT_TRUE(fsm.state() == ResearchState::WAIT_ACK && probe.sends == 2, "RETRY_DUE sends again");
+
+  fsm.post(ResearchEvent::ACK_VALID);
+  fsm.run();
+  ASSERT_TRUE(fsm.state() == ResearchState::IDLE && probe.waitExitCause == ResearchEvent::ACK_VALID,
+              "ACK_VALID ends the wait");
+  const uint32_t ignored = fsm.stats().ignored;
+  delay(500);
+  fsm.run();
+  ASSERT_EQUAL(ignored, fsm.stats().ignored, "The cancelled ACK timer never fires");
+
+  fsm.startTimer(ResearchEvent::RECEIVE_WINDOW, 100);
+  delay(60);
+  fsm.startTimer(ResearchEvent::RECEIVE_WINDOW, 100);
+  delay(60);
+  fsm.run();
+  ASSERT_TRUE(fsm.state() == ResearchState::IDLE, "Re-arming a timer moves it");
+  delay(60);
+  fsm.run();
+  ASSERT_TRUE(fsm.state() == ResearchState::RX, "... to its new deadline");
+
+  bool queued = true;
+  for (uint8_t i = 0; i < MESH_FSM_QUEUE_DEPTH; i++) {
+    queued = fsm.post(ResearchEvent::ACK_VALID) && queued;
+  }
+  ASSERT_TRUE(queued && !fsm.post(ResearchEvent::ACK_VALID), "A full queue refuses the next post()");
+  ASSERT_EQUAL(1, fsm.stats().dropped, "... and counts it");
+  fsm.run();
+  ASSERT_FALSE(fsm.pending(), "run() drains the queue");
+}
+
+void test_spsc_queue() {
+  TEST_START("SpscQueue: Full, Order and Index Wrap");
+
+  SpscQueue<uint16_t, 4> q;
+  bool pushed = true;
+  for (uint16_t n = 0; n < 4; n++) {
+    pushed = q.push(n) && pushed;
+  }
+  ASSERT_TRUE(pushed, "All 4 slots are usable");
+  ASSERT_TRUE(!q.push(99) && q.claim() == nullptr, "A full queue refuses push() and claim()");
+
+  bool inOrder = true;
+  for (uint16_t n = 0; n < 4; n++) {
+    const uint16_t* item = q.front();
+    inOrder = inOrder && item != nullptr && *item == n;
+    q.pop();
+  }
+  ASSERT_TRUE(inOrder && q.empty() && q.front() == nullptr, "Items come out in order, then empty");
+
+  // More records than the uint16 head/tail count, one at a time.
+  bool wrapped = true;
+  for (uint32_t n = 0; n < 70000UL && wrapped; n++) {
+    uint16_t* slot = q.claim();
+    if (slot == nullptr) {
+      wrapped = false;
+      break;
+    }
+    *slot = static_cast<uint16_t>(n);
+    q.commit();
+    wrapped = q.size() == 1 && *q.front() == static_cast<uint16_t>(n);
+    q.pop();
+  }
+  ASSERT_TRUE(wrapped, "claim / commit / pop stay in step across the index wrap");
+  for (uint16_t n = 0; n < 4; n++) {
+    q.push(n);
+  }
+  ASSERT_TRUE(q.size() == 4 && !q.push(4), "Still exactly 4 deep after the wrap");
+}
+
+// START body with its CRC16, as TransferTask sends it.
+static size_t startBody(uint16_t frags, uint32_t size, uint8_t* out) {
+  AudioStartPayload sp = {};
+  sp.total_frags = frags;
+  sp.codec_id = CODEC_RAW_PCM;
+  sp.sample_hz = 8000;
+  sp.total_size = size;
+  serializeAudioStart(&sp, out);
+  sp.crc16 = crc16(out, sizeof(AudioStartPayload) - sizeof(uint16_t));
+  serializeAudioStart(&sp, out);
+  return sizeof(AudioStartPayload);
+}
+
+static void senderFragment(uint8_t sender, uint16_t frag, uint8_t* out, uint16_t len) {
+  for (uint16_t i = 0; i < len; i++) {
+    out[i] = static_cast<uint8_t>(sender * 31 + frag * 7 + i);
+  }
+}
+
+// Never begun, so every context holds its transfer in RAM.
+static SdManager g_sessionSd;
+static SessionTable g_sessions(g_sessionSd);
+
+void test_session_table() {
+  TEST_START("SessionTable: Interleaved Senders, Refusal, Eviction");
+
+  const uint8_t kSenders = MESH_RX_SESSIONS;
+  const uint16_t kFrags = 10;
+  const uint16_t kFragLen = 20;
+  const uint16_t kSession = 0x1A00;   // the same id from every sender
+  uint8_t body[LORA_MAX_DATA_PAYLOAD];
+  LoRaHeader hdr;
+
+  bool started = true;
+  for (uint8_t s = 0; s < kSenders; s++) {
+    buildHeader(&hdr, PKT_AUDIO_START, 0x40 + s, MESH_NODE_ID, 0x01, kSession, 0, 14, 7, 5);
+    const size_t len = startBody(kFrags, kFrags * kFragLen, body);
+    started = started && g_sessions.onStart(hdr, body, len) == ReassemblyResult::STARTED;
+  }
+  ASSERT_TRUE(started, "One context per sender");
+
+  // Round robin; sender 0 swaps fragments 4 and 5 and repeats 6.
+  bool placed = true;
+  bool duplicate = false;
+  for (uint16_t frag = 0; frag < kFrags; frag++) {
+    for (uint8_t s = 0; s < kSenders; s++) {
+      uint16_t f = frag;
+      if (s == 0 && (frag == 4 || frag == 5)) {
+        f = static_cast<uint16_t>(9 - frag);
+      }
+      senderFragment(s, f, body, kFragLen);
+      buildHeader(&hdr, PKT_AUDIO_DATA, 0x40 + s, MESH_NODE_ID, 0x01, kSession, 1 + f, 14, 7, 5);
+      int16_t fragIndex = -1;
+      placed = placed && g_sessions.onData(hdr, body, kFragLen, &fragIndex) == ReassemblyResult::PLACED &&
+               fragIndex == f;
+      if (s == 0 && f == 6) {
+        duplicate = g_sessions.onData(hdr, body, kFragLen, &fragIndex) == ReassemblyResult::DUPLICATE;
+      }
+    }
+  }
+  ASSERT_TRUE(placed, "Every fragment lands in its own sender's context");
+  ASSERT_TRUE(duplicate, "A repeated fragment is DUPLICATE");
+  const Reassembler* first = g_sessions.find(0x40, kSession);
+  ASSERT_TRUE(first != nullptr && first->stats().outOfOrder == 1 && first->stats().duplicates == 1,
+              "Counters stay with their context");
+
+  buildHeader(&hdr, PKT_AUDIO_START, 0x40 + kSenders, MESH_NODE_ID, 0x01, kSession, 0, 14, 7, 5);
+  size_t len = startBody(kFrags, kFrags * kFragLen, body);
+  ASSERT_TRUE(g_sessions.onStart(hdr, body, len) == ReassemblyResult::NO_CONTEXT,
+              "Every context live: a new START is refused, none is dropped");
+  ASSERT_EQUAL(1, g_sessions.stats().refused, "... and counted");
+
+  bool complete = true;
+  uint8_t whole[kFrags * kFragLen];
+  for (uint8_t s = 0; s < kSenders; s++) {
+    for (uint16_t f = 0; f < kFrags; f++) {
+      senderFragment(s, f, whole + f * kFragLen, kFragLen);
+    }
+    AudioEndPayload ep = {};
+    ep.frag_count = kFrags;
+    ep.crc32 = crc32(whole, sizeof(whole));
+    serializeAudioEnd(&ep, body);
+    buildHeader(&hdr, PKT_AUDIO_END, 0x40 + s, MESH_NODE_ID, 0x01, kSession, 1 + kFrags, 14, 7, 5);
+    complete = complete && g_sessions.onEnd(hdr, body, sizeof(AudioEndPayload)) == ReassemblyResult::COMPLETE;
+    complete = complete && g_sessions.onEnd(hdr, body, sizeof(AudioEndPayload)) == ReassemblyResult::COMPLETE;
+  }
+  ASSERT_TRUE(complete, "END settles each context on its own CRC32, retried END too");
+
+  buildHeader(&hdr, PKT_AUDIO_START, 0x40 + kSenders, MESH_NODE_ID, 0x01, kSession, 0, 14, 7, 5);
+  len = startBody(kFrags, kFrags * kFragLen, body);
+  ASSERT_TRUE(g_sessions.onStart(hdr, body, len) == ReassemblyResult::STARTED,
+              "A finished context takes the next START");
+  senderFragment(kSenders, 0, body, kFragLen);
+  buildHeader(&hdr, PKT_AUDIO_DATA, 0x40 + kSenders, MESH_NODE_ID, 0x01, kSession, 1, 14, 7, 5);
+  g_sessions.onData(hdr, body, kFragLen);
+
+  // The newcomer goes quiet; finished contexts go first, then the stalled one.
+  Serial.println(F("  (waiting out MESH_RX_SESSION_STALL_MS)"));
+  delay(MESH_RX_SESSION_STALL_MS);
+  started = true;
+  for (uint8_t s = 0; s < kSenders; s++) {
+    buildHeader(&hdr, PKT_AUDIO_START, 0x60 + s, MESH_NODE_ID, 0x01, kSession, 0, 14, 7, 5);
+    len = startBody(kFrags, kFrags * kFragLen, body);
+    started = started && g_sessions.onStart(hdr, body, len) == ReassemblyResult::STARTED;
+  }
+  ASSERT_TRUE(started && g_sessions.stats().evicted == 1, "A stalled transfer is evicted only when nothing else is free");
+  buildHeader(&hdr, PKT_AUDIO_DATA, 0x40 + kSenders, MESH_NODE_ID, 0x01, kSession, 2, 14, 7, 5);
+  ASSERT_TRUE(g_sessions.onData(hdr, body, kFragLen) == ReassemblyResult::NO_SESSION,
+              "... and its DATA finds no session");
+}
+
+static Reassembler g_resumeRasm(g_sessionSd);
+
+// Opens a transfer of frags 8-byte fragments and places those keep() holds.
+static void placeHeld(uint16_t session, uint16_t frags, bool (*keep)(uint16_t)) {
+  uint8_t body[LORA_MAX_DATA_PAYLOAD];
+  LoRaHeader hdr;
+  buildHeader(&hdr, PKT_AUDIO_START, 0x50, MESH_NODE_ID, 0x01, session, 0, 14, 7, 5);
+  g_resumeRasm.onStart(hdr, body, startBody(frags, frags * 8U, body));
+  for (uint16_t f = 0; f < frags; f++) {
+    if (keep(f)) {
+      senderFragment(0, f, body, 8);
+      buildHeader(&hdr, PKT_AUDIO_DATA, 0x50, MESH_NODE_ID, 0x01, session, 1 + f, 14, 7, 5);
+      g_resumeRasm.onData(hdr, body, 8);
+    }
+  }
+}
+
+// The link dropped out for 40..79; a few others were missed too.
+static bool outageHeld(uint16_t f) {
+  return !(f == 3 || (f >= 40 && f < 80) || f == 140 || f == 141 || f == 260);
+}
+
+static bool evenHeld(uint16_t f) {
+  return f % 2 == 0;
+}
+
+void test_resume_nack() {
+  TEST_START("Reassembler: RESUME Describes the Gaps as PKT_NACK Ranges");
+
+  const uint16_t kFrags = 271;
+  uint8_t body[LORA_MAX_DATA_PAYLOAD];
+  uint8_t wire[LORA_MAX_DATA_PAYLOAD];
+  LoRaHeader hdr;
+  ResumeNack nack;
+
+  placeHeld(0x1B00, kFrags, outageHeld);
+  buildHeader(&hdr, PKT_RESUME, 0x50, MESH_NODE_ID, 0x01, 0x1B00, 400, 14, 7, 5);
+  const size_t len = startBody(kFrags, kFrags * 8U, body);
+  ASSERT_TRUE(g_resumeRasm.onResume(hdr, body, len, &nack) == ReassemblyResult::RESUMED,
+              "RESUME of the open transfer keeps its bitmap");
+  ASSERT_TRUE(nack.head.range_count == 4 &&
+              nack.ranges[0].first_frag == 3 && nack.ranges[0].count == 1 &&
+              nack.ranges[1].first_frag == 40 && nack.ranges[1].count == 40 &&
+              nack.ranges[2].first_frag == 140 && nack.ranges[2].count == 2 &&
+              nack.ranges[3].first_frag == 260 && nack.ranges[3].count == 1,
+              "One range per gap, in order");
+  ASSERT_EQUAL(kFrags, nack.head.covered, "Every gap fit: covered is total_frags");
+  ASSERT_EQUAL(kFrags - 44, nack.head.received, "received counts the held fragments");
+  ASSERT_EQUAL(44, nackMissingCount(nack, kFrags), "The sender resends exactly the 44 missing");
+
+  const size_t wireLen = serializeNack(&nack, wire);
+  ResumeNack back;
+  ASSERT_TRUE(deserializeNack(wire, wireLen, &back) && back.head.range_count == 4 &&
+              back.ranges[1].count == 40 && back.head.covered == kFrags,
+              "NACK survives the wire");
+  ASSERT_FALSE(deserializeNack(wire, wireLen - 1, &back), "A truncated NACK is not trusted");
+
+  // Every other fragment lost: the ranges run out and the rest counts as missing.
+  placeHeld(0x1B01, kFrags, evenHeld);
+  g_resumeRasm.describeMissing(nack);
+  ASSERT_TRUE(nack.head.range_count == LORA_MAX_NACK_RANGES && nack.head.covered == 2 * LORA_MAX_NACK_RANGES + 1,
+              "LORA_MAX_NACK_RANGES ranges, covered stops after the last");
+  ASSERT_EQUAL(LORA_MAX_NACK_RANGES + (kFrags - nack.head.covered), nackMissingCount(nack, kFrags),
+               "Past covered every fragment is resent");
+  bool heldSkipped = true;
+  for (uint16_t f = 0; f < nack.head.covered; f += 2) {
+    heldSkipped = heldSkipped && !nackMissing(nack, f);
+  }
+  ASSERT_TRUE(heldSkipped, "No held fragment before covered is resent");
+
+  for (uint16_t f = 1; f < kFrags; f += 2) {
+    senderFragment(0, f, body, 8);
+    buildHeader(&hdr, PKT_AUDIO_DATA, 0x50, MESH_NODE_ID, 0x01, 0x1B01, 1 + f, 14, 7, 5);
+    g_resumeRasm.onData(hdr, body, 8);
+  }
+  g_resumeRasm.describeMissing(nack);
+  ASSERT_TRUE(nack.head.range_count == 0 && nack.head.covered == kFrags, "All in: no range, nothing to resend");
+}
+
+static bool burstHeld(uint16_t f) {
+  return f != 3 && f != 9;
+}
+
+void test_window_bitmap() {
+  TEST_START("Reassembler: PKT_WINDOW_ACK Bitmap Marks Only the Holes");
+
+  // 20 fragments at seq 1..20, polled in windows of 8 as WindowedSender does.
+  uint8_t body[LORA_MAX_DATA_PAYLOAD];
+  LoRaHeader hdr;
+  LoRaHeader poll;
+  placeHeld(0x1B02, 20, burstHeld);
+  buildHeader(&poll, PKT_WINDOW_POLL, 0x50, MESH_NODE_ID, 0x01, 0x1B02, 21, 14, 7, 5);
+  ASSERT_EQUAL(0xF7UL, g_resumeRasm.windowBitmap(poll, 1, 8), "Fragment 3 missing from the first window");
+  ASSERT_EQUAL(0xFDUL, g_resumeRasm.windowBitmap(poll, 9, 8), "Fragment 9 missing from the second");
+  ASSERT_EQUAL(0x0FUL, g_resumeRasm.windowBitmap(poll, 17, 8), "Past the last fragment nothing is set");
+  ASSERT_EQUAL(0xFFDF7UL, g_resumeRasm.windowBitmap(poll, 1, LORA_MAX_WINDOW_SIZE),
+               "One window over the whole transfer: both holes");
+
+  senderFragment(0, 3, body, 8);
+  buildHeader(&hdr, PKT_AUDIO_DATA_WIN, 0x50, MESH_NODE_ID, 0x01, 0x1B02, 4, 14, 7, 5);
+  g_resumeRasm.onData(hdr, body, 8);
+  ASSERT_EQUAL(0xFFUL, g_resumeRasm.windowBitmap(poll, 1, 8), "The resend fills the first window");
+
+  buildHeader(&poll, PKT_WINDOW_POLL, 0x50, MESH_NODE_ID, 0x01, 0x1B03, 21, 14, 7, 5);
+  ASSERT_EQUAL(0UL, g_resumeRasm.windowBitmap(poll, 1, 8), "Another session's poll sees nothing held");
+}
+
+// One 8-fragment block of 32-byte fragments, the last one short.
+static const uint8_t kFecFrags = 8;
+static const uint16_t kFecFragLen = 32;
+static const uint16_t kFecLastLen = 20;
+static uint8_t g_fecStream[(kFecFrags - 1) * kFecFragLen + kFecLastLen];
+
+static uint16_t fecFragLen(uint8_t f) {
+  return (f + 1 == kFecFrags) ? kFecLastLen : kFecFragLen;
+}
+
+// Opens the transfer and places every fragment but lostA and lostB.
+static void placeFecBlock(uint16_t session, uint8_t lostA, uint8_t lostB) {
+  uint8_t body[LORA_MAX_DATA_PAYLOAD];
+  LoRaHeader hdr;
+  buildHeader(&hdr, PKT_AUDIO_START, 0x50, MESH_NODE_ID, 0x01, session, 0, 14, 7, 5);
+  g_resumeRasm.onStart(hdr, body, startBody(kFecFrags, sizeof(g_fecStream), body));
+  for (uint8_t f = 0; f < kFecFrags; f++) {
+    if (f != lostA && f != lostB) {
+      buildHeader(&hdr, PKT_AUDIO_DATA_WIN, 0x50, MESH_NODE_ID, 0x01, session, 1 + f, 14, 7, 5);
+      g_resumeRasm.onData(hdr, g_fecStream + f * kFecFragLen, fecFragLen(f));
+    }
+  }
+}
+
+// PKT_AUDIO_PARITY p of m over the block, as WindowedSender builds it.
+static ReassemblyResult sendParity(uint16_t session, uint8_t p, uint8_t m, int16_t* rebuilt) {
+  uint8_t frame[LORA_FEC_HEADER_SIZE + kFecFragLen] = {0};
+  FecParityPayload fp = {0, kFecFrags, p, m};
+  serializeFecParity(&fp, frame);
+  for (uint8_t f = p; f < kFecFrags; f += m) {
+    fecXor(frame + LORA_FEC_HEADER_SIZE, g_fecStream + f * kFecFragLen, fecFragLen(f));
+  }
+  LoRaHeader hdr;
+  buildHeader(&hdr, PKT_AUDIO_PARITY, 0x50, MESH_NODE_ID, 0x01, session, 20, 14, 7, 5);
+  return g_resumeRasm.onParity(hdr, frame, sizeof(frame), rebuilt);
+}
+
+// END with the sender's CRC32: COMPLETE only if every byte was rebuilt right.
+static ReassemblyResult endFecBlock(uint16_t session) {
+  uint8_t body[sizeof(AudioEndPayload)];
+  AudioEndPayload ep = {kFecFrags, crc32(g_fecStream, sizeof(g_fecStream)), 0};
+  serializeAudioEnd(&ep, body);
+  LoRaHeader hdr;
+  buildHeader(&hdr, PKT_AUDIO_END, 0x50, MESH_NODE_ID, 0x01, session, 21, 14, 7, 5);
+  return g_resumeRasm.onEnd(hdr, body, sizeof(body));
+}
+
+void test_fec_parity() {
+  TEST_START("Reassembler: PKT_AUDIO_PARITY Rebuilds One Loss per Group");
+
+  ASSERT_TRUE(fecGroupSize(8, 2, 0) == 4 && fecGroupSize(8, 2, 1) == 4 && fecGroupSize(7, 2, 1) == 3 &&
+                  fecGroupSize(5, 3, 2) == 1 && fecGroupSize(8, 1, 0) == 8,
+              "Group p holds fragments p, p + m, ... of the block");
+  ASSERT_EQUAL(0, fecGroupSize(2, 4, 3), "A group past a short block is empty");
+
+  // Lengths off the four-byte stride still XOR every byte, and only those.
+  uint8_t acc[11] = {0};
+  const uint8_t src[11] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+  fecXor(acc, src, 7);
+  ASSERT_TRUE(acc[0] == 1 && acc[6] == 7 && acc[7] == 0 && acc[10] == 0, "fecXor covers exactly len bytes");
+  fecXor(acc, src, 7);
+  ASSERT_TRUE(acc[0] == 0 && acc[6] == 0, "XOR twice cancels");
+
+  for (size_t i = 0; i < sizeof(g_fecStream); i++) {
+    g_fecStream[i] = static_cast<uint8_t>(i * 53 + 7);
+  }
+  int16_t rebuilt = -1;
+
+  // m = 2: a burst of two hits each group once.
+  placeFecBlock(0x1B10, 4, 5);
+  ASSERT_TRUE(sendParity(0x1B10, 0, 2, &rebuilt) == ReassemblyResult::RECOVERED && rebuilt == 4,
+              "Parity 0 rebuilds fragment 4");
+  ASSERT_TRUE(sendParity(0x1B10, 1, 2, &rebuilt) == ReassemblyResult::RECOVERED && rebuilt == 5,
+              "Parity 1 rebuilds fragment 5");
+  ASSERT_TRUE(g_resumeRasm.stats().recovered == 2 && endFecBlock(0x1B10) == ReassemblyResult::COMPLETE,
+              "Rebuilt bytes match the sender's CRC32");
+
+  // The short last fragment comes back at its own length, not the parity's.
+  placeFecBlock(0x1B11, 7, 7);
+  ASSERT_TRUE(sendParity(0x1B11, 1, 2, &rebuilt) == ReassemblyResult::RECOVERED && rebuilt == 7,
+              "Parity 1 rebuilds the short last fragment");
+  ASSERT_TRUE(endFecBlock(0x1B11) == ReassemblyResult::COMPLETE, "... to its own length");
+
+  // Two losses in one group: held until a resend leaves one missing.
+  placeFecBlock(0x1B12, 1, 3);
+  ASSERT_TRUE(sendParity(0x1B12, 1, 2, &rebuilt) == ReassemblyResult::PARITY_HELD && rebuilt == -1,
+              "Two losses in a group are not rebuilt");
+  LoRaHeader hdr;
+  buildHeader(&hdr, PKT_AUDIO_DATA_WIN, 0x50, MESH_NODE_ID, 0x01, 0x1B12, 2, 14, 7, 5);
+  g_resumeRasm.onData(hdr, g_fecStream + kFecFragLen, kFecFragLen, nullptr, &rebuilt);
+  ASSERT_EQUAL(3, rebuilt, "Resending fragment 1 lets the held parity rebuild 3");
+  ASSERT_TRUE(endFecBlock(0x1B12) == ReassemblyResult::COMPLETE, "And the block completes");
+  ASSERT_TRUE(sendParity(0x1B12, 0, 2, &rebuilt) == ReassemblyResult::PARITY_HELD && rebuilt == -1,
+              "Parity for a whole group rebuilds nothing");
+}
+
+void test_out_of_order_reassembly() {
+  TEST_START("Reassembler: Out-of-Order DATA, Running CRC32");
+
+  // 1000 bytes in 242-byte fragments, the last 32; arrival order with a duplicate.
+  static uint8_t stream[1000];
+  for (size_t i = 0; i < sizeof(stream); i++) {
+    stream[i] = static_cast<uint8_t>(i * 29 + 3);
+  }
+  const uint16_t frags = (sizeof(stream) + LORA_MAX_DATA_PAYLOAD - 1) / LORA_MAX_DATA_PAYLOAD;
+  const uint16_t order[] = {2, 4, 0, 3, 0, 1};
+  uint8_t body[LORA_MAX_DATA_PAYLOAD];
+  LoRaHeader hdr;
+  buildHeader(&hdr, PKT_AUDIO_START, 0x50, MESH_NODE_ID, 0x01, 0x1B20, 0, 14, 7, 5);
+  g_resumeRasm.onStart(hdr, body, startBody(frags, sizeof(stream), body));
+
+  bool placed = true;
+  for (uint16_t f : order) {
+    const uint16_t len = (f + 1U == frags) ? sizeof(stream) - f * LORA_MAX_DATA_PAYLOAD : LORA_MAX_DATA_PAYLOAD;
+    buildHeader(&hdr, PKT_AUDIO_DATA, 0x50, MESH_NODE_ID, 0x01, 0x1B20, 1 + f, 14, 7, 5);
+    const ReassemblyResult r = g_resumeRasm.onData(hdr, stream + f * LORA_MAX_DATA_PAYLOAD, len);
+    placed = placed && (r == ReassemblyResult::PLACED || r == ReassemblyResult::DUPLICATE);
+  }
+  ASSERT_TRUE(placed, "Every fragment placed at its offset");
+  ASSERT_TRUE(g_resumeRasm.stats().duplicates == 1 && g_resumeRasm.stats().outOfOrder == 3,
+              "One duplicate, three arrivals behind the highest");
+  ASSERT_EQUAL(crc32(stream, sizeof(stream)), g_resumeRasm.stats().crc32,
+               "Running CRC32 over the frontier equals the payload CRC32");
+
+  uint8_t end[sizeof(AudioEndPayload)];
+  AudioEndPayload ep = {frags, crc32(stream, sizeof(stream)), 0};
+  serializeAudioEnd(&ep, end);
+  buildHeader(&hdr, PKT_AUDIO_END, 0x50, MESH_NODE_ID, 0x01, 0x1B20, 1 + frags, 14, 7, 5);
+  ASSERT_TRUE(g_resumeRasm.onEnd(hdr, end, sizeof(end)) == ReassemblyResult::COMPLETE,
+              "END completes on the running CRC32");
+}
+
+void test_replay_window() {
+  TEST_START("ReplayWindow: Cached ACKs for Retransmits");
+
+  static ReplayWindow replay;
+  LoRaHeader hdr;
+  buildHeader(&hdr, PKT_AUDIO_DATA, 0x0A, MESH_NODE_ID, 0x01, 0x1111, 100, 14, 7, 5);
+  ASSERT_TRUE(replay.find(hdr) == nullptr, "Nothing cached yet");
+
+  uint8_t ack[LORA_ACK_FRAME_SIZE];
+  for (uint8_t i = 0; i < sizeof(ack); i++) {
+    ack[i] = static_cast<uint8_t>(0xA0 + i);
+  }
+  replay.store(hdr, ack, sizeof(ack), 5, 200);
+  const ReplayWindow::Entry* hit = replay.find(hdr);
+  ASSERT_TRUE(hit != nullptr && hit->len == sizeof(ack) && memcmp(hit->frame, ack, sizeof(ack)) == 0 &&
+                  hit->fragIndex == 5 && hit->fragLen == 200,
+              "A retransmit gets the same ACK bytes and log fields back");
+
+  LoRaHeader other = hdr;
+  other.ver_type = makeVerType(LORA_PROTOCOL_VERSION, PKT_AUDIO_END);
+  ASSERT_TRUE(replay.find(other) == nullptr, "Same seq, other packet type: no hit");
+  other = hdr;
+  other.session_id = 0x2222;
+  ASSERT_TRUE(replay.find(other) == nullptr, "Same seq, other session: no hit");
+
+  other = hdr;
+  other.seq_num = static_cast<uint16_t>(hdr.seq_num + MESH_RX_REPLAY_WINDOW);
+  replay.store(other, ack, sizeof(ack), 5 + MESH_RX_REPLAY_WINDOW, 200);
+  ASSERT_TRUE(replay.find(hdr) == nullptr, "A seq one window later takes the slot over");
+  ASSERT_TRUE(replay.find(other) != nullptr, "... and replays itself");
+  replay.forget(other);
+  ASSERT_TRUE(replay.find(other) == nullptr, "forget() drops the session's ACKs");
+
+  // One window per peer; a new peer takes the least recently heard one.
+  replay.clear();
+  for (uint8_t p = 1; p <= MESH_RX_REPLAY_PEERS; p++) {
+    buildHeader(&hdr, PKT_AUDIO_DATA, p, MESH_NODE_ID, 0x01, 0x1111, 7, 14, 7, 5);
+    replay.store(hdr, ack, sizeof(ack), 7, 200);
+    delay(2);
+  }
+  buildHeader(&hdr, PKT_AUDIO_DATA, 1, MESH_NODE_ID, 0x01, 0x1111, 7, 14, 7, 5);
+  replay.find(hdr);
+  delay(2);
+  const uint32_t evictions = replay.stats().peerEvictions;
+  buildHeader(&hdr, PKT_AUDIO_DATA, MESH_RX_REPLAY_PEERS + 1, MESH_NODE_ID, 0x01, 0x1111, 7, 14, 7, 5);
+  replay.store(hdr, ack, sizeof(ack), 7, 200);
+  const uint8_t victim = (MESH_RX_REPLAY_PEERS > 1) ? 2 : 1;
+  buildHeader(&hdr, PKT_AUDIO_DATA, victim, MESH_NODE_ID, 0x01, 0x1111, 7, 14, 7, 5);
+  ASSERT_TRUE(replay.stats().peerEvictions == evictions + 1 && replay.find(hdr) == nullptr,
+              "A peer past MESH_RX_REPLAY_PEERS evicts the least recently heard");
+}
+
+void test_display_schedule() {
+  TEST_START("StatusDisplay: Frame Cap and Quiet-Window Gate");
+
+  StatusDisplay::init();
+  StatusDisplay::service();
+  delay(MESH_DISPLAY_FRAME_MS);
+  ASSERT_FALSE(StatusDisplay::service(), "Nothing changed: nothing drawn");
+
+  StatusDisplay::onPacketReceived();
+  ASSERT_FALSE(StatusDisplay::service(MESH_DISPLAY_RENDER_MS - 1), "No frame without room for a render");
+  ASSERT_TRUE(StatusDisplay::service(MESH_DISPLAY_RENDER_MS), "Drawn once the radio is quiet long enough");
+
+  StatusDisplay::onPacketReceived();
+  ASSERT_FALSE(StatusDisplay::service(), "At most one frame per MESH_DISPLAY_FRAME_MS");
+  delay(MESH_DISPLAY_FRAME_MS);
+  ASSERT_TRUE(StatusDisplay::service(), "... the change is drawn in the next one");
+}
+
+void test_log_status_text() {
+  TEST_START("FixedString / logStatusText(): Cut, Never Reallocated");
+
+  // Every status, with the widest retry suffix, fits the status column uncut.
+  bool fits = true;
+  size_t widest = 0;
+  for (uint8_t st = 0; st < LOG_STATUS_COUNT; st++) {
+    const LogStatusText text = logStatusText(static_cast<LogStatus>(st), 255);
+    fits = fits && !text.truncated();
+    widest = (text.length() > widest) ? text.length() : widest;
+  }
+  Serial.printf("  %u statuses, widest %u/%u chars\n", LOG_STATUS_COUNT, static_cast<unsigned>(widest),
+                static_cast<unsigned>(LogStatusText::capacity()));
+  ASSERT_TRUE(fits, "All statuses fit LOG_STATUS_LEN with _R255");
+  ASSERT_TRUE(logStatusText(LOG_STATUS_ACK_OK, 0) == "ACK_OK_R0", "Sender attempts carry _R<retry>");
+  ASSERT_TRUE(logStatusText(LOG_STATUS_ACK_TIMEOUT, 1) == "ACK_TIMEOUT_R1", "... timeouts too");
+  ASSERT_TRUE(logStatusText(LOG_STATUS_ACK_SENT, 3) == "ACK_SENT", "Receiver replies have no suffix");
+  ASSERT_TRUE(logStatusText(LOG_STATUS_COUNT, 0) == "UNKNOWN", "Out-of-range status logs as UNKNOWN");
+
+  // Display messages longer than the line are cut and flagged.
+  FixedString<31> msg("Transfer done w/ END fail");
+  ASSERT_TRUE(msg == "Transfer done w/ END fail" && !msg.truncated(), "A message that fits is kept whole");
+  msg.assign("xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx");
+  ASSERT_TRUE(msg.length() == 31 && msg.truncated() && msg.c_str()[31] == '\0', "40 chars cut to 31, NUL kept");
+  msg.assign("seq").appendf(" %u of %u", 7U, 12U);
+  ASSERT_TRUE(msg == "seq 7 of 12" && !msg.truncated(), "appendf() formats in place");
+
+  FixedString<8> small("ACK");
+  small.appendf("_R%u_%s", 12U, "MORE");
+  ASSERT_TRUE(small == "ACK_R12_" && small.truncated(), "appendf() past N is cut");
+  small.append("x");
+  ASSERT_TRUE(small.length() == 8 && small.truncated(), "Append to a full string stays cut");
+  const FixedString<8> copy = small;
+  small.clear();
+  ASSERT_TRUE(copy == "ACK_R12_" && small.empty() && !small.truncated(), "Copies own their buffer; clear() resets");
+  ASSERT_TRUE(small.append(nullptr) == "", "nullptr appends nothing");
+}
+
+static RateController g_adr;
+
+// One full window for peer: every fourth sample lost when lossy.
+static void adrWindow(uint8_t peer, float snr, bool lossy, uint8_t samples = MESH_ADR_WINDOW) {
+  g_adr.reset(peer);
+  for (uint8_t i = 0; i < samples; i++) {
+    g_adr.record(peer, !(lossy && i % 4 == 0), snr, -60.0f);
+  }
+}
+
+void test_rate_controller() {
+  TEST_START("RateController: SNR Margin, Step Down, Step Up");
+
+  const uint8_t kPeer = 0x31;
+  LoRaRate rate = {10, 5, LORA_BW_CODE_125, 14};
+  LoRaRate next;
+
+  // Strong link (+6 dB): one SF per window to the fastest, then less power.
+  uint8_t windows = 0;
+  adrWindow(kPeer, 6.0f, false);
+  while (g_adr.decide(kPeer, rate, MESH_ADR_MAX_SF, next) && windows < 16) {
+    rate = next;
+    windows++;
+    adrWindow(kPeer, 6.0f, false);
+  }
+  ASSERT_EQUAL(MESH_ADR_MIN_SF, rate.sf, "Strong link settles at MESH_ADR_MIN_SF");
+  ASSERT_TRUE(rate.txPower < 14 && rate.txPower >= MESH_ADR_MIN_TX_POWER_DBM,
+              "... then sheds power, never below MESH_ADR_MIN_TX_POWER_DBM");
+
+  // SF - 1 only once the mean SNR clears its floor by MESH_ADR_SNR_MARGIN_DB.
+  rate = {9, 5, LORA_BW_CODE_125, 14};
+  adrWindow(kPeer, RateController::requiredSnrDb(8) + MESH_ADR_SNR_MARGIN_DB, false);
+  ASSERT_TRUE(g_adr.decide(kPeer, rate, MESH_ADR_MAX_SF, next) && next.sf == 8 && next.txPower == 14,
+              "Margin met: SF - 1 at the same power");
+  adrWindow(kPeer, RateController::requiredSnrDb(8) + MESH_ADR_SNR_MARGIN_DB - 0.5f, false);
+  ASSERT_FALSE(g_adr.decide(kPeer, rate, MESH_ADR_MAX_SF, next), "Half a dB short of the margin: stay");
+
+  // Lossy link (75 % ACKed): power first, then SF, never past maxSf.
+  adrWindow(kPeer, -12.0f, true);
+  ASSERT_TRUE(g_adr.decide(kPeer, rate, MESH_ADR_MAX_SF, next) && next.sf == 9 &&
+              next.txPower == 14 + MESH_ADR_POWER_STEP_DB,
+              "Below MESH_ADR_MIN_ACK_PCT: more power first");
+  rate.txPower = MESH_ADR_MAX_TX_POWER_DBM;
+  ASSERT_TRUE(g_adr.decide(kPeer, rate, MESH_ADR_MAX_SF, next) && next.sf == 10 &&
+              next.txPower == MESH_ADR_MAX_TX_POWER_DBM,
+              "... SF + 1 once power is at the cap");
+  rate.sf = 10;
+  ASSERT_FALSE(g_adr.decide(kPeer, rate, 10, next), "... but not past maxSf");
+
+  // A part-filled window never triggers a change.
+  adrWindow(kPeer, -12.0f, true, MESH_ADR_WINDOW - 1);
+  ASSERT_FALSE(g_adr.decide(kPeer, rate, MESH_ADR_MAX_SF, next), "Part-filled window: no decision");
+}
+
+// Never begun: only the heard-neighbour table behind txPreamble() is used.
+static LoRaManager g_preambleLora;
+
+static void heardFrom(uint8_t prevHop, uint32_t rxMs) {
+  LoRaRxFrame frame = {};
+  LoRaHeader hdr;
+  buildHeader(&hdr, PKT_AUDIO_DATA, prevHop, MESH_NODE_ID, 0x01, 0x2222, 1, 14, 7, 5);  // prev_hop = src
+  serializeHeader(&hdr, frame.data);
+  frame.len = LORA_HEADER_SIZE;
+  frame.rxMs = rxMs;
+  g_preambleLora.noteHeardFrom(frame);
+}
+
+void test_tx_preamble() {
+  TEST_START("LoRaManager: Wake Preamble per Next Hop");
+
+  heardFrom(0x21, millis());
+  heardFrom(0x22, millis() - MESH_LINK_IDLE_MS / 2);
+#if MESH_RX_DUTY_CYCLE
+  ASSERT_EQUAL(LORA_PREAMBLE_SYMBOLS, g_preambleLora.txPreamble(0x21), "Hop heard just now is awake: plain preamble");
+  ASSERT_EQUAL(MESH_LORA_WAKE_PREAMBLE, g_preambleLora.txPreamble(0x22), "Hop quiet for MESH_LINK_IDLE_MS / 2 may sleep");
+  ASSERT_EQUAL(MESH_LORA_WAKE_PREAMBLE, g_preambleLora.txPreamble(0x23), "Hop never heard gets the wake preamble");
+  ASSERT_EQUAL(MESH_LORA_WAKE_PREAMBLE, g_preambleLora.txPreamble(LORA_BROADCAST_ID),
+               "Broadcast always gets the wake preamble");
+  heardFrom(0x22, millis());
+  ASSERT_EQUAL(LORA_PREAMBLE_SYMBOLS, g_preambleLora.txPreamble(0x22), "A new frame from a hop wakes only that hop");
+  ASSERT_EQUAL(MESH_LORA_WAKE_PREAMBLE, g_preambleLora.txPreamble(LORA_BROADCAST_ID),
+               "... and never a broadcast");
+#else
+  ASSERT_EQUAL(LORA_PREAMBLE_SYMBOLS, g_preambleLora.txPreamble(0x22), "Without MESH_RX_DUTY_CYCLE every hop: plain");
+  ASSERT_EQUAL(LORA_PREAMBLE_SYMBOLS, g_preambleLora.txPreamble(LORA_BROADCAST_ID), "... broadcast too");
+#endif
+}
+
+#if MESH_PROFILE_ENABLE
+void test_stage_profiler() {
+  TEST_START("StageProfiler: Buckets Tile the Range, Percentiles Within a Quarter Octave");
+
+  // Each bucket's top + 1 is the next bucket's first duration.
+  bool tiled = true;
+  for (uint16_t i = 0; i + 1 < PROFILE_BUCKETS; i++) {
+    const uint32_t top = StageProfiler::bucketTop(i);
+    tiled = tiled && StageProfiler::bucketFor(top) == i && StageProfiler::bucketFor(top + 1) == i + 1;
+  }
+  ASSERT_TRUE(tiled, "Buckets are contiguous and do not overlap");
+  ASSERT_TRUE(StageProfiler::bucketTop(PROFILE_BUCKETS - 1) >= 100000000UL, "Range covers an SF12 ACK wait");
+  ASSERT_EQUAL(PROFILE_BUCKETS - 1, StageProfiler::bucketFor(UINT32_MAX), "Longer durations land in the last bucket");
+
+  StageProfiler::Summary sum;
+  StageProfiler::reset();
+  ASSERT_FALSE(StageProfiler::summary(PROFILE_FRAGMENT, sum), "Nothing recorded: no summary");
+  StageProfiler::record(PROFILE_FRAGMENT, 1200);
+  StageProfiler::summary(PROFILE_FRAGMENT, sum);
+  ASSERT_TRUE(sum.p50Us == 1200 && sum.p99Us == 1200, "One sample: percentiles clamp to it");
+
+  for (uint8_t i = 1; i < 50; i++) {
+    StageProfiler::record(PROFILE_FRAGMENT, 1200);
+  }
+  for (uint8_t i = 0; i < 49; i++) {
+    StageProfiler::record(PROFILE_FRAGMENT, 40000);
+  }
+  StageProfiler::record(PROFILE_FRAGMENT, 900000);
+  StageProfiler::summary(PROFILE_FRAGMENT, sum);
+  Serial.printf("  p50=%lu us p99=%lu us over %lu samples\n", static_cast<unsigned long>(sum.p50Us),
+                static_cast<unsigned long>(sum.p99Us), static_cast<unsigned long>(sum.count));
+  ASSERT_EQUAL(1279UL, sum.p50Us, "p50 of 1200 us reads back as its bucket top");
+  ASSERT_TRUE(sum.p99Us >= 40000 && sum.p99Us < 50000, "p99 within a quarter octave above 40 ms");
+  ASSERT_TRUE(sum.count == 100 && sum.minUs == 1200 && sum.maxUs == 900000 &&
+                  sum.totalUs == 50ULL * 1200 + 49ULL * 40000 + 900000,
+              "count, min, max and total are exact");
+  StageProfiler::reset();
+}
+#endif
+
 // ═══════════════════════════════════════════════════════════════════════════
 //  Arduino Setup & Loop
 // ═══════════════════════════════════════════════════════════════════════════
@@ -440,6 +1716,7 @@ void setup() {
   // Serialization tests
   test_serialize_deserialize_round_trip();
   test_deserialize_corrupted_data();
+  test_compact_header_round_trip();
   
   // Overflow and boundary tests
   test_makeVerType_overflow();
@@ -456,8 +1733,36 @@ void setup() {
   
   // CRC tests
   test_zero_length_crc();
+  test_crc_check_values();
+  test_crc_variants_match();
+  test_crc32_combine();
   test_audio_start_crc_validation();
   test_audio_start_crc_tamper_detection();
+  bench_crc();
+  bench_fec();
+  bench_adpcm();
+  test_ima_adpcm_blocks();
+
+  // Module tests
+  test_mesh_router_filter();
+  test_rtt_estimator();
+  test_rate_controller();
+  test_fragment_size();
+  test_airtime_scheduler();
+  test_state_machine_executor();
+  test_spsc_queue();
+  test_session_table();
+  test_resume_nack();
+  test_window_bitmap();
+  test_fec_parity();
+  test_out_of_order_reassembly();
+  test_replay_window();
+  test_display_schedule();
+  test_log_status_text();
+  test_tx_preamble();
+#if MESH_PROFILE_ENABLE
+  test_stage_profiler();
+#endif
   
   // DANGEROUS TESTS - These may crash the ESP32
   Serial.println();
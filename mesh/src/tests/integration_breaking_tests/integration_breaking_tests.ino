@@ -97,7 +97,7 @@ void test_sd_write_excessive_logs() {
       1,
       static_cast<uint16_t>(i),
       i,
-      245
+      242
     );
   }
   
@@ -179,7 +179,7 @@ void test_sd_csv_write_success() {
     return;
   }
 
-  SPIClass verifySpi(FSPI);
+  SPIClass verifySpi(HSPI);  // same host as SdManager
   verifySpi.begin(SD_SCK, SD_MISO, SD_MOSI, SD_CS);
 
   SdFat32 verifySd;
@@ -212,8 +212,8 @@ void test_sd_csv_write_success() {
     5000,
     0,
     32,
-    "DATA",
-    "ACK_OK"
+    PKT_AUDIO_DATA,
+    LOG_STATUS_ACK_OK
   );
   ASSERT_TRUE(writeOk, "logTransmission returns success");
   if (!writeOk) {
@@ -323,7 +323,7 @@ void test_lora_send_oversized_data() {
   uint8_t data[255];
   memset(data, 0xAA, 255);
   
-  // Try to send more than LORA_MAX_DATA_PAYLOAD (245 bytes)
+  // Try to send more than LORA_MAX_DATA_PAYLOAD (242 bytes)
   bool result = lora.sendAudioData(data, 255);
   
   ASSERT_FALSE(result, "LoRa rejects oversized data chunk");
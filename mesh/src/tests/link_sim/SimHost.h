@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * SimHost - what a node library asks of the link simulator
+ *
+ * link_sim.cpp exports these (it links with -rdynamic) and the host shims
+ * in host/ call them, so the firmware sources build unchanged. Every call
+ * is made on the calling node's own coroutine, which is how the simulator
+ * knows whose clock, SD directory and radio it is.
+ *
+ * Time only moves in simSleepUs(): a node that sleeps hands the CPU to the
+ * simulator, which runs radio events and other nodes up to its wake-up.
+ */
+
+struct SimRadioParams {
+  float    freqMhz;
+  float    bwKhz;
+  uint8_t  sf;
+  uint8_t  cr;
+  int8_t   powerDbm;
+  uint16_t preamble;
+};
+
+extern "C" {
+
+uint64_t simNowUs();
+void simSleepUs(uint64_t us);
+uint32_t simRandom();
+void simConsole(const char* text, size_t len);
+bool simConsoleEnabled();
+const char* simSdRoot();
+
+// One radio per node; begin returns its handle.
+int simRadioBegin(const SimRadioParams* params);
+void simRadioSetParams(int radio, const SimRadioParams* params);
+void simRadioSetIrq(int radio, void (*fn)());
+int simRadioTransmit(int radio, const uint8_t* data, size_t len);
+int simRadioFinishTransmit(int radio);
+int simRadioReceive(int radio);
+// Duty-cycled RX: wakes only for a preamble of at least about
+// senderPreamble - minSymbols symbols.
+int simRadioReceiveDutyCycle(int radio, uint16_t senderPreamble, uint16_t minSymbols);
+// Blocking CAD; 1 if a LoRa frame is on the channel, 0 if it is free.
+int simRadioScan(int radio);
+int simRadioStandby(int radio);
+size_t simRadioPacketLength(int radio);
+int simRadioRead(int radio, uint8_t* out, size_t len);
+float simRadioRssi(int radio);
+float simRadioSnr(int radio);
+uint32_t simRadioTimeOnAirUs(int radio, size_t len);
+
+}  // extern "C"
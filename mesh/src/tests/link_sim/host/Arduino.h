@@ -0,0 +1,157 @@
+#pragma once
+
+/*
+ * Arduino core for a node library of the link simulator (host, C++17).
+ *
+ * Just what the firmware uses: time goes to the simulator's clock, Serial
+ * to its console, and the FreeRTOS / ESP calls of the single-core build
+ * are no-ops. MESH_DUAL_CORE is not supported here.
+ */
+
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../SimHost.h"
+
+#define F(x) x
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define RISING 1
+#define FALLING 2
+#define IRAM_ATTR
+#define ARDUINO_ISR_ATTR
+#define DEC 10
+#define HEX 16
+
+inline uint32_t millis() { return static_cast<uint32_t>(simNowUs() / 1000ULL); }
+inline uint32_t micros() { return static_cast<uint32_t>(simNowUs()); }
+inline void delay(unsigned long ms) { simSleepUs(static_cast<uint64_t>(ms) * 1000ULL); }
+inline void delayMicroseconds(unsigned int us) { simSleepUs(us); }
+inline void yield() { simSleepUs(0); }
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return HIGH; }
+
+inline long random(long howBig) { return howBig > 0 ? static_cast<long>(simRandom() % static_cast<uint32_t>(howBig)) : 0; }
+inline long random(long lo, long hi) { return hi > lo ? lo + random(hi - lo) : lo; }
+
+class Print {
+ public:
+  virtual ~Print() = default;
+  virtual size_t write(const uint8_t* data, size_t len) = 0;
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(char c) { return write(reinterpret_cast<const uint8_t*>(&c), 1); }
+  size_t write(const char* text) { return write(reinterpret_cast<const uint8_t*>(text), strlen(text)); }
+
+  size_t printf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+    if (!enabled()) {
+      return 0;
+    }
+    char buf[512];
+    va_list args;
+    va_start(args, fmt);
+    const int len = vsnprintf(buf, sizeof(buf), fmt, args);
+    va_end(args);
+    if (len <= 0) {
+      return 0;
+    }
+    return write(reinterpret_cast<const uint8_t*>(buf), static_cast<size_t>(len) < sizeof(buf) ? len : sizeof(buf) - 1);
+  }
+
+  size_t print(const char* text) { return enabled() ? write(text) : 0; }
+  size_t print(char c) { return enabled() ? write(c) : 0; }
+  size_t print(long v, int base = DEC) { return base == HEX ? printf("%lX", v) : printf("%ld", v); }
+  size_t print(unsigned long v, int base = DEC) { return base == HEX ? printf("%lX", v) : printf("%lu", v); }
+  size_t print(int v, int base = DEC) { return print(static_cast<long>(v), base); }
+  size_t print(unsigned int v, int base = DEC) { return print(static_cast<unsigned long>(v), base); }
+  size_t print(unsigned char v, int base = DEC) { return print(static_cast<unsigned long>(v), base); }
+  size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+
+  template <typename T>
+  size_t println(T v) { return print(v) + println(); }
+  template <typename T>
+  size_t println(T v, int format) { return print(v, format) + println(); }
+  size_t println() { return print("\r\n"); }
+
+ protected:
+  virtual bool enabled() const { return true; }
+};
+
+class Stream : public Print {
+ public:
+  virtual int available() { return 0; }
+  virtual int read() { return -1; }
+};
+
+class HardwareSerial : public Stream {
+ public:
+  void begin(unsigned long) {}
+  void flush() {}
+  operator bool() const { return true; }
+  using Print::write;
+  size_t write(const uint8_t* data, size_t len) override {
+    simConsole(reinterpret_cast<const char*>(data), len);
+    return len;
+  }
+
+ protected:
+  bool enabled() const override { return simConsoleEnabled(); }
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+ public:
+  uint32_t getFreeHeap() const { return 256U * 1024U; }
+  uint32_t getMinFreeHeap() const { return 256U * 1024U; }
+  uint32_t getMaxAllocHeap() const { return 128U * 1024U; }
+  uint32_t getHeapSize() const { return 320U * 1024U; }
+};
+
+extern EspClass ESP;
+
+inline size_t strlcpy(char* dst, const char* src, size_t size) {
+  const size_t len = strlen(src);
+  if (size > 0) {
+    const size_t n = len < size - 1 ? len : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+  }
+  return len;
+}
+
+// ── FreeRTOS, single core ─────────────────────────────────────────────────
+typedef void* TaskHandle_t;
+typedef void* QueueHandle_t;
+typedef void* SemaphoreHandle_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+typedef struct { int unused; } portMUX_TYPE;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xFFFFFFFFUL
+#define pdMS_TO_TICKS(ms) (ms)
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(mux) (void)(mux)
+#define portEXIT_CRITICAL(mux) (void)(mux)
+#define portENTER_CRITICAL_ISR(mux) (void)(mux)
+#define portEXIT_CRITICAL_ISR(mux) (void)(mux)
+
+// The sketch's loop() is the only task.
+inline TaskHandle_t xTaskGetCurrentTaskHandle() {
+  static int loopTask;
+  return &loopTask;
+}
+inline void vTaskDelay(TickType_t ticks) { delay(ticks); }
@@ -0,0 +1,148 @@
+// Out-of-line parts of the host shims, linked into every node library.
+
+#include <sys/stat.h>
+#include <time.h>
+
+#include <Arduino.h>
+#include <SPI.h>
+#include <SSD1306Wire.h>
+#include <SdFat.h>
+
+HardwareSerial Serial;
+EspClass ESP;
+SPIClass SPI;
+
+const uint8_t ArialMT_Plain_10[] = {0};
+const uint8_t ArialMT_Plain_16[] = {0};
+const uint8_t ArialMT_Plain_24[] = {0};
+
+namespace {
+
+// path on the card -> path under this node's directory
+bool hostPath(const char* path, char* out, size_t size) {
+  while (*path == '/') {
+    path++;
+  }
+  const int len = snprintf(out, size, "%s/%s", simSdRoot(), path);
+  return len > 0 && static_cast<size_t>(len) < size;
+}
+
+bool hostExists(const char* path) {
+  struct stat st;
+  return stat(path, &st) == 0;
+}
+
+}  // namespace
+
+// ─── File32 ──────────────────────────────────────────────────────────────────
+
+bool File32::open(const char* path, oflag_t flags) {
+  close();
+  char full[512];
+  if (!hostPath(path, full, sizeof(full))) {
+    return false;
+  }
+  const bool exists = hostExists(full);
+  if ((flags & O_CREAT) && (flags & O_EXCL) && exists) {
+    return false;
+  }
+  const char* mode = "rb";
+  if ((flags & O_ACCMODE) != O_RDONLY) {
+    if (!exists && !(flags & O_CREAT)) {
+      return false;
+    }
+    mode = (flags & O_TRUNC) ? "w+b" : ((flags & O_APPEND) ? "a+b" : (exists ? "r+b" : "w+b"));
+  }
+  _file = fopen(full, mode);
+  _append = (flags & O_APPEND) != 0;
+  return _file != nullptr;
+}
+
+bool File32::close() {
+  if (_file == nullptr) {
+    return true;
+  }
+  const bool ok = fclose(_file) == 0;
+  _file = nullptr;
+  return ok;
+}
+
+bool File32::sync() { return _file != nullptr && fflush(_file) == 0; }
+
+size_t File32::write(const uint8_t* data, size_t len) {
+  if (_file == nullptr) {
+    return 0;
+  }
+  if (_append) {
+    fseek(_file, 0, SEEK_END);
+  }
+  return fwrite(data, 1, len, _file);
+}
+
+int File32::read(void* buf, size_t len) {
+  if (_file == nullptr) {
+    return -1;
+  }
+  return static_cast<int>(fread(buf, 1, len, _file));
+}
+
+int File32::read() {
+  uint8_t c = 0;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+int File32::available() {
+  const uint32_t pos = curPosition();
+  const uint32_t size = fileSize();
+  return size > pos ? static_cast<int>(size - pos) : 0;
+}
+
+bool File32::seekSet(uint32_t pos) { return _file != nullptr && fseek(_file, static_cast<long>(pos), SEEK_SET) == 0; }
+
+uint32_t File32::curPosition() const {
+  return _file != nullptr ? static_cast<uint32_t>(ftell(_file)) : 0;
+}
+
+uint32_t File32::fileSize() const {
+  struct stat st;
+  if (_file == nullptr) {
+    return 0;
+  }
+  fflush(_file);
+  return fstat(fileno(_file), &st) == 0 ? static_cast<uint32_t>(st.st_size) : 0;
+}
+
+bool File32::getModifyDateTime(uint16_t* date, uint16_t* time) {
+  struct stat st;
+  if (_file == nullptr || fstat(fileno(_file), &st) != 0) {
+    return false;
+  }
+  struct tm tm;
+  localtime_r(&st.st_mtime, &tm);
+  *date = static_cast<uint16_t>(((tm.tm_year - 80) << 9) | ((tm.tm_mon + 1) << 5) | tm.tm_mday);
+  *time = static_cast<uint16_t>((tm.tm_hour << 11) | (tm.tm_min << 5) | (tm.tm_sec / 2));
+  return true;
+}
+
+// ─── SdFat32 ─────────────────────────────────────────────────────────────────
+
+bool SdFat32::begin(const SdSpiConfig&) {
+  struct stat st;
+  return stat(simSdRoot(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+bool SdFat32::exists(const char* path) {
+  char full[512];
+  return hostPath(path, full, sizeof(full)) && hostExists(full);
+}
+
+bool SdFat32::remove(const char* path) {
+  char full[512];
+  return hostPath(path, full, sizeof(full)) && ::remove(full) == 0;
+}
+
+bool SdFat32::rename(const char* from, const char* to) {
+  char a[512];
+  char b[512];
+  return hostPath(from, a, sizeof(a)) && hostPath(to, b, sizeof(b)) && ::rename(a, b) == 0;
+}
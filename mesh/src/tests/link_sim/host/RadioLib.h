@@ -0,0 +1,104 @@
+#pragma once
+
+/*
+ * RadioLib's SX1262 for a node library of the link simulator: the calls
+ * LoRaManager makes, forwarded to the simulated channel in link_sim.cpp.
+ * Parameter setters take effect at once; a frame already on air keeps the
+ * parameters it was started with.
+ */
+
+#include <Arduino.h>
+
+#define RADIOLIB_ERR_NONE 0
+#define RADIOLIB_ERR_UNKNOWN -1
+#define RADIOLIB_ERR_PACKET_TOO_LONG -4
+#define RADIOLIB_ERR_TX_TIMEOUT -5
+#define RADIOLIB_ERR_RX_TIMEOUT -6
+#define RADIOLIB_ERR_CRC_MISMATCH -7
+#define RADIOLIB_ERR_INVALID_BANDWIDTH -8
+#define RADIOLIB_ERR_INVALID_SPREADING_FACTOR -9
+#define RADIOLIB_ERR_INVALID_CODING_RATE -10
+#define RADIOLIB_ERR_INVALID_OUTPUT_POWER -13
+#define RADIOLIB_LORA_DETECTED -702
+#define RADIOLIB_CHANNEL_FREE -711
+#define RADIOLIB_SX126X_SYNC_WORD_PRIVATE 0x12
+
+class Module {
+ public:
+  Module(int, int, int, int) {}
+};
+
+class SX1262 {
+ public:
+  SX1262(Module* module) : _module(module) {}
+  ~SX1262() { delete _module; }
+
+  int begin(float freqMhz, float bwKhz, uint8_t sf, uint8_t cr, uint8_t, int8_t powerDbm,
+            uint16_t preamble = 8) {
+    _params = {freqMhz, bwKhz, sf, cr, powerDbm, preamble};
+    _handle = simRadioBegin(&_params);
+    return _handle >= 0 ? RADIOLIB_ERR_NONE : RADIOLIB_ERR_UNKNOWN;
+  }
+
+  int setSpreadingFactor(uint8_t sf) {
+    if (sf < 5 || sf > 12) {
+      return RADIOLIB_ERR_INVALID_SPREADING_FACTOR;
+    }
+    _params.sf = sf;
+    return _apply();
+  }
+  int setBandwidth(float bwKhz) {
+    if (bwKhz < 7.0f || bwKhz > 510.0f) {
+      return RADIOLIB_ERR_INVALID_BANDWIDTH;
+    }
+    _params.bwKhz = bwKhz;
+    return _apply();
+  }
+  int setCodingRate(uint8_t cr) {
+    if (cr < 5 || cr > 8) {
+      return RADIOLIB_ERR_INVALID_CODING_RATE;
+    }
+    _params.cr = cr;
+    return _apply();
+  }
+  int setOutputPower(int8_t powerDbm) {
+    if (powerDbm < -9 || powerDbm > 22) {
+      return RADIOLIB_ERR_INVALID_OUTPUT_POWER;
+    }
+    _params.powerDbm = powerDbm;
+    return _apply();
+  }
+
+  int setPreambleLength(size_t preamble) {
+    _params.preamble = static_cast<uint16_t>(preamble);
+    return _apply();
+  }
+
+  void setDio1Action(void (*fn)()) { simRadioSetIrq(_handle, fn); }
+  void clearDio1Action() { simRadioSetIrq(_handle, nullptr); }
+
+  int startTransmit(const uint8_t* data, size_t len) { return simRadioTransmit(_handle, data, len); }
+  int finishTransmit() { return simRadioFinishTransmit(_handle); }
+  int startReceive() { return simRadioReceive(_handle); }
+  int startReceiveDutyCycleAuto(uint16_t senderPreambleLength = 0, uint16_t minSymbols = 8) {
+    return simRadioReceiveDutyCycle(_handle, senderPreambleLength != 0 ? senderPreambleLength : _params.preamble,
+                                    minSymbols);
+  }
+  int scanChannel() { return simRadioScan(_handle) ? RADIOLIB_LORA_DETECTED : RADIOLIB_CHANNEL_FREE; }
+  int standby() { return simRadioStandby(_handle); }
+  size_t getPacketLength(bool = true) { return simRadioPacketLength(_handle); }
+  int readData(uint8_t* out, size_t len) { return simRadioRead(_handle, out, len); }
+  float getRSSI() { return simRadioRssi(_handle); }
+  float getSNR() { return simRadioSnr(_handle); }
+  uint32_t getTimeOnAir(size_t len) { return simRadioTimeOnAirUs(_handle, len); }
+
+ private:
+  int _apply() {
+    simRadioSetParams(_handle, &_params);
+    return RADIOLIB_ERR_NONE;
+  }
+
+  Module* _module;
+  SimRadioParams _params = {};
+  int _handle = -1;
+};
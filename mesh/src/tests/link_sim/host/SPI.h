@@ -0,0 +1,17 @@
+#pragma once
+
+// SPI for a node library of the link simulator: nothing is on the bus.
+
+#include <Arduino.h>
+
+#define FSPI 0
+#define HSPI 1
+
+class SPIClass {
+ public:
+  explicit SPIClass(int = FSPI) {}
+  bool begin(int = -1, int = -1, int = -1, int = -1) { return true; }
+  void end() {}
+};
+
+extern SPIClass SPI;
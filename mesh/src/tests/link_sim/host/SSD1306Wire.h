@@ -0,0 +1,36 @@
+#pragma once
+
+// The OLED for a node library of the link simulator: draws nothing.
+
+#include <Arduino.h>
+
+#define GEOMETRY_128_64 0
+#define I2C_ONE 0
+#define TEXT_ALIGN_LEFT 0
+#define TEXT_ALIGN_CENTER 1
+#define TEXT_ALIGN_RIGHT 2
+#define BLACK 0
+#define WHITE 1
+
+extern const uint8_t ArialMT_Plain_10[];
+extern const uint8_t ArialMT_Plain_16[];
+extern const uint8_t ArialMT_Plain_24[];
+
+class SSD1306Wire {
+ public:
+  SSD1306Wire(uint8_t, int, int, int = GEOMETRY_128_64, int = I2C_ONE, uint32_t = 700000) {}
+  bool init() { return true; }
+  void displayOn() {}
+  void displayOff() {}
+  void flipScreenVertically() {}
+  void setFont(const uint8_t*) {}
+  void setTextAlignment(int) {}
+  void setColor(int) {}
+  void clear() {}
+  void display() {}
+  void drawString(int, int, const char*) {}
+  void drawLine(int, int, int, int) {}
+  void drawRect(int, int, int, int) {}
+  void fillRect(int, int, int, int) {}
+  uint16_t getStringWidth(const char*, uint16_t length, bool = false) { return static_cast<uint16_t>(length * 6); }
+};
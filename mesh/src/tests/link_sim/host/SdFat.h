@@ -0,0 +1,75 @@
+#pragma once
+
+/*
+ * SdFat for a node library of the link simulator: the card is a host
+ * directory (simSdRoot(), one per node) and File32 a stdio FILE. Paths
+ * are taken relative to that directory. Implemented in HostNode.cpp.
+ */
+
+#include <Arduino.h>
+#include <SPI.h>
+
+typedef int oflag_t;
+
+#define O_RDONLY 0x00
+#define O_READ O_RDONLY
+#define O_WRONLY 0x01
+#define O_WRITE O_WRONLY
+#define O_RDWR 0x02
+#define O_ACCMODE 0x03
+#define O_APPEND 0x08
+#define O_CREAT 0x10
+#define O_TRUNC 0x20
+#define O_EXCL 0x40
+
+#define DEDICATED_SPI 0x80
+#define SHARED_SPI 0x00
+#define SD_SCK_MHZ(mhz) (1000000UL * (mhz))
+
+class SdSpiConfig {
+ public:
+  SdSpiConfig(uint8_t, uint8_t, uint32_t, SPIClass* = nullptr) {}
+};
+
+class File32 : public Stream {
+ public:
+  File32() = default;
+  File32(const File32&) = delete;
+  File32& operator=(const File32&) = delete;
+  ~File32() { close(); }
+
+  bool open(const char* path, oflag_t flags = O_RDONLY);
+  bool close();
+  bool isOpen() const { return _file != nullptr; }
+  bool sync();
+  void flush() { sync(); }
+
+  using Print::write;
+  size_t write(const uint8_t* data, size_t len) override;
+  size_t write(const void* data, size_t len) { return write(static_cast<const uint8_t*>(data), len); }
+  int read(void* buf, size_t len);
+  int read() override;
+  int available() override;
+
+  bool seekSet(uint32_t pos);
+  uint32_t curPosition() const;
+  uint32_t fileSize() const;
+  bool getModifyDateTime(uint16_t* date, uint16_t* time);
+
+ private:
+  FILE* _file = nullptr;
+  bool _append = false;
+};
+
+class SdFat32 {
+ public:
+  bool begin(const SdSpiConfig&);
+  bool exists(const char* path);
+  bool remove(const char* path);
+  bool rename(const char* from, const char* to);
+  uint8_t sdErrorCode() const { return 0; }
+  uint8_t fatType() const { return 32; }
+  uint8_t sectorsPerCluster() const { return 64; }
+  void initErrorHalt(Print*) {}
+  void printSdError(Print*) {}
+};
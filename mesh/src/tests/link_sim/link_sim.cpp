@@ -0,0 +1,1075 @@
+/*
+ * link_sim - the real sketches on a simulated SX1262 channel, on the host
+ *
+ * Each node is a sketch (src.ino with MESH_APP_ROLE) built into its own
+ * shared library against the host shims in host/, so packet.cpp,
+ * LoRaManager, ResearchStateMachine, TransferTask, SessionTable and
+ * SdManager run unchanged, each library with its own MESH_NODE_ID and its
+ * own globals. The simulator loads the libraries and runs every node's
+ * setup() and loop() as a coroutine on one discrete-event clock. A node
+ * only gives up the CPU in delay() and between loop() passes, and time
+ * jumps straight to the next wake-up or radio event. Code runs in zero
+ * simulated time.
+ *
+ * Channel: a frame is on air for the SX126x time on air of its length
+ * (Airtime.h) at the sender's SF / BW / CR. A node hears it if it is in RX
+ * on the same frequency, SF and bandwidth by the last 5 preamble symbols
+ * and stays there, without transmitting, to the end of the frame. The SNR of each copy is --snr (at the sender's boot
+ * power; power changes shift it dB for dB) plus Gaussian fading of
+ * --fade-db. A copy decodes with probability
+ * 1 / (1 + exp(-(snr - floor(sf)) / 0.5)), where floor(sf) is the SX126x
+ * demodulation floor, -7.5 dB at SF7 down to -20 dB at SF12. It is then
+ * still dropped with probability --loss. Overlapping copies at one
+ * receiver collide, and the stronger survives only with 6 dB or more to
+ * spare. RSSI is the receiver's noise floor at its bandwidth (6 dB noise
+ * figure) plus the SNR.
+ *
+ * A receiver in duty-cycled RX only hears a frame whose preamble still
+ * spans one of its preamble searches (copies lost there count as asleep),
+ * and a CAD scan reports busy while a frame on its channel is on air above
+ * the demodulation floor. The report gives each radio's time in TX, RX and
+ * duty-cycled RX, and how much of the run it actually listened.
+ *
+ * Every node's SD card is a directory under --out, so the logs have the
+ * firmware's own schema: r2_sweep_report.py and log_analytics read a
+ * simulated run as they read a field run.
+ *
+ * --outage A:B loses every copy sent between A and B seconds (the link is
+ * gone, e.g. the peer walked out of range). --reboot NAME@S restarts node
+ * NAME at S seconds: a fresh copy of its library is loaded, so every global
+ * starts over, its clock restarts at 0 and only its SD directory is kept.
+ * Both may be given more than once; together they exercise resumed
+ * transfers (MESH_RESUME_ENABLE).
+ *
+ * --check audits the ACKs: every DATA fragment a node logged as ACK_OK in
+ * its lora_log.csv must have reached the node it was addressed to on the
+ * channel, or been rebuilt there from FEC parity (an RX_FEC_RECOVERED row).
+ * Headers are read with packet.cpp, compact ones expanded as a receiver
+ * does; a node's id is the prev_hop of the frames it sends.
+ * The run exits 1 if one did not, or if a session ended in a CRC mismatch.
+ * Two transmitters booted together share session ids and seqs, so an ACK
+ * taken for the other one's fragment shows up here:
+ *   ./link_sim --check --seconds 300 ./node_tx.so ./node_tx3.so ./node_rx.so
+ * with node_tx3.so built as the TX with -DMESH_NODE_ID=3.
+ *
+ * Build (host, C++17, POSIX; from mesh/src). Each node library takes the
+ * -D options a firmware build would (MESH_TRANSFER_MODE, MESH_FEC_PARITY,
+ * MESH_ADR_ENABLE, ...); MESH_DUAL_CORE is not supported:
+ *   node() { g++ -std=gnu++17 -O2 -fPIC -shared -Wl,-Bsymbolic -Wno-pragmas -Itests/link_sim/host \
+ *            -DMESH_TX_REPEAT_MS=500 -DMESH_RUN_ID='"SIM"' "$@" -x c++ src.ino -x none \
+ *            $(find src -name '*.cpp') tests/link_sim/host/HostNode.cpp; }
+ *   node -DMESH_APP_ROLE=1 -DMESH_NODE_ID=1 -DMESH_PEER_NODE_ID=2 -DMESH_LOG_ROLE='"TX"' -o node_tx.so
+ *   node -DMESH_APP_ROLE=2 -DMESH_NODE_ID=2 -DMESH_PEER_NODE_ID=1 -DMESH_LOG_ROLE='"RX"' -o node_rx.so
+ *   g++ -std=gnu++17 -O2 -rdynamic -Wno-pragmas -Itests/link_sim/host -o link_sim tests/link_sim/link_sim.cpp \
+ *       src/models/packet.cpp src/util/Crc.cpp -ldl
+ *
+ * Usage:
+ *   ./link_sim [--seconds S] [--snr DB] [--fade-db DB] [--loss P] [--seed N]
+ *              [--payload-bytes N] [--loop-us US] [--out DIR] [--verbose]
+ *              [--outage A:B] [--reboot NAME@S] [--check] ./node_tx.so ./node_rx.so
+ *   python tests/r2_sweep_report.py link_sim_out/node_tx/lora_log.csv
+ *
+ * A node's SD directory is --out/<library name>. The same seed gives the
+ * same run; only the wall-clock UTC columns of the logs differ.
+ */
+
+#include <dirent.h>
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <ucontext.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <queue>
+#include <random>
+#include <set>
+#include <functional>
+#include <string>
+#include <tuple>
+#include <string_view>
+#include <vector>
+
+#include <RadioLib.h>
+
+#include "SimHost.h"
+#include "../../src/comms/Airtime.h"
+#include "../../src/models/packet.h"
+
+namespace {
+
+struct Options {
+  double seconds = 600.0;
+  double snrDb = 10.0;
+  double fadeDb = 2.0;
+  double loss = 0.0;
+  uint32_t seed = 1;
+  uint32_t payloadBytes = 4096;
+  uint32_t loopUs = 1000;
+  std::string out = "link_sim_out";
+  bool verbose = false;
+  bool check = false;
+  std::vector<std::pair<uint64_t, uint64_t>> outages;   // [startUs, endUs)
+};
+
+struct Reboot {
+  uint64_t atUs;
+  std::string node;
+};
+
+Options g_opt;
+std::vector<Reboot> g_reboots;   // sorted by time, taken from the front
+std::mt19937 g_rng;
+uint64_t g_nowUs = 0;
+
+// ─── Radios and the channel ──────────────────────────────────────────────────
+
+enum class Mode : uint8_t { STANDBY, RX, TX };
+
+enum Loss : uint8_t {
+  LOSS_NONE, LOSS_NOT_LISTENING, LOSS_ASLEEP, LOSS_HALF_DUPLEX, LOSS_COLLISION, LOSS_CHANNEL, LOSS_OUTAGE, LOSS_COUNT
+};
+
+const char* const kLossNames[LOSS_COUNT] = {"delivered", "not_listening", "asleep", "half_duplex", "collision",
+                                            "channel", "outage"};
+
+bool inOutage(uint64_t us) {
+  for (const auto& outage : g_opt.outages) {
+    if (us >= outage.first && us < outage.second) {
+      return true;
+    }
+  }
+  return false;
+}
+
+struct Radio {
+  int node;
+  SimRadioParams params;
+  int8_t bootPowerDbm;
+  Mode mode = Mode::STANDBY;
+  bool dutyCycled = false;   // RX sleeps between preamble searches
+  uint16_t wakePreamble = 0;
+  uint16_t minSymbols = 0;
+  uint32_t epoch = 0;        // bumped whenever RX is interrupted
+  uint64_t modeSinceUs = 0;
+  uint64_t txUs = 0;         // time per mode, for the report
+  uint64_t rxUs = 0;
+  uint64_t dutyCycledUs = 0;
+  void (*irq)() = nullptr;
+  bool txDone = false;
+  uint8_t rxData[256];
+  size_t rxLen = 0;
+  float rxRssi = 0.0f;
+  float rxSnr = 0.0f;
+};
+
+// One copy of a frame at one receiver.
+struct Reception {
+  int radio;
+  uint32_t epoch;
+  float rssi;
+  float snr;
+  Loss loss;
+};
+
+struct Frame {
+  int sender;
+  uint64_t startUs;
+  uint64_t endUs;
+  SimRadioParams params;   // the sender's, as it sent the frame
+  std::vector<uint8_t> data;
+  std::vector<Reception> copies;
+};
+
+struct Event {
+  uint64_t atUs;
+  uint64_t order;   // insertion order breaks ties
+  size_t frame;
+  bool operator>(const Event& other) const {
+    return atUs != other.atUs ? atUs > other.atUs : order > other.order;
+  }
+};
+
+std::vector<Radio> g_radios;
+std::vector<Frame> g_frames;   // on air; slots are reused once delivered
+std::vector<size_t> g_freeFrames;
+std::priority_queue<Event, std::vector<Event>, std::greater<Event>> g_events;
+uint64_t g_eventOrder = 0;
+uint64_t g_lossCount[LOSS_COUNT] = {};
+uint64_t g_framesSent = 0;
+
+// --check: DATA and PARITY frames decoded per receiving node, and each node's id.
+using Landed = std::tuple<int, uint8_t, uint8_t, uint16_t, uint16_t>;   // node, dst, src, session, seq
+std::set<Landed> g_landed;
+std::set<Landed> g_landedParity;
+std::vector<int> g_nodeIds;   // by node index, -1 until it has sent a frame
+
+// The v2 header of a frame, expanding a compact one (MESH_WIRE_COMPACT) the
+// way its receivers do; the defaults are the sender's rate when it sent it.
+bool frameHeader(const std::vector<uint8_t>& data, const SimRadioParams& p, LoRaHeader& hdr) {
+  if (data.size() < LORA_COMPACT_HEADER_MIN || data.size() > LORA_MAX_PAYLOAD) {
+    return false;
+  }
+  uint8_t frame[LORA_MAX_PAYLOAD];
+  memcpy(frame, data.data(), data.size());
+  if (getVersion(frame[0]) == LORA_COMPACT_VERSION) {
+    const LoRaHeaderDefaults d = {0, static_cast<uint8_t>(p.powerDbm), makeSFCR(p.sf, p.cr)};
+    if (expandCompactFrame(frame, data.size(), d) == 0) {
+      return false;
+    }
+  } else if (data.size() < LORA_HEADER_SIZE || getVersion(frame[0]) != LORA_PROTOCOL_VERSION) {
+    return false;
+  }
+  deserializeHeader(frame, &hdr);
+  return true;
+}
+
+// SX126x demodulation floor: -7.5 dB at SF7, 2.5 dB lower per SF step.
+double snrFloorDb(uint8_t sf) { return -2.5 * (static_cast<int>(sf) - 6) - 5.0; }
+
+double noiseFloorDbm(float bwKhz) { return -174.0 + 10.0 * std::log10(bwKhz * 1000.0) + 6.0; }
+
+bool sameChannel(const SimRadioParams& a, const SimRadioParams& b) {
+  return a.sf == b.sf && std::fabs(a.bwKhz - b.bwKhz) < 0.1f && std::fabs(a.freqMhz - b.freqMhz) < 0.01f;
+}
+
+uint32_t timeOnAirUs(const SimRadioParams& p, size_t len) {
+  return loraTimeOnAirUs(static_cast<uint16_t>(len), p.sf, p.bwKhz, p.cr, p.preamble);
+}
+
+// Share of duty-cycled RX the radio listens: RadioLib searches about
+// minSymbols + 1 symbols, then sleeps wakePreamble - 2 * minSymbols.
+double dutyCycleListenShare(const Radio& radio) {
+  const double search = radio.minSymbols + 1.0;
+  const double sleep = std::max(0.0, static_cast<double>(radio.wakePreamble) - 2.0 * radio.minSymbols);
+  return search / (search + sleep);
+}
+
+// Close the time spent in the current mode, before changing it.
+void account(Radio& radio) {
+  const uint64_t spent = g_nowUs - radio.modeSinceUs;
+  if (radio.mode == Mode::TX) {
+    radio.txUs += spent;
+  } else if (radio.mode == Mode::RX) {
+    (radio.dutyCycled ? radio.dutyCycledUs : radio.rxUs) += spent;
+  }
+  radio.modeSinceUs = g_nowUs;
+}
+
+void setMode(Radio& radio, Mode mode, bool dutyCycled = false) {
+  account(radio);
+  radio.mode = mode;
+  radio.dutyCycled = mode == Mode::RX && dutyCycled;
+}
+
+void fireIrq(Radio& radio) {
+  if (radio.irq != nullptr) {
+    radio.irq();
+  }
+}
+
+void leaveRx(Radio& radio) {
+  if (radio.mode == Mode::RX) {
+    radio.epoch++;
+  }
+}
+
+Reception drawCopy(const Radio& from, const Radio& to, const Frame& frame) {
+  Reception copy{static_cast<int>(&to - g_radios.data()), to.epoch, 0.0f, 0.0f, LOSS_NONE};
+  if (to.mode != Mode::RX || !sameChannel(from.params, to.params)) {
+    copy.loss = LOSS_NOT_LISTENING;
+    return copy;
+  }
+  // A sleeping receiver's next preamble search must still land in the preamble.
+  if (to.dutyCycled && from.params.preamble + to.minSymbols < to.wakePreamble) {
+    copy.loss = LOSS_ASLEEP;
+    return copy;
+  }
+  std::normal_distribution<double> fade(0.0, g_opt.fadeDb);
+  const double snr = g_opt.snrDb + (from.params.powerDbm - from.bootPowerDbm) + (g_opt.fadeDb > 0 ? fade(g_rng) : 0.0);
+  copy.snr = static_cast<float>(snr);
+  copy.rssi = static_cast<float>(noiseFloorDbm(to.params.bwKhz) + snr);
+  std::uniform_real_distribution<double> uniform(0.0, 1.0);
+  const double pDecode = 1.0 / (1.0 + std::exp(-(snr - snrFloorDb(from.params.sf)) / 0.5));
+  if (uniform(g_rng) >= pDecode || uniform(g_rng) < g_opt.loss) {
+    copy.loss = LOSS_CHANNEL;
+  }
+  if (inOutage(frame.startUs)) {
+    copy.loss = LOSS_OUTAGE;
+  }
+
+  // Copies already arriving at this receiver overlap this one.
+  for (Frame& other : g_frames) {
+    if (other.data.empty() || &other == &frame || other.endUs <= frame.startUs) {
+      continue;
+    }
+    for (Reception& prior : other.copies) {
+      if (prior.radio != copy.radio || prior.loss == LOSS_NOT_LISTENING) {
+        continue;
+      }
+      if (prior.rssi >= copy.rssi + 6.0f) {
+        copy.loss = LOSS_COLLISION;
+      } else if (copy.rssi >= prior.rssi + 6.0f) {
+        prior.loss = prior.loss == LOSS_NONE ? LOSS_COLLISION : prior.loss;
+      } else {
+        copy.loss = LOSS_COLLISION;
+        prior.loss = prior.loss == LOSS_NONE ? LOSS_COLLISION : prior.loss;
+      }
+    }
+  }
+  return copy;
+}
+
+// Symbols of preamble a receiver needs to lock onto a frame.
+constexpr uint16_t kLockSymbols = 5;
+
+// RX armed while a frame's preamble is still on air locks onto it late.
+void lockLate(Radio& radio) {
+  const int index = static_cast<int>(&radio - g_radios.data());
+  for (Frame& frame : g_frames) {
+    if (frame.data.empty() || frame.sender == index) {
+      continue;
+    }
+    const Radio& from = g_radios[frame.sender];
+    const double symbolUs = 1000.0 * static_cast<double>(1UL << from.params.sf) / from.params.bwKhz;
+    const uint16_t usable = from.params.preamble > kLockSymbols ? from.params.preamble - kLockSymbols : 0;
+    if (g_nowUs >= frame.startUs + static_cast<uint64_t>(symbolUs * usable)) {
+      continue;
+    }
+    for (Reception& copy : frame.copies) {
+      if (copy.radio == index && copy.loss == LOSS_NOT_LISTENING) {
+        copy = drawCopy(from, radio, frame);
+      }
+    }
+  }
+}
+
+void deliver(size_t index) {
+  Frame& frame = g_frames[index];
+  Radio& sender = g_radios[frame.sender];
+  if (sender.mode == Mode::TX) {
+    sender.txDone = true;
+    fireIrq(sender);
+  }
+  for (const Reception& copy : frame.copies) {
+    Radio& rx = g_radios[copy.radio];
+    Loss loss = copy.loss;
+    if (loss == LOSS_NONE && (rx.mode != Mode::RX || rx.epoch != copy.epoch)) {
+      loss = LOSS_HALF_DUPLEX;
+    }
+    g_lossCount[loss]++;
+    if (loss != LOSS_NONE) {
+      continue;
+    }
+    LoRaHeader hdr;
+    if (g_opt.check && frameHeader(frame.data, frame.params, hdr)) {
+      const uint8_t type = getType(hdr.ver_type);
+      const Landed landed = {rx.node, hdr.dst_id, hdr.src_id, hdr.session_id, hdr.seq_num};
+      if (type == PKT_AUDIO_DATA || type == PKT_AUDIO_DATA_WIN) {
+        g_landed.insert(landed);
+      } else if (type == PKT_AUDIO_PARITY) {
+        g_landedParity.insert(landed);
+      }
+    }
+    memcpy(rx.rxData, frame.data.data(), frame.data.size());
+    rx.rxLen = frame.data.size();
+    rx.rxRssi = copy.rssi;
+    rx.rxSnr = copy.snr;
+    fireIrq(rx);
+  }
+  frame.data.clear();
+  frame.copies.clear();
+  g_freeFrames.push_back(index);
+}
+
+// ─── Nodes ───────────────────────────────────────────────────────────────────
+
+constexpr size_t kNodeStackBytes = 1U << 20;
+
+struct Node {
+  std::string name;
+  std::string sdRoot;
+  std::string path;    // library file, copied afresh for each reboot
+  uint32_t boots = 0;
+  uint64_t bootUs = 0; // the node's millis() / micros() count from here
+  void* lib = nullptr;
+  void (*setup)() = nullptr;
+  void (*loop)() = nullptr;
+  ucontext_t ctx;
+  std::unique_ptr<uint8_t[]> stack;
+  uint64_t wakeUs = 0;
+  std::string line;   // console text up to the next newline
+};
+
+std::vector<std::unique_ptr<Node>> g_nodes;
+ucontext_t g_schedulerCtx;
+int g_current = -1;
+
+void runNode(int index) {
+  Node& node = *g_nodes[index];
+  node.setup();
+  for (;;) {
+    node.loop();
+    simSleepUs(g_opt.loopUs);
+  }
+}
+
+// Resolve setup() / loop() and give the node a new coroutine at its start.
+bool startNode(Node& node, int index) {
+  // RTLD_LOCAL and -Bsymbolic keep each node's globals to itself. A bare
+  // file name would send dlopen() to the library search path.
+  node.lib = dlopen(node.path.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (node.lib == nullptr) {
+    fprintf(stderr, "Cannot load %s: %s\n", node.path.c_str(), dlerror());
+    return false;
+  }
+  node.setup = reinterpret_cast<void (*)()>(dlsym(node.lib, "_Z5setupv"));
+  node.loop = reinterpret_cast<void (*)()>(dlsym(node.lib, "_Z4loopv"));
+  if (node.setup == nullptr || node.loop == nullptr) {
+    fprintf(stderr, "%s has no setup() / loop()\n", node.path.c_str());
+    return false;
+  }
+
+  node.stack = std::make_unique<uint8_t[]>(kNodeStackBytes);
+  getcontext(&node.ctx);
+  node.ctx.uc_stack.ss_sp = node.stack.get();
+  node.ctx.uc_stack.ss_size = kNodeStackBytes;
+  node.ctx.uc_link = &g_schedulerCtx;
+  makecontext(&node.ctx, reinterpret_cast<void (*)()>(runNode), 1, index);
+  node.wakeUs = g_nowUs;
+  node.bootUs = g_nowUs;
+  node.line.clear();
+  return true;
+}
+
+bool loadNode(const char* path) {
+  auto node = std::make_unique<Node>();
+  std::string_view stem = path;
+  stem = stem.substr(stem.find_last_of('/') == std::string_view::npos ? 0 : stem.find_last_of('/') + 1);
+  stem = stem.substr(0, stem.find('.'));
+  node->name = std::string(stem);
+  node->sdRoot = g_opt.out + "/" + node->name;
+  node->path = strchr(path, '/') != nullptr ? path : std::string("./") + path;
+
+  if (!startNode(*node, static_cast<int>(g_nodes.size()))) {
+    return false;
+  }
+  for (const auto& other : g_nodes) {
+    if (other->lib == node->lib || other->name == node->name) {
+      fprintf(stderr, "%s is loaded twice; give every node its own library file\n", path);
+      return false;
+    }
+  }
+  g_nodes.push_back(std::move(node));
+  g_nodeIds.push_back(-1);
+  return true;
+}
+
+bool copyFile(const std::string& from, const std::string& to) {
+  FILE* in = fopen(from.c_str(), "rb");
+  FILE* out = in != nullptr ? fopen(to.c_str(), "wb") : nullptr;
+  bool ok = in != nullptr && out != nullptr;
+  char buf[65536];
+  size_t n = 0;
+  while (ok && (n = fread(buf, 1, sizeof(buf), in)) > 0) {
+    ok = fwrite(buf, 1, n, out) == n;
+  }
+  if (in != nullptr) {
+    fclose(in);
+  }
+  if (out != nullptr) {
+    ok = fclose(out) == 0 && ok;
+  }
+  return ok;
+}
+
+// Power-cycle a node. The old library stays mapped, never to run again;
+// dlopen() of a copy under a new name is what gets fresh globals. The radio
+// drops whatever it was doing and keeps its slot until begin() retunes it.
+bool rebootNode(int index) {
+  Node& node = *g_nodes[index];
+  const std::string image = g_opt.out + "/." + node.name + ".boot" + std::to_string(++node.boots) + ".so";
+  if (!copyFile(node.path, image)) {
+    fprintf(stderr, "Cannot copy %s for the reboot\n", node.path.c_str());
+    return false;
+  }
+  const std::string original = node.path;
+  node.path = image;
+  const bool ok = startNode(node, index);
+  node.path = original;
+  remove(image.c_str());
+  if (!ok) {
+    return false;
+  }
+  for (Radio& radio : g_radios) {
+    if (radio.node == index) {
+      leaveRx(radio);
+      setMode(radio, Mode::STANDBY);
+      radio.irq = nullptr;
+      radio.txDone = false;
+    }
+  }
+  printf("link_sim: %s rebooted at %.3f s\n", node.name.c_str(), static_cast<double>(g_nowUs) / 1e6);
+  return true;
+}
+
+// A fresh card: the payload TX sends, none of the last run's logs.
+bool prepareCard(const Node& node) {
+  mkdir(g_opt.out.c_str(), 0755);
+  mkdir(node.sdRoot.c_str(), 0755);
+  static const char* const kOutputs[] = {"lora_log.csv", "lora_log.bin", "lora_log_legacy.csv", "lora_log_legacy.bin",
+                                         "lora_sessions.csv", "lora_prof.csv"};
+  for (const char* name : kOutputs) {
+    remove((node.sdRoot + "/" + name).c_str());
+  }
+  // Nor what a resumed transfer would pick up: tx_resume.bin, rx_*.bin.
+  remove((node.sdRoot + "/tx_resume.bin").c_str());
+  if (DIR* dir = opendir(node.sdRoot.c_str())) {
+    while (const dirent* entry = readdir(dir)) {
+      const std::string_view name = entry->d_name;
+      if (name.substr(0, 3) == "rx_" && name.size() > 4 && name.substr(name.size() - 4) == ".bin") {
+        remove((node.sdRoot + "/" + std::string(name)).c_str());
+      }
+    }
+    closedir(dir);
+  }
+  const std::string payload = node.sdRoot + "/lora_payload_new.bin";
+  // Nor a CRC cached for the last payload: a new one of the same size written within
+  // the same 2 s FAT timestamp would match its key.
+  remove((payload + ".meta").c_str());
+  FILE* file = fopen(payload.c_str(), "wb");
+  if (file == nullptr) {
+    fprintf(stderr, "Cannot write %s\n", payload.c_str());
+    return false;
+  }
+  std::mt19937 bytes(g_opt.seed);
+  for (uint32_t i = 0; i < g_opt.payloadBytes; ++i) {
+    fputc(static_cast<int>(bytes() & 0xFF), file);
+  }
+  return fclose(file) == 0;
+}
+
+// ─── Report ──────────────────────────────────────────────────────────────────
+
+struct SessionTotals {
+  uint64_t complete = 0;
+  uint64_t crcMismatch = 0;
+  uint64_t evicted = 0;
+  uint64_t bytes = 0;
+  uint64_t elapsedMs = 0;
+};
+
+// lora_sessions.csv (SESSION_CSV_HEADER): outcome is column 3, bytes 9, elapsed_ms 10.
+SessionTotals readSessions(const Node& node) {
+  SessionTotals totals;
+  FILE* file = fopen((node.sdRoot + "/lora_sessions.csv").c_str(), "r");
+  if (file == nullptr) {
+    return totals;
+  }
+  char line[512];
+  while (fgets(line, sizeof(line), file) != nullptr) {
+    char* fields[12] = {};
+    int n = 0;
+    for (char* p = line; n < 12 && p != nullptr; ++n) {
+      fields[n] = p;
+      p = strchr(p, ',');
+      if (p != nullptr) {
+        *p++ = '\0';
+      }
+    }
+    if (n < 11 || strcmp(fields[0], "run_id") == 0) {
+      continue;
+    }
+    if (strcmp(fields[3], "COMPLETE") == 0) {
+      totals.complete++;
+      totals.bytes += strtoull(fields[9], nullptr, 10);
+      totals.elapsedMs += strtoull(fields[10], nullptr, 10);
+    } else if (strcmp(fields[3], "CRC_MISMATCH") == 0) {
+      totals.crcMismatch++;
+    } else if (strcmp(fields[3], "EVICTED") == 0) {
+      totals.evicted++;
+    }
+  }
+  fclose(file);
+  return totals;
+}
+
+struct AckAudit {
+  uint64_t acked = 0;
+  uint64_t unbacked = 0;
+  bool logged = false;   // lora_log.csv had the columns
+};
+
+// Calls row() with the named columns of every row of a node's lora_log.csv;
+// false if the file is missing or lacks one of them.
+bool forEachLogRow(const Node& node, const std::vector<const char*>& columns,
+                   const std::function<void(const std::vector<const char*>&)>& row) {
+  FILE* file = fopen((node.sdRoot + "/lora_log.csv").c_str(), "r");
+  if (file == nullptr) {
+    return false;
+  }
+  std::vector<int> col(columns.size(), -1);
+  bool known = false;
+  size_t width = 0;
+  std::vector<const char*> values(columns.size());
+  char line[1024];
+  while (fgets(line, sizeof(line), file) != nullptr) {
+    line[strcspn(line, "\r\n")] = '\0';
+    std::vector<char*> fields;
+    for (char* p = line; p != nullptr;) {
+      fields.push_back(p);
+      p = strchr(p, ',');
+      if (p != nullptr) {
+        *p++ = '\0';
+      }
+    }
+    if (!known) {
+      for (size_t i = 0; i < fields.size(); ++i) {
+        for (size_t c = 0; c < columns.size(); ++c) {
+          if (strcmp(fields[i], columns[c]) == 0) {
+            col[c] = static_cast<int>(i);
+          }
+        }
+      }
+      if (std::any_of(col.begin(), col.end(), [](int c) { return c < 0; })) {
+        break;   // not the CSV schema this audit knows
+      }
+      width = fields.size();
+      known = true;
+      continue;
+    }
+    if (fields.size() < width) {
+      continue;
+    }
+    for (size_t c = 0; c < columns.size(); ++c) {
+      values[c] = fields[col[c]];
+    }
+    row(values);
+  }
+  fclose(file);
+  return known;
+}
+
+// Fragments a receiver rebuilt from parity (RX_FEC_RECOVERED): src,
+// session, frag. Its row names the PARITY or DATA frame that completed the
+// group, which names the sender.
+std::set<std::tuple<uint8_t, uint16_t, uint16_t>> recoveredFragments() {
+  std::set<std::tuple<uint8_t, uint16_t, uint16_t>> recovered;
+  for (size_t i = 0; i < g_nodes.size(); ++i) {
+    forEachLogRow(*g_nodes[i], {"session_id", "seq_num", "frag_index", "status"},
+                  [&](const std::vector<const char*>& v) {
+      const long frag = strtol(v[2], nullptr, 10);
+      if (strcmp(v[3], "RX_FEC_RECOVERED") != 0 || frag < 0) {
+        return;
+      }
+      const auto session = static_cast<uint16_t>(strtoul(v[0], nullptr, 10));
+      const auto seq = static_cast<uint16_t>(strtoul(v[1], nullptr, 10));
+      for (const std::set<Landed>* landed : {&g_landedParity, &g_landed}) {
+        for (const auto& [rxNode, dst, src, frameSession, frameSeq] : *landed) {
+          if (rxNode == static_cast<int>(i) && g_nodeIds[rxNode] == dst && frameSession == session &&
+              frameSeq == seq) {
+            recovered.insert({src, session, static_cast<uint16_t>(frag)});
+          }
+        }
+      }
+    });
+  }
+  return recovered;
+}
+
+// Each DATA ACK_OK row of lora_log.csv against the fragments that landed
+// or that the receiver rebuilt.
+AckAudit auditAcks(const Node& node, const std::set<std::tuple<uint8_t, uint16_t, uint16_t>>& recovered) {
+  AckAudit audit;
+  std::set<std::tuple<uint8_t, uint16_t, uint16_t>> delivered;   // src, session, seq
+  for (const auto& [rxNode, dst, src, session, seq] : g_landed) {
+    if (g_nodeIds[rxNode] == dst) {
+      delivered.insert({src, session, seq});
+    }
+  }
+  audit.logged = forEachLogRow(node, {"node_id", "session_id", "seq_num", "frag_index", "packet_type", "status"},
+                               [&](const std::vector<const char*>& v) {
+    if (strcmp(v[4], "DATA") != 0 || strncmp(v[5], "ACK_OK", 6) != 0) {
+      return;
+    }
+    audit.acked++;
+    const auto src = static_cast<uint8_t>(strtoul(v[0], nullptr, 10));
+    const auto session = static_cast<uint16_t>(strtoul(v[1], nullptr, 10));
+    const auto seq = static_cast<uint16_t>(strtoul(v[2], nullptr, 10));
+    const auto frag = static_cast<uint16_t>(strtoul(v[3], nullptr, 10));
+    if (delivered.count({src, session, seq}) == 0 && recovered.count({src, session, frag}) == 0) {
+      audit.unbacked++;
+    }
+  });
+  return audit;
+}
+
+int usage() {
+  fprintf(stderr,
+          "usage: link_sim [--seconds S] [--snr DB] [--fade-db DB] [--loss P] [--seed N]\n"
+          "                [--payload-bytes N] [--loop-us US] [--out DIR] [--verbose]\n"
+          "                [--outage A:B] [--reboot NAME@S] [--check] NODE.so...\n");
+  return 2;
+}
+
+}  // namespace
+
+// ─── SimHost ─────────────────────────────────────────────────────────────────
+
+extern "C" {
+
+// Each node's clock starts at its (last) boot.
+uint64_t simNowUs() { return g_current >= 0 ? g_nowUs - g_nodes[g_current]->bootUs : g_nowUs; }
+
+void simSleepUs(uint64_t us) {
+  if (g_current < 0) {
+    return;   // static constructors while a library loads
+  }
+  Node& node = *g_nodes[g_current];
+  node.wakeUs = g_nowUs + std::max<uint64_t>(us, 1);
+  swapcontext(&node.ctx, &g_schedulerCtx);
+}
+
+uint32_t simRandom() { return static_cast<uint32_t>(g_rng()); }
+
+bool simConsoleEnabled() { return g_opt.verbose; }
+
+void simConsole(const char* text, size_t len) {
+  if (!g_opt.verbose || g_current < 0) {
+    return;
+  }
+  Node& node = *g_nodes[g_current];
+  for (size_t i = 0; i < len; ++i) {
+    if (text[i] == '\n') {
+      printf("%10.3f %s| %s\n", static_cast<double>(g_nowUs) / 1e6, node.name.c_str(), node.line.c_str());
+      node.line.clear();
+    } else if (text[i] != '\r') {
+      node.line.push_back(text[i]);
+    }
+  }
+}
+
+const char* simSdRoot() { return g_current >= 0 ? g_nodes[g_current]->sdRoot.c_str() : "."; }
+
+int simRadioBegin(const SimRadioParams* params) {
+  if (g_current < 0) {
+    return -1;
+  }
+  for (size_t i = 0; i < g_radios.size(); ++i) {
+    if (g_radios[i].node == g_current) {
+      g_radios[i].params = *params;   // init() again: same radio
+      return static_cast<int>(i);
+    }
+  }
+  Radio radio;
+  radio.node = g_current;
+  radio.params = *params;
+  radio.bootPowerDbm = params->powerDbm;
+  g_radios.push_back(radio);
+  return static_cast<int>(g_radios.size() - 1);
+}
+
+void simRadioSetParams(int radio, const SimRadioParams* params) {
+  Radio& r = g_radios[radio];
+  leaveRx(r);   // retuning drops a frame being received
+  r.params = *params;
+}
+
+void simRadioSetIrq(int radio, void (*fn)()) { g_radios[radio].irq = fn; }
+
+int simRadioTransmit(int radio, const uint8_t* data, size_t len) {
+  Radio& r = g_radios[radio];
+  if (r.mode == Mode::TX) {
+    return RADIOLIB_ERR_TX_TIMEOUT;
+  }
+  if (len == 0 || len > sizeof(r.rxData)) {
+    return RADIOLIB_ERR_PACKET_TOO_LONG;
+  }
+  leaveRx(r);
+  setMode(r, Mode::TX);
+  r.txDone = false;
+
+  size_t index;
+  if (g_freeFrames.empty()) {
+    index = g_frames.size();
+    g_frames.emplace_back();
+  } else {
+    index = g_freeFrames.back();
+    g_freeFrames.pop_back();
+  }
+  Frame& frame = g_frames[index];
+  frame.sender = radio;
+  frame.startUs = g_nowUs;
+  frame.endUs = g_nowUs + timeOnAirUs(r.params, len);
+  frame.data.assign(data, data + len);
+  frame.params = r.params;
+  LoRaHeader hdr;
+  if (frameHeader(frame.data, r.params, hdr)) {
+    g_nodeIds[r.node] = hdr.prev_hop;
+  }
+  for (Radio& other : g_radios) {
+    if (&other != &r) {
+      frame.copies.push_back(drawCopy(r, other, frame));
+    }
+  }
+  g_events.push({frame.endUs, g_eventOrder++, index});
+  g_framesSent++;
+  return RADIOLIB_ERR_NONE;
+}
+
+int simRadioFinishTransmit(int radio) {
+  Radio& r = g_radios[radio];
+  const bool done = r.mode == Mode::TX && r.txDone;
+  setMode(r, Mode::STANDBY);
+  r.txDone = false;
+  return done ? RADIOLIB_ERR_NONE : RADIOLIB_ERR_TX_TIMEOUT;
+}
+
+int simRadioReceive(int radio) {
+  Radio& r = g_radios[radio];
+  if (r.mode != Mode::RX || r.dutyCycled) {
+    r.epoch++;
+    setMode(r, Mode::RX);
+    lockLate(r);
+  }
+  return RADIOLIB_ERR_NONE;
+}
+
+int simRadioReceiveDutyCycle(int radio, uint16_t senderPreamble, uint16_t minSymbols) {
+  Radio& r = g_radios[radio];
+  r.epoch++;
+  setMode(r, Mode::RX, true);
+  r.wakePreamble = senderPreamble;
+  r.minSymbols = minSymbols;
+  lockLate(r);
+  return RADIOLIB_ERR_NONE;
+}
+
+// RadioLib's default CAD: 2 symbols below SF9, 4 from there, then the
+// detection itself. It sees any frame on the channel above the demodulation
+// floor, preamble or payload.
+int simRadioScan(int radio) {
+  Radio& r = g_radios[radio];
+  leaveRx(r);
+  setMode(r, Mode::STANDBY);
+  const double symbolUs = 1000.0 * static_cast<double>(1UL << r.params.sf) / r.params.bwKhz;
+  const uint64_t cadUs = static_cast<uint64_t>(symbolUs * (r.params.sf < 9 ? 2.5 : 4.5));
+  const uint64_t startUs = g_nowUs;
+  simSleepUs(cadUs);
+  r.rxUs += cadUs;
+  r.modeSinceUs = g_nowUs;
+
+  bool busy = false;
+  for (const Frame& frame : g_frames) {
+    if (frame.data.empty() || frame.sender == radio || frame.endUs <= startUs || frame.startUs >= g_nowUs) {
+      continue;
+    }
+    const Radio& from = g_radios[frame.sender];
+    const double snr = g_opt.snrDb + (from.params.powerDbm - from.bootPowerDbm);
+    busy = busy || (sameChannel(from.params, r.params) && snr >= snrFloorDb(from.params.sf));
+  }
+  fireIrq(r);   // CAD done
+  return busy ? 1 : 0;
+}
+
+int simRadioStandby(int radio) {
+  Radio& r = g_radios[radio];
+  leaveRx(r);
+  setMode(r, Mode::STANDBY);
+  return RADIOLIB_ERR_NONE;
+}
+
+size_t simRadioPacketLength(int radio) { return g_radios[radio].rxLen; }
+
+int simRadioRead(int radio, uint8_t* out, size_t len) {
+  Radio& r = g_radios[radio];
+  memcpy(out, r.rxData, std::min(len, r.rxLen));
+  return RADIOLIB_ERR_NONE;
+}
+
+float simRadioRssi(int radio) { return g_radios[radio].rxRssi; }
+
+float simRadioSnr(int radio) { return g_radios[radio].rxSnr; }
+
+uint32_t simRadioTimeOnAirUs(int radio, size_t len) { return timeOnAirUs(g_radios[radio].params, len); }
+
+}  // extern "C"
+
+int main(int argc, char** argv) {
+  std::vector<const char*> libs;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (arg == "--seconds" && hasValue) {
+      g_opt.seconds = std::max(0.001, atof(argv[++i]));
+    } else if (arg == "--snr" && hasValue) {
+      g_opt.snrDb = atof(argv[++i]);
+    } else if (arg == "--fade-db" && hasValue) {
+      g_opt.fadeDb = std::max(0.0, atof(argv[++i]));
+    } else if (arg == "--loss" && hasValue) {
+      g_opt.loss = std::min(1.0, std::max(0.0, atof(argv[++i])));
+    } else if (arg == "--seed" && hasValue) {
+      g_opt.seed = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--payload-bytes" && hasValue) {
+      g_opt.payloadBytes = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "--loop-us" && hasValue) {
+      g_opt.loopUs = std::max(1u, static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10)));
+    } else if (arg == "--out" && hasValue) {
+      g_opt.out = argv[++i];
+    } else if (arg == "--verbose") {
+      g_opt.verbose = true;
+    } else if (arg == "--check") {
+      g_opt.check = true;
+    } else if (arg == "--outage" && hasValue) {
+      const char* spec = argv[++i];
+      const char* colon = strchr(spec, ':');
+      if (colon == nullptr) {
+        return usage();
+      }
+      g_opt.outages.emplace_back(static_cast<uint64_t>(atof(spec) * 1e6), static_cast<uint64_t>(atof(colon + 1) * 1e6));
+    } else if (arg == "--reboot" && hasValue) {
+      const std::string_view spec = argv[++i];
+      const size_t at = spec.find('@');
+      if (at == std::string_view::npos) {
+        return usage();
+      }
+      g_reboots.push_back({static_cast<uint64_t>(atof(std::string(spec.substr(at + 1)).c_str()) * 1e6),
+                           std::string(spec.substr(0, at))});
+    } else if (!arg.empty() && arg[0] == '-') {
+      return usage();
+    } else {
+      libs.push_back(argv[i]);
+    }
+  }
+  if (libs.size() < 2) {
+    return usage();
+  }
+  g_rng.seed(g_opt.seed);
+
+  for (const char* lib : libs) {
+    if (!loadNode(lib) || !prepareCard(*g_nodes.back())) {
+      return 2;
+    }
+  }
+  std::sort(g_reboots.begin(), g_reboots.end(),
+            [](const Reboot& a, const Reboot& b) { return a.atUs < b.atUs; });
+  for (const Reboot& reboot : g_reboots) {
+    const bool known = std::any_of(g_nodes.begin(), g_nodes.end(),
+                                   [&](const std::unique_ptr<Node>& node) { return node->name == reboot.node; });
+    if (!known) {
+      fprintf(stderr, "--reboot: no node named %s\n", reboot.node.c_str());
+      return 2;
+    }
+  }
+  size_t nextReboot = 0;
+
+  const uint64_t endUs = static_cast<uint64_t>(g_opt.seconds * 1e6);
+  const auto wallStart = std::chrono::steady_clock::now();
+  for (;;) {
+    Node* next = nullptr;
+    int nextIndex = -1;
+    for (size_t i = 0; i < g_nodes.size(); ++i) {
+      if (next == nullptr || g_nodes[i]->wakeUs < next->wakeUs) {
+        next = g_nodes[i].get();
+        nextIndex = static_cast<int>(i);
+      }
+    }
+    // Reboots before anything else due at the same time.
+    if (nextReboot < g_reboots.size() && g_reboots[nextReboot].atUs <= next->wakeUs &&
+        (g_events.empty() || g_reboots[nextReboot].atUs <= g_events.top().atUs)) {
+      const Reboot& reboot = g_reboots[nextReboot++];
+      if (reboot.atUs > endUs) {
+        break;
+      }
+      g_nowUs = std::max(g_nowUs, reboot.atUs);
+      for (size_t i = 0; i < g_nodes.size(); ++i) {
+        if (g_nodes[i]->name == reboot.node && !rebootNode(static_cast<int>(i))) {
+          return 2;
+        }
+      }
+      continue;
+    }
+    // Radio events first, so a node waking at the same time sees them.
+    if (!g_events.empty() && g_events.top().atUs <= next->wakeUs) {
+      const Event event = g_events.top();
+      if (event.atUs > endUs) {
+        break;
+      }
+      g_events.pop();
+      g_nowUs = event.atUs;
+      deliver(event.frame);
+      continue;
+    }
+    if (next->wakeUs > endUs) {
+      break;
+    }
+    g_nowUs = next->wakeUs;
+    g_current = nextIndex;
+    swapcontext(&g_schedulerCtx, &next->ctx);
+    g_current = -1;
+  }
+  const double wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+  uint64_t copies = 0;
+  for (uint64_t count : g_lossCount) {
+    copies += count;
+  }
+  printf("link_sim: %.1f s simulated in %.2f s (%.0fx), %zu nodes, seed %u\n", g_opt.seconds, wallS,
+         wallS > 0 ? g_opt.seconds / wallS : 0.0, g_nodes.size(), g_opt.seed);
+  printf("frames sent=%llu copies=%llu", static_cast<unsigned long long>(g_framesSent),
+         static_cast<unsigned long long>(copies));
+  for (int i = 0; i < LOSS_COUNT; ++i) {
+    printf(" %s=%llu", kLossNames[i], static_cast<unsigned long long>(g_lossCount[i]));
+  }
+  printf("\n");
+  g_nowUs = endUs;
+  for (Radio& radio : g_radios) {
+    account(radio);
+  }
+  bool checkFailed = false;
+  const auto recovered = g_opt.check ? recoveredFragments() : decltype(recoveredFragments()){};
+  for (size_t i = 0; i < g_nodes.size(); ++i) {
+    const auto& node = g_nodes[i];
+    for (const Radio& radio : g_radios) {
+      if (radio.node != static_cast<int>(i)) {
+        continue;
+      }
+      const double listenS = (static_cast<double>(radio.rxUs) +
+                              dutyCycleListenShare(radio) * static_cast<double>(radio.dutyCycledUs)) / 1e6;
+      printf("%s: radio tx=%.1f s rx=%.1f s duty_cycled=%.1f s, listening %.1f%% of the run\n", node->name.c_str(),
+             static_cast<double>(radio.txUs) / 1e6, static_cast<double>(radio.rxUs) / 1e6,
+             static_cast<double>(radio.dutyCycledUs) / 1e6, 100.0 * listenS / g_opt.seconds);
+    }
+    if (g_opt.check) {
+      const AckAudit audit = auditAcks(*node, recovered);
+      if (audit.acked > 0) {
+        printf("%s: check data_acked=%llu not_at_receiver=%llu\n", node->name.c_str(),
+               static_cast<unsigned long long>(audit.acked), static_cast<unsigned long long>(audit.unbacked));
+      }
+      checkFailed = checkFailed || audit.unbacked > 0;
+    }
+    const SessionTotals s = readSessions(*node);
+    checkFailed = checkFailed || (g_opt.check && s.crcMismatch > 0);
+    if (s.complete + s.crcMismatch + s.evicted == 0) {
+      printf("%s: logs in %s\n", node->name.c_str(), node->sdRoot.c_str());
+      continue;
+    }
+    printf("%s: sessions complete=%llu crc_mismatch=%llu evicted=%llu goodput=%.0f bps (%.1f transfers/s wall), logs in %s\n",
+           node->name.c_str(), static_cast<unsigned long long>(s.complete),
+           static_cast<unsigned long long>(s.crcMismatch), static_cast<unsigned long long>(s.evicted),
+           s.elapsedMs > 0 ? 8000.0 * static_cast<double>(s.bytes) / static_cast<double>(s.elapsedMs) : 0.0,
+           wallS > 0 ? static_cast<double>(s.complete) / wallS : 0.0, node->sdRoot.c_str());
+  }
+  if (checkFailed) {
+    printf("link_sim: CHECK FAILED\n");
+  }
+  // Nodes stop mid-loop; exit without running their destructors.
+  fflush(stdout);
+  _exit(checkFailed ? 1 : 0);
+}
@@ -0,0 +1,791 @@
+/*
+ * log_analytics - sweep aggregates for large sets of lora_log.csv / lora_log.bin
+ *
+ * The compiled counterpart of r2_sweep_report.py for multi-day, multi-node
+ * runs. Each file is memory-mapped; CSV files are cut into line-aligned
+ * chunks and binary logs (src/storage/LogFormat.h, v1-v4) go one per job,
+ * since their rows take SF, timeout and mode from the META record before
+ * them. Worker threads fold rows into their own buckets and the buckets are
+ * merged at the end, so memory does not grow with the row count: latencies
+ * go into fixed histograms, exact to 1 ms below 1024 ms and within 1/64
+ * above that (1/16 above 128 ms in the time series). A value that repeats,
+ * such as a configured deadline, comes back exact at any size.
+ *
+ * Rows are counted as r2_sweep_report.py counts them. Rows flagged dup=1
+ * and rows without sf / ack_timeout_ms are skipped. Attempts are the
+ * ACK_OK_R<n> / ACK_TIMEOUT_R<n> rows, and n is the retry index. Buckets
+ * are (transfer_mode, sf, ack_timeout_ms, distance_m). distance_m is the
+ * GPS fix's distance from --origin, rounded down to --distance-bin-m, or -1
+ * without an origin or a fix. goodput_bps is the ACKed DATA bytes over the
+ * summed first-send-to-last-ACK span of each session in the bucket.
+ *
+ * The summary is a CSV that `r2_sweep_report.py --summary` renders. With
+ * --timeseries, a second CSV holds one row per (window, sf).
+ *
+ * Build (host, C++17, POSIX):
+ *   g++ -std=c++17 -O2 -pthread -o log_analytics src/tests/log_analytics/log_analytics.cpp
+ *
+ * Usage:
+ *   ./log_analytics [--threads N] [--origin LAT,LON] [--distance-bin-m M]
+ *                   [--summary out.csv] [--timeseries ts.csv] [--window-s S]
+ *                   lora_log.csv [node2/lora_log.bin ...]
+ *   python src/tests/r2_sweep_report.py --summary out.csv
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "../../src/storage/LogFormat.h"
+
+namespace {
+
+// ─── Memory-mapped input ─────────────────────────────────────────────────────
+
+class MappedFile {
+ public:
+  explicit MappedFile(const char* path) {
+    _fd = ::open(path, O_RDONLY);
+    struct stat st;
+    if (_fd < 0 || ::fstat(_fd, &st) != 0) {
+      return;
+    }
+    _size = static_cast<size_t>(st.st_size);
+    if (_size == 0) {
+      _ok = true;
+      return;
+    }
+    void* p = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+    if (p == MAP_FAILED) {
+      return;
+    }
+    ::madvise(p, _size, MADV_SEQUENTIAL);
+    _data = static_cast<const char*>(p);
+    _ok = true;
+  }
+  ~MappedFile() {
+    if (_data != nullptr) {
+      ::munmap(const_cast<char*>(_data), _size);
+    }
+    if (_fd >= 0) {
+      ::close(_fd);
+    }
+  }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  bool ok() const { return _ok; }
+  std::string_view bytes() const { return {_data, _size}; }
+
+ private:
+  int _fd = -1;
+  const char* _data = nullptr;
+  size_t _size = 0;
+  bool _ok = false;
+};
+
+// ─── Latency histogram ───────────────────────────────────────────────────────
+
+// 1 ms bins below 2^LinearBits ms, then 2^SubBits bins per power of two up
+// to 2^24 ms. A bin reports the mean of its samples, so values that repeat
+// (configured deadlines) come back exact.
+template <uint32_t LinearBits, uint32_t SubBits>
+class LatencyHistogram {
+ public:
+  static_assert(SubBits <= LinearBits && LinearBits < 24, "bad histogram shape");
+  static constexpr uint32_t kLinear = 1U << LinearBits;
+  static constexpr uint32_t kSub = 1U << SubBits;
+  static constexpr uint32_t kBins = kLinear + kSub * (24 - LinearBits);
+
+  void add(int64_t ms) {
+    if (ms < 0) {
+      return;
+    }
+    const uint64_t v = std::min<uint64_t>(static_cast<uint64_t>(ms), (uint64_t{1} << 24) - 1);
+    const uint32_t i = index(v);
+    _bins[i]++;
+    _sums[i] += v;
+    _count++;
+  }
+  void merge(const LatencyHistogram& other) {
+    for (uint32_t i = 0; i < kBins; ++i) {
+      _bins[i] += other._bins[i];
+      _sums[i] += other._sums[i];
+    }
+    _count += other._count;
+  }
+  uint64_t count() const { return _count; }
+
+  /** Nearest-rank percentile (q in (0, 1]); -1 when empty. */
+  double percentile(double q) const {
+    if (_count == 0) {
+      return -1.0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * static_cast<double>(_count))));
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < kBins; ++i) {
+      seen += _bins[i];
+      if (seen >= rank) {
+        return static_cast<double>(_sums[i]) / static_cast<double>(_bins[i]);
+      }
+    }
+    return -1.0;
+  }
+
+ private:
+  static uint32_t index(uint64_t v) {
+    if (v < kLinear) {
+      return static_cast<uint32_t>(v);
+    }
+    uint32_t octave = 0;
+    while ((v >> (LinearBits + octave + 1)) != 0) {
+      octave++;
+    }
+    return kLinear + octave * kSub + static_cast<uint32_t>((v >> (LinearBits + octave - SubBits)) - kSub);
+  }
+
+  uint32_t _bins[kBins] = {};
+  uint64_t _sums[kBins] = {};
+  uint64_t _count = 0;
+};
+
+// Sweep buckets are few; time-series windows are many and coarser.
+using BucketHistogram = LatencyHistogram<10, 6>;
+using WindowHistogram = LatencyHistogram<7, 4>;
+
+// ─── Rows and buckets ────────────────────────────────────────────────────────
+
+struct Row {
+  std::string_view mode;      // "SAW" when the log predates the column
+  int sf = -1;
+  int timeoutMs = -1;
+  std::string_view status;
+  std::string_view packetType;
+  int64_t rttMs = -1;
+  int64_t rtoMs = -1;
+  int64_t txTime = 0;
+  int64_t ackTime = 0;
+  int64_t epochMs = -1;       // for the time series; -1 if unknown
+  double lat = 0.0;
+  double lon = 0.0;
+  uint32_t sessionId = 0;
+  uint32_t fragLen = 0;
+  bool dup = false;
+};
+
+struct Span {
+  int64_t first;
+  int64_t last;
+};
+
+struct Bucket {
+  uint64_t attempts = 0;
+  uint64_t ackOk = 0;
+  uint64_t timeouts = 0;
+  uint64_t retryAttempts = 0;
+  uint64_t ackedBytes = 0;
+  double timeoutWaitMs = 0.0;
+  BucketHistogram rtt;
+  BucketHistogram rto;
+  BucketHistogram headroom;  // rto - rtt on ACKed attempts, floored at 0
+  std::unordered_map<uint64_t, Span> sessions;   // (file, session) -> span
+
+  void merge(const Bucket& o) {
+    attempts += o.attempts;
+    ackOk += o.ackOk;
+    timeouts += o.timeouts;
+    retryAttempts += o.retryAttempts;
+    ackedBytes += o.ackedBytes;
+    timeoutWaitMs += o.timeoutWaitMs;
+    rtt.merge(o.rtt);
+    rto.merge(o.rto);
+    headroom.merge(o.headroom);
+    for (const auto& [key, span] : o.sessions) {
+      auto [it, inserted] = sessions.try_emplace(key, span);
+      if (!inserted) {
+        it->second.first = std::min(it->second.first, span.first);
+        it->second.last = std::max(it->second.last, span.last);
+      }
+    }
+  }
+
+  double goodputBps() const {
+    int64_t spanMs = 0;
+    for (const auto& entry : sessions) {
+      spanMs += entry.second.last - entry.second.first;
+    }
+    return spanMs > 0 ? static_cast<double>(ackedBytes) * 8000.0 / static_cast<double>(spanMs) : -1.0;
+  }
+};
+
+struct TsBucket {
+  uint64_t attempts = 0;
+  uint64_t ackOk = 0;
+  uint64_t timeouts = 0;
+  WindowHistogram rtt;
+
+  void merge(const TsBucket& o) {
+    attempts += o.attempts;
+    ackOk += o.ackOk;
+    timeouts += o.timeouts;
+    rtt.merge(o.rtt);
+  }
+};
+
+using BucketKey = std::tuple<std::string, int, int, int>;   // mode, sf, timeout, distance
+using TsKey = std::pair<int64_t, int>;                       // window start (s), sf
+
+struct Options {
+  unsigned threads = 0;
+  bool haveOrigin = false;
+  double originLat = 0.0;
+  double originLon = 0.0;
+  double distanceBinM = 100.0;
+  int64_t windowS = 60;
+  const char* summaryPath = nullptr;
+  const char* timeseriesPath = nullptr;
+};
+
+// "ACK_OK_R3" -> 3; -1 if status is not prefix followed by digits only.
+int retryIndex(std::string_view status, std::string_view prefix) {
+  if (status.size() <= prefix.size() || status.substr(0, prefix.size()) != prefix) {
+    return -1;
+  }
+  int n = 0;
+  const char* end = status.data() + status.size();
+  const auto res = std::from_chars(status.data() + prefix.size(), end, n);
+  return (res.ec == std::errc() && res.ptr == end) ? n : -1;
+}
+
+double haversineM(double lat1, double lon1, double lat2, double lon2) {
+  constexpr double kRad = 3.14159265358979323846 / 180.0;
+  const double dLat = (lat2 - lat1) * kRad;
+  const double dLon = (lon2 - lon1) * kRad;
+  const double a = std::sin(dLat / 2) * std::sin(dLat / 2) +
+                   std::cos(lat1 * kRad) * std::cos(lat2 * kRad) * std::sin(dLon / 2) * std::sin(dLon / 2);
+  return 2.0 * 6371000.0 * std::asin(std::min(1.0, std::sqrt(a)));
+}
+
+class Aggregate {
+ public:
+  explicit Aggregate(const Options& opt) : _opt(opt) {}
+
+  void consume(uint32_t fileIdx, const Row& row) {
+    _rows++;
+    if (row.dup || row.sf < 0 || row.timeoutMs < 0) {
+      _skipped++;
+      return;
+    }
+    int distance = -1;
+    if (_opt.haveOrigin && (row.lat != 0.0 || row.lon != 0.0)) {
+      const double m = haversineM(_opt.originLat, _opt.originLon, row.lat, row.lon);
+      distance = static_cast<int>(std::floor(m / _opt.distanceBinM) * _opt.distanceBinM);
+    }
+    Bucket& b = _buckets[BucketKey(std::string(row.mode.empty() ? "SAW" : row.mode), row.sf, row.timeoutMs,
+                                   distance)];
+
+    const int okRetry = retryIndex(row.status, "ACK_OK_R");
+    const int toRetry = okRetry < 0 ? retryIndex(row.status, "ACK_TIMEOUT_R") : -1;
+    if (okRetry >= 0 || toRetry >= 0) {
+      b.attempts++;
+      b.retryAttempts += static_cast<uint64_t>(okRetry >= 0 ? okRetry : toRetry);
+      b.rtt.add(row.rttMs);
+      if (okRetry >= 0) {
+        b.ackOk++;
+        if (row.packetType == "DATA") {
+          b.ackedBytes += row.fragLen;
+        }
+        if (row.rtoMs > 0) {
+          b.rto.add(row.rtoMs);
+          if (row.rttMs >= 0) {
+            b.headroom.add(std::max<int64_t>(0, row.rtoMs - row.rttMs));
+          }
+        }
+      } else {
+        b.timeouts++;
+        if (row.rtoMs > 0) {
+          b.rto.add(row.rtoMs);
+          b.timeoutWaitMs += static_cast<double>(row.rtoMs);
+        }
+      }
+      if (_opt.timeseriesPath != nullptr && row.epochMs >= 0) {
+        const int64_t window = (row.epochMs / 1000) / _opt.windowS * _opt.windowS;
+        TsBucket& ts = _series[TsKey(window, row.sf)];
+        ts.attempts++;
+        ts.ackOk += okRetry >= 0 ? 1 : 0;
+        ts.timeouts += okRetry >= 0 ? 0 : 1;
+        ts.rtt.add(row.rttMs);
+      }
+    }
+
+    const uint64_t sessionKey = (static_cast<uint64_t>(fileIdx) << 32) | row.sessionId;
+    const int64_t last = std::max(row.txTime, row.ackTime);
+    auto [it, inserted] = b.sessions.try_emplace(sessionKey, Span{row.txTime, last});
+    if (!inserted) {
+      it->second.first = std::min(it->second.first, row.txTime);
+      it->second.last = std::max(it->second.last, last);
+    }
+  }
+
+  void merge(const Aggregate& o) {
+    _rows += o._rows;
+    _skipped += o._skipped;
+    for (const auto& [key, bucket] : o._buckets) {
+      _buckets[key].merge(bucket);
+    }
+    for (const auto& [key, ts] : o._series) {
+      _series[key].merge(ts);
+    }
+  }
+
+  uint64_t rows() const { return _rows; }
+  uint64_t skipped() const { return _skipped; }
+  const std::map<BucketKey, Bucket>& buckets() const { return _buckets; }
+  const std::map<TsKey, TsBucket>& series() const { return _series; }
+
+ private:
+  const Options& _opt;
+  uint64_t _rows = 0;
+  uint64_t _skipped = 0;
+  std::map<BucketKey, Bucket> _buckets;
+  std::map<TsKey, TsBucket> _series;
+};
+
+// ─── CSV (lora_log.csv) ──────────────────────────────────────────────────────
+
+template <typename T>
+T parseNum(std::string_view s, T fallback) {
+  while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) {
+    s.remove_prefix(1);
+  }
+  T v{};
+  const auto res = std::from_chars(s.data(), s.data() + s.size(), v);
+  return res.ec == std::errc() ? v : fallback;
+}
+
+double parseDouble(std::string_view s) {
+  char buf[32];
+  const size_t n = std::min(s.size(), sizeof(buf) - 1);
+  memcpy(buf, s.data(), n);
+  buf[n] = '\0';
+  return std::strtod(buf, nullptr);
+}
+
+// SdManager::_formatIso8601 output, "YYYY-MM-DDTHH:MM:SS.mmmZ", to epoch ms.
+int64_t parseIso8601(std::string_view s) {
+  if (s.size() < 23 || s[4] != '-' || s[10] != 'T' || s[19] != '.') {
+    return -1;
+  }
+  auto num = [&](size_t at, size_t len) { return parseNum<int>(s.substr(at, len), -1); };
+  int y = num(0, 4);
+  const int m = num(5, 2), d = num(8, 2), hh = num(11, 2), mm = num(14, 2), ss = num(17, 2), ms = num(20, 3);
+  if (y < 0 || m < 1 || m > 12 || d < 1 || hh < 0 || mm < 0 || ss < 0 || ms < 0) {
+    return -1;
+  }
+  // days_from_civil (H. Hinnant)
+  y -= m <= 2;
+  const int era = (y >= 0 ? y : y - 399) / 400;
+  const int yoe = y - era * 400;
+  const int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  const int64_t days = static_cast<int64_t>(era) * 146097 + doe - 719468;
+  return ((days * 24 + hh) * 60 + mm) * 60000LL + ss * 1000LL + ms;
+}
+
+enum Column : uint8_t {
+  COL_TIMESTAMP, COL_TX_TIME, COL_ACK_TIME, COL_RTT, COL_SF, COL_TIMEOUT, COL_RTO, COL_MODE,
+  COL_LAT, COL_LON, COL_SESSION, COL_FRAG_LEN, COL_PACKET_TYPE, COL_STATUS, COL_DUP, COL_COUNT
+};
+constexpr const char* kColumnNames[COL_COUNT] = {
+  "timestamp_utc", "tx_time", "ack_time", "rtt_ms", "sf", "ack_timeout_ms", "rto_ms", "transfer_mode",
+  "lat", "lon", "session_id", "frag_len", "packet_type", "status", "dup",
+};
+
+struct CsvSchema {
+  int index[COL_COUNT];   // column position in the file, -1 if absent
+  size_t maxIndex = 0;
+};
+
+std::string_view trimLine(std::string_view line) {
+  while (!line.empty() && (line.back() == '\r' || line.back() == '\n')) {
+    line.remove_suffix(1);
+  }
+  return line;
+}
+
+CsvSchema parseCsvHeader(std::string_view header) {
+  CsvSchema schema;
+  std::fill(std::begin(schema.index), std::end(schema.index), -1);
+  size_t col = 0;
+  header = trimLine(header);
+  while (true) {
+    const size_t comma = header.find(',');
+    const std::string_view name = header.substr(0, comma);
+    for (uint8_t c = 0; c < COL_COUNT; ++c) {
+      if (name == kColumnNames[c]) {
+        schema.index[c] = static_cast<int>(col);
+        schema.maxIndex = std::max(schema.maxIndex, col);
+      }
+    }
+    if (comma == std::string_view::npos) {
+      break;
+    }
+    header.remove_prefix(comma + 1);
+    col++;
+  }
+  return schema;
+}
+
+// The firmware joins fields without quoting, so a plain split is exact.
+void parseCsvRange(std::string_view text, const CsvSchema& schema, uint32_t fileIdx, Aggregate& agg) {
+  std::vector<std::string_view> fields(schema.maxIndex + 1);
+  auto field = [&](Column c) -> std::string_view {
+    const int i = schema.index[c];
+    return (i >= 0 && static_cast<size_t>(i) < fields.size()) ? fields[static_cast<size_t>(i)] : std::string_view();
+  };
+
+  while (!text.empty()) {
+    const size_t nl = text.find('\n');
+    const std::string_view line = trimLine(text.substr(0, nl));
+    text.remove_prefix(nl == std::string_view::npos ? text.size() : nl + 1);
+    if (line.empty()) {
+      continue;
+    }
+    std::fill(fields.begin(), fields.end(), std::string_view());
+    std::string_view rest = line;
+    for (size_t col = 0; col < fields.size(); ++col) {
+      const size_t comma = rest.find(',');
+      fields[col] = rest.substr(0, comma);
+      if (comma == std::string_view::npos) {
+        break;
+      }
+      rest.remove_prefix(comma + 1);
+    }
+
+    Row row;
+    row.mode = field(COL_MODE);
+    row.sf = parseNum<int>(field(COL_SF), -1);
+    row.timeoutMs = parseNum<int>(field(COL_TIMEOUT), -1);
+    row.status = field(COL_STATUS);
+    row.packetType = field(COL_PACKET_TYPE);
+    row.rttMs = parseNum<int64_t>(field(COL_RTT), -1);
+    row.rtoMs = parseNum<int64_t>(field(COL_RTO), -1);
+    row.txTime = parseNum<int64_t>(field(COL_TX_TIME), 0);
+    row.ackTime = parseNum<int64_t>(field(COL_ACK_TIME), 0);
+    row.epochMs = parseIso8601(field(COL_TIMESTAMP));
+    row.lat = parseDouble(field(COL_LAT));
+    row.lon = parseDouble(field(COL_LON));
+    row.sessionId = parseNum<uint32_t>(field(COL_SESSION), 0);
+    row.fragLen = parseNum<uint32_t>(field(COL_FRAG_LEN), 0);
+    row.dup = field(COL_DUP) == "1";
+    agg.consume(fileIdx, row);
+  }
+}
+
+// ─── Binary (lora_log.bin) ───────────────────────────────────────────────────
+
+// LogRowRecord as each LOG_BIN_VERSION wrote it (see tests/log_decoder.py).
+constexpr size_t rowRecordSize(uint16_t version) {
+  return 1 + 3 * 4 + (version >= 2 ? 4 : 0) + (version >= 3 ? 4 : 0) + 3 * 4 + 5 * 2 +
+         LOG_PACKET_TYPE_LEN + LOG_STATUS_LEN + (version >= 4 ? 1 : 0);
+}
+static_assert(rowRecordSize(LOG_BIN_VERSION) == sizeof(LogRowRecord),
+              "LogRowRecord changed; teach rowRecordSize() the new version");
+
+class Cursor {
+ public:
+  explicit Cursor(const char* p) : _p(reinterpret_cast<const uint8_t*>(p)) {}
+  template <typename T>
+  T get() {
+    T v;
+    memcpy(&v, _p, sizeof(T));   // the ESP32 and the hosts this runs on are little-endian
+    _p += sizeof(T);
+    return v;
+  }
+  std::string_view str(size_t len) {
+    const char* s = reinterpret_cast<const char*>(_p);
+    _p += len;
+    return {s, strnlen(s, len)};
+  }
+
+ private:
+  const uint8_t* _p;
+};
+
+const char* modeName(uint8_t mode) {
+  return mode == 0 ? "SAW" : (mode == 1 ? "SR" : "?");
+}
+
+bool parseBinary(std::string_view data, uint32_t fileIdx, Aggregate& agg, const char* path) {
+  LogFileHeader fh;
+  if (data.size() < sizeof(fh)) {
+    fprintf(stderr, "%s: shorter than the log header\n", path);
+    return false;
+  }
+  memcpy(&fh, data.data(), sizeof(fh));
+  const bool known = fh.version >= 1 && fh.version <= LOG_BIN_VERSION;
+  if (fh.magic != LOG_BIN_MAGIC || !known || fh.metaLen != sizeof(LogMetaRecord) ||
+      fh.rowLen != rowRecordSize(fh.version)) {
+    fprintf(stderr, "%s: unsupported layout v%u meta=%u row=%u\n", path, fh.version, fh.metaLen, fh.rowLen);
+    return false;
+  }
+
+  LogMetaRecord meta = {};
+  size_t off = fh.headerLen;
+  while (off < data.size()) {
+    const uint8_t tag = static_cast<uint8_t>(data[off]);
+    if (tag == LOG_TAG_META && off + fh.metaLen <= data.size()) {
+      memcpy(&meta, data.data() + off, sizeof(meta));
+      off += fh.metaLen;
+    } else if (tag == LOG_TAG_ROW && off + fh.rowLen <= data.size()) {
+      Cursor c(data.data() + off + 1);
+      Row row;
+      const int64_t nowMs = c.get<uint32_t>();
+      row.txTime = c.get<uint32_t>();
+      row.ackTime = c.get<uint32_t>();
+      row.rtoMs = fh.version >= 2 ? static_cast<int64_t>(c.get<uint32_t>()) : 0;
+      if (fh.version >= 3) {
+        c.get<uint16_t>();   // toaMs
+        c.get<uint16_t>();   // txMs
+      }
+      row.lat = c.get<float>();
+      row.lon = c.get<float>();
+      c.get<float>();        // snr
+      c.get<int16_t>();      // rssi
+      row.sessionId = c.get<uint16_t>();
+      c.get<uint16_t>();     // seqNum
+      c.get<int16_t>();      // fragIndex
+      row.fragLen = c.get<uint16_t>();
+      row.packetType = c.str(LOG_PACKET_TYPE_LEN);
+      row.status = c.str(LOG_STATUS_LEN);
+      row.dup = fh.version >= 4 && c.get<uint8_t>() != 0;
+
+      // Same int32 wrap as the firmware's rtt_ms column.
+      row.rttMs = static_cast<int32_t>(static_cast<uint32_t>(row.ackTime - row.txTime));
+      row.mode = modeName(meta.transferMode);
+      row.sf = meta.sf;
+      row.timeoutMs = static_cast<int>(meta.ackTimeoutMs);
+      row.epochMs = static_cast<int64_t>(meta.epochBaseMs) + nowMs;
+      agg.consume(fileIdx, row);
+      off += fh.rowLen;
+    } else {
+      off++;   // torn write: resync on the next tag
+    }
+  }
+  return true;
+}
+
+// ─── Jobs ────────────────────────────────────────────────────────────────────
+
+struct Input {
+  const char* path;
+  MappedFile* file;
+  bool binary;
+  CsvSchema schema;
+};
+
+struct Job {
+  uint32_t fileIdx;
+  std::string_view text;   // CSV: whole lines; binary: the whole file
+};
+
+// CSV bodies are cut into line-aligned chunks of at least kMinChunk bytes.
+constexpr size_t kMinChunk = 4 << 20;
+
+void planCsv(uint32_t fileIdx, std::string_view body, unsigned threads, std::vector<Job>& jobs) {
+  const size_t pieces = std::max<size_t>(1, std::min<size_t>(threads * 4, body.size() / kMinChunk));
+  const size_t step = body.size() / pieces + 1;
+  size_t start = 0;
+  while (start < body.size()) {
+    size_t end = std::min(body.size(), start + step);
+    const size_t nl = body.find('\n', end);
+    end = (nl == std::string_view::npos) ? body.size() : nl + 1;
+    jobs.push_back(Job{fileIdx, body.substr(start, end - start)});
+    start = end;
+  }
+}
+
+// ─── Output ──────────────────────────────────────────────────────────────────
+
+void writeSummary(FILE* out, const Aggregate& agg) {
+  fprintf(out,
+          "transfer_mode,sf,ack_timeout_ms,distance_m,attempts,ack_ok,timeouts,success_rate_pct,retry_rate_pct,"
+          "rtt_p50_ms,rtt_p95_ms,rtt_p99_ms,median_rto_ms,timeout_wait_ms,median_headroom_ms,acked_bytes,"
+          "goodput_bps\n");
+  for (const auto& [key, b] : agg.buckets()) {
+    if (b.attempts == 0) {
+      continue;
+    }
+    const double n = static_cast<double>(b.attempts);
+    fprintf(out, "%s,%d,%d,%d,%llu,%llu,%llu,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%llu,%.1f\n",
+            std::get<0>(key).c_str(), std::get<1>(key), std::get<2>(key), std::get<3>(key),
+            static_cast<unsigned long long>(b.attempts), static_cast<unsigned long long>(b.ackOk),
+            static_cast<unsigned long long>(b.timeouts), 100.0 * static_cast<double>(b.ackOk) / n,
+            100.0 * static_cast<double>(b.retryAttempts) / n, b.rtt.percentile(0.50), b.rtt.percentile(0.95),
+            b.rtt.percentile(0.99), b.rto.percentile(0.50), b.rto.count() > 0 ? b.timeoutWaitMs : -1.0,
+            b.headroom.percentile(0.50), static_cast<unsigned long long>(b.ackedBytes), b.goodputBps());
+  }
+}
+
+void writeSeries(FILE* out, const Aggregate& agg) {
+  fprintf(out, "window_start_epoch_s,sf,attempts,ack_ok,timeouts,success_rate_pct,rtt_p50_ms,rtt_p95_ms\n");
+  for (const auto& [key, ts] : agg.series()) {
+    fprintf(out, "%lld,%d,%llu,%llu,%llu,%.2f,%.2f,%.2f\n", static_cast<long long>(key.first), key.second,
+            static_cast<unsigned long long>(ts.attempts), static_cast<unsigned long long>(ts.ackOk),
+            static_cast<unsigned long long>(ts.timeouts),
+            ts.attempts ? 100.0 * static_cast<double>(ts.ackOk) / static_cast<double>(ts.attempts) : 0.0,
+            ts.rtt.percentile(0.50), ts.rtt.percentile(0.95));
+  }
+}
+
+bool hasSuffix(const char* path, const char* suffix) {
+  const size_t n = strlen(path), m = strlen(suffix);
+  return n >= m && strcasecmp(path + n - m, suffix) == 0;
+}
+
+int usage() {
+  fprintf(stderr,
+          "usage: log_analytics [--threads N] [--origin LAT,LON] [--distance-bin-m M]\n"
+          "                     [--summary out.csv] [--timeseries ts.csv] [--window-s S] LOG...\n");
+  return 2;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options opt;
+  std::vector<const char*> paths;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (arg == "--threads" && hasValue) {
+      opt.threads = static_cast<unsigned>(std::max(1, atoi(argv[++i])));
+    } else if (arg == "--origin" && hasValue) {
+      opt.haveOrigin = sscanf(argv[++i], "%lf,%lf", &opt.originLat, &opt.originLon) == 2;
+      if (!opt.haveOrigin) {
+        return usage();
+      }
+    } else if (arg == "--distance-bin-m" && hasValue) {
+      opt.distanceBinM = std::max(1.0, atof(argv[++i]));
+    } else if (arg == "--window-s" && hasValue) {
+      opt.windowS = std::max(1, atoi(argv[++i]));
+    } else if (arg == "--summary" && hasValue) {
+      opt.summaryPath = argv[++i];
+    } else if (arg == "--timeseries" && hasValue) {
+      opt.timeseriesPath = argv[++i];
+    } else if (!arg.empty() && arg[0] == '-') {
+      return usage();
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+  if (paths.empty()) {
+    return usage();
+  }
+  if (opt.threads == 0) {
+    opt.threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  std::vector<std::unique_ptr<MappedFile>> files;
+  std::vector<Input> inputs;
+  std::vector<Job> jobs;
+  int missing = 0;
+  for (const char* path : paths) {
+    files.push_back(std::make_unique<MappedFile>(path));
+    MappedFile* file = files.back().get();
+    if (!file->ok()) {
+      fprintf(stderr, "Missing or unreadable log: %s\n", path);
+      missing++;
+      continue;
+    }
+    Input in{path, file, hasSuffix(path, ".bin"), {}};
+    const uint32_t idx = static_cast<uint32_t>(inputs.size());
+    std::string_view text = file->bytes();
+    if (in.binary) {
+      jobs.push_back(Job{idx, text});
+    } else {
+      const size_t nl = text.find('\n');
+      in.schema = parseCsvHeader(text.substr(0, nl));
+      if (nl != std::string_view::npos) {
+        planCsv(idx, text.substr(nl + 1), opt.threads, jobs);
+      }
+    }
+    inputs.push_back(in);
+  }
+  if (missing > 0) {
+    return 2;
+  }
+
+  // Biggest jobs first so one large file does not finish last on its own.
+  std::sort(jobs.begin(), jobs.end(), [](const Job& a, const Job& b) { return a.text.size() > b.text.size(); });
+
+  const unsigned workers = std::min<unsigned>(opt.threads, std::max<size_t>(1, jobs.size()));
+  std::vector<Aggregate> parts(workers, Aggregate(opt));
+  std::atomic<size_t> next{0};
+  std::atomic<bool> failed{false};
+  std::vector<std::thread> pool;
+  for (unsigned w = 0; w < workers; ++w) {
+    pool.emplace_back([&, w]() {
+      for (size_t j = next++; j < jobs.size(); j = next++) {
+        const Input& in = inputs[jobs[j].fileIdx];
+        if (in.binary) {
+          if (!parseBinary(jobs[j].text, jobs[j].fileIdx, parts[w], in.path)) {
+            failed = true;
+          }
+        } else {
+          parseCsvRange(jobs[j].text, in.schema, jobs[j].fileIdx, parts[w]);
+        }
+      }
+    });
+  }
+  for (std::thread& t : pool) {
+    t.join();
+  }
+
+  Aggregate total(opt);
+  for (const Aggregate& part : parts) {
+    total.merge(part);
+  }
+  files.clear();
+
+  FILE* out = opt.summaryPath ? fopen(opt.summaryPath, "w") : stdout;
+  if (out == nullptr) {
+    fprintf(stderr, "Cannot write %s\n", opt.summaryPath);
+    return 2;
+  }
+  writeSummary(out, total);
+  if (out != stdout) {
+    fclose(out);
+  }
+  if (opt.timeseriesPath != nullptr) {
+    FILE* ts = fopen(opt.timeseriesPath, "w");
+    if (ts == nullptr) {
+      fprintf(stderr, "Cannot write %s\n", opt.timeseriesPath);
+      return 2;
+    }
+    writeSeries(ts, total);
+    fclose(ts);
+  }
+  fprintf(stderr, "%llu rows from %zu files (%zu jobs, %u threads), %llu skipped, %zu buckets\n",
+          static_cast<unsigned long long>(total.rows()), inputs.size(), jobs.size(), workers,
+          static_cast<unsigned long long>(total.skipped()), total.buckets().size());
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,210 @@
+#!/usr/bin/env python3
+"""
+Decoder for the binary SD log (MESH_LOG_FORMAT_BINARY, lora_log.bin).
+
+Mirrors src/storage/LogFormat.h: a 16-byte file header, then tagged records.
+Older files still decode: version 1 (no rto_ms), 2 (no toa_ms / tx_ms) and
+3 (no dup) fill the missing columns with 0.
+A META record ('M') carries the run metadata and epoch base once per boot;
+each ROW record ('R') is one logTransmission() call with raw millis().
+Decoded rows use the same column names and formatting as lora_log.csv, so
+r2_sweep_report.py reads .bin files directly and --csv regenerates the CSV.
+
+Usage:
+  python log_decoder.py lora_log.bin                 # CSV to stdout
+  python log_decoder.py lora_log.bin --csv out.csv   # CSV to a file
+"""
+
+from __future__ import annotations
+
+import argparse
+import struct
+import sys
+from datetime import datetime, timezone
+from pathlib import Path
+from typing import Iterator
+
+
+LOG_BIN_MAGIC = 0x474C524C  # "LRLG"
+LOG_BIN_VERSION = 4
+
+TAG_META = ord("M")
+TAG_ROW = ord("R")
+
+# '<' = packed little-endian, as the ESP32 writes the #pragma pack(1) structs.
+FILE_HEADER = struct.Struct("<IHHHHI")                 # LogFileHeader
+META_RECORD = struct.Struct("<BQBBBI24s8s")           # LogMetaRecord
+ROW_RECORD = struct.Struct("<BIIIIHHfffhHHhH12s24sB")  # LogRowRecord
+ROW_RECORD_V3 = struct.Struct("<BIIIIHHfffhHHhH12s24s")  # before dup
+ROW_RECORD_V2 = struct.Struct("<BIIIIfffhHHhH12s24s")  # before toaMs / txMs
+ROW_RECORD_V1 = struct.Struct("<BIIIfffhHHhH12s24s")   # before rtoMs
+
+TRANSFER_MODES = {0: "SAW", 1: "SR"}
+
+# Same order as LOG_COLUMNS in SdManager.cpp.
+LOG_COLUMNS = [
+    "timestamp_utc", "millis", "tx_time_utc", "tx_time", "ack_time_utc", "ack_time",
+    "rtt_ms", "run_id", "role", "node_id", "sf", "ack_timeout_ms", "rto_ms", "toa_ms", "tx_ms",
+    "transfer_mode", "lat", "lon", "rssi", "snr", "session_id", "seq_num", "frag_index", "frag_len",
+    "packet_type", "status", "dup",
+]
+
+
+class LogFormatError(ValueError):
+    pass
+
+
+def _cstr(raw: bytes) -> str:
+    return raw.split(b"\0", 1)[0].decode("ascii", errors="replace")
+
+
+def format_iso8601(epoch_ms: int) -> str:
+    """SdManager::_formatIso8601: UTC with millisecond precision."""
+    dt = datetime.fromtimestamp(epoch_ms // 1000, tz=timezone.utc)
+    return f"{dt.strftime('%Y-%m-%dT%H:%M:%S')}.{epoch_ms % 1000:03d}Z"
+
+
+def encode_header() -> bytes:
+    return FILE_HEADER.pack(LOG_BIN_MAGIC, LOG_BIN_VERSION, FILE_HEADER.size,
+                            META_RECORD.size, ROW_RECORD.size, 0)
+
+
+def encode_meta(epoch_base_ms: int, node_id: int, sf: int, transfer_mode: int,
+                ack_timeout_ms: int, run_id: str, role: str) -> bytes:
+    return META_RECORD.pack(TAG_META, epoch_base_ms, node_id, sf, transfer_mode, ack_timeout_ms,
+                            run_id.encode()[:23], role.encode()[:7])
+
+
+def encode_row(now_ms: int, tx_time: int, ack_time: int, lat: float, lon: float, snr: float,
+               rssi: int, session_id: int, seq_num: int, frag_index: int, frag_len: int,
+               packet_type: str, status: str, rto_ms: int = 0, toa_ms: int = 0,
+               tx_ms: int = 0, dup: bool = False) -> bytes:
+    return ROW_RECORD.pack(TAG_ROW, now_ms, tx_time, ack_time, rto_ms, toa_ms, tx_ms, lat, lon, snr, rssi,
+                           session_id, seq_num, frag_index, frag_len,
+                           packet_type.encode()[:11], status.encode()[:23], 1 if dup else 0)
+
+
+def iter_records(data: bytes) -> Iterator[tuple[str, dict]]:
+    """Yield ("meta", fields) and ("row", fields) in file order."""
+    if len(data) < FILE_HEADER.size:
+        raise LogFormatError("file shorter than the log header")
+    magic, version, header_len, meta_len, row_len, _ = FILE_HEADER.unpack_from(data, 0)
+    if magic != LOG_BIN_MAGIC:
+        raise LogFormatError(f"bad magic 0x{magic:08X}")
+    row_struct = {1: ROW_RECORD_V1, 2: ROW_RECORD_V2, 3: ROW_RECORD_V3, 4: ROW_RECORD}.get(version)
+    if row_struct is None or meta_len != META_RECORD.size or row_len != row_struct.size:
+        raise LogFormatError(f"unsupported layout v{version} meta={meta_len} row={row_len}")
+
+    offset = header_len
+    while offset < len(data):
+        tag = data[offset]
+        if tag == TAG_META and offset + meta_len <= len(data):
+            _, epoch, node, sf, mode, timeout, run_id, role = META_RECORD.unpack_from(data, offset)
+            yield "meta", {
+                "epoch_base_ms": epoch, "node_id": node, "sf": sf,
+                "transfer_mode": TRANSFER_MODES.get(mode, str(mode)),
+                "ack_timeout_ms": timeout, "run_id": _cstr(run_id), "role": _cstr(role),
+            }
+            offset += meta_len
+        elif tag == TAG_ROW and offset + row_len <= len(data):
+            fields = row_struct.unpack_from(data, offset)
+            if version == 1:
+                fields = fields[:4] + (0,) + fields[4:]
+            if version <= 2:
+                fields = fields[:5] + (0, 0) + fields[5:]
+            if version <= 3:
+                fields = fields + (0,)
+            (_, now_ms, tx_time, ack_time, rto_ms, toa_ms, tx_ms, lat, lon, snr, rssi, session_id,
+             seq_num, frag_index, frag_len, packet_type, status, dup) = fields
+            yield "row", {
+                "millis": now_ms, "tx_time": tx_time, "ack_time": ack_time, "rto_ms": rto_ms,
+                "toa_ms": toa_ms, "tx_ms": tx_ms,
+                "lat": lat, "lon": lon, "snr": snr, "rssi": rssi,
+                "session_id": session_id, "seq_num": seq_num,
+                "frag_index": frag_index, "frag_len": frag_len,
+                "packet_type": _cstr(packet_type), "status": _cstr(status), "dup": dup,
+            }
+            offset += row_len
+        else:
+            # Torn or foreign bytes (e.g. power loss mid-sector): resync on the next tag.
+            offset += 1
+
+
+def iter_csv_rows(data: bytes) -> Iterator[dict]:
+    """Rows as lora_log.csv would have had them: every column, as strings."""
+    meta = {"epoch_base_ms": 0, "node_id": 0, "sf": 0, "transfer_mode": "SAW",
+            "ack_timeout_ms": 0, "run_id": "", "role": ""}
+    for kind, rec in iter_records(data):
+        if kind == "meta":
+            meta = rec
+            continue
+        base = meta["epoch_base_ms"]
+        rtt = (rec["ack_time"] - rec["tx_time"] + 2**31) % 2**32 - 2**31  # int32 like the firmware
+        yield {
+            "timestamp_utc": format_iso8601(base + rec["millis"]),
+            "millis": str(rec["millis"]),
+            "tx_time_utc": format_iso8601(base + rec["tx_time"]),
+            "tx_time": str(rec["tx_time"]),
+            "ack_time_utc": format_iso8601(base + rec["ack_time"]),
+            "ack_time": str(rec["ack_time"]),
+            "rtt_ms": str(rtt),
+            "run_id": meta["run_id"],
+            "role": meta["role"],
+            "node_id": str(meta["node_id"]),
+            "sf": str(meta["sf"]),
+            "ack_timeout_ms": str(meta["ack_timeout_ms"]),
+            "rto_ms": str(rec["rto_ms"]),
+            "toa_ms": str(rec["toa_ms"]),
+            "tx_ms": str(rec["tx_ms"]),
+            "transfer_mode": meta["transfer_mode"],
+            "lat": f"{rec['lat']:.6f}",
+            "lon": f"{rec['lon']:.6f}",
+            "rssi": str(rec["rssi"]),
+            "snr": f"{rec['snr']:.2f}",
+            "session_id": str(rec["session_id"]),
+            "seq_num": str(rec["seq_num"]),
+            "frag_index": str(rec["frag_index"]),
+            "frag_len": str(rec["frag_len"]),
+            "packet_type": rec["packet_type"],
+            "status": rec["status"],
+            "dup": str(rec["dup"]),
+        }
+
+
+def read_log(path: Path) -> Iterator[dict]:
+    return iter_csv_rows(path.read_bytes())
+
+
+def write_csv(rows: Iterator[dict], out) -> int:
+    # The firmware writes plain joins, not quoted CSV; keep that byte for byte.
+    out.write(",".join(LOG_COLUMNS) + "\n")
+    count = 0
+    for row in rows:
+        out.write(",".join(row[c] for c in LOG_COLUMNS) + "\r\n")
+        count += 1
+    return count
+
+
+def main() -> int:
+    parser = argparse.ArgumentParser(description="Convert a binary lora_log.bin to the lora_log.csv schema.")
+    parser.add_argument("bin", help="lora_log.bin from the SD card")
+    parser.add_argument("--csv", help="Output CSV path (default: stdout)")
+    args = parser.parse_args()
+
+    try:
+        rows = list(read_log(Path(args.bin)))
+    except (OSError, LogFormatError) as exc:
+        print(f"Cannot decode {args.bin}: {exc}", file=sys.stderr)
+        return 2
+
+    if args.csv:
+        with open(args.csv, "w", newline="", encoding="utf-8") as handle:
+            count = write_csv(iter(rows), handle)
+        print(f"Wrote {count} rows to {args.csv}", file=sys.stderr)
+    else:
+        write_csv(iter(rows), sys.stdout)
+    return 0
+
+
+if __name__ == "__main__":
+    raise SystemExit(main())
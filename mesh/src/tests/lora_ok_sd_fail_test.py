@@ -76,6 +76,83 @@ class SDCardSimulator:
         return True
 
 
+class LogQueueSimulator:
+    """Mirrors SdManager's CSV log ring: rows queue in RAM, drain in bounded
+    batches to 512-byte sector writes, and are counted when dropped"""
+
+    SECTOR = 512
+
+    def __init__(self, ring_rows=32, flush_rows=8, flush_ms=1000, max_rows_per_flush=16,
+                 file_pos=0, write_fails=False):
+        self.ring_rows = ring_rows
+        self.flush_rows = flush_rows
+        self.flush_ms = flush_ms
+        self.max_rows_per_flush = max_rows_per_flush
+        self.write_fails = write_fails
+        self.ring = []          # (enqueue_ms, line)
+        self.batch = b""
+        self.batch_rows = 0
+        self.file_pos = file_pos
+        self.writes = []        # (offset, length) of every card write
+        self.dropped = 0
+
+    def log(self, now_ms, line):
+        if len(self.ring) >= self.ring_rows:
+            self.dropped += 1
+            return False
+        self.ring.append((now_ms, line.encode() + b"\r\n"))
+        return True
+
+    def _write(self, length):
+        if self.write_fails:
+            return False
+        self.writes.append((self.file_pos, length))
+        self.file_pos += length
+        self.batch = self.batch[length:]
+        return True
+
+    def _append(self, data):
+        while data:
+            target = self.SECTOR - (self.file_pos % self.SECTOR)
+            take = min(len(data), target - len(self.batch))
+            self.batch += data[:take]
+            data = data[take:]
+            if len(self.batch) == target:
+                if not self._write(target):
+                    self.dropped += self.batch_rows
+                    self.batch, self.batch_rows = b"", 0
+                    return False
+                self.batch_rows = 1 if data else 0
+        return True
+
+    def _drain(self, max_rows, sync_tail):
+        rows = 0
+        while self.ring and rows < max_rows:
+            _, line = self.ring.pop(0)
+            rows += 1
+            self.batch_rows += 1
+            if not self._append(line):
+                return False
+        if sync_tail and not self.ring and self.batch:
+            tail_rows = self.batch_rows
+            if not self._write(len(self.batch)):
+                self.dropped += tail_rows
+                self.batch = b""
+            self.batch_rows = 0
+        return True
+
+    def service(self, now_ms):
+        if not self.ring:
+            return True
+        aged = now_ms - self.ring[0][0] >= self.flush_ms
+        if len(self.ring) < self.flush_rows and not aged:
+            return True
+        return self._drain(self.max_rows_per_flush, aged)
+
+    def flush(self):
+        return self._drain(self.ring_rows, True)
+
+
 class LoRaSimulator:
     """Simulates working LoRa radio"""
     
@@ -344,6 +421,52 @@ class SystemTest:
         tx_ok = lora.send_audio_data(bytes([0xFF] * 100), 100)
         return self.assert_true(tx_ok, "Transmissions continue in degraded mode")
     
+    def test_log_queue_batching(self):
+        """Test 9: Log rows are batched into sector writes and drops are counted"""
+        print("\n[Test 9] Buffered CSV Log Queue")
+
+        row = "2026-01-01T00:00:00.000Z,1000," + "x" * 150   # ~180 bytes with CRLF
+
+        q = LogQueueSimulator(file_pos=300)    # header + a few rows already on the card
+        for i in range(7):
+            q.log(i * 10, row)
+        q.service(70)
+        self.assert_true(q.writes == [], "Below flush_rows and younger than flush_ms: nothing written")
+
+        q.log(80, row)
+        q.service(90)
+        self.assert_true(q.writes and q.writes[0] == (300, 212) and
+                         all(off % 512 == 0 and n == 512 for off, n in q.writes[1:]),
+                         "First write tops up to a sector boundary, the rest are whole sectors")
+
+        q = LogQueueSimulator(max_rows_per_flush=4)
+        for i in range(10):
+            q.log(0, row)
+        q.service(10)
+        self.assert_true(len(q.ring) == 6, "One service call drains at most max_rows_per_flush rows")
+
+        q = LogQueueSimulator(ring_rows=4)
+        accepted = [q.log(0, row) for _ in range(6)]
+        self.assert_true(accepted == [True] * 4 + [False] * 2 and q.dropped == 2,
+                         "Full ring rejects rows without blocking and counts them")
+
+        q = LogQueueSimulator()
+        q.log(0, row)
+        q.service(500)
+        self.assert_true(q.writes == [], "A lone young row waits for the age limit")
+        q.service(1000)
+        total = sum(n for _, n in q.writes)
+        self.assert_true(total == len(row) + 2 and not q.batch,
+                         "Aged row is written with the partial tail")
+
+        q = LogQueueSimulator(write_fails=True)
+        for i in range(8):
+            q.log(0, row)
+        q.flush()
+        # Rows 1-3 fill the first sector; the rest stay queued for the next flush.
+        return self.assert_true(q.dropped == 3 and len(q.ring) == 5 and not q.batch,
+                                "Failed sector write counts its rows as dropped, keeps the rest queued")
+
     def run_all_tests(self):
         """Run all test cases"""
         print("=" * 60)
@@ -363,6 +486,7 @@ class SystemTest:
         self.test_sd_write_attempts_tracked(sd)
         self.test_packet_integrity(lora)
         self.test_system_resilience(sd, lora)
+        self.test_log_queue_batching()
         
         # Print summary
         print("\n" + "=" * 60)
@@ -10,25 +10,52 @@ Usage:
     python lora_audio_test.py --log rx_log.txt # parse a receiver log file
 """
 
+import math
 import struct
 import zlib
 import argparse
 import os
+import contextlib
 import csv
 from io import StringIO
 
+import log_decoder
+import r2_sweep_report
+import bench_compare
+
 # ============================================================
 #  Constants — must match LoRaAudioPacket.h
 # ============================================================
-LORA_PROTOCOL_VERSION  = 0x01
-LORA_HEADER_SIZE       = 10
+LORA_PROTOCOL_VERSION  = 0x02
+LORA_HEADER_SIZE       = 13
 LORA_MAX_PAYLOAD       = 255
-LORA_MAX_DATA_PAYLOAD  = LORA_MAX_PAYLOAD - LORA_HEADER_SIZE  # 245
+LORA_MAX_DATA_PAYLOAD  = LORA_MAX_PAYLOAD - LORA_HEADER_SIZE  # 242
 
 PKT_AUDIO_START        = 0x01
 PKT_AUDIO_DATA         = 0x02
 PKT_AUDIO_END          = 0x03
 PKT_ACK                = 0x04
+PKT_AUDIO_DATA_WIN     = 0x05
+PKT_WINDOW_POLL        = 0x06
+PKT_WINDOW_ACK         = 0x07
+PKT_RATE_CTRL          = 0x08
+PKT_AUDIO_PARITY       = 0x09
+PKT_RESUME             = 0x0A
+PKT_NACK               = 0x0B
+
+RATE_OP_REQUEST        = 0x01
+RATE_OP_CONFIRM        = 0x02
+
+LORA_MAX_WINDOW_SIZE   = 32
+
+LORA_MAX_FEC_PARITY    = 4
+LORA_FEC_HEADER_SIZE   = 5
+LORA_MAX_FEC_DATA_PAYLOAD = LORA_MAX_DATA_PAYLOAD - LORA_FEC_HEADER_SIZE  # 237
+
+LORA_NACK_HEADER_SIZE  = 8
+LORA_NACK_RANGE_SIZE   = 4
+LORA_MAX_NACK_RANGES   = 16
+ACK_STATUS_OK          = 0x00
 
 CODEC_RAW_PCM          = 0x00
 CODEC_COMPRESSED       = 0x01
@@ -38,6 +65,7 @@ FLAG_RETRANSMIT        = (1 << 6)
 FLAG_LAST_FRAG         = (1 << 5)
 
 NODE_BROADCAST         = 0xFF
+LORA_DEFAULT_TTL       = 3
 
 CODEC_NAMES = {
     CODEC_RAW_PCM:    "Raw PCM",
@@ -49,6 +77,13 @@ PKT_NAMES = {
     PKT_AUDIO_DATA:  "AUDIO_DATA",
     PKT_AUDIO_END:   "AUDIO_END",
     PKT_ACK:         "ACK",
+    PKT_AUDIO_DATA_WIN: "AUDIO_DATA_WIN",
+    PKT_WINDOW_POLL: "WINDOW_POLL",
+    PKT_WINDOW_ACK:  "WINDOW_ACK",
+    PKT_RATE_CTRL:   "RATE_CTRL",
+    PKT_AUDIO_PARITY: "AUDIO_PARITY",
+    PKT_RESUME:      "RESUME",
+    PKT_NACK:        "NACK",
 }
 
 # ============================================================
@@ -100,9 +135,10 @@ def get_cr(sf_cr: int) -> int:
 
 
 def build_header(pkt_type: int, src: int, dst: int, exp_id: int,
-                 session: int, seq: int, tx_pow: int, sf: int, cr: int) -> bytes:
+                 session: int, seq: int, tx_pow: int, sf: int, cr: int,
+                 next_hop: int = None, prev_hop: int = None, ttl: int = LORA_DEFAULT_TTL) -> bytes:
     """
-    Serialize a LoRaHeader into 10 bytes (little-endian, matches ESP32/Arduino).
+    Serialize a LoRaHeader into 13 bytes (little-endian, matches ESP32/Arduino).
 
     Layout:
       [0]    ver_type  (VERSION high nibble | TYPE low nibble)
@@ -113,10 +149,13 @@ def build_header(pkt_type: int, src: int, dst: int, exp_id: int,
       [6-7]  seq_num     (uint16 little-endian)
       [8]    tx_pow
       [9]    sf_cr       (SF high nibble | CR low nibble)
+      [10]   next_hop    (defaults to dst, like buildHeader())
+      [11]   prev_hop    (defaults to src)
+      [12]   ttl
     """
     ver_type = make_ver_type(LORA_PROTOCOL_VERSION, pkt_type)
     sf_cr    = make_sf_cr(sf, cr)
-    return struct.pack('<BBBBHHBB',
+    return struct.pack('<BBBBHHBBBBB',
         ver_type,
         src,
         dst,
@@ -125,6 +164,9 @@ def build_header(pkt_type: int, src: int, dst: int, exp_id: int,
         seq,
         tx_pow,
         sf_cr,
+        dst if next_hop is None else next_hop,
+        src if prev_hop is None else prev_hop,
+        ttl,
     )
 
 
@@ -167,15 +209,58 @@ def build_audio_end(frag_count: int, crc32_val: int) -> bytes:
     )
 
 
+def build_window_poll(base_seq: int, count: int) -> bytes:
+    """
+    Serialize WindowPollPayload into bytes.
+
+    Layout:
+      [0-1]  base_seq  (uint16)
+      [2]    count     (uint8)
+    """
+    return struct.pack('<HB', base_seq, count)
+
+
+def build_window_ack(base_seq: int, bitmap: int, status: int = 0x00) -> bytes:
+    """
+    Serialize WindowAckPayload into bytes.
+
+    Layout:
+      [0-1]  base_seq  (uint16)
+      [2-5]  bitmap    (uint32, bit i = seq base_seq + i received)
+      [6]    status    (uint8)
+    """
+    return struct.pack('<HIB', base_seq, bitmap, status)
+
+
+def build_fec_parity(block_frag: int, frags: list, parity_index: int, parity_count: int) -> bytes:
+    """
+    Serialize one PKT_AUDIO_PARITY payload (WindowedSender::_sendParity).
+
+    Layout:
+      [0-1]  block_frag    (uint16, first fragment of the block)
+      [2]    data_count    (uint8)
+      [3]    parity_index  (uint8)
+      [4]    parity_count  (uint8)
+      [5..]  XOR of frags[i] for i % parity_count == parity_index, zero-padded
+    """
+    group = frags[parity_index::parity_count]
+    parity = bytearray(max(len(f) for f in group))
+    for f in group:
+        for i, b in enumerate(f):
+            parity[i] ^= b
+    return struct.pack('<HBBB', block_frag, len(frags), parity_index, parity_count) + bytes(parity)
+
+
 # ============================================================
 #  Packet Parsing  (mirrors Arduino deserialize functions)
 # ============================================================
 
 def parse_header(data: bytes) -> dict:
-    """Parse 10-byte header into a dict."""
+    """Parse 13-byte header into a dict."""
     if len(data) < LORA_HEADER_SIZE:
         raise ValueError(f"Header too short: {len(data)} bytes (need {LORA_HEADER_SIZE})")
-    ver_type, src, dst, exp_id, session, seq, tx_pow, sf_cr = struct.unpack_from('<BBBBHHBB', data, 0)
+    (ver_type, src, dst, exp_id, session, seq, tx_pow, sf_cr,
+     next_hop, prev_hop, ttl) = struct.unpack_from('<BBBBHHBBBBB', data, 0)
     return {
         'version':    get_version(ver_type),
         'type':       get_type(ver_type),
@@ -188,6 +273,9 @@ def parse_header(data: bytes) -> dict:
         'tx_pow':     tx_pow,
         'sf':         get_sf(sf_cr),
         'cr':         get_cr(sf_cr),
+        'next_hop':   next_hop,
+        'prev_hop':   prev_hop,
+        'ttl':        ttl,
     }
 
 
@@ -457,6 +545,11 @@ def test_crc():
     # Verify same data gives same CRC
     assert crc16(data) == c16, "CRC-16 should be deterministic"
     assert crc32(data) == c32, "CRC-32 should be deterministic"
+
+    # Check values asserted by cpp_breaking_tests test_crc_check_values()
+    assert crc16(b"123456789") == 0x29B1, "CRC-16/CCITT-FALSE check value"
+    assert crc32(b"123456789") == 0xCBF43926, "CRC-32 check value"
+    assert (c16, c32) == (0x3BFE, 0xAB53EFA7), "Hello LoRa vector"
     print("  PASS")
 
 
@@ -488,6 +581,9 @@ def test_header_pack_unpack():
     assert hdr['tx_pow']     == 14
     assert hdr['sf']         == 9
     assert hdr['cr']         == 7
+    assert hdr['next_hop']   == 0x02, "next_hop defaults to dst (single hop)"
+    assert hdr['prev_hop']   == 0x01, "prev_hop defaults to src"
+    assert hdr['ttl']        == LORA_DEFAULT_TTL
     print("  PASS")
 
 
@@ -586,6 +682,320 @@ def test_airtime_comparison():
         print(f"    Saving    : {saving:.2f}s  ({(saving/raw_stats['airtime_s']*100):.0f}% less airtime)")
 
 
+def test_selective_repeat_window():
+    print("\n--- Test: Selective Repeat Window ---")
+    assert len(build_window_poll(0x1234, 8)) == 3, "WindowPollPayload should be 3 bytes"
+    assert len(build_window_ack(0x1234, 0xFFFFFFFF)) == 7, "WindowAckPayload should be 7 bytes"
+    assert LORA_HEADER_SIZE + 7 <= LORA_MAX_PAYLOAD
+    # The bitmap itself is test_window_bitmap() in cpp_breaking_tests; the
+    # sender's window loop runs in tests/link_sim (MESH_TRANSFER_MODE=1).
+    base, bitmap, status = struct.unpack('<HIB', build_window_ack(0x1234, 0x000000F7))
+    assert (base, bitmap, status) == (0x1234, 0xF7, 0)
+    print("  PASS")
+
+
+def test_fec_parity():
+    print("\n--- Test: FEC XOR Parity ---")
+    rng = [bytes(((i * 53 + b * 7 + 1) & 0xFF) for b in range(LORA_MAX_FEC_DATA_PAYLOAD))
+           for i in range(8)]
+    frags = rng[:7] + [rng[7][:100]]  # short last fragment pads with zeros
+    assert LORA_HEADER_SIZE + LORA_FEC_HEADER_SIZE + LORA_MAX_FEC_DATA_PAYLOAD == LORA_MAX_PAYLOAD
+
+    payloads = [build_fec_parity(40, frags, p, 2) for p in range(2)]
+    assert len(payloads[0]) == LORA_FEC_HEADER_SIZE + LORA_MAX_FEC_DATA_PAYLOAD
+    assert struct.unpack('<HBBB', payloads[1][:LORA_FEC_HEADER_SIZE]) == (40, 8, 1, 2)
+    # Repair is test_fec_parity() in cpp_breaking_tests, on the firmware Reassembler.
+    print("  PASS")
+
+
+def test_fragment_size_selection():
+    print("\n--- Test: Fragment Size Selection ---")
+    audio_bytes = 32000
+    old_frags = -(-audio_bytes // 128)
+    new_frags = -(-audio_bytes // LORA_MAX_DATA_PAYLOAD)
+    assert new_frags < old_frags * 0.55, "242-byte fragments should nearly halve the fragment count"
+
+    # optimalFragmentSize() itself is test_fragment_size() in cpp_breaking_tests.
+    print(f"  {LORA_MAX_DATA_PAYLOAD} B fragments: {new_frags} fragments (128 B chunks: {old_frags})")
+    print("  PASS")
+
+
+def test_adr_decisions():
+    print("\n--- Test: Adaptive Data Rate ---")
+    assert struct.calcsize('<BBBBb') == 5, "RateCtrlPayload should be 5 bytes"
+    req = build_header(PKT_RATE_CTRL, 0x01, 0x02, 1, 0x1234, 9, 14, 10, 5) + struct.pack('<BBBBb', RATE_OP_REQUEST, 9, 5, 0, 14)
+    assert parse_header(req)['type_name'] == "RATE_CTRL" and len(req) == LORA_HEADER_SIZE + 5
+
+    # The decisions themselves are test_rate_controller() in cpp_breaking_tests.
+    # Binary log: a fresh META record marks the SF change for the rows after it.
+    epoch = 1767225600000
+    data = (log_decoder.encode_header()
+            + log_decoder.encode_meta(epoch, 1, 9, 0, 2000, "ADR", "TX")
+            + log_decoder.encode_row(1000, 900, 1100, 0.0, 0.0, 6.0, -60, 1, 1, 0, 242, "DATA", "ACK_OK_R0")
+            + log_decoder.encode_meta(epoch, 1, 8, 0, 2000, "ADR", "TX")
+            + log_decoder.encode_row(2000, 1900, 2050, 0.0, 0.0, 5.0, -62, 2, 1, 0, 242, "DATA", "ACK_OK_R0"))
+    assert [r["sf"] for r in log_decoder.iter_csv_rows(data)] == ["9", "8"]
+    print("  PASS")
+
+
+ACK_TIMEOUT_MS = 2000
+
+
+def test_rto_log_fields():
+    print("\n--- Test: RTO Log Fields ---")
+    # Per-attempt rto_ms reaches the sweep report through the binary log.
+    epoch = 1767225600000
+    data = (log_decoder.encode_header()
+            + log_decoder.encode_meta(epoch, 1, 7, 0, ACK_TIMEOUT_MS, "RTO", "TX")
+            + log_decoder.encode_row(1000, 900, 970, 0.0, 0.0, 6.0, -60, 1, 1, 0, 242, "DATA", "ACK_OK_R0", 520)
+            + log_decoder.encode_row(2000, 1900, 2420, 0.0, 0.0, 0.0, 0, 1, 2, 1, 242, "DATA", "ACK_TIMEOUT_R0", 520)
+            + log_decoder.encode_row(3000, 2500, 2570, 0.0, 0.0, 6.0, -60, 1, 2, 1, 242, "DATA", "ACK_OK_R1", 1040))
+    rows = list(log_decoder.iter_csv_rows(data))
+    assert [r["rto_ms"] for r in rows] == ["520", "520", "1040"]
+    bucket = r2_sweep_report.Bucket()
+    for r in rows:
+        bucket.consume(r["status"], float(r["rtt_ms"]), float(r["rto_ms"]))
+    assert bucket.timeout_wait_ms == 520 and sorted(bucket.headroom_values_ms) == [450, 970]
+
+    # Version 1 files (no rto_ms in the row) still decode.
+    v1_row = log_decoder.ROW_RECORD_V1.pack(log_decoder.TAG_ROW, 1000, 900, 970, 0.0, 0.0, 6.0, -60,
+                                            1, 1, 0, 242, b"DATA", b"ACK_OK_R0")
+    v1 = (log_decoder.FILE_HEADER.pack(log_decoder.LOG_BIN_MAGIC, 1, log_decoder.FILE_HEADER.size,
+                                       log_decoder.META_RECORD.size, log_decoder.ROW_RECORD_V1.size, 0)
+          + log_decoder.encode_meta(epoch, 1, 7, 0, ACK_TIMEOUT_MS, "R2", "TX") + v1_row)
+    assert [r["rto_ms"] for r in log_decoder.iter_csv_rows(v1)] == ["0"]
+    print("  PASS")
+
+
+def test_binary_log_decode():
+    print("\n--- Test: Binary Log Decode ---")
+    # struct sizes must match the static_asserts in LogFormat.h
+    assert (log_decoder.FILE_HEADER.size, log_decoder.META_RECORD.size, log_decoder.ROW_RECORD.size) == (16, 48, 80)
+
+    epoch = 1767225600000  # 2026-01-01T00:00:00Z
+    data = (log_decoder.encode_header()
+            + log_decoder.encode_meta(epoch, 1, 9, 1, 1200, "R2_SF9", "TX")
+            + log_decoder.encode_row(5000, 4900, 5150, 38.5, -77.25, 9.5, -61, 0x1234, 7, 3, 245,
+                                     "DATA", "ACK_OK_R0")
+            + b"\x00\x13"  # torn bytes, skipped on resync
+            + log_decoder.encode_row(6000, 5900, 7100, 38.5, -77.25, 0.0, 0, 0x1234, 8, 4, 245,
+                                     "DATA", "ACK_TIMEOUT_R1"))
+    rows = list(log_decoder.iter_csv_rows(data))
+    assert len(rows) == 2
+    first = rows[0]
+    assert first["timestamp_utc"] == "2026-01-01T00:00:05.000Z"
+    assert first["rtt_ms"] == "250" and first["sf"] == "9" and first["transfer_mode"] == "SR"
+    assert first["run_id"] == "R2_SF9" and first["ack_timeout_ms"] == "1200"
+    assert first["lat"] == "38.500000" and first["snr"] == "9.50" and first["rssi"] == "-61"
+    assert rows[1]["status"] == "ACK_TIMEOUT_R1" and rows[1]["rtt_ms"] == "1200"
+
+    out = StringIO()
+    log_decoder.write_csv(iter(rows), out)
+    lines = out.getvalue().split("\n")
+    assert lines[0] == ",".join(log_decoder.LOG_COLUMNS)
+    assert lines[1].endswith(",DATA,ACK_OK_R0,0\r")
+
+    # Version 3 files (no dup column) decode with dup 0.
+    v3_row = log_decoder.ROW_RECORD_V3.pack(log_decoder.TAG_ROW, 1000, 900, 970, 0, 0, 0, 0.0, 0.0, 6.0, -60,
+                                            1, 1, 0, 242, b"DATA", b"RX_RECV")
+    v3 = (log_decoder.FILE_HEADER.pack(log_decoder.LOG_BIN_MAGIC, 3, log_decoder.FILE_HEADER.size,
+                                       log_decoder.META_RECORD.size, log_decoder.ROW_RECORD_V3.size, 0)
+          + log_decoder.encode_meta(epoch, 2, 9, 0, 1200, "R2", "RX") + v3_row)
+    assert [r["dup"] for r in log_decoder.iter_csv_rows(v3)] == ["0"]
+
+    csv_bytes = len(out.getvalue()) - len(lines[0]) - 1
+    bin_bytes = 2 * log_decoder.ROW_RECORD.size
+    print(f"  2 rows: {bin_bytes} B binary vs {csv_bytes} B CSV")
+    print("  PASS")
+
+
+def lora_time_on_air_us(frame_len: int, sf: int, bw_khz: float, cr: int, preamble: int = 8,
+                        explicit_header: bool = True, crc_on: bool = True) -> int:
+    """Mirror of loraTimeOnAirUs() in Airtime.h: whole quarter symbols, rounded up to 1 us."""
+    de = 1 if (2 ** sf) / bw_khz >= 16.0 else 0
+    bits = 8 * frame_len - 4 * sf + 28 + (16 if crc_on else 0) - (0 if explicit_header else 20)
+    per_block = 4 * (sf - 2 * de)
+    blocks = -(-bits // per_block) if bits > 0 else 0
+    quarters = preamble * 4 + 17 + 4 * (8 + blocks * cr)
+    return math.ceil(quarters * 250.0 * (2 ** sf) / bw_khz)
+
+
+def test_airtime_log_fields():
+    print("\n--- Test: Airtime Log Fields ---")
+    # Same reference points as the static_asserts in Airtime.cpp (Semtech calculator).
+    assert lora_time_on_air_us(255, 7, 125.0, 5) == 399616
+    assert lora_time_on_air_us(16, 7, 125.0, 5) == 51456
+    assert lora_time_on_air_us(255, 12, 125.0, 5) == 9019392
+    assert lora_time_on_air_us(10, 9, 125.0, 8, 8, False, False) == 148480
+
+    # Predicted and measured airtime ride along in every binary row.
+    data = (log_decoder.encode_header()
+            + log_decoder.encode_meta(1767225600000, 1, 7, 0, 2000, "TOA", "TX")
+            + log_decoder.encode_row(1000, 900, 1000, 0.0, 0.0, 6.0, -60, 1, 1, 0, 242, "DATA", "ACK_OK_R0",
+                                     520, 400, 403))
+    row = next(log_decoder.iter_csv_rows(data))
+    assert (row["toa_ms"], row["tx_ms"]) == ("400", "403")
+    print("  PASS")
+
+
+def test_bench_compare():
+    print("\n--- Test: Benchmark Capture Compare ---")
+    baseline = bench_compare.parse_lines([
+        "# BENCH,name,param,iters,us_per_op,rate,unit",
+        "BENCH,crc32_slice4,4096,64,120.000,34.133,MB/s",
+        "[SD] init ok",
+        "BENCH,sd_read,242,271,400.000,0.600,MB/s",
+        "BENCH,radio_tx,7,5,113000.000,112.896,model_ms",
+    ])
+    current = bench_compare.parse_lines([
+        "BENCH,crc32_slice4,4096,64,125.000,32.768,MB/s",   # +4%: noise
+        "BENCH,sd_read,242,271,480.000,0.500,MB/s",          # +20%: regression
+        "BENCH,sd_read,32,2048,90.0",                        # cut line
+        "BENCH,radio_tx,7,5,200000.000,112.896,model_ms",
+    ])
+    assert set(baseline) == {("crc32_slice4", 4096), ("sd_read", 242), ("radio_tx", 7)}
+    assert ("sd_read", 32) not in current
+
+    lines, regressions = bench_compare.compare(baseline, current, threshold_pct=10.0)
+    assert regressions == [("sd_read", 242)]
+    assert not any(line.startswith("radio_tx") for line in lines)
+    _, regressions = bench_compare.compare(baseline, current, threshold_pct=10.0, include_radio=True)
+    assert ("radio_tx", 7) in regressions
+    print(f"  {len(lines) - 1} keys compared, regressions: {regressions}")
+    print("  PASS")
+
+
+def test_log_status_text():
+    print("\n--- Test: Log Status Text ---")
+    # The text itself is test_log_status_text() in cpp_breaking_tests; the
+    # sweep report must still find the attempt index in what it renders.
+    assert r2_sweep_report.ACK_OK_PATTERN.match("ACK_OK_R2").group(1) == "2"
+    assert r2_sweep_report.ACK_TIMEOUT_PATTERN.match("ACK_TIMEOUT_R1")
+    assert not r2_sweep_report.ACK_OK_PATTERN.match("ACK_SENT")
+    print("  PASS")
+
+
+LORA_COMPACT_VERSION = 3
+COMPACT_HAS_EXP, COMPACT_HAS_POW, COMPACT_HAS_SFCR, COMPACT_HAS_HOPS = 0x01, 0x02, 0x04, 0x08
+
+
+def test_compact_wire_header():
+    print("\n--- Test: Compact Wire Header ---")
+    # The v2 layout byte for byte: little-endian, offsets as in packet.cpp.
+    hdr = build_header(PKT_AUDIO_DATA, 0x01, 0x02, 0x07, 0xABCD, 300, 14, 9, 5)
+    assert hdr.hex(' ') == "22 01 02 07 cd ab 2c 01 0e 95 02 01 03"
+    start = build_audio_start(10, CODEC_RAW_PCM, 8000, 1000, 123456, 0xBEEF)
+    assert struct.unpack_from('<I', start, 7)[0] == 123456 and len(start) == 13
+
+    # Compact frames at the link defaults (exp 0x07, 14 dBm, SF9/CR5); the same
+    # vectors are encoded and expanded on the firmware in cpp_breaking_tests
+    # (test_compact_header_round_trip).
+    compact = bytes.fromhex("32 00 01 02 cd ab ac 02")   # DATA, seq 300
+    assert get_version(compact[0]) == LORA_COMPACT_VERSION and get_type(compact[0]) == PKT_AUDIO_DATA
+    assert compact[1] == 0 and struct.unpack_from('<H', compact, 4)[0] == 0xABCD
+    assert compact[6:] == bytes([(300 & 0x7F) | 0x80, 300 >> 7])   # seq as a 7-bit varint
+    routed = bytes.fromhex("34 0b 02 01 11 11 05 09 14 03 02 02")   # ACK, exp 9, 20 dBm, via 0x03
+    assert routed[1] == COMPACT_HAS_EXP | COMPACT_HAS_POW | COMPACT_HAS_HOPS
+    assert routed[7:9] == bytes([0x09, 20]) and routed[9:] == bytes([0x03, 0x02, 2])
+
+    saved = LORA_HEADER_SIZE - len(compact)
+    toa = lora_time_on_air_us(LORA_HEADER_SIZE + 16, 9, 125.0, 5)
+    toa_c = lora_time_on_air_us(LORA_HEADER_SIZE + 16 - saved, 9, 125.0, 5)
+    print(f"  header 13 B -> 7/8/9 B (seq <128 / <16384 / else); 16 B "
+          f"body at SF9: {toa} -> {toa_c} us on air")
+    print("  PASS")
+
+
+def test_sweep_summary_render():
+    print("\n--- Test: Log Analytics Summary Render ---")
+    header = ",".join(r2_sweep_report.SUMMARY_COLUMNS)
+    summary = StringIO(
+        header + "\n"
+        "SR,9,2000,200,500,450,50,90.00,11.00,480.00,1650.00,1990.00,1500.00,75000.00,1020.00,21600,1310.50\n"
+        "SAW,7,1000,-1,19001,16125,2876,84.86,60.70,511.00,1702.44,2735.10,1200.00,2617800.00,883.00,3870000,1302.00\n"
+        "SR,9,2000,0,800,790,10,98.75,1.25,410.00,600.00,900.00,-1.00,-1.00,-1.00,37920,-1.00\n"
+    )
+    rows = r2_sweep_report.read_summary(summary)
+    assert len(rows) == 3
+
+    out = StringIO()
+    with contextlib.redirect_stdout(out):
+        r2_sweep_report.print_summary(rows)
+    lines = out.getvalue().splitlines()
+    assert lines[0].endswith("rtt_p50_ms,rtt_p95_ms,rtt_p99_ms,median_rto_ms,timeout_wait_ms,"
+                             "median_headroom_ms,goodput_kbps")
+    # Sorted by mode, SF, timeout, then distance bin; -1 passes through.
+    assert [line.split(",")[:4] for line in lines[1:]] == [
+        ["SAW", "7", "1000", "-1"], ["SR", "9", "2000", "0"], ["SR", "9", "2000", "200"]]
+    assert lines[1].split(",")[9:12] == ["511.00", "1702.44", "2735.10"]
+    assert lines[2].endswith(",-1.00,-1.00,-1.00,-1.000")
+    assert lines[3].endswith(",1.310")
+
+    # A per-row report CSV is not a summary.
+    try:
+        r2_sweep_report.read_summary(StringIO("transfer_mode,sf,ack_timeout_ms,attempts\n"))
+    except ValueError as exc:
+        assert "distance_m" in str(exc)
+    else:
+        raise AssertionError("read_summary accepted a file without the summary columns")
+    print(f"  {len(rows)} buckets rendered")
+    print("  PASS")
+
+
+WAKE_PREAMBLE = 64
+WAKE_MIN_SYMBOLS = 8
+LBT_MAX_DEFERS = 5
+RETRY_BACKOFF_MAX_MS = 1000
+
+
+def preamble_detected(offset: int, preamble: int, wake: int = WAKE_PREAMBLE,
+                      min_symbols: int = WAKE_MIN_SYMBOLS) -> bool:
+    """Duty-cycled RX (RadioLib startReceiveDutyCycleAuto): search min_symbols + 1
+    symbols, sleep wake - 2 * min_symbols. Does a preamble starting offset
+    symbols into a cycle overlap some search by min_symbols?"""
+    search = min_symbols + 1
+    period = search + wake - 2 * min_symbols
+    start = 0
+    while start < offset + preamble:
+        overlap = min(start + search, offset + preamble) - max(start, offset)
+        if overlap >= min_symbols:
+            return True
+        start += period
+    return False
+
+
+def lbt_backoff_ms(toa_ms: int, busy: int, draw: int) -> int:
+    """Mirror of the backoff in LoRaManager::_listenBeforeTalk(); draw is random(n)."""
+    return min(toa_ms // 2 + draw % ((toa_ms << busy) + 1), RETRY_BACKOFF_MAX_MS)
+
+
+def test_channel_access():
+    print("\n--- Test: Channel Access (LBT, duty-cycled RX) ---")
+    period = (WAKE_MIN_SYMBOLS + 1) + WAKE_PREAMBLE - 2 * WAKE_MIN_SYMBOLS
+    # A wake preamble is caught wherever in the cycle it starts; a plain one mostly is not.
+    assert all(preamble_detected(offset, WAKE_PREAMBLE) for offset in range(period))
+    plain = sum(preamble_detected(offset, 8) for offset in range(period)) / period
+    assert plain < 0.2, f"8-symbol preamble caught {plain:.2f} of the time"
+    # LoRaManager::rxOnPermille()
+    rx_on_permille = 1000 * (WAKE_MIN_SYMBOLS + 1) // (WAKE_PREAMBLE - WAKE_MIN_SYMBOLS + 1)
+    assert rx_on_permille == 157
+
+    # The wake preamble's cost; which hops get it is test_tx_preamble() in cpp_breaking_tests.
+    extra_us = (lora_time_on_air_us(LORA_HEADER_SIZE + 16, 7, 125.0, 5, WAKE_PREAMBLE)
+                - lora_time_on_air_us(LORA_HEADER_SIZE + 16, 7, 125.0, 5))
+    assert extra_us == (WAKE_PREAMBLE - 8) * 1024
+
+    # Backoff after a busy CAD: at least half an airtime, doubling, capped.
+    toa_ms = -(-lora_time_on_air_us(LORA_HEADER_SIZE + 64, 7, 125.0, 5) // 1000)
+    for busy in range(1, LBT_MAX_DEFERS):
+        lows = [lbt_backoff_ms(toa_ms, busy, d) for d in (0, 7, 12345, (toa_ms << busy))]
+        assert min(lows) == toa_ms // 2
+        assert max(lows) == min(toa_ms // 2 + (toa_ms << busy), RETRY_BACKOFF_MAX_MS)
+    print(f"  wake preamble {WAKE_PREAMBLE} sym: radio on {rx_on_permille / 10:.1f}% while idle, "
+          f"+{extra_us / 1000:.1f} ms on the first frame; plain preamble caught {plain:.0%}")
+    print("  PASS")
+
+
 def test_byte_layout_printout():
     print("\n--- Test: Byte Layout Printout ---")
     dummy = generate_dummy_pcm(500)
@@ -605,16 +1015,19 @@ def test_byte_layout_printout():
         if i == 7:  label = " ← seq_num (high byte)"
         if i == 8:  label = " ← tx_pow"
         if i == 9:  label = " ← sf_cr"
-        if i == 10: label = " ← total_frags (low byte)"
-        if i == 11: label = " ← total_frags (high byte)"
-        if i == 12: label = " ← codec_id"
-        if i == 13: label = " ← sample_hz (low byte)"
-        if i == 14: label = " ← sample_hz (high byte)"
-        if i == 15: label = " ← duration_ms (low byte)"
-        if i == 16: label = " ← duration_ms (high byte)"
-        if i in (17,18,19,20): label = f" ← total_size byte {i-17}"
-        if i == 21: label = " ← crc16 (low byte)"
-        if i == 22: label = " ← crc16 (high byte)"
+        if i == 10: label = " ← next_hop"
+        if i == 11: label = " ← prev_hop"
+        if i == 12: label = " ← ttl"
+        if i == 13: label = " ← total_frags (low byte)"
+        if i == 14: label = " ← total_frags (high byte)"
+        if i == 15: label = " ← codec_id"
+        if i == 16: label = " ← sample_hz (low byte)"
+        if i == 17: label = " ← sample_hz (high byte)"
+        if i == 18: label = " ← duration_ms (low byte)"
+        if i == 19: label = " ← duration_ms (high byte)"
+        if i in (20,21,22,23): label = f" ← total_size byte {i-20}"
+        if i == 24: label = " ← crc16 (low byte)"
+        if i == 25: label = " ← crc16 (high byte)"
         print(f"    [{i:02d}]  0x{b:02X}  ({b:>3}){label}")
 
 
@@ -633,6 +1046,18 @@ def run_all_tests():
     test_full_simulation_raw()
     test_full_simulation_compressed()
     test_airtime_comparison()
+    test_selective_repeat_window()
+    test_fec_parity()
+    test_fragment_size_selection()
+    test_adr_decisions()
+    test_rto_log_fields()
+    test_binary_log_decode()
+    test_airtime_log_fields()
+    test_bench_compare()
+    test_log_status_text()
+    test_compact_wire_header()
+    test_sweep_summary_render()
+    test_channel_access()
     test_byte_layout_printout()
 
     print("\n" + "=" * 50)
@@ -2,11 +2,23 @@
 """
 Phase R2 sweep report generator for LoRa CSV logs.
 
-Reads one or more lora_log.csv files and prints a matrix grouped by (sf, ack_timeout_ms),
-including success rate, retry rate, and median RTT over ACK outcomes.
+Reads one or more lora_log.csv files and prints a matrix grouped by
+(transfer_mode, sf, ack_timeout_ms), including success rate, retry rate, and median RTT
+over ACK outcomes. transfer_mode is SAW (stop-and-wait baseline) or SR (selective repeat);
+ack_timeout_ms is the configured ceiling. Rows with a per-attempt rto_ms (MESH_RTO_ADAPTIVE)
+add the median computed deadline, the time spent waiting on attempts that timed out, and
+the median headroom (rto_ms - rtt_ms) left on ACKed attempts; -1 where a log has none.
+rows from logs that predate the column are counted as SAW. Rows flagged dup=1 (a
+receiver answering a retransmit from its ACK cache) are skipped. Binary logs
+(lora_log.bin, MESH_LOG_FORMAT_BINARY) are decoded with log_decoder.py.
+
+For multi-day or multi-node runs, aggregate with the compiled
+tests/log_analytics tool and render its summary CSV here with --summary. The
+summary adds RTT p95/p99, a GPS distance bin and goodput_bps per bucket.
 
 Usage:
-  python r2_sweep_report.py path/to/lora_log.csv [path/to/another.csv ...]
+  python r2_sweep_report.py path/to/lora_log.csv [path/to/lora_log.bin ...]
+  python r2_sweep_report.py --summary log_analytics_summary.csv
 """
 
 from __future__ import annotations
@@ -20,6 +32,8 @@ from dataclasses import dataclass, field
 from pathlib import Path
 from typing import DefaultDict, Iterable
 
+from log_decoder import read_log
+
 
 ACK_OK_PATTERN = re.compile(r"^ACK_OK_R(\d+)$")
 ACK_TIMEOUT_PATTERN = re.compile(r"^ACK_TIMEOUT_R(\d+)$")
@@ -32,8 +46,11 @@ class Bucket:
     timeout: int = 0
     retry_attempts: int = 0
     rtt_values_ms: list[float] = field(default_factory=list)
+    rto_values_ms: list[float] = field(default_factory=list)
+    headroom_values_ms: list[float] = field(default_factory=list)
+    timeout_wait_ms: float = 0.0
 
-    def consume(self, status: str, rtt_ms: float) -> None:
+    def consume(self, status: str, rtt_ms: float, rto_ms: float = -1.0) -> None:
         ok_match = ACK_OK_PATTERN.match(status)
         timeout_match = ACK_TIMEOUT_PATTERN.match(status)
         if ok_match:
@@ -43,6 +60,10 @@ class Bucket:
             self.retry_attempts += retry_idx
             if rtt_ms >= 0:
                 self.rtt_values_ms.append(rtt_ms)
+            if rto_ms > 0:
+                self.rto_values_ms.append(rto_ms)
+                if rtt_ms >= 0:
+                    self.headroom_values_ms.append(rto_ms - rtt_ms)
         elif timeout_match:
             self.attempts += 1
             self.timeout += 1
@@ -50,9 +71,12 @@ class Bucket:
             self.retry_attempts += retry_idx
             if rtt_ms >= 0:
                 self.rtt_values_ms.append(rtt_ms)
+            if rto_ms > 0:
+                self.rto_values_ms.append(rto_ms)
+                self.timeout_wait_ms += rto_ms
 
 
-Key = tuple[int, int]
+Key = tuple[str, int, int]
 
 
 def parse_int(value: str, fallback: int) -> int:
@@ -71,6 +95,10 @@ def parse_float(value: str, fallback: float) -> float:
 
 def iter_rows(csv_paths: Iterable[Path]):
     for path in csv_paths:
+        if path.suffix.lower() == ".bin":
+            for row in read_log(path):
+                yield path, row
+            continue
         with path.open("r", newline="", encoding="utf-8") as handle:
             reader = csv.DictReader(handle)
             for row in reader:
@@ -84,12 +112,16 @@ def aggregate(csv_paths: list[Path]) -> DefaultDict[Key, Bucket]:
         sf = parse_int((row.get("sf") or "").strip(), -1)
         timeout_ms = parse_int((row.get("ack_timeout_ms") or "").strip(), -1)
         rtt_ms = parse_float((row.get("rtt_ms") or "").strip(), -1.0)
+        rto_ms = parse_float((row.get("rto_ms") or "").strip(), -1.0)
+        mode = (row.get("transfer_mode") or "").strip() or "SAW"
+        if (row.get("dup") or "").strip() == "1":
+            continue
 
         if sf < 0 or timeout_ms < 0:
             # Skip legacy rows without R2 metadata columns.
             continue
 
-        buckets[(sf, timeout_ms)].consume(status, rtt_ms)
+        buckets[(mode, sf, timeout_ms)].consume(status, rtt_ms, rto_ms)
 
     return buckets
 
@@ -99,24 +131,88 @@ def print_report(buckets: DefaultDict[Key, Bucket]) -> None:
         print("No Phase R2 rows found. Ensure CSV has sf and ack_timeout_ms columns.")
         return
 
-    print("sf,ack_timeout_ms,attempts,ack_ok,timeouts,success_rate_pct,retry_rate_pct,median_rtt_ms")
-    for (sf, timeout_ms) in sorted(buckets.keys()):
-        bucket = buckets[(sf, timeout_ms)]
+    print("transfer_mode,sf,ack_timeout_ms,attempts,ack_ok,timeouts,success_rate_pct,retry_rate_pct,median_rtt_ms,"
+          "median_rto_ms,timeout_wait_ms,median_headroom_ms")
+    for (mode, sf, timeout_ms) in sorted(buckets.keys()):
+        bucket = buckets[(mode, sf, timeout_ms)]
         success_rate = (100.0 * bucket.ack_ok / bucket.attempts) if bucket.attempts else 0.0
         retry_rate = (100.0 * bucket.retry_attempts / bucket.attempts) if bucket.attempts else 0.0
         median_rtt = statistics.median(bucket.rtt_values_ms) if bucket.rtt_values_ms else -1.0
+        median_rto = statistics.median(bucket.rto_values_ms) if bucket.rto_values_ms else -1.0
+        median_headroom = statistics.median(bucket.headroom_values_ms) if bucket.headroom_values_ms else -1.0
+        timeout_wait = bucket.timeout_wait_ms if bucket.rto_values_ms else -1.0
+
+        print(
+            f"{mode},{sf},{timeout_ms},{bucket.attempts},{bucket.ack_ok},{bucket.timeout},"
+            f"{success_rate:.2f},{retry_rate:.2f},{median_rtt:.2f},"
+            f"{median_rto:.2f},{timeout_wait:.2f},{median_headroom:.2f}"
+        )
+
+
+SUMMARY_COLUMNS = (
+    "transfer_mode", "sf", "ack_timeout_ms", "distance_m", "attempts", "ack_ok", "timeouts",
+    "success_rate_pct", "retry_rate_pct", "rtt_p50_ms", "rtt_p95_ms", "rtt_p99_ms",
+    "median_rto_ms", "timeout_wait_ms", "median_headroom_ms", "acked_bytes", "goodput_bps",
+)
 
+
+def read_summary(handle) -> list[dict[str, str]]:
+    """Rows of a log_analytics summary CSV; raises ValueError on a missing column."""
+    reader = csv.DictReader(handle)
+    missing = [name for name in SUMMARY_COLUMNS if name not in (reader.fieldnames or [])]
+    if missing:
+        raise ValueError(f"not a log_analytics summary, missing: {', '.join(missing)}")
+    return list(reader)
+
+
+def print_summary(rows: list[dict[str, str]]) -> None:
+    if not rows:
+        print("No Phase R2 rows found in summary.")
+        return
+
+    print("transfer_mode,sf,ack_timeout_ms,distance_m,attempts,ack_ok,timeouts,success_rate_pct,retry_rate_pct,"
+          "rtt_p50_ms,rtt_p95_ms,rtt_p99_ms,median_rto_ms,timeout_wait_ms,median_headroom_ms,goodput_kbps")
+
+    def key(row: dict[str, str]):
+        return (row["transfer_mode"], parse_int(row["sf"], -1), parse_int(row["ack_timeout_ms"], -1),
+                parse_int(row["distance_m"], -1))
+
+    for row in sorted(rows, key=key):
+        values = [parse_float(row[name], -1.0) for name in (
+            "success_rate_pct", "retry_rate_pct", "rtt_p50_ms", "rtt_p95_ms", "rtt_p99_ms",
+            "median_rto_ms", "timeout_wait_ms", "median_headroom_ms")]
+        goodput = parse_float(row["goodput_bps"], -1.0)
+        goodput_kbps = goodput / 1000.0 if goodput >= 0 else -1.0
+        mode, sf, timeout_ms, distance_m = key(row)
         print(
-            f"{sf},{timeout_ms},{bucket.attempts},{bucket.ack_ok},{bucket.timeout},"
-            f"{success_rate:.2f},{retry_rate:.2f},{median_rtt:.2f}"
+            f"{mode},{sf},{timeout_ms},{distance_m},{row['attempts']},{row['ack_ok']},{row['timeouts']},"
+            + ",".join(f"{value:.2f}" for value in values)
+            + f",{goodput_kbps:.3f}"
         )
 
 
 def main() -> int:
     parser = argparse.ArgumentParser(description="Generate Phase R2 SF/timeout sweep matrix from CSV logs.")
-    parser.add_argument("csv", nargs="+", help="One or more lora_log.csv files")
+    parser.add_argument("csv", nargs="*", help="One or more lora_log.csv / lora_log.bin files")
+    parser.add_argument("--summary", help="Render a log_analytics summary CSV instead of reading logs")
     args = parser.parse_args()
 
+    if args.summary:
+        summary_path = Path(args.summary).resolve()
+        if not summary_path.exists():
+            print(f"Missing summary file: {summary_path}")
+            return 2
+        with summary_path.open("r", newline="", encoding="utf-8") as handle:
+            try:
+                rows = read_summary(handle)
+            except ValueError as exc:
+                print(exc)
+                return 2
+        print_summary(rows)
+        return 0
+    if not args.csv:
+        parser.error("give one or more log files, or --summary")
+
     csv_paths = [Path(p).resolve() for p in args.csv]
     missing = [str(p) for p in csv_paths if not p.exists()]
     if missing:
@@ -4,392 +4,331 @@
 #include "../src/models/packet.h"
 #include "../src/storage/SdManager.h"
 #include "../src/comms/LoraManager.h"
+#include "../src/comms/Airtime.h"
+#include "../src/bus/SpiArbiter.h"
 #include "../src/app/ResearchStateMachine.h"
+#include "../src/app/WindowedSender.h"
+#include "../src/app/TransferTask.h"
+#include "../src/app/WorkerTask.h"
 #include "../src/display/StatusDisplay.h"
+#include "../src/mesh/MeshRouter.h"
+#include "../src/util/StageProfiler.h"
+#include "../src/util/HeapMonitor.h"
 
 SdManager sdMgr;
 bool g_sd_ready = false;
 
 LoRaManager lora;
 ResearchStateMachine state("TX");
+WindowedSender windowSender(lora, sdMgr);
+TransferTask transfer(lora, sdMgr, state, windowSender);
 
 // Session
 uint16_t g_session_id;
 uint16_t g_seq_num;
-uint32_t timeout_ms = 2000;
+uint32_t timeout_ms = static_cast<uint32_t>(MESH_ACK_TIMEOUT_MS);
 
 // Placeholder location until GPS integration is added
 constexpr float kDefaultLat = 0.0f;
 constexpr float kDefaultLon = 0.0f;
 
 constexpr const char* kPayloadFile = "lora_payload_new.bin";
-constexpr uint8_t kPayloadCodec = CODEC_RAW_PCM;
+constexpr uint8_t kPayloadCodec = MESH_PAYLOAD_CODEC;
 constexpr uint16_t kPayloadSampleHz = 8000;
 constexpr uint16_t kPayloadDurationMs = 0;
 constexpr uint8_t kMaxAckRetries = 2;
 
-static void withRetrySuffix(char* out, size_t outLen, const char* baseStatus, uint8_t retryIndex)
-{
-    snprintf(out, outLen, "%s_R%u", baseStatus, static_cast<unsigned>(retryIndex));
-}
+// Next transfer (or SD / payload check) is due at this millis().
+static uint32_t g_nextRunMs = 0;
 
-static uint32_t crc32Update(uint32_t crc, const uint8_t* data, size_t len)
+static void logAck(uint32_t txTimeMs, bool ackOk, uint16_t seqNum, uint8_t packetType, LogStatus status,
+                   int16_t fragIndex, uint16_t fragLen, uint8_t retryIndex, uint32_t rtoMs)
 {
-    for (size_t i = 0; i < len; ++i)
+    if (packetType == PKT_AUDIO_DATA)
     {
-        crc ^= data[i];
-        for (uint8_t bit = 0; bit < 8; ++bit)
+        if (ackOk)
+        {
+            StatusDisplay::onPacketSent();
+        }
+        else if (retryIndex == kMaxAckRetries)
         {
-            crc = (crc & 1U) ? ((crc >> 1) ^ 0xEDB88320UL) : (crc >> 1);
+            StatusDisplay::setMessage(status == LOG_STATUS_TX_FAIL ? "Failed Sending Data Frag!" : "Data Frag ACK Timeout!");
         }
     }
-    return crc;
+    if (!g_sd_ready)
+        return;
+    const uint32_t ackTimeMs = ackOk ? lora.getLastRxMs() : millis();
+    const int rssi = ackOk ? static_cast<int>(lora.getLastRSSI()) : 0;
+    const float snr = ackOk ? lora.getLastSNR() : 0.0f;
+    // Airtime columns describe the frame just sent (waiting for its ACK sends nothing).
+    const uint32_t toaMs = lora.lastToaMs();
+    const uint32_t txMs = lora.lastTxMs();
+    Serial.printf("[LOG] write csv row type=%s status=%s retry=%u tx=%lu ack=%lu rto=%lu toa=%lu tx_ms=%lu rssi=%d snr=%.1f\n",
+                  packetTypeLabel(packetType), logStatusLabel(status), static_cast<unsigned>(retryIndex),
+                  static_cast<unsigned long>(txTimeMs), static_cast<unsigned long>(ackTimeMs),
+                  static_cast<unsigned long>(rtoMs), static_cast<unsigned long>(toaMs),
+                  static_cast<unsigned long>(txMs), rssi, snr);
+
+    const bool logged = sdMgr.logTransmission(kDefaultLat, kDefaultLon, txTimeMs, ackTimeMs, rssi, snr,
+                                              g_session_id, seqNum, fragIndex, fragLen, packetType, status,
+                                              retryIndex, rtoMs, toaMs, txMs);
+    if (!logged)
+    {
+        Serial.println("[LOG] SD row persist failed");
+    }
 }
 
-static bool getPayloadStats(SdManager& manager, const char* filename,
-                            uint32_t& totalSize, uint16_t& totalFrags, uint32_t& payloadCrc)
+static void logWindowFragment(uint32_t txTimeMs, bool ackOk, uint16_t seqNum,
+                              int16_t fragIndex, uint16_t fragLen,
+                              LogStatus status, uint8_t retryIndex,
+                              uint32_t toaMs, uint32_t txMs)
 {
-    totalSize = 0;
-    totalFrags = 0;
-    payloadCrc = 0;
-
-    if (!manager.openAudioFile(filename))
+    if (ackOk)
     {
-        Serial.printf("[TX] Unable to open payload file: %s\n", filename);
-        return false;
+        StatusDisplay::onPacketSent();
     }
+    if (!g_sd_ready)
+        return;
+    // Arrival time of the ACK frame, not of this (possibly later) log call.
+    const uint32_t ackTimeMs = ackOk ? lora.getLastRxMs() : millis();
+    const int rssi = ackOk ? static_cast<int>(lora.getLastRSSI()) : 0;
+    const float snr = ackOk ? lora.getLastSNR() : 0.0f;
+    Serial.printf("[LOG] write csv row type=DATA status=%s retry=%u seq=%u tx=%lu ack=%lu toa=%lu tx_ms=%lu\n",
+                  logStatusLabel(status), static_cast<unsigned>(retryIndex), seqNum,
+                  static_cast<unsigned long>(txTimeMs), static_cast<unsigned long>(ackTimeMs),
+                  static_cast<unsigned long>(toaMs), static_cast<unsigned long>(txMs));
+    if (!sdMgr.logTransmission(kDefaultLat, kDefaultLon, txTimeMs, ackTimeMs, rssi, snr,
+                               g_session_id, seqNum, fragIndex, fragLen, PKT_AUDIO_DATA_WIN, status, retryIndex,
+                               0, toaMs, txMs))
+    {
+        Serial.println("[LOG] SD row persist failed");
+    }
+}
 
-    uint32_t crcState = 0xFFFFFFFFUL;
-    uint32_t fragCount = 0;
-    AudioPacket packet;
-    while (manager.readAudioChunk(packet))
+// Serial commands: 'h' prints the heap (and worker) report, 'p' the stage histograms
+// gathered so far (MESH_PROFILE_ENABLE).
+static void serviceSerialCommands()
+{
+    while (Serial.available() > 0)
     {
-        if (packet.bytesRead <= 0)
+        const int cmd = Serial.read();
+        if (cmd == 'h')
         {
-            continue;
+            HeapMonitor::printStats();
+            WorkerTask::printStats();
         }
-        totalSize += static_cast<uint32_t>(packet.bytesRead);
-        crcState = crc32Update(crcState, packet.buffer, static_cast<size_t>(packet.bytesRead));
-        fragCount++;
+#if MESH_PROFILE_ENABLE
+        else if (cmd == 'p')
+        {
+            StageProfiler::printStats();
+        }
+#endif
     }
+}
 
-    manager.closeAudioFile();
-
-    if (totalSize == 0 || fragCount == 0)
+#if MESH_PROFILE_ENABLE
+// Stage histograms of the transfer just finished, to serial and lora_prof.csv;
+// then start over so each session's rows stand alone.
+static void dumpProfile()
+{
+    StageProfiler::printStats();
+    static char csv[1024];
+    const size_t len = StageProfiler::formatCsv(csv, sizeof(csv), MESH_RUN_ID, g_session_id);
+    if (g_sd_ready && len > 0 && !sdMgr.writeProfile(csv, len))
     {
-        Serial.println("[TX] Payload file is empty");
-        return false;
+        Serial.println("[PROF] lora_prof.csv write failed");
     }
+    StageProfiler::reset();
+}
+#endif
 
-    if (fragCount > 0xFFFF)
+// Refills the payload read-ahead and drains the CSV log queue while the
+// radio waits (LoRaManager::onIdle) and in the idle loop.
+static void serviceSdLog()
+{
+    if (g_sd_ready)
     {
-        Serial.printf("[TX] Payload too large, fragments=%lu exceeds protocol max\n", static_cast<unsigned long>(fragCount));
-        return false;
+        sdMgr.serviceReadAhead();
+        sdMgr.serviceLog();
     }
-
-    totalFrags = static_cast<uint16_t>(fragCount);
-    payloadCrc = ~crcState;
-    return true;
 }
 
-void setup()
+// LoRaManager::onIdle work: the SD log queue, then the display when the
+// wait leaves room for a frame.
+static void serviceIdle()
 {
-    Serial.begin(115200);
-    delay(2000);
-    Serial.println("\n=== LoRa Audio Transmitter ===");
-
-    Serial.println("Initializing Display...");
-    StatusDisplay::init();
+    serviceSdLog();
+    StatusDisplay::service(lora.quietMs());
+}
 
-    Serial.println("Initializing SD...");
+// Rows and (auto) fragment sizing follow the rate ADR settled on.
+static void onLinkRateChanged()
+{
+    const LoRaRate& rate = lora.rate();
+    sdMgr.setLinkSf(rate.sf);
+#if MESH_FRAG_SIZE == MESH_FRAG_SIZE_AUTO
+    sdMgr.setChunkSize(optimalFragmentSize(rate.sf, bwCodeToKhz(rate.bwCode), rate.cr));
+#endif
+}
 
-    g_sd_ready = sdMgr.init();
-    delay(2000);
-    if (!g_sd_ready)
+// TransferTask is finished: stats, then ADR and the next session.
+static void onTransferDone(const TransferSummary& summary)
+{
+    StatusDisplay::setLoRa(StatusDisplay::LORA_OK_IDLE);
+    if (!summary.started)
     {
-        Serial.println("SD init failed; logging disabled");
+        // No session was opened on the receiver; try again with this one.
+        g_nextRunMs = millis() + MESH_TX_RETRY_MS;
+        return;
     }
-    else
+    StatusDisplay::setMessage(summary.endAcked ? "Transfer complete" : "Transfer done w/ END fail");
+    if (g_sd_ready)
     {
-        Serial.println("SD ready; logging to lora_log.csv");
+        sdMgr.flushLog();
     }
-    StatusDisplay::setSD(g_sd_ready);
-
-    Serial.println("Initializing LoRa...");
-    g_session_id = (uint16_t)(millis() & 0xFFFF);
+    SpiArbiter::printStats();
+    HeapMonitor::printStats();
+    WorkerTask::printStats();
+    MeshRouter::printStats();
+    lora.printListenStats();
+    state.printStats();
+    state.resetStats();
+#if MESH_PROFILE_ENABLE
+    dumpProfile();
+#endif
+    // Rate changes happen between transfers, never inside one.
+    if (lora.serviceAdr(timeout_ms))
+    {
+        onLinkRateChanged();
+    }
+    if (summary.resumable)
+    {
+        // Same session again: the receiver still has what it got of this one.
+        Serial.printf("Transfer interrupted. Resuming session 0x%04X in %lus\n\n", g_session_id,
+                      static_cast<unsigned long>(MESH_TX_RETRY_MS / 1000));
+        StatusDisplay::refresh();
+        g_nextRunMs = millis() + MESH_TX_RETRY_MS;
+        return;
+    }
+    g_session_id++;
     g_seq_num = 0;
-    bool loraOk = lora.init(&g_session_id, &g_seq_num);
+    lora.setSession(g_session_id, g_seq_num);
 
-    StatusDisplay::setLoRa(loraOk ? StatusDisplay::LORA_OK_IDLE : StatusDisplay::LORA_FAIL);
-    state.transition(ResearchEvent::SETUP_COMPLETE);
-
-    Serial.printf("Session: 0x%04X\n", g_session_id);
-    Serial.println("LoRa ready\n");
+    Serial.printf("Transfer complete. Next in %lus\n\n", static_cast<unsigned long>(MESH_TX_REPEAT_MS / 1000));
+    StatusDisplay::refresh();
+    g_nextRunMs = millis() + MESH_TX_REPEAT_MS;
 }
 
-void loop()
+// Next transfer once the previous one (or a failed check) has waited its turn.
+static void startTransferIfDue()
 {
-
+    if (transfer.busy() || static_cast<int32_t>(millis() - g_nextRunMs) < 0)
+    {
+        return;
+    }
     if (!g_sd_ready)
     {
         Serial.println("SD not ready; cannot transmit payload file");
         StatusDisplay::setMessage("SD not ready");
-        delay(2000);
+        g_nextRunMs = millis() + MESH_TX_RETRY_MS;
         return;
     }
-
-    auto logAck = [&](uint32_t txTimeMs, bool ackOk, const char *packetType, const char *status,
-                      int16_t fragIndex, uint16_t fragLen, uint8_t retryIndex)
-    {
-        if (!g_sd_ready)
-            return;
-        const uint32_t ackTimeMs = millis();
-        const int rssi = ackOk ? static_cast<int>(lora.getLastRSSI()) : 0;
-        const float snr = ackOk ? lora.getLastSNR() : 0.0f;
-        const uint16_t seqNum = lora.getLastSeqNum();
-        Serial.printf("[LOG] write csv row type=%s status=%s retry=%u tx=%lu ack=%lu rssi=%d snr=%.1f\n",
-                      packetType, status, static_cast<unsigned>(retryIndex), txTimeMs, ackTimeMs, rssi, snr);
-
-        delay(200);
-        const bool logged = sdMgr.logTransmission(kDefaultLat, kDefaultLon, txTimeMs, ackTimeMs, rssi, snr,
-                                                  g_session_id, seqNum, fragIndex, fragLen, packetType, status);
-        if (!logged)
-        {
-            Serial.println("[LOG] SD row persist failed");
-        }
-    };
-
-    uint32_t payloadSize = 0;
-    uint16_t total_frags = 0;
-    uint32_t audio_crc = 0;
-    if (!getPayloadStats(sdMgr, kPayloadFile, payloadSize, total_frags, audio_crc))
+    StatusDisplay::setLoRa(StatusDisplay::LORA_TRANSMITTING);
+    StatusDisplay::setMessage("Transmitting payload...");
+    if (!transfer.start(kPayloadFile, kPayloadCodec, kPayloadSampleHz, kPayloadDurationMs,
+                        timeout_ms, kMaxAckRetries))
     {
+        StatusDisplay::setLoRa(StatusDisplay::LORA_OK_IDLE);
         StatusDisplay::setMessage("Missing/invalid payload");
-        delay(3000);
-        return;
-    }
-
-    if (!sdMgr.openAudioFile(kPayloadFile))
-    {
-        Serial.printf("[TX] Failed to reopen payload file for transmit: %s\n", kPayloadFile);
-        StatusDisplay::setMessage("Payload open failed");
-        delay(3000);
-        return;
+        g_nextRunMs = millis() + MESH_TX_RETRY_MS;
     }
+}
 
-    Serial.printf("Starting transfer from %s: %lu bytes, %u fragments, CRC32=0x%08lX\n",
-                  kPayloadFile,
-                  static_cast<unsigned long>(payloadSize),
-                  total_frags,
-                  static_cast<unsigned long>(audio_crc));
-    StatusDisplay::setLoRa(StatusDisplay::LORA_TRANSMITTING);
-    StatusDisplay::setMessage("Transmitting payload...");
-
-    // ── 1. Send AUDIO_START ──────────────────────
-    bool startAckOk = false;
-    for (uint8_t retry = 0; retry <= kMaxAckRetries; ++retry)
+// Frames nobody is waiting for (an ACK that came after its deadline, a
+// stray broadcast); the armed ACK is taken before it gets here.
+static void drainReceived()
+{
+    uint8_t raw[LORA_MAX_PAYLOAD];
+    size_t len = 0;
+    while (lora.receiveRaw(raw, sizeof(raw), &len))
     {
-        state.transition(ResearchEvent::PAYLOAD_AVAILABLE);
-        uint32_t startTxTime = millis();
-        bool startSent = lora.sendAudioStart(total_frags, kPayloadCodec, kPayloadSampleHz, kPayloadDurationMs, payloadSize);
-
-        if (!startSent)
+        if (len < LORA_HEADER_SIZE)
         {
-            state.transition(ResearchEvent::TX_FAILED);
-            char status[24];
-            withRetrySuffix(status, sizeof(status), "TX_FAIL", retry);
-            delay(200);
-            logAck(startTxTime, false, "START", status, -1, 0, retry);
-
-            if (retry == kMaxAckRetries)
-            {
-                Serial.println("START failed after retries");
-                sdMgr.closeAudioFile();
-                StatusDisplay::setLoRa(StatusDisplay::LORA_OK_IDLE);
-                delay(3000);
-                return;
-            }
-            delay(50);
             continue;
         }
+        LoRaHeader hdr;
+        deserializeHeader(raw, &hdr);
+        Serial.printf("[RX] Ignored %s seq=%u\n", packetTypeLabel(getType(hdr.ver_type)), hdr.seq_num);
+    }
+}
 
-        state.transition(ResearchEvent::TX_COMPLETE);
-        startAckOk = lora.waitForAck(lora.getLastSeqNum(), timeout_ms);
-
-        char status[24];
-        withRetrySuffix(status, sizeof(status), startAckOk ? "ACK_OK" : "ACK_TIMEOUT", retry);
-        delay(200);
-        logAck(startTxTime, startAckOk, "START", status, -1, 0, retry);
+void setup()
+{
+    Serial.begin(115200);
+    delay(2000);
+    Serial.println("\n=== LoRa Audio Transmitter ===");
 
-        if (startAckOk)
-        {
-            state.transition(ResearchEvent::ACK_VALID);
-            break;
-        }
+    Serial.println("Initializing Display...");
+    StatusDisplay::init();
 
-        if (retry < kMaxAckRetries)
-        {
-            state.transition(ResearchEvent::ACK_TIMEOUT);
-        }
-        else
-        {
-            state.transition(ResearchEvent::RETRY_EXHAUSTED);
-        }
-        delay(50);
-    }
+    Serial.println("Initializing SD...");
 
-    if (!startAckOk)
+    g_sd_ready = sdMgr.init();
+    delay(2000);
+    if (!g_sd_ready)
     {
-        sdMgr.closeAudioFile();
-        StatusDisplay::setLoRa(StatusDisplay::LORA_OK_IDLE);
-        delay(3000);
-        return;
+        Serial.println("SD init failed; logging disabled");
     }
-
-    // ── 2. Send DATA fragments ───────────────────
-    uint16_t dataOkCount = 0;
-    uint16_t dataFailCount = 0;
-    uint16_t frag = 0;
-    AudioPacket packet;
-    while (sdMgr.readAudioChunk(packet))
+    else
     {
-        if (packet.bytesRead <= 0)
-        {
-            continue;
-        }
-
-        const uint16_t chunk = static_cast<uint16_t>(packet.bytesRead);
-        bool dataAckOk = false;
-
-        for (uint8_t retry = 0; retry <= kMaxAckRetries; ++retry)
-        {
-            state.transition(ResearchEvent::PAYLOAD_AVAILABLE);
-            const uint32_t dataTxTime = millis();
-            bool dataSent = lora.sendAudioData(packet.buffer, static_cast<uint8_t>(chunk));
-
-            if (!dataSent)
-            {
-                state.transition(ResearchEvent::TX_FAILED);
-                char status[24];
-                withRetrySuffix(status, sizeof(status), "TX_FAIL", retry);
-                delay(200);
-                logAck(dataTxTime, false, "DATA", status,
-                       static_cast<int16_t>(frag), static_cast<uint16_t>(chunk), retry);
-
-                if (retry == kMaxAckRetries)
-                {
-                    dataFailCount++;
-                    Serial.printf("DATA frag %u failed after retries\n", frag);
-                    StatusDisplay::setMessage("Failed Sending Data Frag!");
-                }
-                else
-                {
-                    delay(50);
-                }
-                continue;
-            }
-
-            state.transition(ResearchEvent::TX_COMPLETE);
-            dataAckOk = lora.waitForAck(lora.getLastSeqNum(), timeout_ms);
-
-            char status[24];
-            withRetrySuffix(status, sizeof(status), dataAckOk ? "ACK_OK" : "ACK_TIMEOUT", retry);
-            delay(200);
-            logAck(dataTxTime, dataAckOk, "DATA", status,
-                   static_cast<int16_t>(frag), static_cast<uint16_t>(chunk), retry);
-
-            if (dataAckOk)
-            {
-                state.transition(ResearchEvent::ACK_VALID);
-                dataOkCount++;
-                break;
-            }
-
-            if (retry < kMaxAckRetries)
-            {
-                state.transition(ResearchEvent::ACK_TIMEOUT);
-                delay(50);
-            }
-            else
-            {
-                state.transition(ResearchEvent::RETRY_EXHAUSTED);
-                dataFailCount++;
-                Serial.printf("DATA frag %u no ACK after retries\n", frag);
-                StatusDisplay::setMessage("Data Frag ACK Timeout!");
-            }
-        }
-
-        if (dataAckOk)
-        {
-            StatusDisplay::onPacketSent();
-        }
-        frag++;
-        delay(50);
+        Serial.printf("SD ready; logging to %s\n",
+                      MESH_LOG_FORMAT == MESH_LOG_FORMAT_BINARY ? "lora_log.bin" : "lora_log.csv");
     }
+    StatusDisplay::setSD(g_sd_ready);
 
-    sdMgr.closeAudioFile();
+    // total_frags in AUDIO_START is counted with the same chunk size.
+    sdMgr.setPayloadCodec(kPayloadCodec);
+    sdMgr.setChunkSize(configuredFragmentSize());
+    Serial.printf("Fragment size: %u bytes (%s)\n",
+                  static_cast<unsigned>(sdMgr.chunkSize()),
+                  MESH_FRAG_SIZE == MESH_FRAG_SIZE_AUTO ? "auto" : "fixed");
 
-    Serial.printf("DATA summary: acked=%u failed_or_timeout=%u total=%u\n",
-                  dataOkCount, dataFailCount, frag);
-                  
-    // ── 3. Send AUDIO_END ────────────────────────
-    bool endAckOk = false;
-    for (uint8_t retry = 0; retry <= kMaxAckRetries; ++retry)
+    Serial.println("Initializing LoRa...");
+    g_session_id = (uint16_t)(millis() & 0xFFFF);
+    g_seq_num = 0;
+    // An unfinished transfer keeps its session so the receiver can resume it.
+    if (g_sd_ready && transfer.savedSession(g_session_id))
     {
-        state.transition(ResearchEvent::PAYLOAD_AVAILABLE);
-        uint32_t endTxTime = millis();
-        bool endSentOk = lora.sendAudioEnd(frag, audio_crc);
-
-        if (!endSentOk)
-        {
-            state.transition(ResearchEvent::TX_FAILED);
-            char status[24];
-            withRetrySuffix(status, sizeof(status), "TX_FAIL", retry);
-            delay(200);
-            logAck(endTxTime, false, "END", status, -1, 0, retry);
-
-            if (retry == kMaxAckRetries)
-            {
-                Serial.println("END send failed after retries");
-            }
-            else
-            {
-                delay(50);
-            }
-            continue;
-        }
+        Serial.printf("Resuming unfinished transfer in session 0x%04X\n", g_session_id);
+    }
+    bool loraOk = lora.init(&g_session_id, &g_seq_num);
+    lora.onIdle(serviceIdle);
+    MeshRouter::begin(lora);
 
-        state.transition(ResearchEvent::TX_COMPLETE);
-        endAckOk = lora.waitForAck(lora.getLastSeqNum(), timeout_ms);
-        char status[24];
-        withRetrySuffix(status, sizeof(status), endAckOk ? "ACK_OK" : "ACK_TIMEOUT", retry);
-        delay(200);
-        logAck(endTxTime, endAckOk, "END", status, -1, 0, retry);
+    StatusDisplay::setLoRa(loraOk ? StatusDisplay::LORA_OK_IDLE : StatusDisplay::LORA_FAIL);
+    StatusDisplay::refresh();
+#if MESH_DUAL_CORE
+    // SD log, payload writes and the OLED move to the other core from here on.
+    WorkerTask::begin(g_sd_ready ? &sdMgr : nullptr);
+#endif
+    HeapMonitor::mark();
+    transfer.begin({logAck, logWindowFragment, onTransferDone});
+    state.transition(ResearchEvent::SETUP_COMPLETE);
 
-        if (endAckOk)
-        {
-            state.transition(ResearchEvent::ACK_VALID);
-            break;
-        }
+    Serial.printf("Session: 0x%04X\n", g_session_id);
+    Serial.println("LoRa ready\n");
+}
 
-        if (retry < kMaxAckRetries)
-        {
-            state.transition(ResearchEvent::ACK_TIMEOUT);
-            delay(50);
-        }
-        else
-        {
-            state.transition(ResearchEvent::RETRY_EXHAUSTED);
-            Serial.println("END ACK timeout after retries");
-        }
-    }
+void loop()
+{
+    MeshRouter::service();
+    serviceSerialCommands();
 
-    // ── Bump session for next run ────────────────
-    StatusDisplay::setLoRa(StatusDisplay::LORA_OK_IDLE);
-    StatusDisplay::setMessage("Transfer complete");
-    g_session_id++;
-    g_seq_num = 0;
+    startTransferIfDue();
+    transfer.service();
+    state.run();
+    drainReceived();
 
-    Serial.println("Transfer complete. Waiting 10s...\n");
-    delay(10000);
+    serviceSdLog();
+    StatusDisplay::service(lora.quietMs());
 }